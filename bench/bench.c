@@ -0,0 +1,200 @@
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "yyjson.h"
+
+#define BENCH_SAMPLES 64
+#define BENCH_SAMPLE_NS (2ull * 1000 * 1000) // target duration of one sample
+#define BENCH_MAX_CASES 128
+
+typedef struct {
+	char name[64];
+	size_t ops; // per sample
+	double mean, min, p50, p90, p99; // ns/op
+	double allocs, bytes; // per op
+} bench_result;
+
+typedef struct {
+	char name[64];
+	double value;
+} bench_value;
+
+static bench_result g_results[BENCH_MAX_CASES];
+static int g_result_count;
+static bench_value g_metrics[BENCH_MAX_CASES];
+static int g_metric_count;
+static int g_failures;
+static const char* const* g_filters;
+static int g_filter_count;
+
+uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+bool bench_selected(const char* name)
+{
+	if (g_filter_count == 0)
+		return true;
+	for (int i = 0; i < g_filter_count; i++) {
+		if (strstr(name, g_filters[i]))
+			return true;
+	}
+	return false;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int count, double pct)
+{
+	int idx = (int)(pct * (count - 1) + 0.5);
+	return sorted[idx];
+}
+
+bool bench_run(const char* name, bench_fn fn, void* state)
+{
+	if (!bench_selected(name) || g_result_count == BENCH_MAX_CASES)
+		return false;
+
+	// grow the batch until one sample is long enough to time reliably
+	size_t ops = 1;
+	for (;;) {
+		uint64_t start = bench_now_ns();
+		fn(state, ops);
+		if (bench_now_ns() - start >= BENCH_SAMPLE_NS || ops >= (1u << 30))
+			break;
+		ops *= 2;
+	}
+
+	double samples[BENCH_SAMPLES];
+	double total_ns = 0;
+	uint64_t allocs = bench_allocs(), bytes = bench_alloc_bytes();
+	for (int i = 0; i < BENCH_SAMPLES; i++) {
+		uint64_t start = bench_now_ns();
+		fn(state, ops);
+		uint64_t elapsed = bench_now_ns() - start;
+		samples[i] = (double)elapsed / (double)ops;
+		total_ns += (double)elapsed;
+	}
+	allocs = bench_allocs() - allocs;
+	bytes = bench_alloc_bytes() - bytes;
+
+	double total_ops = (double)ops * BENCH_SAMPLES;
+	qsort(samples, BENCH_SAMPLES, sizeof(double), compare_double);
+
+	bench_result* r = &g_results[g_result_count++];
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->ops = ops;
+	r->mean = total_ns / total_ops;
+	r->min = samples[0];
+	r->p50 = percentile(samples, BENCH_SAMPLES, 0.50);
+	r->p90 = percentile(samples, BENCH_SAMPLES, 0.90);
+	r->p99 = percentile(samples, BENCH_SAMPLES, 0.99);
+	r->allocs = (double)allocs / total_ops;
+	r->bytes = (double)bytes / total_ops;
+
+	fprintf(stderr, "%-36s %12.1f ns/op  p99 %10.1f  %6.2f allocs/op\n", r->name, r->mean, r->p99, r->allocs);
+	return true;
+}
+
+void bench_metric(const char* name, double value)
+{
+	if (g_metric_count == BENCH_MAX_CASES)
+		return;
+
+	bench_value* m = &g_metrics[g_metric_count++];
+	snprintf(m->name, sizeof(m->name), "%s", name);
+	m->value = value;
+	fprintf(stderr, "%-36s %12.2f\n", name, value);
+}
+
+bool bench_check(const char* name, double value, double max)
+{
+	bench_metric(name, value);
+	if (value <= max)
+		return true;
+	fprintf(stderr, "FAIL %s: %.2f is over %.2f\n", name, value, max);
+	g_failures++;
+	return false;
+}
+
+static void write_report(void)
+{
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* root = yyjson_mut_obj(doc);
+	yyjson_mut_doc_set_root(doc, root);
+	yyjson_mut_obj_add_int(doc, root, "samples", BENCH_SAMPLES);
+
+	yyjson_mut_val* cases = yyjson_mut_arr(doc);
+	for (int i = 0; i < g_result_count; i++) {
+		bench_result* r = &g_results[i];
+		yyjson_mut_val* c = yyjson_mut_arr_add_obj(doc, cases);
+		yyjson_mut_obj_add_str(doc, c, "name", r->name);
+		yyjson_mut_obj_add_uint(doc, c, "ops_per_sample", r->ops);
+		yyjson_mut_obj_add_real(doc, c, "ns_per_op", r->mean);
+		yyjson_mut_obj_add_real(doc, c, "min", r->min);
+		yyjson_mut_obj_add_real(doc, c, "p50", r->p50);
+		yyjson_mut_obj_add_real(doc, c, "p90", r->p90);
+		yyjson_mut_obj_add_real(doc, c, "p99", r->p99);
+		yyjson_mut_obj_add_real(doc, c, "allocs_per_op", r->allocs);
+		yyjson_mut_obj_add_real(doc, c, "bytes_per_op", r->bytes);
+	}
+	yyjson_mut_obj_add_val(doc, root, "cases", cases);
+
+	yyjson_mut_val* metrics = yyjson_mut_obj(doc);
+	for (int i = 0; i < g_metric_count; i++)
+		yyjson_mut_obj_add_real(doc, metrics, g_metrics[i].name, g_metrics[i].value);
+	yyjson_mut_obj_add_val(doc, root, "metrics", metrics);
+
+	char* json = yyjson_mut_write(doc, YYJSON_WRITE_PRETTY, NULL);
+	if (json) {
+		puts(json);
+		free(json);
+	}
+	yyjson_mut_doc_free(doc);
+}
+
+// usage: swipe-bench [substring ...] [file.trace ...]; only cases containing
+// one of the substrings run, and each trace file is replayed for
+// frames-to-fire. Exits 1 if any bench_check was over its budget.
+int main(int argc, const char* argv[])
+{
+	const char* filters[argc];
+	const char* traces[argc];
+	int trace_count = 0;
+	for (int i = 1; i < argc; i++) {
+		size_t len = strlen(argv[i]);
+		if (len > 6 && strcmp(argv[i] + len - 6, ".trace") == 0)
+			traces[trace_count++] = argv[i];
+		else
+			filters[g_filter_count++] = argv[i];
+	}
+	g_filters = filters;
+
+	bench_gesture();
+	for (int i = 0; i < trace_count; i++)
+		bench_gesture_trace(traces[i]);
+	bench_evdev();
+	bench_ipc();
+	bench_config();
+	bench_log();
+	bench_tap();
+	bench_rt();
+	bench_haptic();
+
+	write_report();
+	if (g_failures)
+		fprintf(stderr, "%d checks over budget\n", g_failures);
+	return g_failures ? 1 : 0;
+}
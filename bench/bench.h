@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gesture.h"
+#include "synth.h"
+#include "trace.h"
+
+// Micro-benchmark harness behind `make bench`. Each case is timed in samples
+// of a calibrated number of operations; the report gives mean ns/op,
+// per-sample percentiles and heap allocations per op as JSON on stdout.
+
+typedef void (*bench_fn)(void* state, size_t ops);
+
+// Runs fn under `name` unless the command line filters it out; false if it
+// was skipped.
+bool bench_run(const char* name, bench_fn fn, void* state);
+bool bench_selected(const char* name);
+
+uint64_t bench_now_ns(void);
+
+// Allocations made by the calling thread (see bench_alloc.c).
+uint64_t bench_allocs(void);
+uint64_t bench_alloc_bytes(void);
+
+// Adds a value that is not a timing (e.g. frames-to-fire) to the report.
+void bench_metric(const char* name, double value);
+
+// The same for a value with a budget: above max, the case is reported as
+// failed and swipe-bench exits non-zero once the report is written.
+bool bench_check(const char* name, double value, double max);
+
+// The detection thresholds a default config produces.
+gesture_params bench_gesture_params(void);
+
+// Benchmark groups, one per file.
+void bench_gesture(void);
+void bench_gesture_trace(const char* path);
+void bench_evdev(void);
+void bench_ipc(void);
+void bench_config(void);
+void bench_log(void);
+void bench_tap(void);
+void bench_rt(void);
+void bench_haptic(void);
@@ -0,0 +1,51 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bench.h"
+
+// Replaces the allocator entry points so every heap allocation, including
+// ones made inside libc, is counted for the thread that made it.
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static __thread uint64_t t_allocs;
+static __thread uint64_t t_bytes;
+
+void* malloc(size_t size)
+{
+	t_allocs++;
+	t_bytes += size;
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	t_allocs++;
+	t_bytes += count * size;
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	t_allocs++;
+	t_bytes += size;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+	__libc_free(ptr);
+}
+
+uint64_t bench_allocs(void)
+{
+	return t_allocs;
+}
+
+uint64_t bench_alloc_bytes(void)
+{
+	return t_bytes;
+}
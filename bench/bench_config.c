@@ -0,0 +1,106 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "config.h"
+
+static const char g_config_json[] = "{\n"
+									"  \"haptic\": false,\n"
+									"  \"natural_swipe\": true,\n"
+									"  \"wrap_around\": true,\n"
+									"  \"skip_empty\": true,\n"
+									"  \"fingers\": 3,\n"
+									"  \"distance_pct\": 0.12,\n"
+									"  \"velocity_pct\": 0.5,\n"
+									"  \"settle_factor\": 0.15,\n"
+									"  \"monitor\": \"focused\",\n"
+									"  \"gestures\": [\n"
+									"    { \"type\": \"swipe\", \"fingers\": 4, \"left\": \"move-node-to-workspace prev\" },\n"
+									"    { \"type\": \"pinch\", \"fingers\": 4, \"pinch_out\": \"fullscreen\" }\n"
+									"  ]\n"
+									"}\n";
+
+static void run_load_config(void* state, size_t ops)
+{
+	(void)state;
+	for (size_t i = 0; i < ops; i++) {
+		Config config = load_config();
+		(void)config;
+	}
+}
+
+// a reload: parse, then build every pad's recognizers
+static void run_load_recognizers(void* state, size_t ops)
+{
+	gesture_recognizers* out = state;
+	for (size_t i = 0; i < ops; i++) {
+		Config config = load_config();
+		for (int device = 0; device < CONFIG_MAX_DEVICES; device++)
+			*out = gesture_recognizers_for_device(&config, device);
+	}
+}
+
+// what the control socket's "config" command does per request
+static void run_config_to_json(void* state, size_t ops)
+{
+	const Config* config = state;
+	for (size_t i = 0; i < ops; i++) {
+		yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+		yyjson_mut_val* root = yyjson_mut_obj(doc);
+		yyjson_mut_doc_set_root(doc, root);
+		config_to_json(config, doc, root);
+		free(yyjson_mut_write(doc, 0, NULL));
+		yyjson_mut_doc_free(doc);
+	}
+}
+
+gesture_params bench_gesture_params(void)
+{
+	Config config = default_config();
+	return gesture_params_from_config(&config);
+}
+
+// load_config reads ./config.json, so run it from a scratch directory with
+// its "Loaded config" line sent to /dev/null instead of the report.
+void bench_config(void)
+{
+	char dir[] = "/tmp/swipe-bench-XXXXXX";
+	char cwd[1024];
+	if (!mkdtemp(dir) || !getcwd(cwd, sizeof(cwd)) || chdir(dir) != 0)
+		return;
+
+	FILE* file = fopen("config.json", "w");
+	if (file) {
+		fputs(g_config_json, file);
+		fclose(file);
+
+		fflush(stdout);
+		int saved_out = dup(STDOUT_FILENO);
+		int null_fd = open("/dev/null", O_WRONLY);
+		dup2(null_fd, STDOUT_FILENO);
+
+		bench_run("config/load_config", run_load_config, NULL);
+		gesture_recognizers recognizers = { .count = 0 };
+		bench_run("config/load_recognizers", run_load_recognizers, &recognizers);
+		Config loaded = load_config();
+
+		fflush(stdout);
+		dup2(saved_out, STDOUT_FILENO);
+		close(saved_out);
+		close(null_fd);
+
+		if (loaded.gesture_count != 2 || strcmp(config_gesture_action(&loaded, 2, GESTURE_PINCH_OUT), "fullscreen") != 0)
+			fprintf(stderr, "warning: config gestures did not parse\n");
+	}
+
+	Config config = default_config();
+	bench_run("config/config_to_json", run_config_to_json, &config);
+
+	unlink("config.json");
+	if (chdir(cwd) != 0)
+		perror("chdir");
+	rmdir(dir);
+}
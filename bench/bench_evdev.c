@@ -0,0 +1,95 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "input_evdev.h"
+
+#define PAD_MAX 4096
+
+typedef struct {
+	struct input_event* events;
+	int count;
+	int next;
+	evdev_decoder dec;
+	gesture_ctx* gesture; // optional, receives every frame
+	size_t frames;
+} evdev_bench;
+
+static void push(evdev_bench* b, double t, int type, int code, int value)
+{
+	struct input_event* ev = &b->events[b->count++];
+	ev->input_event_sec = (long)t;
+	ev->input_event_usec = (long)((t - (long)t) * 1e6);
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+// 3-finger swipes encoded as multitouch protocol B, 120 Hz
+static void build_stream(evdev_bench* b, int swipes)
+{
+	const int fingers = 3, moves = 24;
+	b->events = calloc((size_t)swipes * (moves + 2) * (fingers * 4 + 1), sizeof(struct input_event));
+
+	double t = 0;
+	int tracking_id = 0;
+	for (int s = 0; s < swipes; s++) {
+		int dir = (s % 2) ? -1 : 1;
+		int x0 = dir > 0 ? PAD_MAX / 4 : PAD_MAX * 3 / 4;
+		for (int f = 0; f <= moves + 1; f++, t += 1.0 / 120.0) {
+			for (int i = 0; i < fingers; i++) {
+				push(b, t, EV_ABS, ABS_MT_SLOT, i);
+				if (f == moves + 1) {
+					push(b, t, EV_ABS, ABS_MT_TRACKING_ID, -1);
+					continue;
+				}
+				if (f == 0)
+					push(b, t, EV_ABS, ABS_MT_TRACKING_ID, tracking_id++);
+				push(b, t, EV_ABS, ABS_MT_POSITION_X, x0 + dir * f * 48 + i * 160);
+				push(b, t, EV_ABS, ABS_MT_POSITION_Y, PAD_MAX / 2 + i * 120);
+			}
+			push(b, t, EV_SYN, SYN_REPORT, 0);
+		}
+	}
+}
+
+static void on_frame(void* userdata, uint64_t device, const touch* touches, int count)
+{
+	(void)device;
+	evdev_bench* b = userdata;
+	b->frames++;
+	if (b->gesture)
+		gesture_process(b->gesture, touches, count);
+}
+
+// one op is one SYN_REPORT, i.e. one decoded frame
+static void run_stream(void* state, size_t ops)
+{
+	evdev_bench* b = state;
+	size_t target = b->frames + ops;
+	while (b->frames < target) {
+		evdev_decoder_feed(&b->dec, &b->events[b->next], on_frame, b);
+		if (++b->next == b->count)
+			b->next = 0;
+	}
+}
+
+static void run_case(const char* name, gesture_ctx* gesture)
+{
+	evdev_bench b = { .gesture = gesture };
+	build_stream(&b, 16);
+	evdev_axis axis = { 0, PAD_MAX };
+	evdev_decoder_init(&b.dec, 1, axis, axis);
+
+	bench_run(name, run_stream, &b);
+	free(b.events);
+}
+
+void bench_evdev(void)
+{
+	run_case("evdev/decode_frame", NULL);
+
+	gesture_params params = bench_gesture_params();
+	gesture_ctx gesture;
+	gesture_init(&gesture, &params, (gesture_callbacks) { 0 }, NULL);
+	run_case("evdev/decode_and_gesture_frame", &gesture);
+}
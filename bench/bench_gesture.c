@@ -0,0 +1,527 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "tracer.h"
+
+#define MAX_FIRES 256
+
+typedef struct {
+	gesture_ctx ctx;
+	gesture_filter filter;
+	touch_trace trace;
+	touch_frame* packed; // the trace's frames packed up front, or NULL
+	int frame;
+	unsigned long long fires, rejected;
+	float sink;
+} gesture_state_bench;
+
+static void count_fire(gesture_ctx* ctx, int direction)
+{
+	(void)direction;
+	((gesture_state_bench*)ctx->userdata)->fires++;
+}
+
+// one op is one frame through gesture_process
+static void run_trace(void* state, size_t ops)
+{
+	gesture_state_bench* b = state;
+	for (size_t i = 0; i < ops; i++) {
+		gesture_process(&b->ctx, b->trace.touches + b->trace.offsets[b->frame], b->trace.counts[b->frame]);
+		if (++b->frame == b->trace.frames)
+			b->frame = 0;
+	}
+}
+
+// the engine alone on frames packed ahead of time
+static void run_packed(void* state, size_t ops)
+{
+	gesture_state_bench* b = state;
+	for (size_t i = 0; i < ops; i++) {
+		gesture_process_frame(&b->ctx, &b->packed[b->frame]);
+		if (++b->frame == b->trace.frames)
+			b->frame = 0;
+	}
+}
+
+// one op is the AoS to SoA copy gesture_process does for each frame
+static void run_pack(void* state, size_t ops)
+{
+	gesture_state_bench* b = state;
+	touch_frame frame;
+	for (size_t i = 0; i < ops; i++) {
+		touch_frame_pack(&frame, b->trace.touches + b->trace.offsets[b->frame], b->trace.counts[b->frame]);
+		b->sink += frame.x[0];
+		if (++b->frame == b->trace.frames)
+			b->frame = 0;
+	}
+}
+
+// the same with the producer's pre-filter in front, as the daemons run it
+static void run_trace_filtered(void* state, size_t ops)
+{
+	gesture_state_bench* b = state;
+	for (size_t i = 0; i < ops; i++) {
+		const touch* touches = b->trace.touches + b->trace.offsets[b->frame];
+		int count = b->trace.counts[b->frame];
+		if (gesture_filter_pass(&b->filter, GESTURE_FINGERS(b->ctx.params.fingers), count, gesture_phases(touches, count)))
+			gesture_process(&b->ctx, touches, count);
+		else
+			b->rejected++;
+		if (++b->frame == b->trace.frames)
+			b->frame = 0;
+	}
+}
+
+// Two-finger scrolling under the default three-finger config: every frame
+// the filter drops is one the macOS producer no longer converts or queues.
+static void bench_scroll(void)
+{
+	gesture_params params = bench_gesture_params();
+	gesture_state_bench b = { .frame = 0 };
+	bench_trace_swipes(&b.trace, 2, 32, 0.012, 3);
+	gesture_callbacks callbacks = { .armed = NULL, .fired = count_fire };
+	gesture_init(&b.ctx, &params, callbacks, &b);
+
+	bench_run("gesture/scroll_2f_unfiltered", run_trace, &b);
+
+	b.frame = 0;
+	gesture_init(&b.ctx, &params, callbacks, &b);
+	unsigned long long frames = 0;
+	if (bench_run("gesture/scroll_2f_prefiltered", run_trace_filtered, &b)) {
+		b.rejected = 0;
+		b.frame = 0;
+		run_trace_filtered(&b, b.trace.frames);
+		frames = b.trace.frames;
+	}
+	if (frames)
+		bench_metric("gesture/scroll_2f_prefiltered_pct", 100.0 * b.rejected / frames);
+
+	trace_free(&b.trace);
+}
+
+// kernel overrides the one gesture_init picks when non-NULL
+static void bench_fingers(const char* name, int fingers, int trace_fingers, gesture_kernel_fn kernel)
+{
+	gesture_params params = bench_gesture_params();
+	params.fingers = fingers;
+
+	gesture_state_bench b = { .frame = 0 };
+	bench_trace_swipes(&b.trace, trace_fingers, 32, 0.012, 3);
+	gesture_callbacks callbacks = { .armed = NULL, .fired = count_fire };
+	gesture_init(&b.ctx, &params, callbacks, &b);
+	if (kernel)
+		b.ctx.kernel = kernel;
+
+	if (bench_run(name, run_trace, &b) && fingers == trace_fingers && b.fires == 0)
+		fprintf(stderr, "warning: %s never fired\n", name);
+
+	trace_free(&b.trace);
+}
+
+// Reports how many frames after the fingers landed each annotated gesture
+// fired in a replay, plus gestures that fired wrong or not at all. Any of
+// the latter fails the run.
+static trace_score score_fires(const char* profile, const touch_trace* trace, const trace_fire* fires, int fired)
+{
+	trace_score score = trace_score_fires(trace, fires, fired, MAX_FIRES);
+
+	char name[64];
+	if (score.matched > 0) {
+		snprintf(name, sizeof(name), "gesture/frames_to_fire_%s_p50", profile);
+		bench_metric(name, score.p50);
+		snprintf(name, sizeof(name), "gesture/frames_to_fire_%s_p95", profile);
+		bench_metric(name, score.p95);
+	}
+	snprintf(name, sizeof(name), "gesture/missed_%s", profile);
+	bench_check(name, score.missed, 0);
+	snprintf(name, sizeof(name), "gesture/extra_%s", profile);
+	bench_check(name, score.extra, 0);
+	return score;
+}
+
+static void report_fires(const char* profile, const touch_trace* trace, const gesture_params* params)
+{
+	trace_fire fires[MAX_FIRES];
+	score_fires(profile, trace, fires, trace_replay(trace, params, fires, MAX_FIRES));
+}
+
+// Replays a trace and counts frames where the engine's running sums are off
+// from summing the frame's touches again in double precision.
+static void check_aggregates(const char* profile, const touch_trace* trace)
+{
+	gesture_params params = bench_gesture_params();
+	gesture_ctx ctx;
+	gesture_init(&ctx, &params, (gesture_callbacks) { 0 }, NULL);
+
+	int drifted = 0;
+	for (int f = 0; f < trace->frames; f++) {
+		const touch* touches = trace->touches + trace->offsets[f];
+		int count = trace->counts[f] > MAX_TOUCHES ? MAX_TOUCHES : trace->counts[f];
+		gesture_process(&ctx, touches, count);
+
+		double x = 0, y = 0, vel = 0;
+		for (int i = 0; i < count; i++) {
+			x += (float)touches[i].x;
+			y += (float)touches[i].y;
+			vel += (float)touches[i].velocity;
+		}
+		drifted += fabs(x - ctx.agg.sum_x) > 1e-5 || fabs(y - ctx.agg.sum_y) > 1e-5
+			|| fabs(vel - ctx.agg.sum_vel) > 1e-5 * (1 + fabs(vel));
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "gesture/aggregate_drift_%s", profile);
+	bench_check(name, drifted, 0);
+}
+
+// Rotates each frame's touches by the frame index, as an unordered touch set
+// can arrive; the ids are what keep the fingers apart.
+static void shuffle_trace(touch_trace* trace)
+{
+	for (int f = 0; f < trace->frames; f++) {
+		touch* touches = trace->touches + trace->offsets[f];
+		int count = trace->counts[f];
+		for (int r = 0; count > 1 && r < f % count; r++) {
+			touch first = touches[0];
+			memmove(touches, touches + 1, sizeof(touch) * (count - 1));
+			touches[count - 1] = first;
+		}
+	}
+}
+
+static void frames_to_fire(const char* profile, double peak_step, int ramp)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "gesture/frames_to_fire_%s", profile);
+	if (!bench_selected(name))
+		return;
+
+	touch_trace trace;
+	gesture_params params = bench_gesture_params();
+	bench_trace_swipes(&trace, params.fingers, 64, peak_step, ramp);
+	report_fires(profile, &trace, &params);
+
+	shuffle_trace(&trace);
+	snprintf(name, sizeof(name), "%s_shuffled", profile);
+	report_fires(name, &trace, &params);
+	check_aggregates(name, &trace);
+	trace_free(&trace);
+}
+
+static const int HORIZONTAL[] = { GESTURE_RIGHT, GESTURE_LEFT };
+static const int VERTICAL[] = { GESTURE_UP, GESTURE_DOWN };
+static const int DIAGONAL[] = { GESTURE_UP_RIGHT, GESTURE_DOWN_LEFT, GESTURE_DOWN_RIGHT, GESTURE_UP_LEFT };
+
+static gesture_params all_axes_params(void)
+{
+	gesture_params params = bench_gesture_params();
+	params.axes = 0;
+	for (int axis = GESTURE_AXIS_HORIZONTAL; axis <= GESTURE_AXES; axis++)
+		params.axes |= GESTURE_AXIS_BIT(axis);
+	return params;
+}
+
+// Swipes fire in their own direction with every axis enabled, and
+// horizontal ones as soon as with horizontal alone.
+static void frames_to_fire_along(const char* profile, const int* directions, int count)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "gesture/frames_to_fire_%s", profile);
+	if (!bench_selected(name))
+		return;
+
+	gesture_params params = all_axes_params();
+	touch_trace trace;
+	bench_trace_swipes_along(&trace, params.fingers, 64, 0.008, 6, directions, count);
+	report_fires(profile, &trace, &params);
+	trace_free(&trace);
+}
+
+// One frame through the recognizer with every axis enabled; the classifying
+// is folded into the same passes, so this should cost what
+// gesture/swipe_3f_frame does.
+static void bench_axes(const char* name, const int* directions, int count)
+{
+	gesture_params params = all_axes_params();
+	gesture_state_bench b = { .frame = 0 };
+	bench_trace_swipes_along(&b.trace, params.fingers, 32, 0.012, 3, directions, count);
+	gesture_callbacks callbacks = { .armed = NULL, .fired = count_fire };
+	gesture_init(&b.ctx, &params, callbacks, &b);
+
+	if (bench_run(name, run_trace, &b) && b.fires == 0)
+		fprintf(stderr, "warning: %s never fired\n", name);
+
+	trace_free(&b.trace);
+}
+
+typedef struct {
+	gesture_set set;
+	touch_trace trace;
+	int frame;
+	unsigned long long fires;
+} set_bench;
+
+static void count_set_fire(gesture_ctx* ctx, int direction)
+{
+	(void)direction;
+	((set_bench*)gesture_set_of(ctx)->userdata)->fires++;
+}
+
+// one op is one frame through every recognizer of the set
+static void run_set(void* state, size_t ops)
+{
+	set_bench* b = state;
+	for (size_t i = 0; i < ops; i++) {
+		gesture_set_process(&b->set, b->trace.touches + b->trace.offsets[b->frame], b->trace.counts[b->frame]);
+		if (++b->frame == b->trace.frames)
+			b->frame = 0;
+	}
+}
+
+static gesture_params recognizer(gesture_kind kind, int fingers)
+{
+	gesture_params params = bench_gesture_params();
+	params.kind = kind;
+	params.fingers = fingers;
+	return params;
+}
+
+// The three-finger swipe trace through 1-4 recognizers; the frame is packed
+// and summed once however many there are, so each one past the first only
+// adds its own state machine.
+static void bench_set(int count)
+{
+	const gesture_params all[] = {
+		recognizer(GESTURE_KIND_SWIPE, 3),
+		recognizer(GESTURE_KIND_SWIPE, 4),
+		recognizer(GESTURE_KIND_PINCH, 4),
+		recognizer(GESTURE_KIND_PINCH, 3),
+	};
+	gesture_recognizers recognizers = { .count = count };
+	memcpy(recognizers.params, all, sizeof(gesture_params) * count);
+
+	char name[64];
+	snprintf(name, sizeof(name), "gesture/set_%d_recognizers_frame", count);
+	set_bench b = { .frame = 0 };
+	bench_trace_swipes(&b.trace, 3, 32, 0.012, 3);
+	gesture_callbacks callbacks = { .armed = NULL, .fired = count_set_fire };
+	gesture_set_init(&b.set, &recognizers, callbacks, &b);
+
+	if (bench_run(name, run_set, &b) && b.fires == 0)
+		fprintf(stderr, "warning: %s never fired\n", name);
+
+	trace_free(&b.trace);
+}
+
+// A four-finger pinch on its own, then next to a four-finger swipe: each
+// sequence fires its own gesture once and never the other's.
+static void frames_to_fire_pinch(void)
+{
+	if (!bench_selected("gesture/frames_to_fire_pinch"))
+		return;
+
+	gesture_params pinch = recognizer(GESTURE_KIND_PINCH, 4);
+	gesture_recognizers both = { .params = { recognizer(GESTURE_KIND_SWIPE, 4), pinch }, .count = 2 };
+	trace_fire fires[MAX_FIRES];
+	touch_trace trace;
+
+	bench_trace_pinches(&trace, 4, 64, 0.004, 4);
+	report_fires("pinch", &trace, &pinch);
+	score_fires("set_pinch", &trace, fires, trace_replay_set(&trace, &both, fires, MAX_FIRES));
+	trace_free(&trace);
+
+	bench_trace_swipes(&trace, 4, 64, 0.008, 6);
+	score_fires("set_swipe", &trace, fires, trace_replay_set(&trace, &both, fires, MAX_FIRES));
+	trace_free(&trace);
+}
+
+// Long swipes with scrubbing on: how many moves each one makes, and any that
+// went the wrong way. With it off every swipe makes exactly one.
+static void scrub_steps(void)
+{
+	if (!bench_selected("gesture/scrub_steps_per_swipe"))
+		return;
+
+	gesture_params params = bench_gesture_params();
+	params.scrub_pct = 0.05f;
+	touch_trace trace;
+	bench_trace_swipes(&trace, params.fingers, 32, 0.012, 3);
+
+	trace_fire fires[MAX_FIRES];
+	int fired = trace_replay(&trace, &params, fires, MAX_FIRES);
+	int wrong = 0;
+	for (int i = 0, a = 0; i < fired && i < MAX_FIRES; i++) {
+		while (a < trace.fire_count && trace.fires[a].frame < fires[i].frame)
+			a++;
+		wrong += a == trace.fire_count || fires[i].direction != trace.fires[a].direction;
+	}
+	bench_metric("gesture/scrub_steps_per_swipe", (double)fired / trace.fire_count);
+	bench_metric("gesture/scrub_wrong_direction", wrong);
+	trace_free(&trace);
+}
+
+static const char* const ESTIMATOR_NAMES[] = { "exact", "jittered", "smoothed" };
+
+// Flings at three speeds against a curve with a point between each pair:
+// every fling has to add up to the steps its speed is worth whichever way
+// the velocity was estimated, and top-ups count the flings that only got
+// there after firing.
+static void fling_steps(void)
+{
+	if (!bench_selected("gesture/fling_steps"))
+		return;
+
+	// 1.44, 3.6 and 7.2 pad widths per second at 120 Hz
+	static const double speeds[] = { 0.012, 0.030, 0.060 };
+	static const int expected[] = { 1, 2, 3 };
+	gesture_params params = bench_gesture_params();
+	params.fling_vel[0] = 2.5f;
+	params.fling_vel[1] = 5.0f;
+	params.fling_count = 2;
+
+	for (bench_velocity how = BENCH_VELOCITY_EXACT; how <= BENCH_VELOCITY_SMOOTHED; how++) {
+		touch_trace trace;
+		bench_trace_flings(&trace, params.fingers, 60, speeds, 3);
+		bench_trace_reestimate(&trace, how);
+
+		trace_fire fires[MAX_FIRES];
+		int fired = trace_replay(&trace, &params, fires, MAX_FIRES);
+		int steps[60], calls[60];
+		bench_fire_steps(&trace, fires, fired < MAX_FIRES ? fired : MAX_FIRES, steps, calls);
+		int wrong = 0, topups = 0;
+		for (int a = 0; a < trace.fire_count; a++) {
+			wrong += steps[a] != expected[a % 3];
+			topups += calls[a] > 1;
+		}
+
+		char name[64];
+		snprintf(name, sizeof(name), "gesture/fling_steps_wrong_%s", ESTIMATOR_NAMES[how]);
+		bench_check(name, wrong, 0);
+		snprintf(name, sizeof(name), "gesture/fling_topups_%s", ESTIMATOR_NAMES[how]);
+		bench_metric(name, topups);
+		trace_free(&trace);
+	}
+}
+
+// recorded traces (see trace.h) are named after their file
+// The budget for path from the budgets manifest next to it, if it has one.
+static bool find_budget(const char* path, trace_budget* out)
+{
+	const char* slash = strrchr(path, '/');
+	char manifest[512];
+	snprintf(manifest, sizeof(manifest), "%.*sbudgets", slash ? (int)(slash - path) + 1 : 0, path);
+
+	trace_budget budgets[64];
+	int count = trace_budgets_load(manifest, budgets, 64);
+	for (int i = 0; i < count; i++) {
+		if (strcmp(budgets[i].path, path) == 0) {
+			*out = budgets[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+// Replays a trace given on the command line; one listed in a budgets
+// manifest uses its finger count and fails the run past its budgets.
+void bench_gesture_trace(const char* path)
+{
+	touch_trace trace;
+	if (!trace_load(path, &trace)) {
+		fprintf(stderr, "warning: cannot load trace %s\n", path);
+		bench_check("gesture/unreadable_traces", 1, 0);
+		return;
+	}
+
+	const char* base = strrchr(path, '/');
+	const char* profile = base ? base + 1 : path;
+	gesture_params params = bench_gesture_params();
+	trace_budget budget = { .fingers = params.fingers, .p50 = -1, .p95 = -1 };
+	bool budgeted = find_budget(path, &budget);
+	params.fingers = budget.fingers;
+
+	trace_fire fires[MAX_FIRES];
+	trace_score score = score_fires(profile, &trace, fires, trace_replay(&trace, &params, fires, MAX_FIRES));
+	if (budgeted && budget.p50 >= 0 && score.matched > 0) {
+		char name[64];
+		snprintf(name, sizeof(name), "gesture/budget_%s_p50", profile);
+		bench_check(name, score.p50, budget.p50);
+		snprintf(name, sizeof(name), "gesture/budget_%s_p95", profile);
+		bench_check(name, score.p95, budget.p95);
+	}
+	check_aggregates(profile, &trace);
+	trace_free(&trace);
+}
+
+// The kernel without the per-frame pack, and the pack on its own.
+static void bench_soa(int fingers)
+{
+	gesture_params params = bench_gesture_params();
+	params.fingers = fingers;
+
+	gesture_state_bench b = { .frame = 0 };
+	bench_trace_swipes(&b.trace, fingers, 32, 0.012, 3);
+	b.packed = malloc(sizeof(touch_frame) * b.trace.frames);
+	for (int i = 0; i < b.trace.frames; i++)
+		touch_frame_pack(&b.packed[i], b.trace.touches + b.trace.offsets[i], b.trace.counts[i]);
+	gesture_callbacks callbacks = { .armed = NULL, .fired = count_fire };
+	gesture_init(&b.ctx, &params, callbacks, &b);
+
+	char name[64];
+	snprintf(name, sizeof(name), "gesture/packed_%df_frame", fingers);
+	bench_run(name, run_packed, &b);
+	b.frame = 0;
+	snprintf(name, sizeof(name), "gesture/pack_%df", fingers);
+	bench_run(name, run_pack, &b);
+
+	free(b.packed);
+	trace_free(&b.trace);
+}
+
+void bench_gesture(void)
+{
+	bench_fingers("gesture/swipe_3f_frame", 3, 3, NULL);
+	bench_fingers("gesture/swipe_4f_frame", 4, 4, NULL);
+	// frames with the wrong finger count take the early-out path
+	bench_fingers("gesture/mismatch_2f_frame", 3, 2, NULL);
+
+	// the unrolled per-count kernels against the generic loop
+	for (int n = 2; n <= 5; n++) {
+		char name[64];
+		snprintf(name, sizeof(name), "gesture/kernel_%df_unrolled", n);
+		bench_fingers(name, n, n, NULL);
+		snprintf(name, sizeof(name), "gesture/kernel_%df_generic", n);
+		bench_fingers(name, n, n, gesture_kernel_generic);
+	}
+
+	bench_soa(3);
+	bench_soa(5);
+
+	bench_axes("gesture/swipe_3f_frame_all_axes", HORIZONTAL, 2);
+	bench_axes("gesture/vertical_3f_frame", VERTICAL, 2);
+	bench_axes("gesture/diagonal_3f_frame", DIAGONAL, 4);
+
+	for (int n = 1; n <= GESTURE_MAX_RECOGNIZERS; n++)
+		bench_set(n);
+
+	bench_scroll();
+
+	// the same frames with the lifecycle tracer recording
+	tracer_enable(true);
+	bench_fingers("gesture/swipe_3f_frame_traced", 3, 3, NULL);
+	tracer_enable(false);
+	tracer_clear();
+
+	frames_to_fire("flick", 0.015, 2);
+	frames_to_fire("swipe", 0.008, 6);
+	frames_to_fire("drag", 0.005, 12);
+	frames_to_fire_along("swipe_all_axes", HORIZONTAL, 2);
+	frames_to_fire_along("vertical", VERTICAL, 2);
+	frames_to_fire_along("diagonal", DIAGONAL, 4);
+	frames_to_fire_pinch();
+	scrub_steps();
+	fling_steps();
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "bench.h"
+#include "haptic_worker.h"
+#include "histogram.h"
+
+#define HAPTIC_SAMPLES 500
+#define HAPTIC_GAP_NS 200000ull // long enough for the worker to go back to sleep
+#define HAPTIC_STALL_NS (100ull * 1000 * 1000)
+#define HAPTIC_BURST 8
+#define HAPTIC_ACTUATE_US 1000 // about what an MTActuatorActuate call takes
+
+// what the gesture thread pays per fire
+static void run_submit(void* state, size_t ops)
+{
+	haptic_worker* worker = state;
+	for (size_t i = 0; i < ops; i++)
+		haptic_worker_submit(worker, 3);
+}
+
+static unsigned long long handled(haptic_worker* worker, haptic_worker_stats* st)
+{
+	haptic_worker_stats_get(worker, st);
+	return st->actuated + st->coalesced;
+}
+
+// Waits until the worker has taken count pulses off the queue; false if it
+// sat on one for HAPTIC_STALL_NS, i.e. missed the wakeup.
+static bool wait_handled(haptic_worker* worker, unsigned long long count, haptic_worker_stats* st)
+{
+	uint64_t deadline = bench_now_ns() + HAPTIC_STALL_NS;
+	while (handled(worker, st) < count) {
+		if (bench_now_ns() > deadline)
+			return false;
+		nanosleep(&(struct timespec) { 0, 10000 }, NULL);
+	}
+	return true;
+}
+
+static void report(const char* name, const histogram* latency)
+{
+	char metric[96];
+	snprintf(metric, sizeof(metric), "%s_p50_us", name);
+	bench_metric(metric, histogram_percentile(latency, 0.50) / 1e3);
+	snprintf(metric, sizeof(metric), "%s_p99_us", name);
+	bench_metric(metric, histogram_percentile(latency, 0.99) / 1e3);
+	snprintf(metric, sizeof(metric), "%s_max_us", name);
+	bench_metric(metric, latency->max / 1e3);
+}
+
+// Submit-to-dequeue latency of a pulse handed to a sleeping worker: the
+// wakeup path a swipe takes. A pulse left in the queue until the next one
+// arrives is a lost wakeup and fails the run.
+static void measure_wakeup(void)
+{
+	const char* name = "haptic/queue_wakeup";
+	if (!bench_selected(name))
+		return;
+
+	haptic_worker* worker = haptic_worker_start(haptic_backend_stub(0));
+	if (!worker)
+		return;
+
+	histogram latency = { 0 };
+	haptic_worker_stats st;
+	int stalled = 0;
+	for (int i = 0; i < HAPTIC_SAMPLES; i++) {
+		nanosleep(&(struct timespec) { 0, HAPTIC_GAP_NS }, NULL);
+		// alternating patterns are never coalesced
+		haptic_worker_submit(worker, 3 + (i & 1));
+		if (wait_handled(worker, (unsigned long long)i + 1, &st))
+			histogram_record(&latency, st.last_queue_ns);
+		else
+			stalled++;
+	}
+	haptic_worker_stop(worker);
+
+	report(name, &latency);
+	bench_check("haptic/lost_wakeups", stalled, 0);
+}
+
+// The same for the last of a burst queued behind actuations that each take
+// HAPTIC_ACTUATE_US.
+static void measure_burst(void)
+{
+	const char* name = "haptic/queue_burst";
+	if (!bench_selected(name))
+		return;
+
+	haptic_worker* worker = haptic_worker_start(haptic_backend_stub(HAPTIC_ACTUATE_US));
+	if (!worker)
+		return;
+
+	histogram latency = { 0 };
+	haptic_worker_stats st;
+	unsigned long long submitted = 0;
+	for (int i = 0; i < HAPTIC_SAMPLES / HAPTIC_BURST; i++) {
+		for (int j = 0; j < HAPTIC_BURST; j++)
+			haptic_worker_submit(worker, 3 + (j & 1));
+		submitted += HAPTIC_BURST;
+		if (wait_handled(worker, submitted, &st))
+			histogram_record(&latency, st.last_queue_ns);
+	}
+	haptic_worker_stop(worker);
+
+	report(name, &latency);
+	bench_metric("haptic/queue_burst_dropped", st.dropped);
+}
+
+void bench_haptic(void)
+{
+	haptic_worker* worker = haptic_worker_start(haptic_backend_stub(0));
+	if (worker) {
+		bench_run("haptic/submit", run_submit, worker);
+		haptic_worker_stop(worker);
+	}
+
+	measure_wakeup();
+	measure_burst();
+}
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "i3ipc.h"
+#include "mock_server.h"
+#include "stats.h"
+#include "switch_queue.h"
+#include "wm.h"
+
+// Built into the bench in place of aerospace.o so the static request and
+// reply codecs can be timed on their own.
+#include "../src/aerospace.c"
+
+static const char* const g_focus_args[] = { "workspace", "3" };
+
+static void run_serialize(void* state, size_t ops)
+{
+	(void)state;
+	for (size_t i = 0; i < ops; i++) {
+		size_t len;
+		free(serialize_request((const char**)g_focus_args, 2, "", &len));
+	}
+}
+
+typedef struct {
+	const char* reply;
+	size_t len;
+	ipc_conn conn;
+} parse_bench;
+
+// the reply is copied into the read buffer as if it had just arrived
+static void run_parse_response(void* state, size_t ops)
+{
+	parse_bench* b = state;
+	for (size_t i = 0; i < ops; i++) {
+		memcpy(b->conn.read_buf, b->reply, b->len);
+		b->conn.read_buf_len = b->len;
+		bool failed;
+		free(conn_read_response(&b->conn, "stdout", &failed));
+	}
+}
+
+static void run_parse_table(void* state, size_t ops)
+{
+	static workspace_table table;
+	for (size_t i = 0; i < ops; i++) {
+		memset(&table, 0, sizeof(table));
+		parse_workspace_table(state, &table);
+	}
+}
+
+static void run_focus(void* state, size_t ops)
+{
+	for (size_t i = 0; i < ops; i++)
+		free(aerospace_focus_workspace(state, "3"));
+}
+
+// every workspace listed again, against only the visible ones
+static void run_refresh(void* state, size_t ops)
+{
+	for (size_t i = 0; i < ops; i++) {
+		aerospace_invalidate_workspaces(state);
+		aerospace_refresh_workspaces(state, 0, NULL);
+	}
+}
+
+static void run_refresh_visible(void* state, size_t ops)
+{
+	for (size_t i = 0; i < ops; i++)
+		aerospace_refresh_workspaces(state, 0, NULL);
+}
+
+#define BATCH_COMMANDS 4
+
+// BATCH_COMMANDS switches in one aerospace_batch, one writev and one wait,
+// against the same switches each sent and answered on its own
+static void run_batch(void* state, size_t ops)
+{
+	static const char* const args[] = { "workspace", "3" };
+	aerospace_command commands[BATCH_COMMANDS];
+	for (int c = 0; c < BATCH_COMMANDS; c++)
+		commands[c] = (aerospace_command) { (const char**)args, 2, NULL, NULL };
+
+	char* results[BATCH_COMMANDS];
+	for (size_t i = 0; i < ops; i++) {
+		aerospace_batch(state, commands, BATCH_COMMANDS, results);
+		for (int c = 0; c < BATCH_COMMANDS; c++)
+			free(results[c]);
+	}
+}
+
+static void run_serial(void* state, size_t ops)
+{
+	for (size_t i = 0; i < ops; i++) {
+		for (int c = 0; c < BATCH_COMMANDS; c++)
+			free(aerospace_focus_workspace(state, "3"));
+	}
+}
+
+static void run_i3_command(void* state, size_t ops)
+{
+	for (size_t i = 0; i < ops; i++)
+		i3ipc_command(state, "workspace next_on_output");
+}
+
+#define SCRUB_STEPS 6 // the mock has eight workspaces per monitor
+
+// A scrub of SCRUB_STEPS workspaces the way the executors used to send it,
+// one switch and round trip per step, against the single multi-step switch
+// they send now.
+static void run_scrub_single(void* state, size_t ops)
+{
+	wm_backend* wm = state;
+	for (size_t i = 0; i < ops; i++) {
+		for (int s = 0; s < SCRUB_STEPS; s++)
+			wm->switch_workspace(wm, 1);
+	}
+}
+
+static void run_scrub_coalesced(void* state, size_t ops)
+{
+	wm_backend* wm = state;
+	for (size_t i = 0; i < ops; i++)
+		wm->switch_workspace(wm, SCRUB_STEPS);
+}
+
+static void bench_scrub(const char* prefix, wm_backend* wm)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "ipc/%s_scrub_%d_single", prefix, SCRUB_STEPS);
+	bench_run(name, run_scrub_single, wm);
+	snprintf(name, sizeof(name), "ipc/%s_scrub_%d_coalesced", prefix, SCRUB_STEPS);
+	bench_run(name, run_scrub_coalesced, wm);
+}
+
+#define FLOOD_FIRES 1000
+#define FLOOD_INTERVAL_NS 500000ull // 2 kHz, far past any hand
+#define FLOOD_RATE 50.0
+#define FLOOD_BURST 4
+
+// A pad or state machine gone wrong: a swipe every FLOOD_INTERVAL_NS and a
+// configured command every tenth, into the switch queue with and without
+// the rate limit. Reports how many commands reached the server, the most
+// that were ever waiting (a failure past SWITCH_QUEUE_DEPTH), and
+// fire-to-reply latency.
+static void bench_flood(const char* prefix, wm_backend* wm, double rate)
+{
+	char name[96];
+	const char* variant = rate > 0 ? "limited" : "unlimited";
+	snprintf(name, sizeof(name), "ipc/%s_flood_%s", prefix, variant);
+	if (!bench_selected(name))
+		return;
+
+	static swipe_stats stats;
+	stats_init(&stats);
+	static switch_queue q;
+	if (!switch_queue_start(&q, wm, &stats, rate, FLOOD_BURST))
+		return;
+
+	uint64_t start = ipc_monotonic_ns();
+	for (int i = 0; i < FLOOD_FIRES; i++) {
+		switch_queue_steps(&q, i % 2 ? 1 : -1);
+		if (i % 10 == 0)
+			switch_queue_action(&q, "workspace 3");
+		nanosleep(&(struct timespec) { 0, FLOOD_INTERVAL_NS }, NULL);
+	}
+	// let what is still waiting go out before stopping
+	for (int spins = 0; spins < 1000; spins++) {
+		int steps, actions;
+		switch_queue_pending(&q, &steps, &actions);
+		if (!steps && !actions)
+			break;
+		nanosleep(&(struct timespec) { 0, 1000000 }, NULL);
+	}
+	uint64_t elapsed = ipc_monotonic_ns() - start;
+	int peak = q.peak_depth;
+	switch_queue_stop(&q);
+
+	histogram latency = stats.switch_latency;
+	unsigned long long sent = latency.count + atomic_load(&stats.switch_errors);
+	snprintf(name, sizeof(name), "ipc/%s_flood_%s_sent_per_sec", prefix, variant);
+	bench_metric(name, sent * 1e9 / elapsed);
+	snprintf(name, sizeof(name), "ipc/%s_flood_%s_peak_depth", prefix, variant);
+	bench_check(name, peak, SWITCH_QUEUE_DEPTH);
+	snprintf(name, sizeof(name), "ipc/%s_flood_%s_dropped", prefix, variant);
+	bench_metric(name, atomic_load(&stats.dropped));
+	snprintf(name, sizeof(name), "ipc/%s_flood_%s_throttled", prefix, variant);
+	bench_metric(name, atomic_load(&stats.throttled));
+	snprintf(name, sizeof(name), "ipc/%s_flood_%s_latency_p99_us", prefix, variant);
+	bench_metric(name, histogram_percentile(&latency, 0.99) / 1e3);
+	snprintf(name, sizeof(name), "ipc/%s_flood_%s_latency_max_us", prefix, variant);
+	bench_metric(name, latency.max / 1e3);
+}
+
+static void bench_codecs(void)
+{
+	bench_run("ipc/serialize_request", run_serialize, NULL);
+
+	static parse_bench parse;
+	char* table = mock_workspace_json(2, 8);
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* root = yyjson_mut_obj(doc);
+	yyjson_mut_doc_set_root(doc, root);
+	yyjson_mut_obj_add_int(doc, root, "exitCode", 0);
+	yyjson_mut_obj_add_str(doc, root, "stdout", table);
+	yyjson_mut_obj_add_str(doc, root, "stderr", "");
+	char* reply = yyjson_mut_write(doc, 0, &parse.len);
+	yyjson_mut_doc_free(doc);
+
+	parse.reply = reply;
+	parse.conn.fd = -1;
+	bench_run("ipc/parse_response_16ws", run_parse_response, &parse);
+	bench_run("ipc/parse_workspace_table_16ws", run_parse_table, table);
+
+	free(reply);
+	free(table);
+}
+
+static void bench_roundtrips(void)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/swipe-bench-%d.sock", (int)getpid());
+
+	mock_server* server = mock_server_start(path, MOCK_AEROSPACE);
+	if (server) {
+		aerospace* client = aerospace_new(path);
+		bench_run("ipc/aerospace_focus_roundtrip", run_focus, client);
+		bench_run("ipc/aerospace_refresh_roundtrip", run_refresh, client);
+		bench_run("ipc/aerospace_refresh_visible_roundtrip", run_refresh_visible, client);
+		bench_run("ipc/aerospace_batch_4", run_batch, client);
+		bench_run("ipc/aerospace_serial_4", run_serial, client);
+		aerospace_close(client);
+
+		wm_options options = { .wrap_around = true, .skip_empty = false, .monitor = "focused" };
+		wm_backend* wm = wm_aerospace_new(aerospace_new(path), options);
+		if (wm) {
+			bench_scrub("aerospace", wm);
+			bench_flood("aerospace", wm, 0);
+			bench_flood("aerospace", wm, FLOOD_RATE);
+			wm->close(wm);
+		}
+		mock_server_stop(server);
+	}
+
+	server = mock_server_start(path, MOCK_I3);
+	if (server) {
+		i3ipc* client = i3ipc_new(path);
+		if (client) {
+			bench_run("ipc/i3_command_roundtrip", run_i3_command, client);
+			i3ipc_close(client);
+		}
+
+		wm_options options = { .wrap_around = true, .skip_empty = true };
+		wm_backend* wm = wm_i3_new(path, options);
+		if (wm) {
+			bench_scrub("i3", wm);
+			bench_flood("i3", wm, 0);
+			bench_flood("i3", wm, FLOOD_RATE);
+			wm->close(wm);
+		}
+		mock_server_stop(server);
+	}
+}
+
+void bench_ipc(void)
+{
+	bench_codecs();
+	bench_roundtrips();
+}
@@ -0,0 +1,113 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench.h"
+#include "log.h"
+
+#define BENCH_SAMPLES_ENQUEUE 256
+#define BENCH_IDLE_NS 50000000 // long enough for a polling flusher to show up
+
+// One line shaped like the IPC error path: a string and two integers.
+static void run_fprintf(void* state, size_t ops)
+{
+	FILE* file = state;
+	for (size_t i = 0; i < ops; i++)
+		fprintf(file, "Failed to reconnect to %s: %s (errno %d)\n", "/tmp/bobko.aerospace-agent.sock", "Connection refused", (int)i);
+}
+
+#define LOG_BURST 128 // half a thread ring
+
+static int compare_double(const void* a, const void* b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+static unsigned long long processed(void)
+{
+	log_stats st;
+	log_stats_get(&st);
+	return st.written + st.dropped;
+}
+
+static void wait_drained(unsigned long long target)
+{
+	while (processed() < target)
+		sched_yield();
+}
+
+static void log_burst(int n)
+{
+	for (int i = 0; i < n; i++)
+		log_error("Failed to reconnect to %s: %s (errno %d)", "/tmp/bobko.aerospace-agent.sock", "Connection refused", i);
+}
+
+static void run_log_filtered(void* state, size_t ops)
+{
+	(void)state;
+	for (size_t i = 0; i < ops; i++)
+		log_debug("frame %d", (int)i);
+}
+
+// What the logging thread pays: bursts into an empty ring, timed without the
+// waits for the flusher in between. The first record of each burst wakes the
+// flusher, so the figure includes one signal spread over LOG_BURST records.
+static double enqueue_ns(void)
+{
+	double samples[BENCH_SAMPLES_ENQUEUE];
+	unsigned long long target = processed();
+	for (int i = 0; i < BENCH_SAMPLES_ENQUEUE; i++) {
+		uint64_t start = bench_now_ns();
+		log_burst(LOG_BURST);
+		samples[i] = (double)(bench_now_ns() - start) / LOG_BURST;
+		target += LOG_BURST;
+		wait_drained(target);
+	}
+	qsort(samples, BENCH_SAMPLES_ENQUEUE, sizeof(double), compare_double);
+	return samples[BENCH_SAMPLES_ENQUEUE / 2];
+}
+
+// Both sides write to /dev/null. stderr is unbuffered, so the stdio case
+// pays a write(2) per line like the daemon did; the flusher gets a buffered
+// stream and flushes once per drain.
+void bench_log(void)
+{
+	FILE* unbuffered = fopen("/dev/null", "w");
+	FILE* buffered = fopen("/dev/null", "w");
+	if (!unbuffered || !buffered) {
+		if (unbuffered)
+			fclose(unbuffered);
+		if (buffered)
+			fclose(buffered);
+		return;
+	}
+	setvbuf(unbuffered, NULL, _IONBF, 0);
+	bench_run("log/fprintf_unbuffered", run_fprintf, unbuffered);
+
+	log_start(LOG_INFO, buffered, buffered);
+	log_stats before, after;
+	log_stats_get(&before);
+	bench_run("log/async_filtered", run_log_filtered, NULL);
+	if (bench_selected("log/async_enqueue"))
+		bench_metric("log/async_enqueue_p50_ns", enqueue_ns());
+	// an idle logger must not wake up on its own
+	if (bench_selected("log/idle_wakeups")) {
+		nanosleep(&(struct timespec) { 0, BENCH_IDLE_NS / 2 }, NULL);
+		log_stats idle;
+		log_stats_get(&idle);
+		nanosleep(&(struct timespec) { 0, BENCH_IDLE_NS }, NULL);
+		log_stats_get(&after);
+		bench_check("log/idle_wakeups", (double)(after.wakeups - idle.wakeups), 0);
+	}
+	log_stop();
+	log_stats_get(&after);
+
+	// the waits above keep the ring from filling, so this should stay 0
+	if (bench_selected("log/async_enqueue"))
+		bench_metric("log/async_dropped", (double)(after.dropped - before.dropped));
+
+	fclose(unbuffered);
+	fclose(buffered);
+}
@@ -0,0 +1,124 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "histogram.h"
+#include "rt_thread.h"
+
+#define JITTER_PERIOD_NS 2000000ull // 500 Hz
+#define JITTER_SAMPLES 500
+#define JITTER_SPINNERS_PER_CPU 4 // a deep run queue, not just busy cores
+
+// Wakeup-to-process latency of the engine thread: a producer stamps a frame
+// into a pipe every JITTER_PERIOD_NS, the way evdev wakes the input thread,
+// and the consumer records how long after the stamp it finished running the
+// frame through the engine. Under load, spinning threads at the default
+// class compete with it.
+typedef struct {
+	int fds[2];
+	touch_trace trace;
+	gesture_ctx ctx;
+	histogram latency;
+} jitter_run;
+
+static atomic_bool g_spin;
+
+static void* spinner(__attribute__((unused)) void* arg)
+{
+	volatile unsigned long long sink = 0;
+	while (atomic_load_explicit(&g_spin, memory_order_relaxed))
+		sink++;
+	return NULL;
+}
+
+static void* consumer(void* arg)
+{
+	jitter_run* run = arg;
+	int frame = 0;
+	uint64_t stamp;
+	while (read(run->fds[0], &stamp, sizeof(stamp)) == sizeof(stamp)) {
+		const touch* touches = run->trace.touches + run->trace.offsets[frame];
+		gesture_process(&run->ctx, touches, run->trace.counts[frame]);
+		frame = (frame + 1) % run->trace.frames;
+		histogram_record(&run->latency, bench_now_ns() - stamp);
+	}
+	return NULL;
+}
+
+static void measure(const char* name, rt_class want, bool loaded)
+{
+	if (!bench_selected(name))
+		return;
+
+	jitter_run run = { 0 };
+	if (pipe(run.fds) != 0)
+		return;
+	bench_trace_swipes(&run.trace, 3, 8, 0.02, 4);
+	gesture_params params = bench_gesture_params();
+	gesture_init(&run.ctx, &params, (gesture_callbacks) { 0 }, NULL);
+
+	int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	cpus = cpus < 1 ? 1 : cpus > 64 ? 64 : cpus;
+	pthread_t spinners[64 * JITTER_SPINNERS_PER_CPU];
+	int spinning = 0;
+	atomic_store(&g_spin, true);
+	for (int i = 0; loaded && i < cpus * JITTER_SPINNERS_PER_CPU; i++) {
+		if (pthread_create(&spinners[spinning], NULL, spinner, NULL) == 0)
+			spinning++;
+	}
+
+	rt_params params_rt = rt_params_gesture(want);
+	params_rt.period_ns = JITTER_PERIOD_NS;
+	pthread_t thread;
+	rt_class got = RT_CLASS_DEFAULT;
+	bool started = rt_thread_start(&thread, "bench-jitter", &params_rt, consumer, &run, &got);
+	if (started) {
+		struct timespec next;
+		clock_gettime(CLOCK_MONOTONIC, &next);
+		for (int i = 0; i < JITTER_SAMPLES; i++) {
+			next.tv_nsec += JITTER_PERIOD_NS;
+			if (next.tv_nsec >= 1000000000) {
+				next.tv_nsec -= 1000000000;
+				next.tv_sec++;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+			uint64_t stamp = bench_now_ns();
+			if (write(run.fds[1], &stamp, sizeof(stamp)) != sizeof(stamp))
+				break;
+		}
+		close(run.fds[1]);
+		pthread_join(thread, NULL);
+	} else {
+		close(run.fds[1]);
+	}
+	close(run.fds[0]);
+
+	atomic_store(&g_spin, false);
+	for (int i = 0; i < spinning; i++)
+		pthread_join(spinners[i], NULL);
+	trace_free(&run.trace);
+	if (!started)
+		return;
+
+	char metric[96];
+	snprintf(metric, sizeof(metric), "%s_p50_us", name);
+	bench_metric(metric, histogram_percentile(&run.latency, 0.50) / 1e3);
+	snprintf(metric, sizeof(metric), "%s_p99_us", name);
+	bench_metric(metric, histogram_percentile(&run.latency, 0.99) / 1e3);
+	snprintf(metric, sizeof(metric), "%s_max_us", name);
+	bench_metric(metric, run.latency.max / 1e3);
+	// 0 default, 1 high, 2 realtime: what the system let the thread have
+	snprintf(metric, sizeof(metric), "%s_class", name);
+	bench_metric(metric, got);
+}
+
+void bench_rt(void)
+{
+	measure("rt/wakeup_idle_default", RT_CLASS_DEFAULT, false);
+	measure("rt/wakeup_loaded_default", RT_CLASS_DEFAULT, true);
+	measure("rt/wakeup_loaded_high", RT_CLASS_HIGH, true);
+	measure("rt/wakeup_loaded_realtime", RT_CLASS_REALTIME, true);
+}
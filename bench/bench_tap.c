@@ -0,0 +1,22 @@
+#include "bench.h"
+#include "tap_health.h"
+
+// what key_handler adds per gesture callback
+static void run_callback(void* state, size_t ops)
+{
+	tap_health* h = state;
+	uint64_t now = bench_now_ns();
+	for (size_t i = 0; i < ops; i++) {
+		tap_health_conversion(h, 2000);
+		tap_health_callback(h, now, now + 15000, true);
+		now += 8333333; // 120 Hz
+	}
+}
+
+void bench_tap(void)
+{
+	tap_health h;
+	tap_health_init(&h);
+	if (bench_run("tap/callback_accounting", run_callback, &h))
+		bench_metric("tap/synthetic_events_per_sec", h.rate);
+}
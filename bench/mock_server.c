@@ -0,0 +1,507 @@
+#include "mock_server.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i3ipc.h"
+#include "ipc.h"
+#include "yyjson.h"
+
+#define MOCK_BUFFER_SIZE 65536
+#define MOCK_MONITORS 2
+#define MOCK_PER_MONITOR 8
+#define MOCK_SUBSCRIBERS 4
+
+struct mock_server {
+	int listen_fd;
+	char path[108];
+	mock_protocol protocol;
+	pthread_t thread;
+	pthread_mutex_t lock; // the state and replies below
+	int visible[MOCK_MONITORS]; // index within the monitor
+	int focused; // monitor index
+	char* all_reply; // list-workspaces --all, rebuilt when the state changes
+	char* stale_reply; // the one before that
+	char* visible_reply; // list-workspaces --monitor all --visible
+	char* stale_visible_reply;
+	mock_failure failure;
+	int failures; // commands left to fail
+	char* nonempty_reply; // list-workspaces --empty no
+	char* ok_reply;
+	char* error_reply;
+	char* i3_workspaces;
+	char* i3_commands; // RUN_COMMAND payloads, newline-separated
+	int subscribers[MOCK_SUBSCRIBERS]; // fds, -1 when free
+	int subscriber_count;
+};
+
+typedef struct {
+	mock_server* server;
+	int fd;
+	bool subscribed;
+} mock_client;
+
+// Only the visible workspaces when visible_only.
+static char* workspace_json(int monitors, int per_monitor, const int* visible, int focused, bool visible_only)
+{
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* root = yyjson_mut_arr(doc);
+	yyjson_mut_doc_set_root(doc, root);
+
+	char name[16];
+	for (int m = 0; m < monitors; m++) {
+		for (int w = 0; w < per_monitor; w++) {
+			if (visible_only && w != visible[m])
+				continue;
+			snprintf(name, sizeof(name), "%d", m * per_monitor + w + 1);
+			yyjson_mut_val* item = yyjson_mut_arr_add_obj(doc, root);
+			yyjson_mut_obj_add_strcpy(doc, item, "workspace", name);
+			yyjson_mut_obj_add_int(doc, item, "monitor-id", m + 1);
+			yyjson_mut_obj_add_bool(doc, item, "workspace-is-visible", w == visible[m]);
+			yyjson_mut_obj_add_bool(doc, item, "workspace-is-focused", m == focused && w == visible[m]);
+		}
+	}
+
+	char* json = yyjson_mut_write(doc, 0, NULL);
+	yyjson_mut_doc_free(doc);
+	return json;
+}
+
+char* mock_workspace_json(int monitors, int per_monitor)
+{
+	int* visible = calloc(monitors, sizeof(int));
+	char* json = workspace_json(monitors, per_monitor, visible, 0, false);
+	free(visible);
+	return json;
+}
+
+static char* aerospace_reply(int exit_code, const char* stdout_text, const char* stderr_text)
+{
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* root = yyjson_mut_obj(doc);
+	yyjson_mut_doc_set_root(doc, root);
+	yyjson_mut_obj_add_int(doc, root, "exitCode", exit_code);
+	yyjson_mut_obj_add_str(doc, root, "stdout", stdout_text);
+	yyjson_mut_obj_add_str(doc, root, "stderr", stderr_text);
+
+	size_t len;
+	char* json = yyjson_mut_write(doc, 0, &len);
+	yyjson_mut_doc_free(doc);
+
+	// replies are newline-terminated like the server's
+	json = realloc(json, len + 2);
+	json[len] = '\n';
+	json[len + 1] = '\0';
+	return json;
+}
+
+static bool write_all(int fd, const void* data, size_t len)
+{
+	const char* p = data;
+	while (len > 0) {
+		ssize_t n = write(fd, p, len);
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+// Rebuilds the listing after a change; the old one is kept for
+// MOCK_FAIL_STALE. Called with the lock held.
+static void state_changed(mock_server* server)
+{
+	free(server->stale_reply);
+	free(server->stale_visible_reply);
+	server->stale_reply = server->all_reply;
+	server->stale_visible_reply = server->visible_reply;
+	char* all = workspace_json(MOCK_MONITORS, MOCK_PER_MONITOR, server->visible, server->focused, false);
+	server->all_reply = aerospace_reply(0, all, "");
+	free(all);
+	all = workspace_json(MOCK_MONITORS, MOCK_PER_MONITOR, server->visible, server->focused, true);
+	server->visible_reply = aerospace_reply(0, all, "");
+	free(all);
+}
+
+// Carries out `workspace <name|next|prev> [--wrap-around]`; false if there
+// is no such workspace. Called with the lock held.
+static bool focus(mock_server* server, yyjson_val* args)
+{
+	const char* target = yyjson_get_str(yyjson_arr_get(args, 1));
+	if (!target)
+		return false;
+
+	int m = server->focused, w = server->visible[m];
+	if (strcmp(target, "next") == 0 || strcmp(target, "prev") == 0) {
+		bool wrap = yyjson_equals_str(yyjson_arr_get(args, 2), "--wrap-around");
+		w += target[0] == 'n' ? 1 : -1;
+		if (w < 0 || w >= MOCK_PER_MONITOR) {
+			if (!wrap)
+				return true;
+			w = (w + MOCK_PER_MONITOR) % MOCK_PER_MONITOR;
+		}
+	} else {
+		int n = atoi(target) - 1;
+		if (n < 0 || n >= MOCK_MONITORS * MOCK_PER_MONITOR)
+			return false;
+		m = n / MOCK_PER_MONITOR;
+		w = n % MOCK_PER_MONITOR;
+	}
+	server->focused = m;
+	server->visible[m] = w;
+	state_changed(server);
+	return true;
+}
+
+// The reply to one request, or NULL when the connection is to drop
+// instead; caller frees.
+static char* answer_aerospace(mock_server* server, yyjson_val* request)
+{
+	yyjson_val* args = yyjson_obj_get(request, "args");
+	pthread_mutex_lock(&server->lock);
+	char* reply = NULL;
+	if (yyjson_equals_str(yyjson_arr_get(args, 0), "list-workspaces")) {
+		bool nonempty = false, visible = false;
+		size_t idx, max;
+		yyjson_val* arg;
+		yyjson_arr_foreach(args, idx, max, arg)
+		{
+			nonempty = nonempty || yyjson_equals_str(arg, "--empty");
+			visible = visible || yyjson_equals_str(arg, "--visible");
+		}
+		bool stale = server->failures > 0 && server->failure == MOCK_FAIL_STALE && server->stale_reply;
+		if (nonempty)
+			reply = strdup(server->nonempty_reply);
+		else if (visible)
+			reply = strdup(stale ? server->stale_visible_reply : server->visible_reply);
+		else
+			reply = strdup(stale ? server->stale_reply : server->all_reply);
+		// the --empty listing goes out with the full one and shares its turn
+		if (stale && !nonempty)
+			server->failures--;
+	} else if (yyjson_equals_str(yyjson_arr_get(args, 0), "workspace")) {
+		mock_failure failure = server->failures > 0 ? server->failure : MOCK_FAIL_NONE;
+		if (failure == MOCK_FAIL_ERROR) {
+			reply = strdup(server->error_reply);
+		} else {
+			bool found = focus(server, args);
+			if (failure != MOCK_FAIL_DROP)
+				reply = strdup(found ? server->ok_reply : server->error_reply);
+		}
+		if (failure == MOCK_FAIL_ERROR || failure == MOCK_FAIL_DROP)
+			server->failures--;
+	} else {
+		reply = strdup(server->ok_reply);
+	}
+	pthread_mutex_unlock(&server->lock);
+	return reply;
+}
+
+static void serve_aerospace(mock_server* server, int fd, char* buf)
+{
+	size_t len = 0;
+	for (;;) {
+		ssize_t n = read(fd, buf + len, MOCK_BUFFER_SIZE - len);
+		if (n <= 0)
+			return;
+		len += (size_t)n;
+
+		size_t used = 0;
+		while (used < len) {
+			while (used < len && (buf[used] == '\n' || buf[used] == ' '))
+				used++;
+			if (used == len)
+				break;
+
+			yyjson_doc* doc = yyjson_read_opts(buf + used, len - used, YYJSON_READ_STOP_WHEN_DONE, NULL, NULL);
+			if (!doc)
+				break;
+			used += yyjson_doc_get_read_size(doc);
+
+			char* reply = answer_aerospace(server, yyjson_doc_get_root(doc));
+			yyjson_doc_free(doc);
+			bool ok = reply && write_all(fd, reply, strlen(reply));
+			free(reply);
+			if (!ok)
+				return;
+		}
+
+		memmove(buf, buf + used, len - used);
+		len -= used;
+	}
+}
+
+static bool read_exact(int fd, char* buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = read(fd, buf, len);
+		if (n <= 0)
+			return false;
+		buf += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+static bool write_i3(int fd, uint32_t type, const char* payload)
+{
+	char header[I3IPC_HEADER_SIZE];
+	uint32_t len = (uint32_t)strlen(payload);
+	memcpy(header, I3IPC_MAGIC, 6);
+	memcpy(header + 6, &len, 4);
+	memcpy(header + 10, &type, 4);
+	return write_all(fd, header, sizeof(header)) && write_all(fd, payload, len);
+}
+
+// Called with the lock held.
+static void log_command(mock_server* server, const char* command, size_t len)
+{
+	size_t used = server->i3_commands ? strlen(server->i3_commands) : 0;
+	server->i3_commands = realloc(server->i3_commands, used + len + 2);
+	memcpy(server->i3_commands + used, command, len);
+	server->i3_commands[used + len] = '\n';
+	server->i3_commands[used + len + 1] = '\0';
+}
+
+// Once subscribed a client gets the events mock_server_event sends; its
+// connection stays registered until it closes or the server stops.
+static void serve_i3(mock_client* client, char* buf)
+{
+	mock_server* server = client->server;
+	for (;;) {
+		char header[I3IPC_HEADER_SIZE];
+		uint32_t len, type;
+		if (!read_exact(client->fd, header, sizeof(header)))
+			return;
+		memcpy(&len, header + 6, 4);
+		memcpy(&type, header + 10, 4);
+		if (len > MOCK_BUFFER_SIZE || !read_exact(client->fd, buf, len))
+			return;
+
+		pthread_mutex_lock(&server->lock);
+		char* reply;
+		bool subscribe = false;
+		if (type == I3IPC_GET_WORKSPACES) {
+			reply = strdup(server->i3_workspaces);
+		} else if (type == I3IPC_SUBSCRIBE) {
+			subscribe = !client->subscribed && server->subscriber_count < MOCK_SUBSCRIBERS;
+			reply = strdup(subscribe ? "{\"success\":true}" : "{\"success\":false}");
+		} else {
+			log_command(server, buf, len);
+			reply = strdup("[{\"success\":true}]");
+		}
+		pthread_mutex_unlock(&server->lock);
+
+		bool ok = write_i3(client->fd, type, reply);
+		free(reply);
+		if (!ok)
+			return;
+
+		// registered only after the reply, so no event overtakes it
+		if (subscribe) {
+			pthread_mutex_lock(&server->lock);
+			for (int i = 0; i < MOCK_SUBSCRIBERS; i++) {
+				if (server->subscribers[i] < 0) {
+					server->subscribers[i] = client->fd;
+					server->subscriber_count++;
+					break;
+				}
+			}
+			client->subscribed = true;
+			pthread_mutex_unlock(&server->lock);
+		}
+	}
+}
+
+// Only a subscribed client touches the server on its way out:
+// mock_server_stop waits for those and no others.
+static void unsubscribe(mock_client* client)
+{
+	mock_server* server = client->server;
+	pthread_mutex_lock(&server->lock);
+	for (int i = 0; i < MOCK_SUBSCRIBERS; i++) {
+		if (server->subscribers[i] == client->fd) {
+			server->subscribers[i] = -1;
+			server->subscriber_count--;
+		}
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+static void* client_thread(void* arg)
+{
+	mock_client* client = arg;
+	char* buf = malloc(MOCK_BUFFER_SIZE);
+	if (client->server->protocol == MOCK_AEROSPACE)
+		serve_aerospace(client->server, client->fd, buf);
+	else
+		serve_i3(client, buf);
+
+	free(buf);
+	if (client->subscribed)
+		unsubscribe(client);
+	close(client->fd);
+	free(client);
+	return NULL;
+}
+
+static void* accept_thread(void* arg)
+{
+	mock_server* server = arg;
+	for (;;) {
+		int fd = accept(server->listen_fd, NULL, NULL);
+		if (fd < 0)
+			return NULL;
+
+		mock_client* client = malloc(sizeof(mock_client));
+		client->server = server;
+		client->fd = fd;
+		client->subscribed = false;
+
+		pthread_t thread;
+		pthread_create(&thread, NULL, client_thread, client);
+		pthread_detach(thread);
+	}
+}
+
+mock_server* mock_server_start(const char* path, mock_protocol protocol)
+{
+	mock_server* server = calloc(1, sizeof(mock_server));
+	server->protocol = protocol;
+	snprintf(server->path, sizeof(server->path), "%s", path);
+
+	pthread_mutex_init(&server->lock, NULL);
+	state_changed(server);
+	server->nonempty_reply = aerospace_reply(0, "[{\"workspace\":\"1\"},{\"workspace\":\"2\"},{\"workspace\":\"9\"}]", "");
+	server->ok_reply = aerospace_reply(0, "", "");
+	server->error_reply = aerospace_reply(1, "", "mock: command failed");
+
+	server->i3_workspaces = strdup("[{\"name\":\"1\",\"output\":\"A\",\"focused\":true},"
+								   "{\"name\":\"2\",\"output\":\"A\",\"focused\":false},"
+								   "{\"name\":\"3\",\"output\":\"B\",\"focused\":false}]");
+	for (int i = 0; i < MOCK_SUBSCRIBERS; i++)
+		server->subscribers[i] = -1;
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	unlink(path);
+
+	server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server->listen_fd < 0 || bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+		|| listen(server->listen_fd, 8) < 0) {
+		perror("mock_server_start");
+		mock_server_stop(server);
+		return NULL;
+	}
+
+	pthread_create(&server->thread, NULL, accept_thread, server);
+	return server;
+}
+
+void mock_server_stop(mock_server* server)
+{
+	if (!server)
+		return;
+	if (server->listen_fd >= 0) {
+		shutdown(server->listen_fd, SHUT_RDWR);
+		close(server->listen_fd);
+		if (server->thread)
+			pthread_join(server->thread, NULL);
+	}
+
+	// end the subscriptions and wait for their threads to let go
+	pthread_mutex_lock(&server->lock);
+	for (int i = 0; i < MOCK_SUBSCRIBERS; i++) {
+		if (server->subscribers[i] >= 0)
+			shutdown(server->subscribers[i], SHUT_RDWR);
+	}
+	pthread_mutex_unlock(&server->lock);
+	while (mock_server_subscribers(server) > 0)
+		nanosleep(&(struct timespec) { 0, 1000000 }, NULL);
+
+	unlink(server->path);
+	free(server->all_reply);
+	free(server->stale_reply);
+	free(server->visible_reply);
+	free(server->stale_visible_reply);
+	free(server->nonempty_reply);
+	free(server->ok_reply);
+	free(server->error_reply);
+	free(server->i3_workspaces);
+	free(server->i3_commands);
+	pthread_mutex_destroy(&server->lock);
+	free(server);
+}
+
+void mock_server_fail(mock_server* server, mock_failure failure, int count)
+{
+	pthread_mutex_lock(&server->lock);
+	server->failure = failure;
+	server->failures = count;
+	pthread_mutex_unlock(&server->lock);
+}
+
+void mock_server_focus(mock_server* server, int workspace)
+{
+	pthread_mutex_lock(&server->lock);
+	int n = workspace - 1;
+	if (n >= 0 && n < MOCK_MONITORS * MOCK_PER_MONITOR) {
+		server->focused = n / MOCK_PER_MONITOR;
+		server->visible[server->focused] = n % MOCK_PER_MONITOR;
+		state_changed(server);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+int mock_server_visible(mock_server* server, int monitor_id)
+{
+	pthread_mutex_lock(&server->lock);
+	int m = monitor_id - 1;
+	int workspace = m >= 0 && m < MOCK_MONITORS ? m * MOCK_PER_MONITOR + server->visible[m] + 1 : 0;
+	pthread_mutex_unlock(&server->lock);
+	return workspace;
+}
+
+void mock_server_set_workspaces(mock_server* server, const char* json)
+{
+	pthread_mutex_lock(&server->lock);
+	free(server->i3_workspaces);
+	server->i3_workspaces = strdup(json);
+	pthread_mutex_unlock(&server->lock);
+}
+
+char* mock_server_commands(mock_server* server)
+{
+	pthread_mutex_lock(&server->lock);
+	char* commands = server->i3_commands ? server->i3_commands : strdup("");
+	server->i3_commands = NULL;
+	pthread_mutex_unlock(&server->lock);
+	return commands;
+}
+
+int mock_server_subscribers(mock_server* server)
+{
+	pthread_mutex_lock(&server->lock);
+	int count = server->subscriber_count;
+	pthread_mutex_unlock(&server->lock);
+	return count;
+}
+
+void mock_server_event(mock_server* server, uint32_t type, const char* payload)
+{
+	pthread_mutex_lock(&server->lock);
+	for (int i = 0; i < MOCK_SUBSCRIBERS; i++) {
+		if (server->subscribers[i] >= 0)
+			write_i3(server->subscribers[i], type, payload);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+
+// Stand-in window-manager sockets for round-trip benchmarks and tests.
+// Replies are canned, so the numbers measure the client and the socket, not
+// a WM. The AeroSpace mock keeps which workspace each of its two monitors
+// shows (workspaces 1-8 and 9-16): `workspace` commands move it and
+// list-workspaces (all, or --visible) reports it, and failures can be injected into both. The
+// i3 mock logs the commands it is sent and pushes events to subscribers.
+
+typedef enum {
+	MOCK_AEROSPACE, // newline-framed JSON requests, AeroSpace server replies
+	MOCK_I3, // i3-ipc binary framing
+} mock_protocol;
+
+typedef struct mock_server mock_server;
+
+typedef enum {
+	MOCK_FAIL_NONE,
+	MOCK_FAIL_ERROR, // a `workspace` command answers exitCode 1 and changes nothing
+	MOCK_FAIL_DROP, // a `workspace` command is carried out, then the connection closes unanswered
+	MOCK_FAIL_STALE, // list-workspaces reports the state from before the last change
+} mock_failure;
+
+mock_server* mock_server_start(const char* path, mock_protocol protocol);
+void mock_server_stop(mock_server* server);
+
+// The next count requests of the kind failure applies to fail that way.
+void mock_server_fail(mock_server* server, mock_failure failure, int count);
+
+// Shows workspace (1-16) on its monitor and focuses it behind the clients'
+// backs, the way a click or a keyboard shortcut would.
+void mock_server_focus(mock_server* server, int workspace);
+
+// The workspace monitor_id (1 or 2) shows.
+int mock_server_visible(mock_server* server, int monitor_id);
+
+// The workspace listing both mocks report: `monitors` monitors with
+// `per_monitor` workspaces each, in AeroSpace's list-workspaces JSON.
+char* mock_workspace_json(int monitors, int per_monitor);
+
+// The i3 mock's GET_WORKSPACES reply from now on.
+void mock_server_set_workspaces(mock_server* server, const char* json);
+
+// The commands the i3 mock was sent since the last call, one per line;
+// caller frees.
+char* mock_server_commands(mock_server* server);
+
+// How many i3 clients are subscribed.
+int mock_server_subscribers(mock_server* server);
+
+// Sends an event (e.g. I3IPC_EVENT_WORKSPACE) to every subscribed i3 client.
+void mock_server_event(mock_server* server, uint32_t type, const char* payload);
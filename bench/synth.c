@@ -0,0 +1,159 @@
+#include "synth.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+void bench_trace_swipes(touch_trace* trace, int fingers, int swipes, double peak_step, int ramp)
+{
+	static const int directions[] = { GESTURE_RIGHT, GESTURE_LEFT };
+	bench_trace_swipes_along(trace, fingers, swipes, peak_step, ramp, directions, 2);
+}
+
+// One swipe with its lead-in, lift-off frame and trailing empty frame.
+static void append_swipe(touch_trace* trace, int fingers, int direction, double peak_step, int ramp, int moves, double* t)
+{
+	static const double axis_x[GESTURE_AXES + 1] = { 0, 1, 0, M_SQRT1_2, M_SQRT1_2 };
+	static const double axis_y[GESTURE_AXES + 1] = { 0, 0, 1, M_SQRT1_2, -M_SQRT1_2 };
+	const int rest = 4;
+	const double dt = 1.0 / 120.0;
+	touch frame[MAX_TOUCHES];
+
+	double dir = direction > 0 ? 1.0 : -1.0;
+	double ux = dir * axis_x[abs(direction)], uy = dir * axis_y[abs(direction)];
+	// starts 0.2 before the middle of the pad and moves through it
+	double x = 0.5 - 0.2 * ux, y = 0.5 - 0.2 * uy;
+
+	for (int f = 0; f < rest + moves + 1; f++, *t += dt) {
+		int moving = f - rest + 1;
+		double step = moving > 0 ? peak_step * (moving < ramp ? (double)moving / ramp : 1.0) : 0;
+		bool lift = f == rest + moves;
+		x += ux * step;
+		y += uy * step;
+
+		for (int i = 0; i < fingers; i++) {
+			frame[i].x = x + 0.04 * i;
+			frame[i].y = y + 0.03 * i;
+			frame[i].phase = lift ? END_PHASE : (f == 0 ? 1 : 2);
+			frame[i].timestamp = *t;
+			frame[i].velocity = ux * step / dt;
+			frame[i].velocity_y = uy * step / dt;
+			frame[i].is_palm = false;
+			frame[i].id = i;
+		}
+		trace_append(trace, frame, fingers);
+		if (lift)
+			trace_annotate(trace, trace->frames - 1, direction);
+	}
+
+	trace_append(trace, frame, 0);
+	*t += dt;
+}
+
+void bench_trace_swipes_along(touch_trace* trace, int fingers, int swipes, double peak_step, int ramp,
+	const int* directions, int direction_count)
+{
+	trace_init(trace);
+	double t = 0;
+	for (int s = 0; s < swipes; s++)
+		append_swipe(trace, fingers, directions[s % direction_count], peak_step, ramp, 24, &t);
+}
+
+void bench_trace_flings(touch_trace* trace, int fingers, int flings, const double* peak_steps, int speeds)
+{
+	trace_init(trace);
+	double t = 0;
+	for (int s = 0; s < flings; s++)
+		append_swipe(trace, fingers, s % 2 ? GESTURE_LEFT : GESTURE_RIGHT, peak_steps[s % speeds], 3, 8, &t);
+}
+
+void bench_trace_pinches(touch_trace* trace, int fingers, int pinches, double peak_step, int ramp)
+{
+	const int rest = 4, moves = 24;
+	const double dt = 1.0 / 120.0;
+	touch frame[MAX_TOUCHES];
+
+	trace_init(trace);
+	double t = 0;
+	for (int p = 0; p < pinches; p++) {
+		int direction = p % 2 ? GESTURE_PINCH_OUT : GESTURE_PINCH_IN;
+		double dir = direction > 0 ? 1.0 : -1.0;
+		// the fingers sit on a circle around the middle of the pad, off the
+		// axes so every one of them moves in x and y
+		double radius = direction > 0 ? 0.06 : 0.16;
+
+		for (int f = 0; f < rest + moves + 1; f++, t += dt) {
+			int moving = f - rest + 1;
+			double step = moving > 0 ? peak_step * (moving < ramp ? (double)moving / ramp : 1.0) : 0;
+			bool lift = f == rest + moves;
+			radius += dir * step;
+
+			for (int i = 0; i < fingers; i++) {
+				double angle = M_PI / 4 + 2 * M_PI * i / fingers;
+				frame[i].x = 0.5 + radius * cos(angle);
+				frame[i].y = 0.5 + radius * sin(angle);
+				frame[i].phase = lift ? END_PHASE : (f == 0 ? 1 : 2);
+				frame[i].timestamp = t;
+				frame[i].velocity = dir * step * cos(angle) / dt;
+				frame[i].velocity_y = dir * step * sin(angle) / dt;
+				frame[i].is_palm = false;
+				frame[i].id = i;
+			}
+			trace_append(trace, frame, fingers);
+			if (lift)
+				trace_annotate(trace, trace->frames - 1, direction);
+		}
+
+		trace_append(trace, frame, 0);
+		t += dt;
+	}
+}
+
+void bench_trace_reestimate(touch_trace* trace, bench_velocity how)
+{
+	if (how == BENCH_VELOCITY_EXACT)
+		return;
+
+	double last_x[MAX_TOUCHES], last_y[MAX_TOUCHES], vel_x[MAX_TOUCHES], vel_y[MAX_TOUCHES];
+	double last_t = 0;
+	unsigned seed = 1;
+	for (int f = 0; f < trace->frames; f++) {
+		touch* touches = trace->touches + trace->offsets[f];
+		int count = trace->counts[f] > MAX_TOUCHES ? MAX_TOUCHES : trace->counts[f];
+		if (!count)
+			continue;
+
+		seed = seed * 1103515245u + 12345u;
+		double jitter = ((seed >> 16) & 0x7fff) / 32767.0 - 0.5;
+		double t = touches[0].timestamp + (how == BENCH_VELOCITY_JITTERED ? jitter * 0.5 / 120.0 : 0);
+		for (int i = 0; i < count; i++) {
+			touch* tc = &touches[i];
+			int id = tc->id % MAX_TOUCHES;
+			if (tc->phase == 1) {
+				vel_x[id] = vel_y[id] = 0;
+			} else if (t > last_t) {
+				double vx = (tc->x - last_x[id]) / (t - last_t), vy = (tc->y - last_y[id]) / (t - last_t);
+				double keep = how == BENCH_VELOCITY_SMOOTHED ? 0.5 : 0;
+				vel_x[id] = keep * vel_x[id] + (1 - keep) * vx;
+				vel_y[id] = keep * vel_y[id] + (1 - keep) * vy;
+			}
+			last_x[id] = tc->x;
+			last_y[id] = tc->y;
+			tc->velocity = vel_x[id];
+			tc->velocity_y = vel_y[id];
+		}
+		last_t = t;
+	}
+}
+
+void bench_fire_steps(const touch_trace* trace, const trace_fire* fires, int fired, int* steps, int* calls)
+{
+	for (int a = 0, i = 0; a < trace->fire_count; a++) {
+		steps[a] = calls[a] = 0;
+		for (; i < fired && trace->fires[a].frame >= fires[i].frame; i++) {
+			if (fires[i].direction == trace->fires[a].direction) {
+				steps[a] += fires[i].steps;
+				calls[a]++;
+			}
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "trace.h"
+
+// Synthetic touch traces for the benches and tests.
+
+// Repeated `fingers`-finger swipes alternating right and left, sampled at
+// 120 Hz. Each has a resting lead-in, speeds up to peak_step of pad width per
+// frame over ramp frames, then lifts off and leaves an empty frame. Every
+// swipe is annotated with its expected direction at the lift-off frame.
+void bench_trace_swipes(touch_trace* trace, int fingers, int swipes, double peak_step, int ramp);
+
+// The same, cycling through directions (gesture.h GESTURE_* values) instead
+// of right and left.
+void bench_trace_swipes_along(touch_trace* trace, int fingers, int swipes, double peak_step, int ramp,
+	const int* directions, int direction_count);
+
+// Short, hard swipes alternating right and left, the nth peaking at
+// peak_steps[n % speeds] of pad width per frame.
+void bench_trace_flings(touch_trace* trace, int fingers, int flings, const double* peak_steps, int speeds);
+
+// Pinches alternating in and out: the fingers spread on a circle that
+// shrinks or grows by up to peak_step per frame, annotated GESTURE_PINCH_IN
+// or GESTURE_PINCH_OUT at lift-off.
+void bench_trace_pinches(touch_trace* trace, int fingers, int pinches, double peak_step, int ramp);
+
+typedef enum {
+	BENCH_VELOCITY_EXACT, // as synthesized
+	BENCH_VELOCITY_JITTERED, // differences over timestamps off by up to a quarter frame
+	BENCH_VELOCITY_SMOOTHED, // differences through an EMA
+} bench_velocity;
+
+// Recomputes each touch's velocity from its positions the way another
+// producer might; BENCH_VELOCITY_EXACT leaves the trace as it is.
+void bench_trace_reestimate(touch_trace* trace, bench_velocity how);
+
+// The steps the fires of a replay add up to for each annotated swipe, and
+// how many fired calls that took; both arrays have trace->fire_count slots.
+void bench_fire_steps(const touch_trace* trace, const trace_fire* fires, int fired, int* steps, int* calls);
@@ -1,33 +1,65 @@
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <pwd.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/socket.h>
 #include <sys/uio.h>
-#include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include "aerospace.h"
+#include "ipc.h"
+#include "log.h"
 #include "yyjson.h"
 
 #define READ_BUFFER_SIZE 8192
+// how long the set of monitors and workspaces is trusted; in between a
+// refresh only asks which ones are visible and which are empty
+#define LISTING_TTL_NS (30ull * 1000 * 1000 * 1000)
+#define TABLE_FORMAT "%{workspace} %{monitor-id} %{workspace-is-visible} %{workspace-is-focused}"
+
+extern char** environ;
 
-static const char* ERROR_SOCKET_CREATE = "Failed to create Unix domain socket";
-static const char* ERROR_SOCKET_RECEIVE = "Failed to receive data from socket";
-static const char* ERROR_SOCKET_CLOSE = "Failed to close socket connection";
 static const char* ERROR_JSON_PRINT = "Failed to print JSON to string";
-static const char* WARN_CLI_FALLBACK = "Warning: Failed to connect to socket at %s: %s (errno %d). Falling back to CLI.";
+
+typedef struct {
+	char name[AEROSPACE_NAME_MAX];
+	bool empty;
+} workspace_entry;
+
+typedef struct {
+	int id;
+	int visible; // index into workspaces as confirmed by the server, -1 if unknown
+	int predicted; // visible after every in-flight navigation succeeds
+	int inflight;
+	unsigned long long last_seq; // newest navigation issued on this monitor
+	int count;
+	workspace_entry workspaces[AEROSPACE_MAX_WORKSPACES];
+} monitor_entry;
+
+// Snapshot of every monitor's workspaces. Replaced wholesale on refresh and
+// patched in place when the daemon itself moves focus.
+typedef struct {
+	int count;
+	int focused; // index into monitors, -1 if unknown
+	uint64_t refreshed_ns;
+	uint64_t listed_ns; // last full listing, 0 when the next must be one
+	monitor_entry monitors[AEROSPACE_MAX_MONITORS];
+} workspace_table;
 
 struct aerospace {
-	int fd;
+	ipc_conn conns[AEROSPACE_CONN_COUNT];
 	char* socket_path;
 	bool use_cli_fallback;
-	char read_buf[READ_BUFFER_SIZE];
-	size_t read_buf_len;
+	pthread_mutex_t table_lock;
+	workspace_table* table;
+	unsigned long long nav_seq;
 };
 
 static void fatal_error(const char* fmt, ...)
@@ -74,79 +106,8 @@ static char* get_default_socket_path(void)
 	return path;
 }
 
-static char* execute_cli_command(const char* command_string)
+static char* serialize_request(const char** args, int arg_count, const char* stdin_payload, size_t* len)
 {
-	FILE* pipe = popen(command_string, "r");
-	if (!pipe) {
-		fatal_error("popen() failed for command '%s'", command_string);
-	}
-
-	char* output = malloc(READ_BUFFER_SIZE + 1);
-	if (!output) {
-		pclose(pipe);
-		fatal_error("Failed to allocate buffer for CLI output");
-	}
-
-	size_t nread = fread(output, 1, READ_BUFFER_SIZE, pipe);
-	output[nread] = '\0';
-
-	int status = pclose(pipe);
-	if (status != 0) {
-		if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-			fprintf(stderr, "Warning: CLI command failed with exit code %d: %s\n", WEXITSTATUS(status), command_string);
-		} else if (status == -1) {
-			fprintf(stderr, "Warning: pclose failed: %s\n", strerror(errno));
-		}
-	}
-
-	if (nread > 0 && output[nread - 1] == '\n') {
-		output[nread - 1] = '\0';
-	}
-
-	return output;
-}
-
-static char* execute_aerospace_command(aerospace* client, const char** args, int arg_count, const char* stdin_payload, const char* expected_output_field)
-{
-	if (!client || !args || arg_count == 0) {
-		errno = EINVAL;
-		fprintf(stderr, "execute_aerospace_command: Invalid arguments\n");
-		return NULL;
-	}
-
-	if (client->use_cli_fallback) {
-		size_t total_len = strlen("aerospace");
-		for (int i = 0; i < arg_count; i++) {
-			total_len += 1 + strlen(args[i]);
-		}
-
-		char* cli_command_base = malloc(total_len + 1);
-		if (!cli_command_base) {
-			fatal_error("Failed to allocate memory for CLI command");
-		}
-
-		char* p = cli_command_base;
-		p += sprintf(p, "aerospace");
-		for (int i = 0; i < arg_count; i++) {
-			p += sprintf(p, " %s", args[i]);
-		}
-
-		char* final_command;
-		if (stdin_payload && strlen(stdin_payload) > 0) {
-			const char* format = "echo '%s' | %s";
-			size_t len = snprintf(NULL, 0, format, stdin_payload, cli_command_base);
-			final_command = malloc(len + 1);
-			snprintf(final_command, len + 1, format, stdin_payload, cli_command_base);
-			free(cli_command_base);
-		} else {
-			final_command = cli_command_base;
-		}
-
-		char* result = execute_cli_command(final_command);
-		free(final_command);
-		return result;
-	}
-
 	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
 	yyjson_mut_val* root = yyjson_mut_obj(doc);
 	yyjson_mut_doc_set_root(doc, root);
@@ -157,54 +118,44 @@ static char* execute_aerospace_command(aerospace* client, const char** args, int
 		yyjson_mut_arr_add_str(doc, args_array, args[i]);
 	}
 	yyjson_mut_obj_add_val(doc, root, "args", args_array);
-	size_t len;
-	const char* json_str = yyjson_mut_write(doc, 0, &len);
+	char* json_str = yyjson_mut_write(doc, 0, len);
 	yyjson_mut_doc_free(doc);
 	if (!json_str) {
 		fatal_error(ERROR_JSON_PRINT);
 	}
+	return json_str;
+}
 
-	struct iovec iov[2];
-	char newline = '\n';
-	iov[0].iov_base = (void*)json_str;
-	iov[0].iov_len = len;
-	iov[1].iov_base = &newline;
-	iov[1].iov_len = 1;
-
-	if (writev(client->fd, iov, 2) < 0) {
-		perror("writev failed");
-	}
-	free((void*)json_str);
+// Reads one reply. A reply that is not JSON or has no exitCode drops the
+// connection: whatever follows it cannot be matched to a request, so the
+// next request reconnects instead of reading it.
+static char* conn_read_response(ipc_conn* conn, const char* expected_output_field, bool* failed)
+{
+	*failed = true;
 
 	yyjson_doc* resp_doc = NULL;
 	yyjson_read_err err;
 	size_t parsed_bytes = 0;
 
 	while (true) {
-		if (client->read_buf_len > 0) {
-			resp_doc = yyjson_read_opts(client->read_buf, client->read_buf_len, YYJSON_READ_STOP_WHEN_DONE, NULL, &err);
+		if (conn->read_buf_len > 0) {
+			resp_doc = yyjson_read_opts(conn->read_buf, conn->read_buf_len, YYJSON_READ_STOP_WHEN_DONE, NULL, &err);
 			if (resp_doc) {
 				parsed_bytes = yyjson_doc_get_read_size(resp_doc);
 				break;
 			}
+			// only a reply cut short can still complete
+			if (err.code != YYJSON_READ_ERROR_UNEXPECTED_END && err.code != YYJSON_READ_ERROR_EMPTY_CONTENT) {
+				log_error("Malformed response: %s at byte %zu", err.msg, err.pos);
+				ipc_conn_drop(conn);
+				return NULL;
+			}
 		}
-		if (client->read_buf_len >= READ_BUFFER_SIZE) {
-			fprintf(stderr, "Error: Read buffer overflow, clearing buffer.\n");
-			client->read_buf_len = 0;
-			return NULL;
-		}
-		ssize_t bytes_read = read(client->fd, client->read_buf + client->read_buf_len, READ_BUFFER_SIZE - client->read_buf_len);
-		if (bytes_read <= 0) {
-			fprintf(stderr, "%s\n", ERROR_SOCKET_RECEIVE);
+		if (ipc_conn_fill(conn) <= 0)
 			return NULL;
-		}
-		client->read_buf_len += bytes_read;
 	}
 
-	if (client->read_buf_len > parsed_bytes) {
-		memmove(client->read_buf, client->read_buf + parsed_bytes, client->read_buf_len - parsed_bytes);
-	}
-	client->read_buf_len -= parsed_bytes;
+	ipc_conn_consume(conn, parsed_bytes);
 
 	yyjson_val* resp_root = yyjson_doc_get_root(resp_doc);
 	char* result = NULL;
@@ -213,11 +164,13 @@ static char* execute_aerospace_command(aerospace* client, const char** args, int
 	if (yyjson_is_int(exitCodeItem)) {
 		exitCode = (int)yyjson_get_int(exitCodeItem);
 	} else {
-		fprintf(stderr, "Response does not contain valid %s field\n", "exitCode");
+		log_error("Response does not contain valid %s field", "exitCode");
 		yyjson_doc_free(resp_doc);
+		ipc_conn_drop(conn);
 		return NULL;
 	}
 
+	*failed = false;
 	if (exitCode != 0) {
 		yyjson_val* output_item = yyjson_obj_get(resp_root, "stderr");
 		if (yyjson_is_str(output_item)) {
@@ -234,41 +187,288 @@ static char* execute_aerospace_command(aerospace* client, const char** args, int
 	return result;
 }
 
+// Reads what fd has into buf, keeping at most cap - 1 bytes and dropping the
+// rest so the CLI never blocks on a full pipe. False at end of file.
+static bool cli_read(int fd, char* buf, size_t cap, size_t* len)
+{
+	char discard[512];
+	bool room = *len < cap - 1;
+	ssize_t n = read(fd, room ? buf + *len : discard, room ? cap - 1 - *len : sizeof(discard));
+	if (n < 0)
+		return errno == EINTR || errno == EAGAIN;
+	if (n == 0)
+		return false;
+	if (room)
+		*len += (size_t)n;
+	return true;
+}
+
+static void strip_newline(char* buf, size_t len)
+{
+	buf[len] = '\0';
+	if (len > 0 && buf[len - 1] == '\n')
+		buf[len - 1] = '\0';
+}
+
+// Runs the aerospace CLI with args as its argv and stdin_payload on its
+// stdin. No shell sits in between, so an argument such as a --format string
+// reaches it as one word, whatever it contains. Answers like a socket
+// request: stdout if expected_output_field asks for output, NULL on another
+// success, stderr (or the exit code) on failure, and *failed with NULL when
+// the CLI could not be run or did not exit.
+static char* execute_cli(const char** args, int arg_count, const char* stdin_payload, const char* expected_output_field, bool* failed)
+{
+	*failed = true;
+	const char* argv[arg_count + 2];
+	argv[0] = "aerospace";
+	for (int i = 0; i < arg_count; i++)
+		argv[i + 1] = args[i];
+	argv[arg_count + 1] = NULL;
+
+	bool feed = stdin_payload && stdin_payload[0];
+	int out[2], err[2], in[2] = { -1, -1 };
+	if (pipe(out) != 0 || pipe(err) != 0 || (feed && pipe(in) != 0))
+		fatal_error("pipe() failed for aerospace %s", args[0]);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+	posix_spawn_file_actions_addclose(&actions, out[0]);
+	posix_spawn_file_actions_addclose(&actions, out[1]);
+	posix_spawn_file_actions_addclose(&actions, err[0]);
+	posix_spawn_file_actions_addclose(&actions, err[1]);
+	if (feed) {
+		posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+		posix_spawn_file_actions_addclose(&actions, in[0]);
+		posix_spawn_file_actions_addclose(&actions, in[1]);
+	} else {
+		// never the daemon's own stdin
+		posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+	}
+
+	pid_t pid;
+	int rc = posix_spawnp(&pid, "aerospace", &actions, NULL, (char* const*)argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	close(out[1]);
+	close(err[1]);
+	if (feed)
+		close(in[0]);
+
+	if (rc != 0) {
+		log_warn("Warning: could not run aerospace %s: %s", args[0], strerror(rc));
+		if (feed)
+			close(in[1]);
+		close(out[0]);
+		close(err[0]);
+		return NULL;
+	}
+
+	// the payload is a workspace list, well under a pipe buffer, so it goes
+	// in whole before the output is read
+	if (feed) {
+		size_t len = strlen(stdin_payload);
+		if (write(in[1], stdin_payload, len) != (ssize_t)len || write(in[1], "\n", 1) != 1)
+			log_warn("Warning: aerospace %s did not take its input: %s", args[0], strerror(errno));
+		close(in[1]);
+	}
+
+	char* output = malloc(READ_BUFFER_SIZE + 1);
+	if (!output)
+		fatal_error("Failed to allocate buffer for CLI output");
+	char error[1024];
+	size_t output_len = 0, error_len = 0;
+
+	// both pipes are drained together so neither fills up while the other
+	// is read
+	struct pollfd fds[2] = { { .fd = out[0], .events = POLLIN }, { .fd = err[0], .events = POLLIN } };
+	while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (fds[0].revents && !cli_read(out[0], output, READ_BUFFER_SIZE + 1, &output_len))
+			fds[0].fd = -1;
+		if (fds[1].revents && !cli_read(err[0], error, sizeof(error), &error_len))
+			fds[1].fd = -1;
+	}
+	close(out[0]);
+	close(err[0]);
+	strip_newline(output, output_len);
+	strip_newline(error, error_len);
+
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+	if (!WIFEXITED(status)) {
+		log_warn("Warning: aerospace %s did not exit", args[0]);
+		free(output);
+		return NULL;
+	}
+
+	*failed = false;
+	int code = WEXITSTATUS(status);
+	if (code != 0) {
+		free(output);
+		if (error[0])
+			return strdup(error);
+		size_t len = (size_t)snprintf(NULL, 0, "aerospace %s exited with code %d", args[0], code);
+		char* message = malloc(len + 1);
+		if (message)
+			snprintf(message, len + 1, "aerospace %s exited with code %d", args[0], code);
+		return message;
+	}
+	if (!expected_output_field) {
+		free(output);
+		return NULL;
+	}
+	return output;
+}
+
+// *failed is set when no reply was read, as opposed to a reply with a
+// non-zero exitCode.
+static char* execute_request(aerospace* client, aerospace_conn_kind kind, const char** args, int arg_count, const char* stdin_payload, const char* expected_output_field, bool* failed)
+{
+	*failed = true;
+	if (!client || !args || arg_count == 0 || kind < 0 || kind >= AEROSPACE_CONN_COUNT) {
+		errno = EINVAL;
+		log_error("execute_aerospace_command: Invalid arguments");
+		return NULL;
+	}
+
+	if (client->use_cli_fallback)
+		return execute_cli(args, arg_count, stdin_payload, expected_output_field, failed);
+
+	size_t len;
+	char* json_str = serialize_request(args, arg_count, stdin_payload, &len);
+
+	struct iovec iov[2];
+	char newline = '\n';
+	iov[0].iov_base = json_str;
+	iov[0].iov_len = len;
+	iov[1].iov_base = &newline;
+	iov[1].iov_len = 1;
+
+	ipc_conn* conn = &client->conns[kind];
+	pthread_mutex_lock(&conn->lock);
+
+	uint64_t start = ipc_monotonic_ns();
+	char* result = NULL;
+	if (ipc_conn_send(conn, iov, 2))
+		result = conn_read_response(conn, expected_output_field, failed);
+	ipc_conn_record(conn, start, 1, *failed);
+
+	pthread_mutex_unlock(&conn->lock);
+	free(json_str);
+	return result;
+}
+
+static char* execute_aerospace_command(aerospace* client, aerospace_conn_kind kind, const char** args, int arg_count, const char* stdin_payload, const char* expected_output_field)
+{
+	bool failed;
+	return execute_request(client, kind, args, arg_count, stdin_payload, expected_output_field, &failed);
+}
+
+static int execute_batch(aerospace* client, aerospace_conn_kind kind, const aerospace_command* commands, int count, char** results)
+{
+	if (!client || !commands || !results || count <= 0) {
+		errno = EINVAL;
+		log_error("aerospace_batch: Invalid arguments");
+		return -1;
+	}
+
+	for (int i = 0; i < count; i++)
+		results[i] = NULL;
+
+	if (client->use_cli_fallback) {
+		int answered = 0;
+		for (; answered < count; answered++) {
+			const aerospace_command* command = &commands[answered];
+			bool failed;
+			results[answered] = execute_cli(command->args, command->arg_count, command->stdin_payload, command->expected_output_field, &failed);
+			if (failed)
+				break;
+		}
+		return answered;
+	}
+
+	// every request is followed by its own newline, which can share one byte
+	char newline = '\n';
+	char** payloads = malloc(sizeof(char*) * count);
+	struct iovec* iov = malloc(sizeof(struct iovec) * count * 2);
+	if (!payloads || !iov)
+		fatal_error("Failed to allocate memory for batch");
+
+	for (int i = 0; i < count; i++) {
+		size_t len;
+		payloads[i] = serialize_request(commands[i].args, commands[i].arg_count, commands[i].stdin_payload, &len);
+		iov[i * 2].iov_base = payloads[i];
+		iov[i * 2].iov_len = len;
+		iov[i * 2 + 1].iov_base = &newline;
+		iov[i * 2 + 1].iov_len = 1;
+	}
+
+	ipc_conn* conn = &client->conns[kind];
+	pthread_mutex_lock(&conn->lock);
+
+	uint64_t start = ipc_monotonic_ns();
+	int answered = 0;
+	int errors = count;
+	if (ipc_conn_send(conn, iov, count * 2)) {
+		errors = 0;
+		for (; answered < count; answered++) {
+			bool failed;
+			results[answered] = conn_read_response(conn, commands[answered].expected_output_field, &failed);
+			if (failed) {
+				// responses after a broken one cannot be matched to their
+				// requests; the next request starts on a fresh connection
+				errors += count - answered;
+				ipc_conn_drop(conn);
+				break;
+			}
+		}
+	}
+	ipc_conn_record(conn, start, count, errors);
+
+	pthread_mutex_unlock(&conn->lock);
+
+	for (int i = 0; i < count; i++)
+		free(payloads[i]);
+	free(payloads);
+	free(iov);
+	return answered;
+}
+
+int aerospace_batch(aerospace* client, const aerospace_command* commands, int count, char** results)
+{
+	return execute_batch(client, AEROSPACE_CONN_COMMAND, commands, count, results);
+}
+
 aerospace* aerospace_new(const char* socketPath)
 {
 	aerospace* client = malloc(sizeof(aerospace));
-	client->fd = -1;
 	client->use_cli_fallback = false;
-	client->read_buf_len = 0;
+	client->table = NULL;
+	client->nav_seq = 0;
+	pthread_mutex_init(&client->table_lock, NULL);
 
 	if (socketPath)
 		client->socket_path = strdup(socketPath);
 	else
 		client->socket_path = get_default_socket_path();
 
-	errno = 0;
-	client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
-	if (client->fd < 0) {
-		int socket_errno = errno;
-		free(client->socket_path);
-		free(client);
-		errno = socket_errno;
-		fatal_error("%s", ERROR_SOCKET_CREATE);
+	for (int i = 0; i < AEROSPACE_CONN_COUNT; i++) {
+		if (!ipc_conn_open(&client->conns[i], client->socket_path) && !client->use_cli_fallback) {
+			int connect_errno = errno;
+			log_warn("Warning: Failed to connect to socket at %s: %s (errno %d). Falling back to CLI.", client->socket_path, strerror(connect_errno), connect_errno);
+			client->use_cli_fallback = true;
+		}
 	}
 
-	struct sockaddr_un addr;
-	memset(&addr, 0, sizeof(struct sockaddr_un));
-	addr.sun_family = AF_UNIX;
-	strncpy(addr.sun_path, client->socket_path, sizeof(addr.sun_path) - 1);
-	addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
-
-	errno = 0;
-	if (connect(client->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-		int connect_errno = errno;
-		fprintf(stderr, WARN_CLI_FALLBACK, client->socket_path, strerror(connect_errno), connect_errno);
-		close(client->fd);
-		client->fd = -1;
-		client->use_cli_fallback = true;
+	if (client->use_cli_fallback) {
+		for (int i = 0; i < AEROSPACE_CONN_COUNT; i++)
+			ipc_conn_drop(&client->conns[i]);
 	}
 
 	return client;
@@ -276,25 +476,39 @@ aerospace* aerospace_new(const char* socketPath)
 
 int aerospace_is_initialized(aerospace* client)
 {
-	return (client && (client->fd >= 0 || client->use_cli_fallback));
+	return (client && (client->conns[AEROSPACE_CONN_COMMAND].fd >= 0 || client->use_cli_fallback));
 }
 
 void aerospace_close(aerospace* client)
 {
 	if (client) {
-		if (client->fd >= 0) {
-			errno = 0;
-			if (close(client->fd) < 0) {
-				fprintf(stderr, "%s: %s (errno %d)\n", ERROR_SOCKET_CLOSE, strerror(errno), errno);
-			}
-			client->fd = -1;
-		}
+		for (int i = 0; i < AEROSPACE_CONN_COUNT; i++)
+			ipc_conn_destroy(&client->conns[i]);
+		free(client->table);
+		pthread_mutex_destroy(&client->table_lock);
 		free(client->socket_path);
 		client->socket_path = NULL;
 		free(client);
 	}
 }
 
+void aerospace_conn_stats_get(aerospace* client, aerospace_conn_kind kind, aerospace_conn_stats* out)
+{
+	memset(out, 0, sizeof(*out));
+	if (!client || kind < 0 || kind >= AEROSPACE_CONN_COUNT)
+		return;
+
+	ipc_conn_stats_get(&client->conns[kind], out);
+}
+
+void aerospace_conn_stats_reset(aerospace* client)
+{
+	if (!client)
+		return;
+	for (int i = 0; i < AEROSPACE_CONN_COUNT; i++)
+		ipc_conn_stats_reset(&client->conns[i]);
+}
+
 char* aerospace_switch(aerospace* client, const char* direction)
 {
 	return aerospace_workspace(client, 0, direction, "");
@@ -308,16 +522,473 @@ char* aerospace_workspace(aerospace* client, int wrap_around, const char* ws_com
 	if (wrap_around) {
 		args[arg_count++] = "--wrap-around";
 	}
-	return execute_aerospace_command(client, args, arg_count, stdin_payload, NULL);
+	return execute_aerospace_command(client, AEROSPACE_CONN_COMMAND, args, arg_count, stdin_payload, NULL);
 }
 
 char* aerospace_list_workspaces(aerospace* client, bool include_empty)
 {
 	if (include_empty) {
 		const char* args[] = { "list-workspaces", "--monitor", "focused" };
-		return execute_aerospace_command(client, args, 3, "", "stdout");
+		return execute_aerospace_command(client, AEROSPACE_CONN_QUERY, args, 3, "", "stdout");
 	} else {
 		const char* args[] = { "list-workspaces", "--monitor", "focused", "--empty", "no" };
-		return execute_aerospace_command(client, args, 5, "", "stdout");
+		return execute_aerospace_command(client, AEROSPACE_CONN_QUERY, args, 5, "", "stdout");
+	}
+}
+
+static bool json_truthy(yyjson_val* val)
+{
+	if (yyjson_is_bool(val))
+		return yyjson_get_bool(val);
+	if (yyjson_is_str(val))
+		return strcmp(yyjson_get_str(val), "true") == 0;
+	return false;
+}
+
+static int json_int(yyjson_val* val, int fallback)
+{
+	if (yyjson_is_int(val))
+		return (int)yyjson_get_int(val);
+	if (yyjson_is_str(val))
+		return atoi(yyjson_get_str(val));
+	return fallback;
+}
+
+static monitor_entry* table_monitor(workspace_table* table, int monitor_id)
+{
+	for (int i = 0; i < table->count; i++) {
+		if (table->monitors[i].id == monitor_id)
+			return &table->monitors[i];
+	}
+	return NULL;
+}
+
+static bool parse_workspace_table(const char* json, workspace_table* table)
+{
+	yyjson_doc* doc = yyjson_read(json, strlen(json), 0);
+	if (!doc)
+		return false;
+
+	yyjson_val* root = yyjson_doc_get_root(doc);
+	if (!yyjson_is_arr(root)) {
+		yyjson_doc_free(doc);
+		return false;
+	}
+
+	size_t idx, max;
+	yyjson_val* item;
+	yyjson_arr_foreach(root, idx, max, item)
+	{
+		const char* name = yyjson_get_str(yyjson_obj_get(item, "workspace"));
+		int monitor_id = json_int(yyjson_obj_get(item, "monitor-id"), -1);
+		if (!name || monitor_id < 0)
+			continue;
+
+		monitor_entry* mon = table_monitor(table, monitor_id);
+		if (!mon) {
+			if (table->count >= AEROSPACE_MAX_MONITORS)
+				continue;
+			mon = &table->monitors[table->count++];
+			mon->id = monitor_id;
+			mon->visible = -1;
+			mon->predicted = -1;
+			mon->inflight = 0;
+			mon->last_seq = 0;
+			mon->count = 0;
+		}
+		if (mon->count >= AEROSPACE_MAX_WORKSPACES)
+			continue;
+
+		workspace_entry* ws = &mon->workspaces[mon->count];
+		snprintf(ws->name, sizeof(ws->name), "%s", name);
+		ws->empty = false;
+
+		if (json_truthy(yyjson_obj_get(item, "workspace-is-visible")))
+			mon->visible = mon->predicted = mon->count;
+		if (json_truthy(yyjson_obj_get(item, "workspace-is-focused")))
+			table->focused = (int)(mon - table->monitors);
+		mon->count++;
+	}
+
+	yyjson_doc_free(doc);
+	return table->count > 0;
+}
+
+static void mark_nonempty(const char* json, workspace_table* table)
+{
+	for (int m = 0; m < table->count; m++) {
+		for (int w = 0; w < table->monitors[m].count; w++)
+			table->monitors[m].workspaces[w].empty = true;
+	}
+
+	yyjson_doc* doc = yyjson_read(json, strlen(json), 0);
+	if (!doc)
+		return;
+
+	size_t idx, max;
+	yyjson_val* item;
+	yyjson_arr_foreach(yyjson_doc_get_root(doc), idx, max, item)
+	{
+		const char* name = yyjson_get_str(yyjson_obj_get(item, "workspace"));
+		if (!name)
+			continue;
+		for (int m = 0; m < table->count; m++) {
+			monitor_entry* mon = &table->monitors[m];
+			for (int w = 0; w < mon->count; w++) {
+				if (strcmp(mon->workspaces[w].name, name) == 0)
+					mon->workspaces[w].empty = false;
+			}
+		}
+	}
+
+	yyjson_doc_free(doc);
+}
+
+static int monitor_find(const monitor_entry* mon, const char* name)
+{
+	for (int w = 0; w < mon->count; w++) {
+		if (strcmp(mon->workspaces[w].name, name) == 0)
+			return w;
+	}
+	return -1;
+}
+
+// A refresh can be answered before our own in-flight switches land; keep
+// predicting from where those switches are headed rather than the snapshot.
+static void carry_inflight(const workspace_table* old, workspace_table* table)
+{
+	for (int m = 0; m < old->count; m++) {
+		const monitor_entry* prev = &old->monitors[m];
+		monitor_entry* mon = table_monitor(table, prev->id);
+		if (!mon || prev->inflight == 0)
+			continue;
+
+		mon->inflight = prev->inflight;
+		mon->last_seq = prev->last_seq;
+		if (prev->predicted >= 0) {
+			int idx = monitor_find(mon, prev->workspaces[prev->predicted].name);
+			if (idx >= 0)
+				mon->predicted = idx;
+		}
+	}
+}
+
+// true if every workspace the nonempty listing names is in table.
+static bool knows_nonempty(const char* json, const workspace_table* table)
+{
+	yyjson_doc* doc = yyjson_read(json, strlen(json), 0);
+	if (!doc)
+		return false;
+
+	bool known = true;
+	size_t idx, max;
+	yyjson_val* item;
+	yyjson_arr_foreach(yyjson_doc_get_root(doc), idx, max, item)
+	{
+		const char* name = yyjson_get_str(yyjson_obj_get(item, "workspace"));
+		bool found = false;
+		for (int m = 0; name && !found && m < table->count; m++)
+			found = monitor_find(&table->monitors[m], name) >= 0;
+		known = known && (!name || found);
+	}
+	yyjson_doc_free(doc);
+	return known;
+}
+
+// Moves the cached table to what the visible listing (one workspace per
+// monitor) shows. False, leaving it alone, when a monitor or workspace came
+// or went, which only a full listing can settle. Called with the lock held.
+static bool patch_workspace_table(workspace_table* table, const workspace_table* seen, const char* nonempty)
+{
+	if (seen->count != table->count || (nonempty && !knows_nonempty(nonempty, table)))
+		return false;
+
+	int visible[AEROSPACE_MAX_MONITORS];
+	for (int m = 0; m < table->count; m++) {
+		const monitor_entry* shown = table_monitor((workspace_table*)seen, table->monitors[m].id);
+		visible[m] = shown && shown->count == 1 ? monitor_find(&table->monitors[m], shown->workspaces[0].name) : -1;
+		if (visible[m] < 0)
+			return false;
 	}
+
+	for (int m = 0; m < table->count; m++) {
+		monitor_entry* mon = &table->monitors[m];
+		mon->visible = visible[m];
+		// in-flight switches keep predicting from where they are headed
+		if (mon->inflight == 0)
+			mon->predicted = mon->visible;
+		if (seen->focused >= 0 && seen->monitors[seen->focused].id == mon->id)
+			table->focused = m;
+	}
+	if (nonempty)
+		mark_nonempty(nonempty, table);
+	return true;
+}
+
+// Between full listings: which workspace each monitor shows and which are
+// empty, in one round trip that carries a few entries instead of all of
+// them. False if the table has to be listed again in full.
+static bool refresh_visible(aerospace* client)
+{
+	const char* visible_args[] = { "list-workspaces", "--monitor", "all", "--visible", "--json", "--format", TABLE_FORMAT };
+	const char* nonempty_args[] = { "list-workspaces", "--all", "--empty", "no", "--json", "--format", "%{workspace}" };
+	aerospace_command commands[2] = {
+		{ visible_args, 7, "", "stdout" },
+		{ nonempty_args, 7, "", "stdout" },
+	};
+	char* results[2];
+	int answered = execute_batch(client, AEROSPACE_CONN_QUERY, commands, 2, results);
+
+	workspace_table* seen = calloc(1, sizeof(workspace_table));
+	seen->focused = -1;
+	bool ok = answered == 2 && results[0] && parse_workspace_table(results[0], seen);
+	if (ok) {
+		pthread_mutex_lock(&client->table_lock);
+		ok = client->table && patch_workspace_table(client->table, seen, results[1]);
+		if (ok)
+			client->table->refreshed_ns = ipc_monotonic_ns();
+		pthread_mutex_unlock(&client->table_lock);
+	}
+
+	for (int i = 0; i < answered; i++)
+		free(results[i]);
+	free(seen);
+	return ok;
+}
+
+bool aerospace_refresh_workspaces(aerospace* client, uint64_t max_age_ns, bool* refreshed)
+{
+	if (refreshed)
+		*refreshed = false;
+	if (!client)
+		return false;
+
+	pthread_mutex_lock(&client->table_lock);
+	uint64_t now = ipc_monotonic_ns();
+	bool fresh = client->table && now - client->table->refreshed_ns < max_age_ns;
+	bool listed = client->table && client->table->listed_ns && now - client->table->listed_ns < LISTING_TTL_NS;
+	pthread_mutex_unlock(&client->table_lock);
+	if (fresh)
+		return true;
+
+	if (listed && refresh_visible(client)) {
+		if (refreshed)
+			*refreshed = true;
+		return true;
+	}
+
+	// both lists go out in one write on the query connection
+	const char* all_args[] = { "list-workspaces", "--all", "--json", "--format", TABLE_FORMAT };
+	const char* nonempty_args[] = { "list-workspaces", "--all", "--empty", "no", "--json", "--format", "%{workspace}" };
+	aerospace_command commands[2] = {
+		{ all_args, 5, "", "stdout" },
+		{ nonempty_args, 7, "", "stdout" },
+	};
+	char* results[2];
+	int answered = execute_batch(client, AEROSPACE_CONN_QUERY, commands, 2, results);
+
+	workspace_table* table = calloc(1, sizeof(workspace_table));
+	table->focused = -1;
+	bool ok = answered == 2 && results[0] && parse_workspace_table(results[0], table);
+	if (ok && results[1])
+		mark_nonempty(results[1], table);
+
+	for (int i = 0; i < answered; i++)
+		free(results[i]);
+
+	if (!ok) {
+		log_error("Failed to refresh workspace table");
+		free(table);
+		return false;
+	}
+
+	table->refreshed_ns = table->listed_ns = ipc_monotonic_ns();
+	pthread_mutex_lock(&client->table_lock);
+	workspace_table* old = client->table;
+	if (old)
+		carry_inflight(old, table);
+	client->table = table;
+	pthread_mutex_unlock(&client->table_lock);
+	free(old);
+
+	if (refreshed)
+		*refreshed = true;
+	return true;
+}
+
+void aerospace_invalidate_workspaces(aerospace* client)
+{
+	pthread_mutex_lock(&client->table_lock);
+	if (client->table)
+		client->table->refreshed_ns = client->table->listed_ns = 0;
+	pthread_mutex_unlock(&client->table_lock);
+}
+
+int aerospace_monitor_id(aerospace* client, const char* selector)
+{
+	if (!client)
+		return AEROSPACE_MONITOR_NONE;
+
+	if (!selector || strcmp(selector, "focused") == 0) {
+		int id = AEROSPACE_MONITOR_NONE;
+		pthread_mutex_lock(&client->table_lock);
+		workspace_table* table = client->table;
+		if (table && table->focused >= 0)
+			id = table->monitors[table->focused].id;
+		pthread_mutex_unlock(&client->table_lock);
+		return id;
+	}
+
+	if (strcmp(selector, "mouse") == 0) {
+		const char* args[] = { "list-monitors", "--mouse", "--format", "%{monitor-id}" };
+		char* output = execute_aerospace_command(client, AEROSPACE_CONN_QUERY, args, 4, "", "stdout");
+		int id = output && *output ? atoi(output) : AEROSPACE_MONITOR_NONE;
+		free(output);
+		return id > 0 ? id : AEROSPACE_MONITOR_NONE;
+	}
+
+	int id = atoi(selector);
+	return id > 0 ? id : AEROSPACE_MONITOR_NONE;
+}
+
+aerospace_nav_result aerospace_navigate(aerospace* client, int monitor_id, int direction, bool wrap_around, bool skip_empty, aerospace_nav* nav)
+{
+	aerospace_nav_result found = AEROSPACE_NAV_UNKNOWN;
+
+	pthread_mutex_lock(&client->table_lock);
+	monitor_entry* mon = client->table ? table_monitor(client->table, monitor_id) : NULL;
+	if (mon && mon->predicted >= 0)
+		found = AEROSPACE_NAV_STAY;
+	if (found == AEROSPACE_NAV_STAY && mon->count > 1 && direction != 0) {
+		int step = direction > 0 ? 1 : -1;
+		int steps = abs(direction);
+		int idx = mon->predicted, target = -1;
+		// a full lap visits every workspace once, so steps past the number of
+		// eligible ones wrap around again
+		for (int n = 1; steps > 0 && n <= mon->count * steps; n++) {
+			idx += step;
+			if (idx < 0 || idx >= mon->count) {
+				if (!wrap_around)
+					break;
+				idx = (idx + mon->count) % mon->count;
+			}
+			if (skip_empty && mon->workspaces[idx].empty)
+				continue;
+			target = idx;
+			steps--;
+		}
+
+		if (target >= 0 && target != mon->predicted) {
+			found = AEROSPACE_NAV_MOVED;
+			mon->predicted = target;
+			mon->inflight++;
+			mon->last_seq = nav->seq = ++client->nav_seq;
+			nav->monitor_id = monitor_id;
+			snprintf(nav->name, sizeof(nav->name), "%s", mon->workspaces[target].name);
+		}
+	}
+	pthread_mutex_unlock(&client->table_lock);
+
+	return found;
+}
+
+void aerospace_nav_complete(aerospace* client, const aerospace_nav* nav, bool ok)
+{
+	pthread_mutex_lock(&client->table_lock);
+	workspace_table* table = client->table;
+	monitor_entry* mon = table ? table_monitor(table, nav->monitor_id) : NULL;
+	if (mon) {
+		if (mon->inflight > 0)
+			mon->inflight--;
+
+		int idx = monitor_find(mon, nav->name);
+		if (ok && idx >= 0) {
+			mon->visible = idx;
+			table->focused = (int)(mon - table->monitors);
+		} else if (!ok) {
+			// later navigations were computed on top of this one; only the
+			// newest decides where the prediction rolls back to
+			if (nav->seq == mon->last_seq)
+				mon->predicted = mon->visible;
+			table->refreshed_ns = 0;
+		}
+
+		if (mon->inflight == 0)
+			mon->predicted = mon->visible;
+	}
+	pthread_mutex_unlock(&client->table_lock);
+}
+
+void aerospace_nav_supersede(aerospace* client, const aerospace_nav* nav)
+{
+	pthread_mutex_lock(&client->table_lock);
+	monitor_entry* mon = client->table ? table_monitor(client->table, nav->monitor_id) : NULL;
+	if (mon) {
+		if (mon->inflight > 0)
+			mon->inflight--;
+		if (mon->inflight == 0)
+			mon->predicted = mon->visible;
+	}
+	pthread_mutex_unlock(&client->table_lock);
+}
+
+char* aerospace_nav_send(aerospace* client, const aerospace_nav* nav)
+{
+	const char* args[] = { "workspace", nav->name };
+	bool failed;
+	char* result = execute_request(client, AEROSPACE_CONN_COMMAND, args, 2, "", NULL, &failed);
+	// without a reply the switch may or may not have happened; the table
+	// goes stale either way and the next refresh settles it
+	if (failed && !result)
+		result = strdup("no reply from the server");
+	aerospace_nav_complete(client, nav, result == NULL);
+	return result;
+}
+
+char* aerospace_focus_workspace(aerospace* client, const char* name)
+{
+	const char* args[] = { "workspace", name };
+	return execute_aerospace_command(client, AEROSPACE_CONN_COMMAND, args, 2, "", NULL);
+}
+
+char* aerospace_run(aerospace* client, const char* command_line)
+{
+	char buf[AEROSPACE_COMMAND_MAX];
+	snprintf(buf, sizeof(buf), "%s", command_line);
+
+	const char* args[AEROSPACE_MAX_BATCH][AEROSPACE_MAX_ARGS];
+	aerospace_command commands[AEROSPACE_MAX_BATCH];
+	int count = 0;
+	for (char* save = NULL, *part = strtok_r(buf, ";", &save); part && count < AEROSPACE_MAX_BATCH;
+		part = strtok_r(NULL, ";", &save)) {
+		int arg_count = 0;
+		for (char* arg_save = NULL, *arg = strtok_r(part, " \t", &arg_save); arg && arg_count < AEROSPACE_MAX_ARGS;
+			arg = strtok_r(NULL, " \t", &arg_save))
+			args[count][arg_count++] = arg;
+		if (arg_count == 0)
+			continue;
+		commands[count] = (aerospace_command) { args[count], arg_count, "", NULL };
+		count++;
+	}
+	if (count == 0)
+		return strdup("empty command");
+
+	char* result = NULL;
+	if (count == 1) {
+		result = execute_aerospace_command(client, AEROSPACE_CONN_COMMAND, args[0], commands[0].arg_count, "", NULL);
+	} else {
+		char* results[AEROSPACE_MAX_BATCH];
+		int answered = aerospace_batch(client, commands, count, results);
+		for (int i = 0; i < answered; i++) {
+			if (!result)
+				result = results[i];
+			else
+				free(results[i]);
+		}
+		if (!result && answered < count)
+			result = strdup("no reply from the server");
+	}
+	// whatever it did, focus may have moved under the cached table
+	aerospace_invalidate_workspaces(client);
+	return result;
 }
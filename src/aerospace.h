@@ -1,19 +1,120 @@
+#ifndef AEROSPACE_H
 #define AEROSPACE_H
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+#include "ipc.h"
+
 typedef struct aerospace aerospace;
 
+#define AEROSPACE_MAX_MONITORS 8
+#define AEROSPACE_MAX_WORKSPACES 64
+#define AEROSPACE_NAME_MAX 64
+#define AEROSPACE_MONITOR_NONE -1
+
+// Commands and queries travel on separate sockets so a slow query never
+// delays a workspace switch queued behind it.
+typedef enum {
+	AEROSPACE_CONN_COMMAND,
+	AEROSPACE_CONN_QUERY,
+	AEROSPACE_CONN_COUNT
+} aerospace_conn_kind;
+
+typedef ipc_conn_stats aerospace_conn_stats;
+
 aerospace* aerospace_new(const char* socketPath);
 
 int aerospace_is_initialized(aerospace* client);
 
 void aerospace_close(aerospace* client);
 
+// One command inside an aerospace_batch() call; fields mirror the
+// arguments of the single-command helpers below.
+typedef struct {
+	const char** args;
+	int arg_count;
+	const char* stdin_payload;
+	const char* expected_output_field;
+} aerospace_command;
+
+void aerospace_conn_stats_get(aerospace* client, aerospace_conn_kind kind, aerospace_conn_stats* out);
+void aerospace_conn_stats_reset(aerospace* client);
+
 char* aerospace_switch(aerospace* client, const char* direction);
 
 char* aerospace_workspace(aerospace* client, int wrap_around, const char* ws_command, const char* stdin_payload);
 
 char* aerospace_list_workspaces(aerospace* client, bool include_empty);
+
+// Writes all commands to the command connection with a single writev and
+// reads the responses back in order. results[i] follows the convention of the
+// single-command calls (NULL on success or the server's stderr). Returns the
+// number of commands that received a response, or -1 on invalid arguments.
+int aerospace_batch(aerospace* client, const aerospace_command* commands, int count, char** results);
+
+// Per-monitor workspace table. The table is cached inside the client and only
+// re-queried when older than max_age_ns; *refreshed reports whether a query
+// was made. Most queries only ask which workspaces are visible and which are
+// empty; the full listing goes out every 30s, and whenever a monitor or
+// workspace appears that the table does not have. Returns false if the table
+// could not be loaded.
+bool aerospace_refresh_workspaces(aerospace* client, uint64_t max_age_ns, bool* refreshed);
+
+// Marks the table stale; the next refresh lists every workspace again.
+void aerospace_invalidate_workspaces(aerospace* client);
+
+// Resolves "focused", "mouse" or a numeric monitor id to an AeroSpace monitor
+// id. "focused" is answered from the table, "mouse" needs a query.
+int aerospace_monitor_id(aerospace* client, const char* selector);
+
+// Optimistic navigation: aerospace_navigate() picks the workspace `direction`
+// steps (+1 next, -1 prev, +3 three on) from the predicted one on
+// monitor_id, honoring wrap_around (without it, the last one it can reach)
+// and skip_empty, and moves the prediction there at once so the next swipe
+// in a burst does not wait for the server. Every navigate that returns
+// AEROSPACE_NAV_MOVED must be followed by aerospace_nav_send(), or by
+// aerospace_nav_complete() with the outcome of the command; a failure rolls
+// the prediction back and marks the table stale.
+typedef struct {
+	int monitor_id;
+	unsigned long long seq;
+	char name[AEROSPACE_NAME_MAX];
+} aerospace_nav;
+
+typedef enum {
+	AEROSPACE_NAV_UNKNOWN, // no table for the monitor; only the server can tell
+	AEROSPACE_NAV_STAY, // nothing to send: an end without wrap-around, or already there
+	AEROSPACE_NAV_MOVED, // nav is filled in
+} aerospace_nav_result;
+
+aerospace_nav_result aerospace_navigate(aerospace* client, int monitor_id, int direction, bool wrap_around, bool skip_empty, aerospace_nav* nav);
+
+void aerospace_nav_complete(aerospace* client, const aerospace_nav* nav, bool ok);
+
+// Sends the workspace command for nav and completes it with the outcome. A
+// connection that drops before answering counts as a failure. Returns NULL
+// on success, otherwise what went wrong; caller frees.
+char* aerospace_nav_send(aerospace* client, const aerospace_nav* nav);
+
+// Settles a navigation that is not going to be sent because a later one on
+// the same monitor replaced it; the later one's completion decides where the
+// prediction ends up.
+void aerospace_nav_supersede(aerospace* client, const aerospace_nav* nav);
+
+char* aerospace_focus_workspace(aerospace* client, const char* name);
+
+#define AEROSPACE_COMMAND_MAX 256
+#define AEROSPACE_MAX_ARGS 16
+#define AEROSPACE_MAX_BATCH 8
+
+// Runs a command line such as "focus-monitor up", split on whitespace (no
+// quoting). Several commands separated by ';', as in
+// "move-node-to-workspace next; workspace next", go out in one
+// aerospace_batch() and run in order. Returns NULL on success or the first
+// error, like the calls above.
+char* aerospace_run(aerospace* client, const char* command_line);
+
+#endif
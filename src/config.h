@@ -1,14 +1,38 @@
-#include <CoreFoundation/CoreFoundation.h>
 #define CONFIG_H
 
+#include "gesture.h"
 #include "yyjson.h"
 #include <pwd.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#define SWIPE_ACTION_MAX 192
+
+// One entry of "gestures": a recognizer besides the main swipe, whose
+// directions all run commands.
+typedef struct {
+	gesture_kind kind;
+	int fingers;
+	char actions[GESTURE_DIRECTIONS][SWIPE_ACTION_MAX]; // indexed by direction + GESTURE_DIRECTION_MAX
+} recognizer_config;
+
+#define CONFIG_MAX_DEVICES 4
+
+// One entry of "devices": overrides for the nth trackpad (the order the
+// evdev devices are opened on linux, first touched on macOS). 0, or -1 for
+// the ints, keeps the top-level value.
+typedef struct {
+	int fingers;
+	float distance_pct;
+	float velocity_pct;
+	int haptic; // -1, 0 or 1
+	int actuator; // index into the actuators found at startup, -1 for the pad's own
+} device_config;
+
 typedef struct {
 	bool natural_swipe;
 	bool wrap_around;
@@ -23,11 +47,30 @@ typedef struct {
 	float min_travel;
 	float min_step_fast;
 	float min_travel_fast;
+	float pinch_pct;
+	float scrub_pct;
+	float fling_velocity[GESTURE_FLING_MAX]; // ascending; see gesture_params.fling_vel
+	int fling_count;
+	float switch_rate; // commands per second to the window manager, 0 for no limit
+	int switch_burst;
 	float palm_disp;
-	CFTimeInterval palm_age;
+	double palm_age; // seconds
 	float palm_velocity;
 	const char* swipe_left;
 	const char* swipe_right;
+	// window-manager command per direction, indexed by direction +
+	// GESTURE_DIRECTION_MAX; "" leaves the direction off. Left and right
+	// always switch workspaces.
+	char actions[GESTURE_DIRECTIONS][SWIPE_ACTION_MAX];
+	recognizer_config gestures[GESTURE_MAX_RECOGNIZERS - 1];
+	int gesture_count;
+	device_config devices[CONFIG_MAX_DEVICES];
+	int device_count;
+	char monitor[16]; // "focused", "mouse" or an AeroSpace monitor id
+	char wm[16]; // "aerospace" or "i3" (also sway)
+	char log_level[8]; // "debug", "info", "warn", "error" or "off"
+	char gesture_priority[16]; // "default", "high" or "realtime"; read at startup
+	bool trace_events; // keep a lifecycle trace for `swipectl trace-dump`
 } Config;
 
 static Config default_config()
@@ -46,14 +89,191 @@ static Config default_config()
 	config.min_travel = 0.015f;
 	config.min_step_fast = 0.0f;
 	config.min_travel_fast = 0.003f;
+	config.pinch_pct = 0.25f; // spread grows or shrinks by 25 %
+	config.scrub_pct = 0.0f; // one move per swipe
+	memset(config.fling_velocity, 0, sizeof(config.fling_velocity));
+	config.fling_count = 0; // every swipe moves one workspace
+	config.switch_rate = 30.0f; // per second, well above a hand
+	config.switch_burst = 4; // sent back to back before the rate applies
 	config.palm_disp = 0.025; // 2.5% pad from origin
 	config.palm_age = 0.06; // 60ms before judgment
 	config.palm_velocity = 0.1; // 10% of pad dimension per second
 	config.swipe_left = "prev";
 	config.swipe_right = "next";
+	memset(config.actions, 0, sizeof(config.actions));
+	memset(config.gestures, 0, sizeof(config.gestures));
+	config.gesture_count = 0;
+	memset(config.devices, 0, sizeof(config.devices));
+	config.device_count = 0;
+	snprintf(config.monitor, sizeof(config.monitor), "focused");
+#ifdef __APPLE__
+	snprintf(config.wm, sizeof(config.wm), "aerospace");
+#else
+	snprintf(config.wm, sizeof(config.wm), "i3");
+#endif
+	snprintf(config.log_level, sizeof(config.log_level), "info");
+	snprintf(config.gesture_priority, sizeof(config.gesture_priority), "realtime");
+	config.trace_events = false;
 	return config;
 }
 
+static const char* config_action(const Config* config, int direction)
+{
+	return config->actions[direction + GESTURE_DIRECTION_MAX];
+}
+
+// The command for a direction of recognizer index, as numbered by
+// gesture_recognizers_from_config; "" when there is none.
+static const char* config_gesture_action(const Config* config, int index, int direction)
+{
+	if (direction < -GESTURE_DIRECTION_MAX || direction > GESTURE_DIRECTION_MAX || index > config->gesture_count)
+		return "";
+	if (index == 0)
+		return config_action(config, direction);
+	return config->gestures[index - 1].actions[direction + GESTURE_DIRECTION_MAX];
+}
+
+static gesture_params gesture_params_from_config(const Config* config)
+{
+	gesture_params params;
+	params.kind = GESTURE_KIND_SWIPE;
+	params.fingers = config->fingers;
+	params.swipe_tolerance = config->swipe_tolerance;
+	params.distance_pct = config->distance_pct;
+	params.velocity_pct = config->velocity_pct;
+	params.settle_factor = config->settle_factor;
+	params.min_step = config->min_step;
+	params.min_travel = config->min_travel;
+	params.min_step_fast = config->min_step_fast;
+	params.min_travel_fast = config->min_travel_fast;
+	params.pinch_pct = config->pinch_pct;
+	params.scrub_pct = config->scrub_pct;
+	params.fling_count = config->fling_count;
+	memcpy(params.fling_vel, config->fling_velocity, sizeof(params.fling_vel));
+
+	// an axis is only recognized when one of its directions has an action
+	params.axes = GESTURE_AXIS_BIT(GESTURE_AXIS_HORIZONTAL);
+	for (int axis = GESTURE_AXIS_VERTICAL; axis <= GESTURE_AXES; ++axis) {
+		if (config_action(config, axis)[0] || config_action(config, -axis)[0])
+			params.axes |= GESTURE_AXIS_BIT(axis);
+	}
+	return params;
+}
+
+// The main swipe first, then "gestures" in order. Every axis of an extra
+// swipe runs commands, so it only recognizes the ones that have some.
+static gesture_recognizers gesture_recognizers_from_config(const Config* config)
+{
+	gesture_recognizers recognizers;
+	recognizers.params[0] = gesture_params_from_config(config);
+	recognizers.count = 1;
+
+	for (int i = 0; i < config->gesture_count; ++i) {
+		const recognizer_config* extra = &config->gestures[i];
+		gesture_params* params = &recognizers.params[recognizers.count++];
+		*params = recognizers.params[0];
+		params->kind = extra->kind;
+		params->fingers = extra->fingers;
+		params->axes = 0;
+		for (int axis = GESTURE_AXIS_HORIZONTAL; axis <= GESTURE_AXES; ++axis) {
+			if (extra->actions[axis + GESTURE_DIRECTION_MAX][0] || extra->actions[-axis + GESTURE_DIRECTION_MAX][0])
+				params->axes |= GESTURE_AXIS_BIT(axis);
+		}
+	}
+	return recognizers;
+}
+
+// config with the overrides of pad index applied.
+static Config config_for_device(const Config* config, int index)
+{
+	Config out = *config;
+	if (index < 0 || index >= config->device_count)
+		return out;
+
+	const device_config* device = &config->devices[index];
+	if (device->fingers)
+		out.fingers = device->fingers;
+	if (device->distance_pct > 0)
+		out.distance_pct = device->distance_pct;
+	if (device->velocity_pct > 0)
+		out.velocity_pct = device->velocity_pct;
+	if (device->haptic >= 0)
+		out.haptic = device->haptic;
+	return out;
+}
+
+static gesture_recognizers gesture_recognizers_for_device(const Config* config, int index)
+{
+	Config device = config_for_device(config, index);
+	return gesture_recognizers_from_config(&device);
+}
+
+static void config_to_json(const Config* config, yyjson_mut_doc* doc, yyjson_mut_val* obj)
+{
+	yyjson_mut_obj_add_bool(doc, obj, "natural_swipe", config->natural_swipe);
+	yyjson_mut_obj_add_bool(doc, obj, "wrap_around", config->wrap_around);
+	yyjson_mut_obj_add_bool(doc, obj, "haptic", config->haptic);
+	yyjson_mut_obj_add_bool(doc, obj, "skip_empty", config->skip_empty);
+	yyjson_mut_obj_add_int(doc, obj, "fingers", config->fingers);
+	yyjson_mut_obj_add_int(doc, obj, "swipe_tolerance", config->swipe_tolerance);
+	yyjson_mut_obj_add_real(doc, obj, "distance_pct", config->distance_pct);
+	yyjson_mut_obj_add_real(doc, obj, "velocity_pct", config->velocity_pct);
+	yyjson_mut_obj_add_real(doc, obj, "settle_factor", config->settle_factor);
+	yyjson_mut_obj_add_real(doc, obj, "min_step", config->min_step);
+	yyjson_mut_obj_add_real(doc, obj, "min_travel", config->min_travel);
+	yyjson_mut_obj_add_real(doc, obj, "min_step_fast", config->min_step_fast);
+	yyjson_mut_obj_add_real(doc, obj, "min_travel_fast", config->min_travel_fast);
+	yyjson_mut_obj_add_real(doc, obj, "pinch_pct", config->pinch_pct);
+	yyjson_mut_obj_add_real(doc, obj, "scrub_pct", config->scrub_pct);
+	yyjson_mut_val* fling = yyjson_mut_obj_add_arr(doc, obj, "fling_velocity");
+	for (int i = 0; i < config->fling_count; ++i)
+		yyjson_mut_arr_add_real(doc, fling, config->fling_velocity[i]);
+	yyjson_mut_obj_add_real(doc, obj, "switch_rate", config->switch_rate);
+	yyjson_mut_obj_add_int(doc, obj, "switch_burst", config->switch_burst);
+	yyjson_mut_obj_add_str(doc, obj, "swipe_left", config->swipe_left);
+	yyjson_mut_obj_add_str(doc, obj, "swipe_right", config->swipe_right);
+	for (int direction = -GESTURE_AXES; direction <= GESTURE_AXES; ++direction) {
+		const char* name = gesture_direction_name(direction);
+		if (!name || abs(direction) == GESTURE_AXIS_HORIZONTAL || !config_action(config, direction)[0])
+			continue;
+		char key[32];
+		snprintf(key, sizeof(key), "swipe_%s", name);
+		yyjson_mut_obj_add(obj, yyjson_mut_strcpy(doc, key), yyjson_mut_strcpy(doc, config_action(config, direction)));
+	}
+	yyjson_mut_val* gestures = yyjson_mut_obj_add_arr(doc, obj, "gestures");
+	for (int i = 0; i < config->gesture_count; ++i) {
+		const recognizer_config* extra = &config->gestures[i];
+		yyjson_mut_val* gesture = yyjson_mut_arr_add_obj(doc, gestures);
+		yyjson_mut_obj_add_str(doc, gesture, "type", extra->kind == GESTURE_KIND_PINCH ? "pinch" : "swipe");
+		yyjson_mut_obj_add_int(doc, gesture, "fingers", extra->fingers);
+		for (int direction = -GESTURE_DIRECTION_MAX; direction <= GESTURE_DIRECTION_MAX; ++direction) {
+			const char* name = gesture_direction_name(direction);
+			if (name && extra->actions[direction + GESTURE_DIRECTION_MAX][0])
+				yyjson_mut_obj_add_strcpy(doc, gesture, name, extra->actions[direction + GESTURE_DIRECTION_MAX]);
+		}
+	}
+	yyjson_mut_val* devices = yyjson_mut_obj_add_arr(doc, obj, "devices");
+	for (int i = 0; i < config->device_count; ++i) {
+		const device_config* device = &config->devices[i];
+		yyjson_mut_val* entry = yyjson_mut_arr_add_obj(doc, devices);
+		if (device->fingers)
+			yyjson_mut_obj_add_int(doc, entry, "fingers", device->fingers);
+		if (device->distance_pct > 0)
+			yyjson_mut_obj_add_real(doc, entry, "distance_pct", device->distance_pct);
+		if (device->velocity_pct > 0)
+			yyjson_mut_obj_add_real(doc, entry, "velocity_pct", device->velocity_pct);
+		if (device->haptic >= 0)
+			yyjson_mut_obj_add_bool(doc, entry, "haptic", device->haptic);
+		if (device->actuator >= 0)
+			yyjson_mut_obj_add_int(doc, entry, "actuator", device->actuator);
+	}
+	yyjson_mut_obj_add_strcpy(doc, obj, "monitor", config->monitor);
+	yyjson_mut_obj_add_strcpy(doc, obj, "wm", config->wm);
+	yyjson_mut_obj_add_strcpy(doc, obj, "log_level", config->log_level);
+	yyjson_mut_obj_add_strcpy(doc, obj, "gesture_priority", config->gesture_priority);
+	yyjson_mut_obj_add_bool(doc, obj, "trace_events", config->trace_events);
+}
+
 static int read_file_to_buffer(const char* path, char** out, size_t* size)
 {
 	FILE* file = fopen(path, "rb");
@@ -79,6 +299,99 @@ static int read_file_to_buffer(const char* path, char** out, size_t* size)
 	return 1;
 }
 
+// An action is a command string, or an array of them that runs as one
+// ;-separated line. False if item is neither or names nothing.
+static bool config_read_action(yyjson_val* item, char* out)
+{
+	if (yyjson_is_str(item)) {
+		snprintf(out, SWIPE_ACTION_MAX, "%s", yyjson_get_str(item));
+		return out[0] != '\0';
+	}
+	if (!yyjson_is_arr(item))
+		return false;
+
+	size_t len = 0, idx, max;
+	yyjson_val* command;
+	out[0] = '\0';
+	yyjson_arr_foreach(item, idx, max, command)
+	{
+		if (yyjson_is_str(command) && len < SWIPE_ACTION_MAX)
+			len += (size_t)snprintf(out + len, SWIPE_ACTION_MAX - len, "%s%s", len ? "; " : "", yyjson_get_str(command));
+	}
+	return out[0] != '\0';
+}
+
+// A swipe only takes the swipe directions and a pinch only pinch_in and
+// pinch_out; entries without any command are dropped.
+static void config_read_gestures(Config* config, yyjson_val* list)
+{
+	size_t idx, max;
+	yyjson_val* entry;
+	yyjson_arr_foreach(list, idx, max, entry)
+	{
+		if (config->gesture_count == GESTURE_MAX_RECOGNIZERS - 1) {
+			fprintf(stderr, "Only %d extra gestures are supported; ignoring the rest.\n", GESTURE_MAX_RECOGNIZERS - 1);
+			break;
+		}
+		yyjson_val* type = yyjson_obj_get(entry, "type");
+		yyjson_val* fingers = yyjson_obj_get(entry, "fingers");
+		if (!yyjson_is_obj(entry) || !yyjson_is_str(type) || !yyjson_is_int(fingers))
+			continue;
+
+		recognizer_config* extra = &config->gestures[config->gesture_count];
+		memset(extra, 0, sizeof(*extra));
+		extra->kind = strcmp(yyjson_get_str(type), "pinch") == 0 ? GESTURE_KIND_PINCH : GESTURE_KIND_SWIPE;
+		extra->fingers = (int)yyjson_get_int(fingers);
+
+		bool any = false;
+		for (int direction = -GESTURE_DIRECTION_MAX; direction <= GESTURE_DIRECTION_MAX; ++direction) {
+			const char* name = gesture_direction_name(direction);
+			bool pinch = abs(direction) == GESTURE_PINCH;
+			if (!name || pinch != (extra->kind == GESTURE_KIND_PINCH))
+				continue;
+			if (config_read_action(yyjson_obj_get(entry, name), extra->actions[direction + GESTURE_DIRECTION_MAX]))
+				any = true;
+		}
+		if (any && extra->fingers > 1 && extra->fingers <= MAX_TOUCHES)
+			config->gesture_count++;
+	}
+}
+
+// Entries are positional, so one that is not an object still takes its
+// pad's place and keeps every top-level value.
+static void config_read_devices(Config* config, yyjson_val* list)
+{
+	size_t idx, max;
+	yyjson_val* entry;
+	yyjson_arr_foreach(list, idx, max, entry)
+	{
+		if (config->device_count == CONFIG_MAX_DEVICES) {
+			fprintf(stderr, "Only %d devices are supported; ignoring the rest.\n", CONFIG_MAX_DEVICES);
+			break;
+		}
+		device_config* device = &config->devices[config->device_count++];
+		*device = (device_config) { .haptic = -1, .actuator = -1 };
+		if (!yyjson_is_obj(entry))
+			continue;
+
+		yyjson_val* item = yyjson_obj_get(entry, "fingers");
+		if (item && yyjson_is_int(item) && yyjson_get_int(item) > 1 && yyjson_get_int(item) <= MAX_TOUCHES)
+			device->fingers = (int)yyjson_get_int(item);
+		item = yyjson_obj_get(entry, "distance_pct");
+		if (item && yyjson_is_real(item))
+			device->distance_pct = (float)yyjson_get_real(item);
+		item = yyjson_obj_get(entry, "velocity_pct");
+		if (item && yyjson_is_real(item))
+			device->velocity_pct = (float)yyjson_get_real(item);
+		item = yyjson_obj_get(entry, "haptic");
+		if (item && yyjson_is_bool(item))
+			device->haptic = yyjson_get_bool(item);
+		item = yyjson_obj_get(entry, "actuator");
+		if (item && yyjson_is_int(item) && yyjson_get_int(item) >= 0)
+			device->actuator = (int)yyjson_get_int(item);
+	}
+}
+
 static Config load_config()
 {
 	Config config = default_config();
@@ -153,6 +466,78 @@ static Config load_config()
 	if (item && yyjson_is_real(item))
 		config.settle_factor = (float)yyjson_get_real(item);
 
+	item = yyjson_obj_get(root, "monitor");
+	if (item && yyjson_is_str(item))
+		snprintf(config.monitor, sizeof(config.monitor), "%s", yyjson_get_str(item));
+	else if (item && yyjson_is_int(item))
+		snprintf(config.monitor, sizeof(config.monitor), "%d", (int)yyjson_get_int(item));
+
+	item = yyjson_obj_get(root, "wm");
+	if (item && yyjson_is_str(item))
+		snprintf(config.wm, sizeof(config.wm), "%s", yyjson_get_str(item));
+
+	item = yyjson_obj_get(root, "log_level");
+	if (item && yyjson_is_str(item))
+		snprintf(config.log_level, sizeof(config.log_level), "%s", yyjson_get_str(item));
+
+	item = yyjson_obj_get(root, "gesture_priority");
+	if (item && yyjson_is_str(item))
+		snprintf(config.gesture_priority, sizeof(config.gesture_priority), "%s", yyjson_get_str(item));
+
+	item = yyjson_obj_get(root, "trace_events");
+	if (item && yyjson_is_bool(item))
+		config.trace_events = yyjson_get_bool(item);
+
+	item = yyjson_obj_get(root, "pinch_pct");
+	if (item && yyjson_is_real(item))
+		config.pinch_pct = (float)yyjson_get_real(item);
+
+	item = yyjson_obj_get(root, "scrub_pct");
+	if (item && yyjson_is_real(item))
+		config.scrub_pct = (float)yyjson_get_real(item);
+
+	item = yyjson_obj_get(root, "switch_rate");
+	if (item && yyjson_is_num(item) && yyjson_get_num(item) >= 0)
+		config.switch_rate = (float)yyjson_get_num(item);
+
+	item = yyjson_obj_get(root, "switch_burst");
+	if (item && yyjson_is_int(item) && yyjson_get_int(item) >= 1)
+		config.switch_burst = (int)yyjson_get_int(item);
+
+	for (int direction = -GESTURE_AXES; direction <= GESTURE_AXES; ++direction) {
+		const char* name = gesture_direction_name(direction);
+		if (!name || abs(direction) == GESTURE_AXIS_HORIZONTAL)
+			continue;
+		char key[32];
+		snprintf(key, sizeof(key), "swipe_%s", name);
+		config_read_action(yyjson_obj_get(root, key), config.actions[direction + GESTURE_DIRECTION_MAX]);
+	}
+
+	// each velocity has to be above the one before it
+	item = yyjson_obj_get(root, "fling_velocity");
+	if (item && yyjson_is_arr(item)) {
+		size_t idx, max;
+		yyjson_val* value;
+		yyjson_arr_foreach(item, idx, max, value)
+		{
+			float velocity = (float)yyjson_get_num(value);
+			bool ascending = !config.fling_count || velocity > config.fling_velocity[config.fling_count - 1];
+			if (!yyjson_is_num(value) || !ascending || velocity <= 0 || config.fling_count == GESTURE_FLING_MAX) {
+				fprintf(stderr, "Ignoring fling_velocity entry %zu.\n", idx);
+				continue;
+			}
+			config.fling_velocity[config.fling_count++] = velocity;
+		}
+	}
+
+	item = yyjson_obj_get(root, "gestures");
+	if (item && yyjson_is_arr(item))
+		config_read_gestures(&config, item);
+
+	item = yyjson_obj_get(root, "devices");
+	if (item && yyjson_is_arr(item))
+		config_read_devices(&config, item);
+
 	config.swipe_left = config.natural_swipe ? "next" : "prev";
 	config.swipe_right = config.natural_swipe ? "prev" : "next";
 
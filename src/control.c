@@ -0,0 +1,324 @@
+#include "control.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CONTROL_MAX_CLIENTS 8
+#define CONTROL_LINE_MAX 4096
+#define CONTROL_SEND_TIMEOUT_MS 200 // a client that stops reading is dropped after this
+
+typedef struct {
+	int fd;
+	size_t len;
+	char buf[CONTROL_LINE_MAX];
+} control_client;
+
+struct control_server {
+	char path[108];
+	int listen_fd;
+	int wake[2]; // written by control_stop
+	pthread_t thread;
+	const control_command* commands;
+	int count;
+	void* userdata;
+	control_client clients[CONTROL_MAX_CLIENTS];
+};
+
+// The per-user runtime directory where there is one ($XDG_RUNTIME_DIR on
+// Linux, $TMPDIR on macOS), else /tmp with the user's name in the file name.
+void control_default_path(char* buf, size_t len)
+{
+#ifdef __APPLE__
+	// launchd does not always set TMPDIR for agents; ask for the same directory
+	char user_tmp[PATH_MAX];
+	const char* dir = getenv("TMPDIR");
+	if (!dir && confstr(_CS_DARWIN_USER_TEMP_DIR, user_tmp, sizeof(user_tmp)) > 0)
+		dir = user_tmp;
+#else
+	const char* dir = getenv("XDG_RUNTIME_DIR");
+#endif
+	if (dir && dir[0]) {
+		size_t dir_len = strlen(dir);
+		while (dir_len > 1 && dir[dir_len - 1] == '/')
+			dir_len--;
+		int n = snprintf(buf, len, "%.*s/aerospace-swipe.ctl", (int)dir_len, dir);
+		// sun_path is 104 bytes on macOS
+		if (n > 0 && (size_t)n < len && n < 104)
+			return;
+	}
+
+	const char* user = getenv("USER");
+	snprintf(buf, len, "/tmp/aerospace-swipe-%s.ctl", user ? user : "unknown");
+}
+
+static bool write_all(int fd, const char* data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		len -= (size_t)n;
+	}
+	return true;
+}
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Writes to a non-blocking client until `deadline`; false if it did not take
+// everything by then, so one stuck client cannot stall the others.
+static bool send_bounded(int fd, const char* data, size_t len, int64_t deadline)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n > 0) {
+			data += n;
+			len -= (size_t)n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+			return false;
+
+		int64_t left = deadline - now_ms();
+		struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+		if (left <= 0 || poll(&pfd, 1, (int)left) == 0)
+			return false;
+	}
+	return true;
+}
+
+static bool list_commands(control_server* server, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	yyjson_mut_val* names = yyjson_mut_obj_add_arr(doc, reply, "commands");
+	for (int i = 0; i < server->count; i++)
+		yyjson_mut_arr_add_str(doc, names, server->commands[i].name);
+	yyjson_mut_arr_add_str(doc, names, "help");
+	return true;
+}
+
+static bool dispatch(control_server* server, const char* line, size_t len, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	yyjson_doc* request = yyjson_read(line, len, 0);
+	yyjson_val* root = yyjson_doc_get_root(request);
+	const char* name = yyjson_get_str(yyjson_obj_get(root, "command"));
+
+	bool ok = false;
+	if (!name) {
+		yyjson_mut_obj_add_str(doc, reply, "error", "expected {\"command\": ...}");
+	} else if (strcmp(name, "help") == 0) {
+		ok = list_commands(server, doc, reply);
+	} else {
+		const control_command* command = NULL;
+		for (int i = 0; i < server->count && !command; i++) {
+			if (strcmp(server->commands[i].name, name) == 0)
+				command = &server->commands[i];
+		}
+
+		if (command)
+			ok = command->fn(server->userdata, root, doc, reply);
+		else
+			yyjson_mut_obj_add_str(doc, reply, "error", "unknown command");
+	}
+
+	yyjson_doc_free(request);
+	return ok;
+}
+
+static bool handle_line(control_server* server, int fd, const char* line, size_t len)
+{
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* reply = yyjson_mut_obj(doc);
+	yyjson_mut_doc_set_root(doc, reply);
+
+	// "ok" goes first so it reads well from a terminal
+	yyjson_mut_val* ok_key = yyjson_mut_str(doc, "ok");
+	yyjson_mut_val* ok_val = yyjson_mut_false(doc);
+	yyjson_mut_obj_add(reply, ok_key, ok_val);
+	if (dispatch(server, line, len, doc, reply))
+		yyjson_mut_set_bool(ok_val, true);
+
+	size_t out_len;
+	char* out = yyjson_mut_write(doc, 0, &out_len);
+	yyjson_mut_doc_free(doc);
+	if (!out)
+		return false;
+
+	int64_t deadline = now_ms() + CONTROL_SEND_TIMEOUT_MS;
+	bool sent = send_bounded(fd, out, out_len, deadline) && send_bounded(fd, "\n", 1, deadline);
+	free(out);
+	return sent;
+}
+
+// Returns false once the client should be dropped.
+static bool serve_client(control_server* server, control_client* client)
+{
+	ssize_t n = read(client->fd, client->buf + client->len, sizeof(client->buf) - client->len);
+	if (n <= 0)
+		return n < 0 && (errno == EINTR || errno == EAGAIN);
+	client->len += (size_t)n;
+
+	size_t start = 0;
+	for (size_t i = 0; i < client->len; i++) {
+		if (client->buf[i] != '\n')
+			continue;
+		if (i > start && !handle_line(server, client->fd, client->buf + start, i - start))
+			return false;
+		start = i + 1;
+	}
+
+	memmove(client->buf, client->buf + start, client->len - start);
+	client->len -= start;
+	// a line longer than the buffer can never complete
+	return client->len < sizeof(client->buf);
+}
+
+static void accept_client(control_server* server)
+{
+	int fd = accept(server->listen_fd, NULL, NULL);
+	if (fd < 0)
+		return;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (server->clients[i].fd < 0) {
+			server->clients[i].fd = fd;
+			server->clients[i].len = 0;
+			return;
+		}
+	}
+	close(fd);
+}
+
+static void* control_thread(void* arg)
+{
+	control_server* server = arg;
+	struct pollfd fds[CONTROL_MAX_CLIENTS + 2];
+
+	for (;;) {
+		int nfds = 0;
+		fds[nfds++] = (struct pollfd) { .fd = server->wake[0], .events = POLLIN };
+		fds[nfds++] = (struct pollfd) { .fd = server->listen_fd, .events = POLLIN };
+		for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+			fds[nfds++] = (struct pollfd) { .fd = server->clients[i].fd, .events = POLLIN };
+
+		if (poll(fds, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("control: poll");
+			return NULL;
+		}
+
+		if (fds[0].revents)
+			return NULL;
+		if (fds[1].revents & POLLIN)
+			accept_client(server);
+
+		for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+			control_client* client = &server->clients[i];
+			if (client->fd >= 0 && fds[i + 2].revents && !serve_client(server, client)) {
+				close(client->fd);
+				client->fd = -1;
+			}
+		}
+	}
+}
+
+control_server* control_start(const char* path, const control_command* commands, int count, void* userdata)
+{
+	control_server* server = calloc(1, sizeof(control_server));
+	if (!server)
+		return NULL;
+
+	snprintf(server->path, sizeof(server->path), "%s", path);
+	server->commands = commands;
+	server->count = count;
+	server->userdata = userdata;
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+		server->clients[i].fd = -1;
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+	// a socket nobody answers on was left by a crashed daemon
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (probe >= 0 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+		fprintf(stderr, "control: %s is already served by another instance\n", path);
+		close(probe);
+		free(server);
+		return NULL;
+	}
+	if (probe >= 0)
+		close(probe);
+	unlink(path);
+
+	server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server->listen_fd < 0 || pipe(server->wake) < 0) {
+		fprintf(stderr, "control: socket: %s\n", strerror(errno));
+		if (server->listen_fd >= 0)
+			close(server->listen_fd);
+		free(server);
+		return NULL;
+	}
+
+	mode_t old_mask = umask(0077);
+	int bound = bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr));
+	umask(old_mask);
+	if (bound < 0 || listen(server->listen_fd, 4) < 0) {
+		fprintf(stderr, "control: cannot listen on %s: %s\n", path, strerror(errno));
+		close(server->listen_fd);
+		close(server->wake[0]);
+		close(server->wake[1]);
+		free(server);
+		return NULL;
+	}
+
+	if (pthread_create(&server->thread, NULL, control_thread, server) != 0) {
+		close(server->listen_fd);
+		close(server->wake[0]);
+		close(server->wake[1]);
+		unlink(path);
+		free(server);
+		return NULL;
+	}
+	return server;
+}
+
+void control_stop(control_server* server)
+{
+	if (!server)
+		return;
+
+	write_all(server->wake[1], "x", 1);
+	pthread_join(server->thread, NULL);
+
+	for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (server->clients[i].fd >= 0)
+			close(server->clients[i].fd);
+	}
+	close(server->listen_fd);
+	close(server->wake[0]);
+	close(server->wake[1]);
+	unlink(server->path);
+	free(server);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "yyjson.h"
+
+// Per-user control socket. Clients send one JSON object per line, e.g.
+// {"command":"stats"}, and get one JSON object per line back with "ok" set
+// from the handler's result. Handlers run on the control thread; a client
+// that stops reading its replies is dropped rather than waited on.
+
+typedef bool (*control_fn)(void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply);
+
+typedef struct {
+	const char* name;
+	control_fn fn;
+} control_command;
+
+typedef struct control_server control_server;
+
+// $XDG_RUNTIME_DIR/aerospace-swipe.ctl on Linux, $TMPDIR/aerospace-swipe.ctl
+// on macOS, /tmp/aerospace-swipe-$USER.ctl without one.
+void control_default_path(char* buf, size_t len);
+
+// commands must outlive the server.
+control_server* control_start(const char* path, const control_command* commands, int count, void* userdata);
+void control_stop(control_server* server);
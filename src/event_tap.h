@@ -6,10 +6,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define ACTIVATE_PCT 0.05f
-#define END_PHASE 8 // NSTouchPhaseEnded
-#define FAST_VEL_FACTOR 0.80f
-#define MAX_TOUCHES 16
+#include "gesture.h"
 
 extern const char* get_name_for_pid(uint64_t pid);
 extern char* string_copy(char* s);
@@ -20,36 +17,12 @@ struct event_tap {
 	CGEventMask mask;
 };
 
-typedef struct {
-	double x;
-	double y;
-	int phase;
-	double timestamp;
-	double velocity;
-	bool is_palm;
-} touch;
-
 typedef struct {
 	double x;
 	double y;
 	double timestamp;
 } touch_state;
 
-// Gesture state enumeration
-typedef enum {
-	GS_IDLE,
-	GS_ARMED,
-	GS_COMMITTED
-} gesture_state;
-
-// Gesture context structure
-typedef struct {
-	gesture_state state;
-	float start_x, start_y, peak_velx;
-	int dir, last_fire_dir;
-	float prev_x[MAX_TOUCHES], base_x[MAX_TOUCHES];
-} gesture_ctx;
-
 // Palm rejection tracking structure
 typedef struct {
 	CGPoint start, last;
@@ -21,6 +21,7 @@
 	nt.timestamp = [[touchObj valueForKey:@"timestamp"] doubleValue];
 
 	id touchIdentity = [touchObj identity];
+	nt.id = (int)[touchIdentity hash];
 
 	if (!touchStates) {
 		touchStates = CFDictionaryCreateMutable(NULL, 0,
@@ -28,12 +29,14 @@
 			NULL);
 	}
 
-	double velocity_x = 0.0;
+	double velocity_x = 0.0, velocity_y = 0.0;
 	touch_state* state = (touch_state*)CFDictionaryGetValue(touchStates, (__bridge const void*)(touchIdentity));
 	if (state) {
 		double dt = nt.timestamp - state->timestamp;
-		if (dt > 0)
+		if (dt > 0) {
 			velocity_x = (nt.x - state->x) / dt;
+			velocity_y = (nt.y - state->y) / dt;
+		}
 		state->x = nt.x;
 		state->y = nt.y;
 		state->timestamp = nt.timestamp;
@@ -47,6 +50,7 @@
 		}
 	}
 	nt.velocity = velocity_x;
+	nt.velocity_y = velocity_y;
 
 	if (nt.phase == 8) {
 		CFDictionaryRemoveValue(touchStates, (__bridge const void*)(touchIdentity));
@@ -0,0 +1,711 @@
+#include "gesture.h"
+
+#include <math.h>
+#include <string.h>
+#ifdef GESTURE_CHECK_AGGREGATES
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#include "touch_simd.h"
+#include "tracer.h"
+
+static const char* const STATE_NAMES[] = { "GS_IDLE", "GS_ARMED", "GS_COMMITTED" };
+
+// unit vectors of the axes, indexed by gesture_axis
+#define DIAGONAL 0.70710678f
+static const float AXIS_X[GESTURE_AXES + 1] = { 0, 1, 0, DIAGONAL, DIAGONAL };
+static const float AXIS_Y[GESTURE_AXES + 1] = { 0, 0, 1, DIAGONAL, -DIAGONAL };
+
+static const char* const DIRECTION_NAMES[GESTURE_DIRECTIONS] = {
+	"pinch_in", "up_left", "down_left", "down", "left", NULL, "right", "up", "up_right", "down_right", "pinch_out"
+};
+
+const char* gesture_direction_name(int direction)
+{
+	if (direction < -GESTURE_DIRECTION_MAX || direction > GESTURE_DIRECTION_MAX)
+		return NULL;
+	return DIRECTION_NAMES[direction + GESTURE_DIRECTION_MAX];
+}
+
+static void reset_gesture_state(gesture_ctx* ctx)
+{
+	ctx->state = GS_IDLE;
+	ctx->last_fire_dir = 0;
+	ctx->start_spread = 0;
+}
+
+static void arm_gesture(gesture_ctx* ctx)
+{
+	ctx->state = GS_ARMED;
+	if (ctx->callbacks.armed)
+		ctx->callbacks.armed(ctx);
+}
+
+static void fire_gesture(gesture_ctx* ctx, int direction, int steps)
+{
+	if (direction == ctx->last_fire_dir)
+		return;
+
+	ctx->last_fire_dir = direction;
+	ctx->state = GS_COMMITTED;
+	ctx->fire_steps = steps;
+
+	if (ctx->callbacks.fired)
+		ctx->callbacks.fired(ctx, direction);
+}
+
+// more steps for the direction that already fired
+static void fire_again(gesture_ctx* ctx, int steps)
+{
+	ctx->fire_steps = steps;
+	if (ctx->callbacks.fired)
+		ctx->callbacks.fired(ctx, ctx->last_fire_dir);
+}
+
+// Weight of the newest frame in the velocity a fling is classified by, so
+// one frame's timing noise can't earn a step on its own.
+#define FLING_SMOOTHING 0.5f
+// A fling tops up after firing only once its smoothed velocity clears the
+// next point of the curve by this factor.
+#define FLING_HYSTERESIS 1.15f
+
+static int fling_steps(const gesture_params* params, float vel)
+{
+	int steps = 1;
+	while (steps <= params->fling_count && fabsf(vel) >= params->fling_vel[steps - 1])
+		steps++;
+	return steps;
+}
+
+// The per-frame helpers are forced inline so each kernel below gets its own
+// copy with count folded to a constant.
+#define GESTURE_INLINE static inline __attribute__((always_inline))
+
+void touch_frame_pack(touch_frame* frame, const touch* touches, int count)
+{
+	if (count > MAX_TOUCHES)
+		count = MAX_TOUCHES;
+
+	for (int i = 0; i < count; ++i) {
+		frame->x[i] = touches[i].x;
+		frame->y[i] = touches[i].y;
+		frame->vel[i] = touches[i].velocity;
+		frame->vel_y[i] = touches[i].velocity_y;
+		frame->id[i] = touches[i].id;
+		frame->phase[i] = (uint8_t)touches[i].phase;
+	}
+	// reductions read whole chunks of four
+	for (int i = count; i < ((count + 3) & ~3); ++i)
+		frame->x[i] = frame->y[i] = frame->vel[i] = frame->vel_y[i] = 0;
+	frame->count = count;
+}
+
+static void aggregates_extrema(touch_aggregates* agg)
+{
+	float min_x = agg->count ? agg->x[0] : 0, max_x = min_x;
+	float min_y = agg->count ? agg->y[0] : 0, max_y = min_y;
+	for (int i = 1; i < agg->count; ++i) {
+		min_x = fminf(min_x, agg->x[i]);
+		max_x = fmaxf(max_x, agg->x[i]);
+		min_y = fminf(min_y, agg->y[i]);
+		max_y = fmaxf(max_y, agg->y[i]);
+	}
+	agg->min_x = min_x;
+	agg->max_x = max_x;
+	agg->min_y = min_y;
+	agg->max_y = max_y;
+}
+
+// Moves one touch's value from was to now; false when it held an extremum
+// and moved inward, so the others have to be searched.
+static inline bool extremum_move(float* min, float* max, float was, float now)
+{
+	if (now < *min)
+		*min = now;
+	else if (was == *min && now > was)
+		return false;
+	if (now > *max)
+		*max = now;
+	else if (was == *max && now < was)
+		return false;
+	return true;
+}
+
+static void aggregates_rebuild(touch_aggregates* agg, const touch_frame* frame)
+{
+	int count = frame->count;
+	touch_totals sum;
+	touch_sums(frame, count, &sum);
+
+	agg->count = count;
+	agg->sum_x = sum.x;
+	agg->sum_y = sum.y;
+	agg->sum_vel = sum.vel;
+	agg->sum_vel_y = sum.vel_y;
+	agg->sum_r2 = sum.r2;
+	memcpy(agg->id, frame->id, sizeof(int) * count);
+	memcpy(agg->x, frame->x, sizeof(float) * count);
+	memcpy(agg->y, frame->y, sizeof(float) * count);
+	memcpy(agg->vel, frame->vel, sizeof(float) * count);
+	memcpy(agg->vel_y, frame->vel_y, sizeof(float) * count);
+	aggregates_extrema(agg);
+	agg->rebuilds++;
+}
+
+// The same ids in another order: copies frame into scratch in the
+// aggregates' lane order, so per-touch history never has to move. False if
+// an id is new.
+static bool aggregates_reorder(const touch_aggregates* agg, const touch_frame* frame, touch_frame* scratch)
+{
+	int count = frame->count;
+	for (int j = 0; j < count; ++j) {
+		int i = 0;
+		while (i < count && frame->id[i] != agg->id[j])
+			i++;
+		if (i == count)
+			return false;
+
+		scratch->x[j] = frame->x[i];
+		scratch->y[j] = frame->y[i];
+		scratch->vel[j] = frame->vel[i];
+		scratch->vel_y[j] = frame->vel_y[i];
+		scratch->id[j] = frame->id[i];
+		scratch->phase[j] = frame->phase[i];
+	}
+	for (int i = count; i < ((count + 3) & ~3); ++i)
+		scratch->x[i] = scratch->y[i] = scratch->vel[i] = scratch->vel_y[i] = 0;
+	scratch->count = count;
+	return true;
+}
+
+// Brings the sums up to date with frame, touching only what changed, and
+// returns the frame to run recognizers on: frame itself, or scratch when its
+// touches arrived in another order. *same_touches is false when the set of
+// touches is not the previous frame's.
+static const touch_frame* aggregates_update(touch_aggregates* agg, const touch_frame* frame, touch_frame* scratch,
+	bool* same_touches)
+{
+	int count = frame->count;
+	*same_touches = false;
+
+	if (count != agg->count) {
+		aggregates_rebuild(agg, frame);
+		return frame;
+	}
+	bool same_order = true;
+	for (int i = 0; i < count; ++i)
+		same_order &= agg->id[i] == frame->id[i];
+	if (!same_order) {
+		if (!aggregates_reorder(agg, frame, scratch)) {
+			aggregates_rebuild(agg, frame);
+			return frame;
+		}
+		frame = scratch;
+	}
+	*same_touches = true;
+
+	double dx = 0, dy = 0, dvel = 0, dvel_y = 0, dr2 = 0;
+	unsigned updates = 0;
+	bool extrema = true;
+	for (int i = 0; i < count; ++i) {
+		if (frame->x[i] == agg->x[i] && frame->y[i] == agg->y[i] && frame->vel[i] == agg->vel[i]
+			&& frame->vel_y[i] == agg->vel_y[i])
+			continue;
+		dx += (double)frame->x[i] - agg->x[i];
+		dy += (double)frame->y[i] - agg->y[i];
+		dvel += (double)frame->vel[i] - agg->vel[i];
+		dvel_y += (double)frame->vel_y[i] - agg->vel_y[i];
+		dr2 += ((double)frame->x[i] * frame->x[i] + (double)frame->y[i] * frame->y[i])
+			- ((double)agg->x[i] * agg->x[i] + (double)agg->y[i] * agg->y[i]);
+		extrema = extrema && extremum_move(&agg->min_x, &agg->max_x, agg->x[i], frame->x[i])
+			&& extremum_move(&agg->min_y, &agg->max_y, agg->y[i], frame->y[i]);
+		agg->x[i] = frame->x[i];
+		agg->y[i] = frame->y[i];
+		agg->vel[i] = frame->vel[i];
+		agg->vel_y[i] = frame->vel_y[i];
+		updates++;
+	}
+	agg->sum_x += dx;
+	agg->sum_y += dy;
+	agg->sum_vel += dvel;
+	agg->sum_vel_y += dvel_y;
+	agg->sum_r2 += dr2;
+	agg->updates += updates;
+	if (!extrema) {
+		aggregates_extrema(agg);
+		agg->rescans++;
+	}
+
+#ifdef GESTURE_CHECK_AGGREGATES
+	touch_totals sum;
+	touch_sums(frame, count, &sum);
+	if (fabs(sum.x - agg->sum_x) > 1e-4 || fabs(sum.y - agg->sum_y) > 1e-4 || fabs(sum.r2 - agg->sum_r2) > 1e-4
+		|| fabs(sum.vel - agg->sum_vel) > 1e-3 * (1 + fabsf(sum.vel))
+		|| fabs(sum.vel_y - agg->sum_vel_y) > 1e-3 * (1 + fabsf(sum.vel_y))) {
+		fprintf(stderr, "gesture: aggregates drifted: x %f/%f y %f/%f r2 %f/%f vel %f/%f vel_y %f/%f\n",
+			agg->sum_x, sum.x, agg->sum_y, sum.y, agg->sum_r2, sum.r2, agg->sum_vel, sum.vel, agg->sum_vel_y, sum.vel_y);
+		abort();
+	}
+	for (int i = 0; i < count; ++i) {
+		if (frame->x[i] < agg->min_x || frame->x[i] > agg->max_x || frame->y[i] < agg->min_y
+			|| frame->y[i] > agg->max_y) {
+			fprintf(stderr, "gesture: touch %d outside the extrema\n", frame->id[i]);
+			abort();
+		}
+	}
+#endif
+	return frame;
+}
+
+static touch_means aggregates_means(const touch_aggregates* agg)
+{
+	int count = agg->count ? agg->count : 1;
+	double x = agg->sum_x / count, y = agg->sum_y / count;
+	return (touch_means) {
+		.x = (float)x,
+		.y = (float)y,
+		.vel = (float)(agg->sum_vel / count),
+		.vel_y = (float)(agg->sum_vel_y / count),
+		.var = (float)fmax(agg->sum_r2 / count - x * x - y * y, 0),
+	};
+}
+
+GESTURE_INLINE float along_axis(int axis, float x, float y)
+{
+	return x * AXIS_X[axis] + y * AXIS_Y[axis];
+}
+
+// The enabled axis (x, y) lies closest to. With only the horizontal axis
+// enabled that is always horizontal, whatever the motion.
+GESTURE_INLINE int closest_axis(unsigned axes, float x, float y)
+{
+	int best = GESTURE_AXIS_HORIZONTAL;
+	float best_along = -1;
+	for (int axis = GESTURE_AXIS_HORIZONTAL; axis <= GESTURE_AXES; ++axis) {
+		float along = fabsf(along_axis(axis, x, y));
+		if ((axes & GESTURE_AXIS_BIT(axis)) && along > best_along) {
+			best = axis;
+			best_along = along;
+		}
+	}
+	return best;
+}
+
+GESTURE_INLINE void start_gesture(gesture_ctx* ctx, int axis, const touch_means* m)
+{
+	ctx->axis = axis;
+	ctx->start_x = m->x;
+	ctx->start_y = m->y;
+	ctx->fling_vel = along_axis(axis, m->vel, m->vel_y);
+	ctx->peak_vel = ctx->fling_vel;
+	ctx->dir = (ctx->peak_vel >= 0) ? 1 : -1;
+}
+
+// Folds this frame's velocity along the axis into the smoothed one; returns
+// the smoothed velocity.
+GESTURE_INLINE float smooth_velocity(gesture_ctx* ctx, float vel)
+{
+	ctx->fling_vel += FLING_SMOOTHING * (vel - ctx->fling_vel);
+	return ctx->fling_vel;
+}
+
+static bool handle_committed_state(gesture_ctx* ctx, const touch_frame* frame, const touch_means* m)
+{
+	int count = frame->count;
+	bool all_ended = true;
+	for (int i = 0; i < count; ++i) {
+		if (frame->phase[i] != END_PHASE) {
+			all_ended = false;
+			break;
+		}
+	}
+
+	if (!count || all_ended) {
+		reset_gesture_state(ctx);
+		return true;
+	}
+
+	// a pinch stays done until the fingers lift
+	if (ctx->params.kind == GESTURE_KIND_PINCH)
+		return true;
+
+	// a fling still speeding up after it fired tops up its steps, once it is
+	// clear of the next point of the curve
+	if (ctx->params.fling_count) {
+		float vel = smooth_velocity(ctx, along_axis(ctx->axis, m->vel, m->vel_y));
+		if ((vel > 0) == (ctx->last_fire_dir > 0) && fabsf(vel) > fabsf(ctx->peak_vel)) {
+			ctx->peak_vel = vel;
+			int steps = fling_steps(&ctx->params, vel / FLING_HYSTERESIS);
+			if (steps > ctx->fling_steps) {
+				fire_again(ctx, steps - ctx->fling_steps);
+				ctx->fling_steps = steps;
+				return true;
+			}
+		}
+	}
+
+	// scrubbing: every scrub_pct further along fires the same direction
+	// again, one step per frame
+	float along = along_axis(ctx->axis, m->x - ctx->start_x, m->y - ctx->start_y);
+	float travel = ctx->last_fire_dir > 0 ? along : -along;
+	if (ctx->params.scrub_pct > 0 && travel >= ctx->scrub_at) {
+		ctx->scrub_at += ctx->params.scrub_pct;
+		fire_again(ctx, 1);
+		return true;
+	}
+
+	// swiping back along the axis that fired re-arms it
+	if ((along * ctx->last_fire_dir) < 0 && fabsf(along) >= ctx->params.min_travel) {
+		start_gesture(ctx, ctx->axis, m);
+
+		memcpy(ctx->base_x, frame->x, sizeof(float) * count);
+		memcpy(ctx->base_y, frame->y, sizeof(float) * count);
+
+		arm_gesture(ctx);
+	}
+
+	return true;
+}
+
+GESTURE_INLINE void handle_idle_state(gesture_ctx* ctx, const touch_frame* frame, int count, const touch_means* m)
+{
+	unsigned axes = ctx->params.axes;
+	float dx = m->x - ctx->start_x;
+	float dy = m->y - ctx->start_y;
+
+	// a flick is classified by its velocity, a slower swipe by how far it went
+	int axis = closest_axis(axes, m->vel, m->vel_y);
+	bool fast = fabsf(along_axis(axis, m->vel, m->vel_y)) >= ctx->params.velocity_pct * FAST_VEL_FACTOR;
+	if (!fast)
+		axis = closest_axis(axes, dx, dy);
+	float need = fast ? ctx->params.min_travel_fast : ctx->params.min_travel;
+
+	// every finger has to have moved; y only counts when a non-horizontal
+	// axis can be picked
+	float wy = (axes & ~GESTURE_AXIS_BIT(GESTURE_AXIS_HORIZONTAL)) ? 1.0f : 0.0f;
+	bool moved = touch_all_moved(frame, count, ctx->base_x, ctx->base_y, wy, need);
+
+	float along = fabsf(along_axis(axis, dx, dy));
+	float across = fabsf(along_axis(axis, -dy, dx));
+
+	if (moved && (fast || (along >= ACTIVATE_PCT && along > across))) {
+		start_gesture(ctx, axis, m);
+		arm_gesture(ctx);
+	}
+}
+
+GESTURE_INLINE void handle_armed_state(gesture_ctx* ctx, const touch_frame* frame, int count, const touch_means* m)
+{
+	int axis = ctx->axis;
+	float dx = m->x - ctx->start_x;
+	float dy = m->y - ctx->start_y;
+	float along = along_axis(axis, dx, dy);
+
+	if (fabsf(along_axis(axis, -dy, dx)) > fabsf(along)) {
+		reset_gesture_state(ctx);
+		return;
+	}
+
+	float vel = along_axis(axis, m->vel, m->vel_y);
+	bool fast = fabsf(vel) >= ctx->params.velocity_pct * FAST_VEL_FACTOR;
+	float stepReq = fast ? ctx->params.min_step_fast : ctx->params.min_step;
+
+	// fingers that stalled or moved against the swipe
+	if (touch_mismatches(frame, count, ctx->prev_x, ctx->prev_y, AXIS_X[axis], AXIS_Y[axis], stepReq, along)
+		> ctx->params.swipe_tolerance) {
+		reset_gesture_state(ctx);
+		return;
+	}
+
+	// the fling curve reads the peak of the smoothed velocity
+	float smoothed = smooth_velocity(ctx, vel);
+	if (fabsf(smoothed) > fabsf(ctx->peak_vel)) {
+		ctx->peak_vel = smoothed;
+		ctx->dir = (smoothed >= 0) ? 1 : -1;
+	}
+
+	int fired = 0;
+	if (fabsf(vel) >= ctx->params.velocity_pct) {
+		fired = vel > 0 ? axis : -axis;
+	} else if (fabsf(along) >= ctx->params.distance_pct && fabsf(vel) <= ctx->params.velocity_pct * ctx->params.settle_factor) {
+		fired = along > 0 ? axis : -axis;
+	}
+	if (fired) {
+		ctx->scrub_at = (fired > 0 ? along : -along) + ctx->params.scrub_pct;
+		ctx->fling_steps = (ctx->peak_vel > 0) == (fired > 0) ? fling_steps(&ctx->params, ctx->peak_vel) : 1;
+		fire_gesture(ctx, fired, ctx->fling_steps);
+	}
+}
+
+// A frame with exactly params.fingers touches, past the committed and
+// count checks.
+GESTURE_INLINE void process_fingers(gesture_ctx* ctx, const touch_frame* frame, const touch_means* m, int count)
+{
+	if (ctx->state == GS_IDLE) {
+		handle_idle_state(ctx, frame, count, m);
+	} else if (ctx->state == GS_ARMED) {
+		handle_armed_state(ctx, frame, count, m);
+	}
+
+	memcpy(ctx->prev_x, frame->x, sizeof(float) * count);
+	memcpy(ctx->prev_y, frame->y, sizeof(float) * count);
+	if (ctx->state == GS_IDLE) {
+		memcpy(ctx->base_x, frame->x, sizeof(float) * count);
+		memcpy(ctx->base_y, frame->y, sizeof(float) * count);
+	}
+}
+
+void gesture_kernel_generic(gesture_ctx* ctx, const touch_frame* frame, const touch_means* means)
+{
+	process_fingers(ctx, frame, means, ctx->params.fingers);
+}
+
+// One copy of process_fingers per common finger count, with the chunk loops
+// unrolled by the compiler.
+#define GESTURE_KERNEL(n)                                                                                  \
+	static void gesture_kernel_##n(gesture_ctx* ctx, const touch_frame* frame, const touch_means* means) \
+	{                                                                                                   \
+		process_fingers(ctx, frame, means, n);                                                          \
+	}
+
+GESTURE_KERNEL(2)
+GESTURE_KERNEL(3)
+GESTURE_KERNEL(4)
+GESTURE_KERNEL(5)
+
+// Spread is the RMS distance of the touches from their centroid. It has to
+// change by more than the centroid moves, so a swipe never reads as a pinch.
+static void pinch_kernel(gesture_ctx* ctx, const touch_frame* frame, const touch_means* m)
+{
+	(void)frame;
+	float spread = sqrtf(m->var);
+	if (ctx->start_spread <= 0) {
+		ctx->start_spread = spread;
+		ctx->start_x = m->x;
+		ctx->start_y = m->y;
+		return;
+	}
+
+	float change = spread - ctx->start_spread;
+	float drift = hypotf(m->x - ctx->start_x, m->y - ctx->start_y);
+	float ratio = spread / ctx->start_spread;
+
+	if (ctx->state == GS_IDLE) {
+		if (fabsf(change) > drift && fabsf(ratio - 1) >= ctx->params.pinch_pct / 2) {
+			ctx->dir = change > 0 ? 1 : -1;
+			arm_gesture(ctx);
+		}
+	} else if (ctx->state == GS_ARMED) {
+		if (drift > fabsf(change)) {
+			reset_gesture_state(ctx);
+		} else if (ratio <= 1 - ctx->params.pinch_pct) {
+			fire_gesture(ctx, GESTURE_PINCH_IN, 1);
+		} else if (ratio >= 1 + ctx->params.pinch_pct) {
+			fire_gesture(ctx, GESTURE_PINCH_OUT, 1);
+		}
+	}
+}
+
+gesture_kernel_fn gesture_kernel_for(const gesture_params* params)
+{
+	if (params->kind == GESTURE_KIND_PINCH)
+		return pinch_kernel;
+
+	switch (params->fingers) {
+	case 2:
+		return gesture_kernel_2;
+	case 3:
+		return gesture_kernel_3;
+	case 4:
+		return gesture_kernel_4;
+	case 5:
+		return gesture_kernel_5;
+	default:
+		return gesture_kernel_generic;
+	}
+}
+
+void gesture_set_params(gesture_ctx* ctx, const gesture_params* params)
+{
+	ctx->params = *params;
+	ctx->kernel = gesture_kernel_for(params);
+}
+
+void gesture_init(gesture_ctx* ctx, const gesture_params* params, gesture_callbacks callbacks, void* userdata)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->state = GS_IDLE;
+	gesture_set_params(ctx, params);
+	ctx->callbacks = callbacks;
+	ctx->userdata = userdata;
+}
+
+static void process_frame(gesture_ctx* ctx, const touch_frame* frame, const touch_means* means, bool same_touches)
+{
+	int count = frame->count;
+
+	if (ctx->state == GS_COMMITTED) {
+		if (handle_committed_state(ctx, frame, means))
+			return;
+	}
+
+	// a frame with another count, or the first of a new set of fingers:
+	// positions are measured from here, not from whichever touches an
+	// earlier frame left behind
+	if (count != ctx->params.fingers || !same_touches) {
+		if (ctx->state == GS_ARMED && count != ctx->params.fingers)
+			ctx->state = GS_IDLE;
+
+		memcpy(ctx->prev_x, frame->x, sizeof(float) * count);
+		memcpy(ctx->prev_y, frame->y, sizeof(float) * count);
+		memcpy(ctx->base_x, frame->x, sizeof(float) * count);
+		memcpy(ctx->base_y, frame->y, sizeof(float) * count);
+		ctx->start_spread = 0;
+		if (count != ctx->params.fingers)
+			return;
+	}
+
+	ctx->kernel(ctx, frame, means);
+}
+
+static void process_frame_traced(gesture_ctx* ctx, const touch_frame* frame, const touch_means* means, bool same_touches)
+{
+	uint64_t start = tracer_begin();
+	gesture_state before = ctx->state;
+
+	process_frame(ctx, frame, means, same_touches);
+
+	if (!start)
+		return;
+	tracer_span("engine", "gesture_process", start, "touches", frame->count);
+	if (ctx->state != before) {
+		// one span per state, emitted when it is left
+		if (ctx->state_since_ns)
+			tracer_span("state", STATE_NAMES[before], ctx->state_since_ns, NULL, 0);
+		ctx->state_since_ns = tracer_now_ns();
+	}
+}
+
+void gesture_process_frame(gesture_ctx* ctx, const touch_frame* frame)
+{
+	touch_frame scratch;
+	bool same_touches;
+	frame = aggregates_update(&ctx->agg, frame, &scratch, &same_touches);
+	touch_means means = aggregates_means(&ctx->agg);
+	process_frame_traced(ctx, frame, &means, same_touches);
+}
+
+void gesture_process(gesture_ctx* ctx, const touch* touches, int count)
+{
+	touch_frame frame;
+	touch_frame_pack(&frame, touches, count);
+	gesture_process_frame(ctx, &frame);
+}
+
+static void set_armed(gesture_ctx* ctx)
+{
+	gesture_set* set = gesture_set_of(ctx);
+	if (set->callbacks.armed)
+		set->callbacks.armed(ctx);
+}
+
+// fires are held until every recognizer has seen the frame
+static void set_fired(gesture_ctx* ctx, int direction)
+{
+	gesture_set* set = gesture_set_of(ctx);
+	set->fired[gesture_set_index(set, ctx)] = direction;
+}
+
+void gesture_set_configure(gesture_set* set, const gesture_recognizers* recognizers)
+{
+	gesture_callbacks callbacks = { .armed = set_armed, .fired = set_fired };
+	set->count = recognizers->count < GESTURE_MAX_RECOGNIZERS ? recognizers->count : GESTURE_MAX_RECOGNIZERS;
+	for (int i = 0; i < set->count; ++i)
+		gesture_init(&set->recognizers[i], &recognizers->params[i], callbacks, set);
+	set->owner = -1;
+	set->resync = true;
+}
+
+void gesture_set_init(gesture_set* set, const gesture_recognizers* recognizers, gesture_callbacks callbacks, void* userdata)
+{
+	memset(set, 0, sizeof(*set));
+	set->callbacks = callbacks;
+	set->userdata = userdata;
+	gesture_set_configure(set, recognizers);
+}
+
+void gesture_set_process_frame(gesture_set* set, const touch_frame* frame)
+{
+	touch_frame scratch;
+	bool same_touches;
+	frame = aggregates_update(&set->agg, frame, &scratch, &same_touches);
+	touch_means means = aggregates_means(&set->agg);
+	same_touches &= !set->resync;
+	set->resync = false;
+
+	for (int i = 0; i < set->count; ++i) {
+		set->fired[i] = 0;
+		if (set->owner < 0 || set->owner == i)
+			process_frame_traced(&set->recognizers[i], frame, &means, same_touches);
+	}
+
+	int winner = set->owner;
+	if (winner < 0) {
+		for (int i = 0; i < set->count && winner < 0; ++i) {
+			if (set->fired[i])
+				winner = i;
+		}
+		if (winner >= 0) {
+			set->owner = winner;
+			for (int i = 0; i < set->count; ++i) {
+				if (i != winner)
+					reset_gesture_state(&set->recognizers[i]);
+			}
+		}
+	}
+	if (winner >= 0 && set->fired[winner] && set->callbacks.fired)
+		set->callbacks.fired(&set->recognizers[winner], set->fired[winner]);
+
+	// the owner lets go once its fingers have lifted
+	if (set->owner >= 0 && set->recognizers[set->owner].state == GS_IDLE) {
+		set->owner = -1;
+		set->resync = true;
+	}
+}
+
+void gesture_set_process(gesture_set* set, const touch* touches, int count)
+{
+	touch_frame frame;
+	touch_frame_pack(&frame, touches, count);
+	gesture_set_process_frame(set, &frame);
+}
+
+unsigned gesture_recognizers_fingers(const gesture_recognizers* recognizers)
+{
+	unsigned fingers = 0;
+	for (int i = 0; i < recognizers->count; ++i)
+		fingers |= GESTURE_FINGERS(recognizers->params[i].fingers);
+	return fingers;
+}
+
+unsigned gesture_set_fingers(const gesture_set* set)
+{
+	unsigned fingers = 0;
+	for (int i = 0; i < set->count; ++i)
+		fingers |= GESTURE_FINGERS(set->recognizers[i].params.fingers);
+	return fingers;
+}
+
+gesture_state gesture_set_state(const gesture_set* set)
+{
+	if (set->owner >= 0)
+		return set->recognizers[set->owner].state;
+
+	gesture_state state = GS_IDLE;
+	for (int i = 0; i < set->count; ++i) {
+		if (set->recognizers[i].state > state)
+			state = set->recognizers[i].state;
+	}
+	return state;
+}
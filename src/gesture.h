@@ -0,0 +1,273 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ACTIVATE_PCT 0.05f
+#define END_PHASE 8 // NSTouchPhaseEnded
+#define FAST_VEL_FACTOR 0.80f
+#define MAX_TOUCHES 16
+
+typedef struct {
+	double x;
+	double y;
+	int phase;
+	double timestamp;
+	double velocity; // x per second
+	bool is_palm;
+	int id; // stable while the finger is down
+	double velocity_y; // y per second, y growing upwards
+} touch;
+
+// The engine's copy of a frame: structure-of-arrays floats in 16-byte
+// aligned lanes so reductions run four touches at a time. Lanes from count
+// up to the next multiple of four are zero.
+typedef struct {
+	_Alignas(16) float x[MAX_TOUCHES];
+	_Alignas(16) float y[MAX_TOUCHES];
+	_Alignas(16) float vel[MAX_TOUCHES];
+	_Alignas(16) float vel_y[MAX_TOUCHES];
+	int id[MAX_TOUCHES];
+	uint8_t phase[MAX_TOUCHES];
+	int count;
+} touch_frame;
+
+typedef struct {
+	float x, y, vel, vel_y, r2; // r2 sums x * x + y * y
+} touch_totals;
+
+// Running sums and extrema over the touches of the previous frame, keyed by
+// touch id. A frame with the same ids only re-sums the touches whose values
+// changed; a reordered one is copied into the sums' order first and a new
+// set is summed from scratch. x, y and vel are the values currently in the
+// sums. An extremum is only searched for again when the touch holding it
+// moves inward; all are 0 without touches.
+typedef struct {
+	int count;
+	int id[MAX_TOUCHES];
+	float x[MAX_TOUCHES], y[MAX_TOUCHES], vel[MAX_TOUCHES], vel_y[MAX_TOUCHES];
+	double sum_x, sum_y, sum_vel, sum_vel_y, sum_r2;
+	float min_x, max_x, min_y, max_y;
+	unsigned long long rebuilds, updates; // sets summed from scratch, touches re-summed
+	unsigned long long rescans; // extrema searched for again
+} touch_aggregates;
+
+// What recognizers read off the aggregates each frame: centroid, mean
+// velocity per second, and the variance of the touches around the centroid
+// (a pinch is its square root changing).
+typedef struct {
+	float x, y, vel, vel_y, var;
+} touch_means;
+
+// Narrows and transposes up to MAX_TOUCHES touches.
+void touch_frame_pack(touch_frame* frame, const touch* touches, int count);
+
+// Gesture state enumeration
+typedef enum {
+	GS_IDLE,
+	GS_ARMED,
+	GS_COMMITTED
+} gesture_state;
+
+// Swipe directions as passed to the fired callback. Each axis is a line the
+// fingers move along; a direction is its axis number signed by which way
+// along it, so horizontal keeps -1/+1 and the opposite of a direction is its
+// negation.
+typedef enum {
+	GESTURE_AXIS_HORIZONTAL = 1, // +1 right
+	GESTURE_AXIS_VERTICAL = 2, // +2 up
+	GESTURE_AXIS_RISING = 3, // +3 up and right
+	GESTURE_AXIS_FALLING = 4, // +4 down and right
+} gesture_axis;
+
+#define GESTURE_AXES 4
+#define GESTURE_AXIS_BIT(axis) (1u << (axis))
+
+// Pinches are reported like a fifth axis: -5 in, +5 out.
+#define GESTURE_PINCH 5
+#define GESTURE_DIRECTION_MAX GESTURE_PINCH
+#define GESTURE_DIRECTIONS (2 * GESTURE_DIRECTION_MAX + 1) // for arrays indexed by direction + GESTURE_DIRECTION_MAX
+
+enum {
+	GESTURE_LEFT = -GESTURE_AXIS_HORIZONTAL,
+	GESTURE_RIGHT = GESTURE_AXIS_HORIZONTAL,
+	GESTURE_DOWN = -GESTURE_AXIS_VERTICAL,
+	GESTURE_UP = GESTURE_AXIS_VERTICAL,
+	GESTURE_DOWN_LEFT = -GESTURE_AXIS_RISING,
+	GESTURE_UP_RIGHT = GESTURE_AXIS_RISING,
+	GESTURE_UP_LEFT = -GESTURE_AXIS_FALLING,
+	GESTURE_DOWN_RIGHT = GESTURE_AXIS_FALLING,
+	GESTURE_PINCH_IN = -GESTURE_PINCH,
+	GESTURE_PINCH_OUT = GESTURE_PINCH,
+};
+
+// "left", "up_right", "pinch_in", ...; NULL for anything else.
+const char* gesture_direction_name(int direction);
+
+typedef enum {
+	GESTURE_KIND_SWIPE,
+	GESTURE_KIND_PINCH,
+} gesture_kind;
+
+#define GESTURE_FLING_MAX 4
+
+// Detection thresholds; every context carries its own copy so devices can be
+// tuned independently.
+typedef struct {
+	gesture_kind kind;
+	int fingers;
+	int swipe_tolerance;
+	float distance_pct;
+	float velocity_pct;
+	float settle_factor;
+	float min_step;
+	float min_travel;
+	float min_step_fast;
+	float min_travel_fast;
+	unsigned axes; // GESTURE_AXIS_BIT()s the recognizer may pick; 0 is horizontal only
+	float pinch_pct; // change in spread that fires a pinch
+	float scrub_pct; // further travel that fires the same swipe again; 0 is off
+	// fling curve: a swipe whose peak smoothed velocity along its axis reaches
+	// fling_vel[i] (ascending, pad widths per second) moves i + 2 steps
+	float fling_vel[GESTURE_FLING_MAX];
+	int fling_count;
+} gesture_params;
+
+typedef struct gesture_ctx gesture_ctx;
+
+// The per-frame work for a frame with exactly params.fingers touches.
+typedef void (*gesture_kernel_fn)(gesture_ctx* ctx, const touch_frame* frame, const touch_means* means);
+
+// fired may come more than once per swipe: when it reverses, each scrub
+// step, and when a fling speeds past another point of the curve after
+// firing. ctx->fire_steps is how many steps that call adds.
+typedef struct {
+	void (*armed)(gesture_ctx* ctx);
+	void (*fired)(gesture_ctx* ctx, int direction);
+} gesture_callbacks;
+
+// Gesture context structure
+struct gesture_ctx {
+	gesture_state state;
+	float start_x, start_y;
+	float fling_vel, peak_vel; // smoothed velocity along axis, and its peak
+	float start_spread; // pinches; 0 until measured
+	float scrub_at; // travel from start along the fired direction that fires again
+	int axis; // gesture_axis picked when the gesture armed
+	int dir, last_fire_dir;
+	int fire_steps; // for the fired callback
+	int fling_steps; // steps the fling curve gave the current swipe so far
+	_Alignas(16) float prev_x[MAX_TOUCHES];
+	_Alignas(16) float prev_y[MAX_TOUCHES];
+	_Alignas(16) float base_x[MAX_TOUCHES];
+	_Alignas(16) float base_y[MAX_TOUCHES];
+	gesture_params params;
+	gesture_kernel_fn kernel; // picked from params.fingers
+	gesture_callbacks callbacks;
+	void* userdata;
+	touch_aggregates agg;
+	uint64_t state_since_ns; // for the tracer's state spans
+};
+
+void gesture_init(gesture_ctx* ctx, const gesture_params* params, gesture_callbacks callbacks, void* userdata);
+
+// Replaces the thresholds and picks the kernel for the new finger count; use
+// this rather than assigning params.
+void gesture_set_params(gesture_ctx* ctx, const gesture_params* params);
+
+// Unrolled swipe kernels exist for 2-5 fingers; other counts get the generic
+// one, pinches their own.
+gesture_kernel_fn gesture_kernel_for(const gesture_params* params);
+void gesture_kernel_generic(gesture_ctx* ctx, const touch_frame* frame, const touch_means* means);
+
+// Pre-filter for the thread that produces frames, so a frame the engine
+// would ignore is not converted or queued. It only looks at the touch count
+// and the OR of the touches' phases (NSTouchPhase values), and passes:
+// - any frame with a count in `fingers`, a GESTURE_FINGERS() mask,
+// - any frame whose count differs from the previous frame's,
+// - any frame with an ended or cancelled touch.
+// What it drops is a steady run with another count (two-finger scrolling
+// under a three-finger config), which the engine only uses to reset state
+// the first frame of the run already reset. One filter per device.
+typedef struct {
+	int last_count;
+} gesture_filter;
+
+#define TOUCH_PHASE_CANCELLED 16
+#define GESTURE_FINGERS(count) (1u << (count))
+
+static inline bool gesture_filter_pass(gesture_filter* f, unsigned fingers, int count, unsigned phases)
+{
+	bool pass = (count < 32 && (fingers & GESTURE_FINGERS(count))) || count != f->last_count
+		|| (phases & (END_PHASE | TOUCH_PHASE_CANCELLED));
+	f->last_count = count;
+	return pass;
+}
+
+static inline unsigned gesture_phases(const touch* touches, int count)
+{
+	unsigned phases = 0;
+	for (int i = 0; i < count; ++i)
+		phases |= (unsigned)touches[i].phase;
+	return phases;
+}
+
+// Feeds one frame of touches through the state machine. Not thread-safe; a
+// context must only ever be driven from one thread or serial queue.
+void gesture_process(gesture_ctx* ctx, const touch* touches, int count);
+
+// The same for a frame that is already packed.
+void gesture_process_frame(gesture_ctx* ctx, const touch_frame* frame);
+
+// Several recognizers on one device, e.g. a three-finger swipe, a
+// four-finger swipe and a four-finger pinch. Each frame is packed and
+// aggregated once and the same means are handed to every recognizer.
+//
+// Only one recognizer fires per touch sequence. When several fire on the
+// same frame the earliest in the list wins; the winner then owns the
+// device, and the others are reset and skipped, until it is idle again
+// (its fingers lifted). A swipe that owns the device can still fire again
+// by reversing. armed callbacks pass through as they happen; fired ones
+// only for the winner. Callbacks get the recognizer's context, whose
+// userdata is the set.
+#define GESTURE_MAX_RECOGNIZERS 4
+
+typedef struct {
+	gesture_params params[GESTURE_MAX_RECOGNIZERS];
+	int count;
+} gesture_recognizers;
+
+typedef struct {
+	touch_aggregates agg;
+	gesture_ctx recognizers[GESTURE_MAX_RECOGNIZERS];
+	int count;
+	int owner; // recognizer that fired, until it is idle again; -1 when none
+	bool resync; // recognizers skipped while owned measure afresh
+	int fired[GESTURE_MAX_RECOGNIZERS]; // directions fired this frame
+	gesture_callbacks callbacks;
+	void* userdata;
+} gesture_set;
+
+void gesture_set_init(gesture_set* set, const gesture_recognizers* recognizers, gesture_callbacks callbacks, void* userdata);
+
+// Replaces the recognizers; all of them start over idle.
+void gesture_set_configure(gesture_set* set, const gesture_recognizers* recognizers);
+
+void gesture_set_process(gesture_set* set, const touch* touches, int count);
+void gesture_set_process_frame(gesture_set* set, const touch_frame* frame);
+
+// The finger counts any recognizer wants, for gesture_filter_pass.
+unsigned gesture_set_fingers(const gesture_set* set);
+unsigned gesture_recognizers_fingers(const gesture_recognizers* recognizers);
+
+// The owner's state, else the furthest along of the recognizers'.
+gesture_state gesture_set_state(const gesture_set* set);
+
+static inline gesture_set* gesture_set_of(const gesture_ctx* ctx)
+{
+	return (gesture_set*)ctx->userdata;
+}
+
+static inline int gesture_set_index(const gesture_set* set, const gesture_ctx* ctx)
+{
+	return (int)(ctx - set->recognizers);
+}
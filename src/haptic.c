@@ -5,6 +5,8 @@
 #include <mach/mach_error.h>
 #include <stdio.h>
 
+#include "log.h"
+
 #define CF_RELEASE(obj)      \
 	do {                     \
 		if ((obj) != NULL) { \
@@ -113,7 +115,7 @@ bool haptic_actuate(CFTypeRef act, int32_t pattern)
 {
 	IOReturn kr = _actuate(act, pattern);
 	if (kr != kIOReturnSuccess) {
-		fprintf(stderr, "haptic_actuate: 0x%04x (%s)\n", kr, mach_error_string(kr));
+		log_error("haptic_actuate: 0x%04x (%s)", kr, mach_error_string(kr));
 		return false;
 	}
 	return true;
@@ -128,6 +130,47 @@ void haptic_actuate_all(CFArrayRef arr, int32_t pattern)
 		_actuate(CFArrayGetValueAtIndex(arr, i), pattern);
 }
 
+static bool mt_backend_actuate(void* ctx, int32_t pattern)
+{
+	return haptic_actuate((CFTypeRef)ctx, pattern);
+}
+
+static void mt_backend_close(void* ctx)
+{
+	haptic_close((CFTypeRef)ctx);
+}
+
+haptic_backend haptic_backend_mt(CFTypeRef act)
+{
+	haptic_backend backend = {
+		.ctx = (void*)act,
+		.actuate = mt_backend_actuate,
+		.close = mt_backend_close,
+	};
+	return backend;
+}
+
+static bool mt_all_backend_actuate(void* ctx, int32_t pattern)
+{
+	haptic_actuate_all((CFArrayRef)ctx, pattern);
+	return true;
+}
+
+static void mt_all_backend_close(void* ctx)
+{
+	haptic_close_all((CFArrayRef)ctx);
+}
+
+haptic_backend haptic_backend_mt_all(CFArrayRef arr)
+{
+	haptic_backend backend = {
+		.ctx = (void*)arr,
+		.actuate = mt_all_backend_actuate,
+		.close = mt_all_backend_close,
+	};
+	return backend;
+}
+
 void haptic_close(CFTypeRef act)
 {
 	if (act && MTActuatorIsOpen(act))
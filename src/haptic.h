@@ -1,5 +1,6 @@
 #define HAPTIC_H
 
+#include "haptic_worker.h"
 #include <IOKit/IOKitLib.h>
 
 extern CFTypeRef MTActuatorCreateFromDeviceID(UInt64 deviceID);
@@ -17,5 +18,12 @@ CFMutableArrayRef haptic_open_all(void);
 bool haptic_actuate(CFTypeRef actuator, int32_t pattern);
 void haptic_actuate_all(CFArrayRef actuators, int32_t pattern);
 
+// Worker backend that owns `actuator` and closes it with the worker.
+haptic_backend haptic_backend_mt(CFTypeRef actuator);
+
+// Same for every actuator in `actuators` (see haptic_open_all): a pulse is
+// played on all of them.
+haptic_backend haptic_backend_mt_all(CFArrayRef actuators);
+
 void haptic_close(CFTypeRef actuator);
 void haptic_close_all(CFArrayRef actuators);
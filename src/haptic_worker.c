@@ -0,0 +1,272 @@
+#include "haptic_worker.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracer.h"
+
+#define HAPTIC_QUEUE_SIZE 16 // power of two
+#define HAPTIC_COALESCE_NS (30ull * 1000 * 1000) // one pulse already covers ~30ms
+
+typedef struct {
+	atomic_size_t seq;
+	int32_t pattern;
+	uint64_t enqueued_ns;
+} haptic_cell;
+
+struct haptic_worker {
+	haptic_backend backend;
+	pthread_t thread;
+	pthread_mutex_t lock; // only for sleeping, never held while queueing
+	pthread_cond_t wake;
+	atomic_bool sleeping;
+	atomic_bool running;
+
+	haptic_cell cells[HAPTIC_QUEUE_SIZE];
+	atomic_size_t head; // next cell to produce
+	size_t tail; // next cell to consume, worker only
+
+	atomic_ullong submitted, actuated, coalesced, dropped;
+	atomic_uint_fast64_t last_queue_ns, max_queue_ns, total_queue_ns;
+};
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Bounded multi-producer queue: each cell's sequence number tells producers
+// when it is free and the consumer when it is filled.
+static bool queue_push(haptic_worker* w, int32_t pattern, uint64_t now)
+{
+	size_t pos = atomic_load_explicit(&w->head, memory_order_relaxed);
+	for (;;) {
+		haptic_cell* cell = &w->cells[pos & (HAPTIC_QUEUE_SIZE - 1)];
+		size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&w->head, &pos, pos + 1,
+					memory_order_relaxed, memory_order_relaxed)) {
+				cell->pattern = pattern;
+				cell->enqueued_ns = now;
+				atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = atomic_load_explicit(&w->head, memory_order_relaxed);
+		}
+	}
+}
+
+static bool queue_pop(haptic_worker* w, int32_t* pattern, uint64_t* enqueued_ns)
+{
+	haptic_cell* cell = &w->cells[w->tail & (HAPTIC_QUEUE_SIZE - 1)];
+	size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+	if ((intptr_t)seq - (intptr_t)(w->tail + 1) < 0)
+		return false;
+
+	*pattern = cell->pattern;
+	*enqueued_ns = cell->enqueued_ns;
+	atomic_store_explicit(&cell->seq, w->tail + HAPTIC_QUEUE_SIZE, memory_order_release);
+	w->tail++;
+	return true;
+}
+
+static bool queue_empty(haptic_worker* w)
+{
+	haptic_cell* cell = &w->cells[w->tail & (HAPTIC_QUEUE_SIZE - 1)];
+	return (intptr_t)atomic_load(&cell->seq) - (intptr_t)(w->tail + 1) < 0;
+}
+
+static void record_latency(haptic_worker* w, uint64_t queued)
+{
+	atomic_store_explicit(&w->last_queue_ns, queued, memory_order_relaxed);
+	atomic_fetch_add_explicit(&w->total_queue_ns, queued, memory_order_relaxed);
+
+	uint64_t max = atomic_load_explicit(&w->max_queue_ns, memory_order_relaxed);
+	while (queued > max && !atomic_compare_exchange_weak_explicit(&w->max_queue_ns, &max, queued,
+							   memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+static void* haptic_worker_main(void* arg)
+{
+	haptic_worker* w = arg;
+	int32_t last_pattern = -1;
+	uint64_t last_fire_ns = 0;
+	tracer_thread_name("haptic");
+
+	while (atomic_load(&w->running) || !queue_empty(w)) {
+		int32_t pattern;
+		uint64_t enqueued_ns;
+
+		if (!queue_pop(w, &pattern, &enqueued_ns)) {
+			pthread_mutex_lock(&w->lock);
+			atomic_store(&w->sleeping, true);
+			// pairs with the fence in haptic_worker_submit: either this
+			// sees its pulse or it sees sleeping and signals
+			atomic_thread_fence(memory_order_seq_cst);
+			if (queue_empty(w) && atomic_load(&w->running))
+				pthread_cond_wait(&w->wake, &w->lock);
+			atomic_store(&w->sleeping, false);
+			pthread_mutex_unlock(&w->lock);
+			continue;
+		}
+
+		uint64_t now = monotonic_ns();
+		record_latency(w, now - enqueued_ns);
+		tracer_span("haptic", "queued", enqueued_ns, "pattern", pattern);
+
+		// a burst of swipes should feel like a burst, not a buzz
+		if (pattern == last_pattern && enqueued_ns < last_fire_ns + HAPTIC_COALESCE_NS) {
+			atomic_fetch_add_explicit(&w->coalesced, 1, memory_order_relaxed);
+			tracer_instant("haptic", "coalesced", "pattern", pattern);
+			continue;
+		}
+
+		uint64_t start = tracer_begin();
+		if (w->backend.actuate(w->backend.ctx, pattern))
+			atomic_fetch_add_explicit(&w->actuated, 1, memory_order_relaxed);
+		tracer_end("haptic", "actuate", start, "pattern", pattern);
+		last_pattern = pattern;
+		last_fire_ns = monotonic_ns();
+	}
+
+	return NULL;
+}
+
+haptic_worker* haptic_worker_start(haptic_backend backend)
+{
+	if (!backend.actuate)
+		return NULL;
+
+	haptic_worker* w = calloc(1, sizeof(haptic_worker));
+	if (!w)
+		return NULL;
+
+	w->backend = backend;
+	for (size_t i = 0; i < HAPTIC_QUEUE_SIZE; i++)
+		atomic_init(&w->cells[i].seq, i);
+	atomic_init(&w->head, 0);
+	atomic_init(&w->sleeping, false);
+	atomic_init(&w->running, true);
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->wake, NULL);
+
+	if (pthread_create(&w->thread, NULL, haptic_worker_main, w) != 0) {
+		fprintf(stderr, "haptic_worker_start: failed to create thread\n");
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->wake);
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+bool haptic_worker_submit(haptic_worker* w, int32_t pattern)
+{
+	if (!w)
+		return false;
+
+	atomic_fetch_add_explicit(&w->submitted, 1, memory_order_relaxed);
+	if (!queue_push(w, pattern, monotonic_ns())) {
+		atomic_fetch_add_explicit(&w->dropped, 1, memory_order_relaxed);
+		return false;
+	}
+
+	// the push is only a release store; without the fence the load below
+	// could be ordered before it and miss a worker going to sleep
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&w->sleeping, memory_order_relaxed)) {
+		pthread_mutex_lock(&w->lock);
+		pthread_cond_signal(&w->wake);
+		pthread_mutex_unlock(&w->lock);
+	}
+	return true;
+}
+
+void haptic_worker_stats_get(haptic_worker* w, haptic_worker_stats* out)
+{
+	memset(out, 0, sizeof(*out));
+	if (!w)
+		return;
+
+	out->submitted = atomic_load(&w->submitted);
+	out->actuated = atomic_load(&w->actuated);
+	out->coalesced = atomic_load(&w->coalesced);
+	out->dropped = atomic_load(&w->dropped);
+	out->last_queue_ns = atomic_load(&w->last_queue_ns);
+	out->max_queue_ns = atomic_load(&w->max_queue_ns);
+	out->total_queue_ns = atomic_load(&w->total_queue_ns);
+}
+
+void haptic_worker_stop(haptic_worker* w)
+{
+	if (!w)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	atomic_store(&w->running, false);
+	pthread_cond_signal(&w->wake);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	if (w->backend.close)
+		w->backend.close(w->backend.ctx);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->wake);
+	free(w);
+}
+
+typedef struct {
+	uint32_t delay_us;
+	atomic_ullong count;
+} stub_actuator;
+
+static bool stub_actuate(void* ctx, int32_t pattern)
+{
+	(void)pattern;
+	stub_actuator* stub = ctx;
+	if (stub->delay_us)
+		usleep(stub->delay_us);
+	atomic_fetch_add_explicit(&stub->count, 1, memory_order_relaxed);
+	return true;
+}
+
+static void stub_close(void* ctx)
+{
+	free(ctx);
+}
+
+haptic_backend haptic_backend_stub(uint32_t actuate_delay_us)
+{
+	stub_actuator* stub = calloc(1, sizeof(stub_actuator));
+	haptic_backend backend = { 0 };
+	if (!stub)
+		return backend;
+
+	stub->delay_us = actuate_delay_us;
+	atomic_init(&stub->count, 0);
+	backend.ctx = stub;
+	backend.actuate = stub_actuate;
+	backend.close = stub_close;
+	return backend;
+}
+
+unsigned long long haptic_backend_stub_count(haptic_backend backend)
+{
+	if (backend.actuate != stub_actuate)
+		return 0;
+	return atomic_load(&((stub_actuator*)backend.ctx)->count);
+}
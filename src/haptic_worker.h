@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Anything that can produce a haptic pulse. The macOS backend wraps an
+// MTActuator (see haptic.h); the stub backend only counts, so queueing can be
+// exercised where no actuator exists.
+typedef struct {
+	void* ctx;
+	bool (*actuate)(void* ctx, int32_t pattern);
+	void (*close)(void* ctx);
+} haptic_backend;
+
+haptic_backend haptic_backend_stub(uint32_t actuate_delay_us);
+unsigned long long haptic_backend_stub_count(haptic_backend backend);
+
+typedef struct {
+	unsigned long long submitted;
+	unsigned long long actuated;
+	unsigned long long coalesced;
+	unsigned long long dropped;
+	uint64_t last_queue_ns;
+	uint64_t max_queue_ns;
+	uint64_t total_queue_ns;
+} haptic_worker_stats;
+
+typedef struct haptic_worker haptic_worker;
+
+haptic_worker* haptic_worker_start(haptic_backend backend);
+
+// Queues a pulse without blocking. Pulses that arrive in a burst collapse
+// into one; returns false only if the queue is full.
+bool haptic_worker_submit(haptic_worker* worker, int32_t pattern);
+
+void haptic_worker_stats_get(haptic_worker* worker, haptic_worker_stats* out);
+
+// Drains pending pulses, joins the thread and closes the backend.
+void haptic_worker_stop(haptic_worker* worker);
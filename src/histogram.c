@@ -0,0 +1,60 @@
+#include "histogram.h"
+
+#include <math.h>
+#include <string.h>
+
+static int bucket_of(uint64_t value)
+{
+	if (value < 4)
+		return (int)value;
+
+	int msb = 63 - __builtin_clzll(value);
+	if (msb > 31)
+		return HISTOGRAM_BUCKETS - 1;
+	int sub = (int)(value >> (msb - 2)) & 3;
+	return 4 + (msb - 2) * 4 + sub;
+}
+
+// midpoint of the values a bucket covers
+static uint64_t bucket_value(int bucket)
+{
+	if (bucket < 4)
+		return (uint64_t)bucket;
+
+	int msb = (bucket - 4) / 4 + 2;
+	int sub = (bucket - 4) % 4;
+	uint64_t width = 1ull << (msb - 2);
+	return ((uint64_t)(4 + sub) << (msb - 2)) + width / 2;
+}
+
+void histogram_record(histogram* h, uint64_t value)
+{
+	h->buckets[bucket_of(value)]++;
+	h->count++;
+	if (value > h->max)
+		h->max = value;
+}
+
+void histogram_reset(histogram* h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+uint64_t histogram_percentile(const histogram* h, double pct)
+{
+	if (h->count == 0)
+		return 0;
+
+	unsigned long long rank = (unsigned long long)ceil(pct * (double)h->count);
+	if (rank == 0)
+		rank = 1;
+	unsigned long long seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank) {
+			uint64_t value = bucket_value(i);
+			return value < h->max ? value : h->max;
+		}
+	}
+	return h->max;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+// Log-linear histogram for latencies in ns: four buckets per power of two,
+// so a percentile is within ~12% of the true value. Values at or above
+// 2^32 ns (~4.3s) share the last bucket. Not synchronized; callers that
+// record from several threads hold their own lock.
+
+#define HISTOGRAM_BUCKETS (4 + 30 * 4)
+
+typedef struct {
+	unsigned long long count;
+	uint64_t max;
+	unsigned long long buckets[HISTOGRAM_BUCKETS];
+} histogram;
+
+void histogram_record(histogram* h, uint64_t value);
+void histogram_reset(histogram* h);
+
+// pct in [0, 1]; returns 0 for an empty histogram.
+uint64_t histogram_percentile(const histogram* h, double pct);
@@ -0,0 +1,212 @@
+#include "i3ipc.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "yyjson.h"
+
+struct i3ipc {
+	ipc_conn conns[I3IPC_CONN_COUNT];
+	char* socket_path;
+};
+
+typedef struct {
+	uint32_t length;
+	uint32_t type;
+} i3ipc_header;
+
+i3ipc* i3ipc_new(const char* socket_path)
+{
+	if (!socket_path)
+		socket_path = getenv("SWAYSOCK");
+	if (!socket_path)
+		socket_path = getenv("I3SOCK");
+	if (!socket_path) {
+		fprintf(stderr, "i3ipc: no socket path and neither SWAYSOCK nor I3SOCK is set\n");
+		return NULL;
+	}
+
+	i3ipc* client = malloc(sizeof(i3ipc));
+	if (!client)
+		return NULL;
+
+	client->socket_path = strdup(socket_path);
+	for (int i = 0; i < I3IPC_CONN_COUNT; i++) {
+		if (!ipc_conn_open(&client->conns[i], client->socket_path))
+			fprintf(stderr, "i3ipc: failed to connect to %s: %s\n", client->socket_path, strerror(errno));
+	}
+
+	return client;
+}
+
+void i3ipc_close(i3ipc* client)
+{
+	if (!client)
+		return;
+	for (int i = 0; i < I3IPC_CONN_COUNT; i++)
+		ipc_conn_destroy(&client->conns[i]);
+	free(client->socket_path);
+	free(client);
+}
+
+static bool send_message(ipc_conn* conn, uint32_t type, const char* payload, size_t len)
+{
+	char header[I3IPC_HEADER_SIZE];
+	uint32_t length = (uint32_t)len;
+	memcpy(header, I3IPC_MAGIC, 6);
+	memcpy(header + 6, &length, sizeof(length));
+	memcpy(header + 10, &type, sizeof(type));
+
+	struct iovec iov[2] = {
+		{ .iov_base = header, .iov_len = sizeof(header) },
+		{ .iov_base = (void*)payload, .iov_len = len },
+	};
+	return ipc_conn_send(conn, iov, len ? 2 : 1);
+}
+
+// Waits until a whole message sits in the read buffer; the payload starts at
+// read_buf + I3IPC_HEADER_SIZE and is consumed by the caller.
+static bool read_message(ipc_conn* conn, i3ipc_header* out)
+{
+	for (;;) {
+		if (conn->read_buf_len >= I3IPC_HEADER_SIZE) {
+			if (memcmp(conn->read_buf, I3IPC_MAGIC, 6) != 0) {
+				log_error("i3ipc: bad magic, dropping connection");
+				ipc_conn_drop(conn);
+				return false;
+			}
+			memcpy(&out->length, conn->read_buf + 6, sizeof(out->length));
+			memcpy(&out->type, conn->read_buf + 10, sizeof(out->type));
+			if (out->length > IPC_READ_BUFFER_SIZE - I3IPC_HEADER_SIZE) {
+				log_error("i3ipc: %u byte message does not fit the read buffer", out->length);
+				ipc_conn_drop(conn);
+				return false;
+			}
+			if (conn->read_buf_len >= I3IPC_HEADER_SIZE + out->length)
+				return true;
+		}
+		if (ipc_conn_fill(conn) <= 0)
+			return false;
+	}
+}
+
+static bool request_locked(ipc_conn* conn, uint32_t type, const char* payload, size_t len, i3ipc_payload_fn on_reply, void* userdata)
+{
+	if (!send_message(conn, type, payload, len))
+		return false;
+
+	for (;;) {
+		i3ipc_header header;
+		if (!read_message(conn, &header))
+			return false;
+
+		// events can interleave with replies on a subscribed connection
+		bool is_reply = !(header.type & I3IPC_EVENT_MASK);
+		if (is_reply && on_reply)
+			on_reply(userdata, header.type, conn->read_buf + I3IPC_HEADER_SIZE, header.length);
+		ipc_conn_consume(conn, I3IPC_HEADER_SIZE + header.length);
+
+		if (is_reply)
+			return true;
+	}
+}
+
+bool i3ipc_request(i3ipc* client, i3ipc_conn_kind kind, uint32_t type, const char* payload, size_t len, i3ipc_payload_fn on_reply, void* userdata)
+{
+	if (!client || kind < 0 || kind >= I3IPC_CONN_COUNT)
+		return false;
+
+	ipc_conn* conn = &client->conns[kind];
+	pthread_mutex_lock(&conn->lock);
+	uint64_t start = ipc_monotonic_ns();
+	bool ok = request_locked(conn, type, payload, len, on_reply, userdata);
+	ipc_conn_record(conn, start, 1, !ok);
+	pthread_mutex_unlock(&conn->lock);
+	return ok;
+}
+
+static void check_command_reply(void* userdata, uint32_t type, const char* payload, size_t len)
+{
+	(void)type;
+	bool* success = userdata;
+
+	// RUN_COMMAND answers with one {"success": bool, ...} per command,
+	// SUBSCRIBE with a single object
+	yyjson_doc* doc = yyjson_read(payload, len, 0);
+	yyjson_val* root = yyjson_doc_get_root(doc);
+	if (yyjson_is_obj(root)) {
+		*success = yyjson_get_bool(yyjson_obj_get(root, "success"));
+		yyjson_doc_free(doc);
+		return;
+	}
+
+	size_t idx, max;
+	yyjson_val* item;
+	*success = yyjson_is_arr(root) && yyjson_arr_size(root) > 0;
+	yyjson_arr_foreach(root, idx, max, item)
+	{
+		if (!yyjson_get_bool(yyjson_obj_get(item, "success"))) {
+			yyjson_val* error = yyjson_obj_get(item, "error");
+			log_error("i3ipc: command failed: %s", yyjson_is_str(error) ? yyjson_get_str(error) : "unknown error");
+			*success = false;
+		}
+	}
+	yyjson_doc_free(doc);
+}
+
+bool i3ipc_command(i3ipc* client, const char* command)
+{
+	bool success = false;
+	if (!i3ipc_request(client, I3IPC_CONN_COMMAND, I3IPC_RUN_COMMAND, command, strlen(command), check_command_reply, &success))
+		return false;
+	return success;
+}
+
+int i3ipc_subscribe(i3ipc* client, const char* events, i3ipc_payload_fn on_event, void* userdata)
+{
+	if (!client)
+		return -1;
+
+	// the subscription owns the event connection from here on, so callers
+	// dedicate a thread to it
+	ipc_conn* conn = &client->conns[I3IPC_CONN_EVENTS];
+	pthread_mutex_lock(&conn->lock);
+
+	bool success = false;
+	if (!request_locked(conn, I3IPC_SUBSCRIBE, events, strlen(events), check_command_reply, &success) || !success) {
+		pthread_mutex_unlock(&conn->lock);
+		return -1;
+	}
+
+	for (;;) {
+		i3ipc_header header;
+		if (!read_message(conn, &header))
+			break;
+		if (header.type & I3IPC_EVENT_MASK)
+			on_event(userdata, header.type, conn->read_buf + I3IPC_HEADER_SIZE, header.length);
+		ipc_conn_consume(conn, I3IPC_HEADER_SIZE + header.length);
+	}
+
+	pthread_mutex_unlock(&conn->lock);
+	return 0;
+}
+
+void i3ipc_conn_stats_get(i3ipc* client, i3ipc_conn_kind kind, ipc_conn_stats* out)
+{
+	memset(out, 0, sizeof(*out));
+	if (client && kind >= 0 && kind < I3IPC_CONN_COUNT)
+		ipc_conn_stats_get(&client->conns[kind], out);
+}
+
+// the event connection stays locked while a subscription runs, so only the
+// request connections are reset
+void i3ipc_conn_stats_reset(i3ipc* client)
+{
+	if (!client)
+		return;
+	ipc_conn_stats_reset(&client->conns[I3IPC_CONN_COMMAND]);
+	ipc_conn_stats_reset(&client->conns[I3IPC_CONN_QUERY]);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ipc.h"
+
+// Client for the i3/sway binary IPC protocol: "i3-ipc", a native-endian
+// uint32 payload length and message type, then the JSON payload.
+
+#define I3IPC_MAGIC "i3-ipc"
+#define I3IPC_HEADER_SIZE 14
+
+#define I3IPC_RUN_COMMAND 0
+#define I3IPC_GET_WORKSPACES 1
+#define I3IPC_SUBSCRIBE 2
+#define I3IPC_EVENT_MASK 0x80000000u
+#define I3IPC_EVENT_WORKSPACE (I3IPC_EVENT_MASK | 0)
+
+typedef enum {
+	I3IPC_CONN_COMMAND,
+	I3IPC_CONN_QUERY,
+	I3IPC_CONN_EVENTS, // owned by i3ipc_subscribe while it runs
+	I3IPC_CONN_COUNT
+} i3ipc_conn_kind;
+
+typedef struct i3ipc i3ipc;
+
+// Called with the payload still inside the connection's read buffer; it is
+// neither copied nor NUL-terminated and is only valid during the call.
+typedef void (*i3ipc_payload_fn)(void* userdata, uint32_t type, const char* payload, size_t len);
+
+// socket_path may be NULL to use $SWAYSOCK or $I3SOCK.
+i3ipc* i3ipc_new(const char* socket_path);
+void i3ipc_close(i3ipc* client);
+
+// Sends one message and hands the reply to on_reply. Returns false on
+// transport errors.
+bool i3ipc_request(i3ipc* client, i3ipc_conn_kind kind, uint32_t type, const char* payload, size_t len, i3ipc_payload_fn on_reply, void* userdata);
+
+// Runs a command such as "workspace next_on_output"; false if the transport
+// failed or i3 reported the command unsuccessful.
+bool i3ipc_command(i3ipc* client, const char* command);
+
+// Subscribes the event connection to `events` (a JSON array such as
+// ["workspace"]) and delivers events until the connection closes.
+int i3ipc_subscribe(i3ipc* client, const char* events, i3ipc_payload_fn on_event, void* userdata);
+
+// Do not ask for I3IPC_CONN_EVENTS while a subscription runs; it holds the
+// connection until the stream ends.
+void i3ipc_conn_stats_get(i3ipc* client, i3ipc_conn_kind kind, ipc_conn_stats* out);
+void i3ipc_conn_stats_reset(i3ipc* client);
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+
+#include "gesture.h"
+
+// Receives one frame of touches from `device`; the array is only valid for
+// the duration of the call.
+typedef void (*input_frame_fn)(void* userdata, uint64_t device, const touch* touches, int count);
+
+// A source of touch frames. The macOS event tap pushes frames from the main
+// run loop (see event_tap.m); pull-based sources implement this interface.
+typedef struct input_backend input_backend;
+struct input_backend {
+	const char* name;
+	void* impl;
+	// Delivers frames until the source ends or stop() is called. Returns 0 on
+	// a clean end, -1 on error.
+	int (*run)(input_backend* backend, input_frame_fn on_frame, void* userdata);
+	void (*stop)(input_backend* backend);
+	// Makes run() call on_frame once with device 0 and no touches, from the
+	// thread in run(), even while no pad is sending anything.
+	void (*wake)(input_backend* backend);
+	void (*close)(input_backend* backend);
+};
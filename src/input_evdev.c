@@ -0,0 +1,441 @@
+#include "input_evdev.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "tracer.h"
+
+#define EVDEV_MAX_DEVICES 4
+#define EVDEV_WAKE (EVDEV_MAX_DEVICES + 1) // epoll tag; EVDEV_MAX_DEVICES is stop
+#define EVDEV_READ_BATCH 64
+
+typedef struct {
+	int fds[EVDEV_MAX_DEVICES];
+	evdev_decoder decoders[EVDEV_MAX_DEVICES];
+	int count;
+	int stop_fd;
+	int wake_fd;
+} evdev_source;
+
+static double normalize(int32_t raw, evdev_axis axis)
+{
+	if (axis.max <= axis.min)
+		return 0.0;
+	return (double)(raw - axis.min) / (double)(axis.max - axis.min);
+}
+
+static void reset_slot(evdev_slot* slot)
+{
+	memset(slot, 0, sizeof(*slot));
+	slot->tracking_id = -1;
+}
+
+void evdev_decoder_init(evdev_decoder* dec, uint64_t device, evdev_axis x, evdev_axis y)
+{
+	memset(dec, 0, sizeof(*dec));
+	dec->device = device;
+	dec->x = x;
+	dec->y = y;
+	for (int i = 0; i < MAX_TOUCHES; i++)
+		reset_slot(&dec->slots[i]);
+}
+
+static void emit_frame(evdev_decoder* dec, double now, input_frame_fn on_frame, void* userdata)
+{
+	uint64_t start = tracer_begin();
+	int count = 0;
+
+	for (int i = 0; i < MAX_TOUCHES; i++) {
+		evdev_slot* slot = &dec->slots[i];
+		if (slot->tracking_id < 0 && !slot->ending)
+			continue;
+
+		if (slot->moved) {
+			slot->x = normalize(slot->raw_x, dec->x);
+			// evdev y grows downwards, NSTouch normalizedPosition upwards
+			slot->y = 1.0 - normalize(slot->raw_y, dec->y);
+		}
+
+		touch* t = &dec->frame[count++];
+		t->x = slot->x;
+		t->y = slot->y;
+		t->timestamp = now;
+		t->is_palm = false;
+		t->id = i; // a slot holds one contact from down to up
+		t->velocity = 0.0;
+		t->velocity_y = 0.0;
+
+		if (slot->ending) {
+			t->phase = TOUCH_PHASE_ENDED;
+		} else if (slot->began) {
+			t->phase = TOUCH_PHASE_BEGAN;
+		} else {
+			t->phase = slot->moved ? TOUCH_PHASE_MOVED : TOUCH_PHASE_STATIONARY;
+			double dt = now - slot->last_time;
+			if (dt > 0) {
+				t->velocity = (slot->x - slot->last_x) / dt;
+				t->velocity_y = (slot->y - slot->last_y) / dt;
+			}
+		}
+
+		slot->last_x = slot->x;
+		slot->last_y = slot->y;
+		slot->last_time = now;
+		slot->moved = false;
+		slot->began = false;
+		if (slot->ending)
+			reset_slot(slot);
+	}
+
+	tracer_end("input", "convert", start, "touches", count);
+	on_frame(userdata, dec->device, dec->frame, count);
+}
+
+void evdev_decoder_sync(evdev_decoder* dec, const evdev_snapshot* snap)
+{
+	// without a snapshot the current slot is the best guess there is
+	if (snap)
+		dec->slot = snap->slot >= 0 && snap->slot < MAX_TOUCHES ? snap->slot : -1;
+	for (int i = 0; i < MAX_TOUCHES; i++) {
+		evdev_slot* slot = &dec->slots[i];
+		int32_t id = snap ? snap->tracking_id[i] : -1;
+		if (id < 0) {
+			if (slot->tracking_id >= 0)
+				slot->ending = true;
+			continue;
+		}
+		if (slot->tracking_id != id) {
+			reset_slot(slot);
+			slot->tracking_id = id;
+			slot->began = true;
+		}
+		slot->raw_x = snap->x[i];
+		slot->raw_y = snap->y[i];
+		slot->moved = true;
+	}
+}
+
+void evdev_decoder_feed(evdev_decoder* dec, const struct input_event* ev, input_frame_fn on_frame, void* userdata)
+{
+	if (ev->type == EV_SYN) {
+		if (ev->code == SYN_DROPPED) {
+			// the kernel lost events and slot state is unreliable until the
+			// device is asked for it at the next SYN_REPORT
+			dec->dropped = true;
+		} else if (ev->code == SYN_REPORT) {
+			if (dec->dropped) {
+				dec->dropped = false;
+				evdev_snapshot snap;
+				bool synced = dec->sync && dec->sync(dec->sync_userdata, &snap);
+				evdev_decoder_sync(dec, synced ? &snap : NULL);
+			}
+			emit_frame(dec, ev->input_event_sec + ev->input_event_usec / 1e6, on_frame, userdata);
+		}
+		return;
+	}
+
+	if (ev->type != EV_ABS || dec->dropped)
+		return;
+
+	if (ev->code == ABS_MT_SLOT) {
+		dec->slot = ev->value >= 0 && ev->value < MAX_TOUCHES ? ev->value : -1;
+		return;
+	}
+	// a contact in a slot past MAX_TOUCHES is not followed
+	if (dec->slot < 0)
+		return;
+
+	evdev_slot* slot = &dec->slots[dec->slot];
+	switch (ev->code) {
+	case ABS_MT_TRACKING_ID:
+		if (ev->value < 0) {
+			if (slot->tracking_id >= 0)
+				slot->ending = true;
+		} else {
+			reset_slot(slot);
+			slot->tracking_id = ev->value;
+			slot->began = true;
+			slot->moved = true;
+		}
+		break;
+	case ABS_MT_POSITION_X:
+		slot->raw_x = ev->value;
+		slot->moved = true;
+		break;
+	case ABS_MT_POSITION_Y:
+		slot->raw_y = ev->value;
+		slot->moved = true;
+		break;
+	default:
+		break;
+	}
+}
+
+static int drain_fd(int fd, evdev_decoder* dec, input_frame_fn on_frame, void* userdata)
+{
+	struct input_event events[EVDEV_READ_BATCH];
+
+	for (;;) {
+		ssize_t n = read(fd, events, sizeof(events));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN ? 1 : -1;
+		}
+		if (n == 0)
+			return 0;
+
+		for (size_t i = 0; i < (size_t)n / sizeof(struct input_event); i++)
+			evdev_decoder_feed(dec, &events[i], on_frame, userdata);
+	}
+}
+
+static int evdev_run(input_backend* backend, input_frame_fn on_frame, void* userdata)
+{
+	evdev_source* src = backend->impl;
+	tracer_thread_name("input");
+
+	int ep = epoll_create1(EPOLL_CLOEXEC);
+	if (ep < 0)
+		return -1;
+
+	struct epoll_event ev = { .events = EPOLLIN, .data.u32 = EVDEV_MAX_DEVICES };
+	epoll_ctl(ep, EPOLL_CTL_ADD, src->stop_fd, &ev);
+	ev.data.u32 = EVDEV_WAKE;
+	epoll_ctl(ep, EPOLL_CTL_ADD, src->wake_fd, &ev);
+
+	int watched = 0;
+	for (int i = 0; i < src->count; i++) {
+		ev.data.u32 = i;
+		if (epoll_ctl(ep, EPOLL_CTL_ADD, src->fds[i], &ev) == 0) {
+			watched++;
+		} else if (errno == EPERM) {
+			// regular files (captures) cannot be polled; they are always readable
+			int rc = drain_fd(src->fds[i], &src->decoders[i], on_frame, userdata);
+			if (rc < 0) {
+				close(ep);
+				return -1;
+			}
+		}
+	}
+
+	int result = 0;
+	while (watched > 0) {
+		struct epoll_event ready[EVDEV_MAX_DEVICES + 2];
+		int n = epoll_wait(ep, ready, EVDEV_MAX_DEVICES + 2, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			result = -1;
+			break;
+		}
+
+		bool stop = false;
+		for (int i = 0; i < n; i++) {
+			uint32_t idx = ready[i].data.u32;
+			if (idx == EVDEV_MAX_DEVICES) {
+				stop = true;
+				continue;
+			}
+			if (idx == EVDEV_WAKE) {
+				uint64_t count;
+				if (read(src->wake_fd, &count, sizeof(count)) > 0)
+					on_frame(userdata, 0, NULL, 0);
+				continue;
+			}
+			if (drain_fd(src->fds[idx], &src->decoders[idx], on_frame, userdata) <= 0) {
+				epoll_ctl(ep, EPOLL_CTL_DEL, src->fds[idx], NULL);
+				watched--;
+			}
+		}
+		if (stop)
+			break;
+	}
+
+	close(ep);
+	return result;
+}
+
+static void evdev_stop(input_backend* backend)
+{
+	evdev_source* src = backend->impl;
+	uint64_t one = 1;
+	if (write(src->stop_fd, &one, sizeof(one)) < 0)
+		perror("evdev_stop");
+}
+
+static void evdev_wake(input_backend* backend)
+{
+	evdev_source* src = backend->impl;
+	uint64_t one = 1;
+	if (write(src->wake_fd, &one, sizeof(one)) < 0)
+		perror("evdev_wake");
+}
+
+static void evdev_close(input_backend* backend)
+{
+	evdev_source* src = backend->impl;
+	for (int i = 0; i < src->count; i++)
+		close(src->fds[i]);
+	close(src->stop_fd);
+	close(src->wake_fd);
+	free(src);
+	free(backend);
+}
+
+static input_backend* evdev_backend_new(evdev_source* src)
+{
+	src->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	src->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	input_backend* backend = calloc(1, sizeof(input_backend));
+	if (src->stop_fd < 0 || src->wake_fd < 0 || !backend) {
+		free(backend);
+		for (int i = 0; i < src->count; i++)
+			close(src->fds[i]);
+		if (src->stop_fd >= 0)
+			close(src->stop_fd);
+		if (src->wake_fd >= 0)
+			close(src->wake_fd);
+		free(src);
+		return NULL;
+	}
+
+	backend->name = "evdev";
+	backend->impl = src;
+	backend->run = evdev_run;
+	backend->stop = evdev_stop;
+	backend->wake = evdev_wake;
+	backend->close = evdev_close;
+	return backend;
+}
+
+static bool read_axis(int fd, int code, evdev_axis* axis)
+{
+	struct input_absinfo info;
+	if (ioctl(fd, EVIOCGABS(code), &info) < 0)
+		return false;
+	axis->min = info.minimum;
+	axis->max = info.maximum;
+	return axis->max > axis->min;
+}
+
+// evdev_sync_fn over the device's fd. Regular files (captures) fail it.
+static bool read_snapshot(void* userdata, evdev_snapshot* out)
+{
+	int fd = (int)(intptr_t)userdata;
+	static const int codes[] = { ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y };
+	int32_t* values[] = { out->tracking_id, out->x, out->y };
+	for (int i = 0; i < 3; i++) {
+		struct {
+			uint32_t code;
+			int32_t values[MAX_TOUCHES];
+		} req;
+		req.code = codes[i];
+		// a pad with fewer slots leaves the rest free
+		memset(req.values, 0xff, sizeof(req.values));
+		if (ioctl(fd, EVIOCGMTSLOTS(sizeof(req)), &req) < 0)
+			return false;
+		memcpy(values[i], req.values, sizeof(req.values));
+	}
+
+	struct input_absinfo info;
+	if (ioctl(fd, EVIOCGABS(ABS_MT_SLOT), &info) < 0)
+		return false;
+	out->slot = info.value;
+	return true;
+}
+
+static void attach_sync(evdev_decoder* dec, int fd)
+{
+	dec->sync = read_snapshot;
+	dec->sync_userdata = (void*)(intptr_t)fd;
+}
+
+#define BIT_SET(bits, bit) ((bits)[(bit) / 8] & (1u << ((bit) % 8)))
+
+int input_evdev_scan(char paths[][EVDEV_PATH_MAX], int max)
+{
+	int found = 0;
+	for (int i = 0; i < 64 && found < max; i++) {
+		char path[EVDEV_PATH_MAX];
+		snprintf(path, sizeof(path), "/dev/input/event%d", i);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		// touchscreens carry the same axes but are direct, not pointer, devices
+		uint8_t props[INPUT_PROP_CNT / 8] = { 0 };
+		evdev_axis x;
+		if (ioctl(fd, EVIOCGPROP(sizeof(props)), props) >= 0 && BIT_SET(props, INPUT_PROP_POINTER)
+			&& read_axis(fd, ABS_MT_POSITION_X, &x))
+			snprintf(paths[found++], EVDEV_PATH_MAX, "%s", path);
+		close(fd);
+	}
+	return found;
+}
+
+input_backend* input_evdev_open(const char* const* paths, int count)
+{
+	evdev_source* src = calloc(1, sizeof(evdev_source));
+	if (!src)
+		return NULL;
+
+	for (int i = 0; i < count && src->count < EVDEV_MAX_DEVICES; i++) {
+		int fd = open(paths[i], O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) {
+			fprintf(stderr, "evdev: cannot open %s: %s\n", paths[i], strerror(errno));
+			continue;
+		}
+
+		evdev_axis x, y;
+		if (!read_axis(fd, ABS_MT_POSITION_X, &x) || !read_axis(fd, ABS_MT_POSITION_Y, &y)) {
+			fprintf(stderr, "evdev: %s is not a multitouch device\n", paths[i]);
+			close(fd);
+			continue;
+		}
+
+		evdev_decoder* dec = &src->decoders[src->count];
+		evdev_decoder_init(dec, src->count + 1, x, y);
+		attach_sync(dec, fd);
+		// fingers already on the pad begin with the first frame
+		evdev_snapshot snap;
+		if (read_snapshot(dec->sync_userdata, &snap))
+			evdev_decoder_sync(dec, &snap);
+		src->fds[src->count++] = fd;
+	}
+
+	if (src->count == 0) {
+		free(src);
+		return NULL;
+	}
+	return evdev_backend_new(src);
+}
+
+input_backend* input_evdev_replay(const char* path, evdev_axis x, evdev_axis y)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "evdev: cannot open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	evdev_source* src = calloc(1, sizeof(evdev_source));
+	if (!src) {
+		close(fd);
+		return NULL;
+	}
+
+	evdev_decoder_init(&src->decoders[0], 1, x, y);
+	attach_sync(&src->decoders[0], fd);
+	src->fds[0] = fd;
+	src->count = 1;
+	return evdev_backend_new(src);
+}
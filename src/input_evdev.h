@@ -0,0 +1,77 @@
+#pragma once
+#include <linux/input.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "input.h"
+
+// NSTouchPhase values, so evdev frames look like the ones from the event tap.
+#define TOUCH_PHASE_BEGAN 1
+#define TOUCH_PHASE_MOVED 2
+#define TOUCH_PHASE_STATIONARY 4
+#define TOUCH_PHASE_ENDED END_PHASE
+
+typedef struct {
+	int32_t min;
+	int32_t max;
+} evdev_axis;
+
+typedef struct {
+	int32_t tracking_id; // -1 when the slot is free
+	int32_t raw_x, raw_y;
+	double x, y;
+	double last_x, last_y, last_time;
+	bool began;
+	bool moved;
+	bool ending;
+} evdev_slot;
+
+// The device's multitouch state as EVIOCGMTSLOTS and EVIOCGABS(ABS_MT_SLOT)
+// report it.
+typedef struct {
+	int slot;
+	int32_t tracking_id[MAX_TOUCHES];
+	int32_t x[MAX_TOUCHES], y[MAX_TOUCHES];
+} evdev_snapshot;
+
+// Fills a snapshot of the device; false if it cannot be read.
+typedef bool (*evdev_sync_fn)(void* userdata, evdev_snapshot* out);
+
+// Turns a multitouch protocol B event stream into touch frames. Pure state
+// machine: it never touches a file descriptor, so captured streams can be fed
+// straight into it. After SYN_DROPPED it asks sync for the device's state
+// at the next SYN_REPORT; without it, every contact ends.
+typedef struct {
+	uint64_t device;
+	evdev_axis x, y;
+	int slot; // -1 after an ABS_MT_SLOT out of range, until a valid one
+	bool dropped; // SYN_DROPPED seen, discard until the next SYN_REPORT
+	evdev_sync_fn sync; // may be NULL
+	void* sync_userdata;
+	evdev_slot slots[MAX_TOUCHES];
+	touch frame[MAX_TOUCHES];
+} evdev_decoder;
+
+void evdev_decoder_init(evdev_decoder* dec, uint64_t device, evdev_axis x, evdev_axis y);
+void evdev_decoder_feed(evdev_decoder* dec, const struct input_event* ev, input_frame_fn on_frame, void* userdata);
+
+// Brings the slots in line with snap, taking effect with the next frame:
+// contacts that are gone end, new ones begin and the rest move to where
+// snap has them. NULL ends every contact.
+void evdev_decoder_sync(evdev_decoder* dec, const evdev_snapshot* snap);
+
+#define EVDEV_PATH_MAX 32
+
+// Finds touchpads under /dev/input (pointer devices with multitouch axes).
+// Returns how many paths were written, at most max.
+int input_evdev_scan(char paths[][EVDEV_PATH_MAX], int max);
+
+// Reads live touchpads (e.g. /dev/input/event5) through an epoll loop. Pad
+// size comes from EVIOCGABS, and fingers already down when it opens are
+// picked up from EVIOCGMTSLOTS.
+input_backend* input_evdev_open(const char* const* paths, int count);
+
+// Replays a file of raw struct input_event records, as captured from a
+// device node; x and y give the pad's axis ranges at capture time. There is
+// no device to re-sync from, so SYN_DROPPED ends every contact.
+input_backend* input_evdev_replay(const char* path, evdev_axis x, evdev_axis y);
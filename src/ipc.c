@@ -0,0 +1,201 @@
+#include "ipc.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "tracer.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static const char* ERROR_SOCKET_RECEIVE = "Failed to receive data from socket";
+static const char* ERROR_SOCKET_CLOSE = "Failed to close socket connection";
+
+uint64_t ipc_monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int ipc_connect(const char* path)
+{
+	errno = 0;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(struct sockaddr_un));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
+
+	errno = 0;
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		int connect_errno = errno;
+		close(fd);
+		errno = connect_errno;
+		return -1;
+	}
+
+	return fd;
+}
+
+bool ipc_conn_open(ipc_conn* conn, const char* path)
+{
+	memset(&conn->stats, 0, sizeof(conn->stats));
+	pthread_mutex_init(&conn->lock, NULL);
+	conn->path = path;
+	conn->read_buf_len = 0;
+	conn->fd = ipc_connect(path);
+	return conn->fd >= 0;
+}
+
+void ipc_conn_destroy(ipc_conn* conn)
+{
+	ipc_conn_drop(conn);
+	pthread_mutex_destroy(&conn->lock);
+}
+
+void ipc_conn_drop(ipc_conn* conn)
+{
+	if (conn->fd >= 0) {
+		errno = 0;
+		if (close(conn->fd) < 0)
+			log_error("%s: %s (errno %d)", ERROR_SOCKET_CLOSE, strerror(errno), errno);
+		conn->fd = -1;
+	}
+	conn->read_buf_len = 0;
+}
+
+bool ipc_conn_reconnect(ipc_conn* conn)
+{
+	ipc_conn_drop(conn);
+	conn->fd = ipc_connect(conn->path);
+	if (conn->fd < 0) {
+		log_error("Failed to reconnect to %s: %s (errno %d)", conn->path, strerror(errno), errno);
+		return false;
+	}
+	conn->stats.reconnects++;
+	return true;
+}
+
+static bool write_all(int fd, struct iovec* iov, int iovcnt, size_t* written)
+{
+	*written = 0;
+	while (iovcnt > 0) {
+		int chunk = iovcnt < IOV_MAX ? iovcnt : IOV_MAX;
+		ssize_t n = writev(fd, iov, chunk);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		*written += n;
+
+		while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char*)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return true;
+}
+
+static bool send_request(ipc_conn* conn, struct iovec* iov, int iovcnt)
+{
+	size_t written = 0;
+	if (conn->fd >= 0 && write_all(conn->fd, iov, iovcnt, &written))
+		return true;
+
+	// nothing reached the server, so it is safe to retry once on a fresh socket
+	if (written == 0 && ipc_conn_reconnect(conn) && write_all(conn->fd, iov, iovcnt, &written))
+		return true;
+
+	perror("writev failed");
+	ipc_conn_drop(conn);
+	return false;
+}
+
+bool ipc_conn_send(ipc_conn* conn, struct iovec* iov, int iovcnt)
+{
+	uint64_t start = tracer_begin();
+	bool ok = send_request(conn, iov, iovcnt);
+	tracer_end("ipc", "request", start, "ok", ok);
+	return ok;
+}
+
+ssize_t ipc_conn_fill(ipc_conn* conn)
+{
+	if (conn->read_buf_len >= IPC_READ_BUFFER_SIZE) {
+		log_error("Error: Read buffer overflow, clearing buffer.");
+		ipc_conn_drop(conn);
+		return -1;
+	}
+
+	ssize_t bytes_read;
+	do {
+		bytes_read = read(conn->fd, conn->read_buf + conn->read_buf_len, IPC_READ_BUFFER_SIZE - conn->read_buf_len);
+	} while (bytes_read < 0 && errno == EINTR);
+
+	if (bytes_read <= 0) {
+		log_error("%s", ERROR_SOCKET_RECEIVE);
+		// the stream position is unknown now; reconnect on the next request
+		ipc_conn_drop(conn);
+		return bytes_read;
+	}
+
+	conn->read_buf_len += bytes_read;
+	return bytes_read;
+}
+
+void ipc_conn_consume(ipc_conn* conn, size_t n)
+{
+	if (n >= conn->read_buf_len) {
+		conn->read_buf_len = 0;
+		return;
+	}
+	memmove(conn->read_buf, conn->read_buf + n, conn->read_buf_len - n);
+	conn->read_buf_len -= n;
+}
+
+void ipc_conn_record(ipc_conn* conn, uint64_t start_ns, int requests, int errors)
+{
+	uint64_t elapsed = ipc_monotonic_ns() - start_ns;
+
+	conn->stats.requests += requests;
+	conn->stats.errors += errors;
+	conn->stats.last_ns = elapsed;
+	conn->stats.total_ns += elapsed;
+	if (elapsed > conn->stats.max_ns)
+		conn->stats.max_ns = elapsed;
+	histogram_record(&conn->stats.latency, elapsed);
+	tracer_span("ipc", "round_trip", start_ns, "requests", requests);
+}
+
+void ipc_conn_stats_get(ipc_conn* conn, ipc_conn_stats* out)
+{
+	pthread_mutex_lock(&conn->lock);
+	*out = conn->stats;
+	pthread_mutex_unlock(&conn->lock);
+}
+
+void ipc_conn_stats_reset(ipc_conn* conn)
+{
+	pthread_mutex_lock(&conn->lock);
+	memset(&conn->stats, 0, sizeof(conn->stats));
+	pthread_mutex_unlock(&conn->lock);
+}
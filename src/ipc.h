@@ -0,0 +1,63 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "histogram.h"
+
+// Shared plumbing for the window-manager clients: a Unix socket with its own
+// lock, an in-place read buffer that framing code parses without copying,
+// reconnect-on-failure and per-connection latency counters.
+
+#define IPC_READ_BUFFER_SIZE 65536
+
+typedef struct {
+	unsigned long long requests;
+	unsigned long long errors;
+	unsigned long long reconnects;
+	uint64_t last_ns;
+	uint64_t max_ns;
+	uint64_t total_ns;
+	histogram latency; // one sample per send/receive cycle
+} ipc_conn_stats;
+
+typedef struct {
+	int fd;
+	const char* path; // not owned
+	pthread_mutex_t lock;
+	char read_buf[IPC_READ_BUFFER_SIZE];
+	size_t read_buf_len;
+	ipc_conn_stats stats;
+} ipc_conn;
+
+uint64_t ipc_monotonic_ns(void);
+
+// Returns a connected socket or -1 with errno set.
+int ipc_connect(const char* path);
+
+// Initializes the connection and tries to connect; the connection is usable
+// (and reconnects lazily) even when this returns false.
+bool ipc_conn_open(ipc_conn* conn, const char* path);
+void ipc_conn_destroy(ipc_conn* conn);
+
+// The helpers below expect conn->lock to be held.
+void ipc_conn_drop(ipc_conn* conn);
+bool ipc_conn_reconnect(ipc_conn* conn);
+
+// Writes every iovec, retrying once on a fresh socket if nothing was sent.
+bool ipc_conn_send(ipc_conn* conn, struct iovec* iov, int iovcnt);
+
+// Appends whatever the socket has to read_buf. Returns the byte count, or
+// <= 0 after dropping the connection on EOF, error or a full buffer.
+ssize_t ipc_conn_fill(ipc_conn* conn);
+
+// Discards the first n bytes of read_buf once a message has been handled.
+void ipc_conn_consume(ipc_conn* conn, size_t n);
+
+void ipc_conn_record(ipc_conn* conn, uint64_t start_ns, int requests, int errors);
+
+void ipc_conn_stats_get(ipc_conn* conn, ipc_conn_stats* out);
+void ipc_conn_stats_reset(ipc_conn* conn);
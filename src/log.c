@@ -0,0 +1,379 @@
+#include "log.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_RING_SIZE 256 // records per thread, power of two
+#define LOG_STRING_BYTES 512 // inline string storage per record, shared by its strings
+#define LOG_LINE_MAX 1024
+
+typedef struct {
+	uint64_t ns;
+	const char* fmt;
+	uint8_t level;
+	uint8_t count;
+	uint16_t string_len;
+	log_arg args[LOG_MAX_ARGS]; // LOG_ARG_STR values point into strings
+	char strings[LOG_STRING_BYTES];
+} log_record;
+
+// Single-producer single-consumer: the owning thread writes at head, the
+// flusher reads at tail.
+typedef struct log_ring {
+	atomic_size_t head;
+	atomic_size_t tail;
+	atomic_bool orphaned; // owning thread exited; freed once drained
+	struct log_ring* next;
+	log_record records[LOG_RING_SIZE];
+} log_ring;
+
+atomic_int log_min_level = LOG_INFO;
+
+static pthread_mutex_t g_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static log_ring* g_rings;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static __thread log_ring* t_ring;
+
+static atomic_bool g_running;
+static atomic_int g_writers; // log_write calls between the g_running check and the push
+static pthread_t g_flusher;
+static FILE* g_out;
+static FILE* g_err;
+static atomic_ullong g_written, g_dropped, g_truncated, g_wakeups;
+
+// The flusher sleeps on g_wake while every ring is empty; a write that finds
+// it sleeping signals it, so an idle daemon has no timer waking it up.
+static pthread_mutex_t g_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static atomic_bool g_sleeping;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void ring_orphan(void* ring)
+{
+	atomic_store_explicit(&((log_ring*)ring)->orphaned, true, memory_order_release);
+}
+
+static void make_key(void)
+{
+	pthread_key_create(&g_ring_key, ring_orphan);
+}
+
+static log_ring* thread_ring(void)
+{
+	if (t_ring)
+		return t_ring;
+
+	log_ring* ring = calloc(1, sizeof(log_ring));
+	if (!ring)
+		return NULL;
+
+	pthread_once(&g_key_once, make_key);
+	pthread_setspecific(g_ring_key, ring);
+
+	pthread_mutex_lock(&g_rings_lock);
+	ring->next = g_rings;
+	g_rings = ring;
+	pthread_mutex_unlock(&g_rings_lock);
+
+	t_ring = ring;
+	return ring;
+}
+
+static void fill_record(log_record* rec, log_level level, const char* fmt, const log_arg* args, int count)
+{
+	rec->ns = now_ns();
+	rec->fmt = fmt;
+	rec->level = (uint8_t)level;
+	rec->count = (uint8_t)(count < LOG_MAX_ARGS ? count : LOG_MAX_ARGS);
+	rec->string_len = 0;
+
+	for (int i = 0; i < rec->count; i++) {
+		rec->args[i] = args[i];
+		if (args[i].type != LOG_ARG_STR)
+			continue;
+
+		// strings are copied now; the caller's buffer may be gone by flush time
+		const char* s = args[i].s ? args[i].s : "(null)";
+		size_t room = LOG_STRING_BYTES - rec->string_len;
+		size_t len = strlen(s);
+		if (len >= room) {
+			len = room ? room - 1 : 0;
+			atomic_fetch_add_explicit(&g_truncated, 1, memory_order_relaxed);
+		}
+
+		char* dst = rec->strings + rec->string_len;
+		if (room) {
+			memcpy(dst, s, len);
+			dst[len] = '\0';
+			rec->string_len += (uint16_t)(len + 1);
+		}
+		rec->args[i].s = room ? dst : "";
+	}
+}
+
+// Formats one printf conversion per argument, so records never need a
+// va_list. Returns the length written to buf.
+static size_t format_record(const log_record* rec, char* buf, size_t size)
+{
+	size_t len = 0;
+	int arg = 0;
+
+	for (const char* p = rec->fmt; *p && len + 1 < size; p++) {
+		if (*p != '%') {
+			buf[len++] = *p;
+			continue;
+		}
+		if (p[1] == '%') {
+			buf[len++] = '%';
+			p++;
+			continue;
+		}
+
+		// %[flags][width][.precision][length]conversion
+		char spec[32] = "%";
+		size_t n = 1;
+		const char* q = p + 1;
+		while (*q && strchr("-+ #0", *q) && n < 16)
+			spec[n++] = *q++;
+		while (*q && ((*q >= '0' && *q <= '9') || *q == '.') && n < 24)
+			spec[n++] = *q++;
+		while (*q && strchr("hlLqjzt", *q))
+			q++;
+		char conv = *q;
+		if (!conv)
+			break;
+		p = q;
+
+		const log_arg* a = arg < rec->count ? &rec->args[arg++] : NULL;
+		size_t room = size - len;
+		int written = -1;
+		if (a && (a->type == LOG_ARG_INT || a->type == LOG_ARG_UINT) && strchr("diouxXc", conv)) {
+			if (conv == 'c') {
+				spec[n++] = 'c';
+				spec[n] = '\0';
+				written = snprintf(buf + len, room, spec, (int)a->i);
+			} else {
+				spec[n++] = 'l';
+				spec[n++] = 'l';
+				spec[n++] = conv;
+				spec[n] = '\0';
+				written = a->type == LOG_ARG_INT && (conv == 'd' || conv == 'i')
+					? snprintf(buf + len, room, spec, a->i)
+					: snprintf(buf + len, room, spec, a->u);
+			}
+		} else if (a && a->type == LOG_ARG_DOUBLE && strchr("fFeEgGaA", conv)) {
+			spec[n++] = conv;
+			spec[n] = '\0';
+			written = snprintf(buf + len, room, spec, a->d);
+		} else if (a && a->type == LOG_ARG_STR && conv == 's') {
+			spec[n++] = 's';
+			spec[n] = '\0';
+			written = snprintf(buf + len, room, spec, a->s);
+		} else if (a && a->type == LOG_ARG_PTR && conv == 'p') {
+			written = snprintf(buf + len, room, "%p", a->p);
+		} else {
+			written = snprintf(buf + len, room, "<?>");
+		}
+
+		if (written > 0)
+			len += (size_t)written < room ? (size_t)written : room - 1;
+	}
+
+	buf[len] = '\0';
+	return len;
+}
+
+static void emit(const log_record* rec)
+{
+	char line[LOG_LINE_MAX];
+	size_t len = format_record(rec, line, sizeof(line) - 1);
+	line[len++] = '\n';
+
+	FILE* file = rec->level >= LOG_WARN ? g_err : g_out;
+	fwrite(line, 1, len, file ? file : (rec->level >= LOG_WARN ? stderr : stdout));
+	atomic_fetch_add_explicit(&g_written, 1, memory_order_relaxed);
+}
+
+static void wake_flusher(void)
+{
+	pthread_mutex_lock(&g_wake_lock);
+	pthread_cond_signal(&g_wake);
+	pthread_mutex_unlock(&g_wake_lock);
+}
+
+void log_write(log_level level, const char* fmt, const log_arg* args, int count)
+{
+	// log_stop waits for g_writers to drop to zero before its last drain, so
+	// a record pushed after the check below is still written
+	atomic_fetch_add(&g_writers, 1);
+	if (!atomic_load(&g_running)) {
+		atomic_fetch_sub(&g_writers, 1);
+		log_record rec;
+		fill_record(&rec, level, fmt, args, count);
+		emit(&rec);
+		return;
+	}
+
+	log_ring* ring = thread_ring();
+	size_t head = ring ? atomic_load_explicit(&ring->head, memory_order_relaxed) : 0;
+	if (!ring || head - atomic_load_explicit(&ring->tail, memory_order_acquire) == LOG_RING_SIZE) {
+		atomic_fetch_sub(&g_writers, 1);
+		atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	fill_record(&ring->records[head & (LOG_RING_SIZE - 1)], level, fmt, args, count);
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	atomic_fetch_sub(&g_writers, 1);
+
+	// pairs with the fence in flusher_thread: either it sees this record or
+	// this sees it sleeping
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&g_sleeping, memory_order_relaxed))
+		wake_flusher();
+}
+
+static bool rings_empty(void)
+{
+	bool empty = true;
+	pthread_mutex_lock(&g_rings_lock);
+	for (log_ring* ring = g_rings; ring && empty; ring = ring->next)
+		empty = atomic_load_explicit(&ring->tail, memory_order_relaxed) == atomic_load_explicit(&ring->head, memory_order_acquire);
+	pthread_mutex_unlock(&g_rings_lock);
+	return empty;
+}
+
+// Writes queued records oldest first across all rings and frees rings whose
+// threads are gone. Returns how many records were written.
+static size_t drain(void)
+{
+	size_t total = 0;
+	pthread_mutex_lock(&g_rings_lock);
+
+	for (;;) {
+		log_ring* oldest = NULL;
+		uint64_t oldest_ns = 0;
+		for (log_ring* ring = g_rings; ring; ring = ring->next) {
+			size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+			if (tail == atomic_load_explicit(&ring->head, memory_order_acquire))
+				continue;
+			uint64_t ns = ring->records[tail & (LOG_RING_SIZE - 1)].ns;
+			if (!oldest || ns < oldest_ns) {
+				oldest = ring;
+				oldest_ns = ns;
+			}
+		}
+		if (!oldest)
+			break;
+
+		size_t tail = atomic_load_explicit(&oldest->tail, memory_order_relaxed);
+		emit(&oldest->records[tail & (LOG_RING_SIZE - 1)]);
+		atomic_store_explicit(&oldest->tail, tail + 1, memory_order_release);
+		total++;
+	}
+
+	for (log_ring** link = &g_rings; *link;) {
+		log_ring* ring = *link;
+		if (atomic_load_explicit(&ring->orphaned, memory_order_acquire)
+			&& atomic_load(&ring->tail) == atomic_load(&ring->head)) {
+			*link = ring->next;
+			free(ring);
+		} else {
+			link = &ring->next;
+		}
+	}
+
+	pthread_mutex_unlock(&g_rings_lock);
+
+	if (total) {
+		fflush(g_out);
+		fflush(g_err);
+	}
+	return total;
+}
+
+static void* flusher_thread(__attribute__((unused)) void* arg)
+{
+	while (atomic_load_explicit(&g_running, memory_order_acquire)) {
+		if (drain() > 0)
+			continue;
+
+		pthread_mutex_lock(&g_wake_lock);
+		atomic_store(&g_sleeping, true);
+		// pairs with the fence in log_write
+		atomic_thread_fence(memory_order_seq_cst);
+		if (rings_empty() && atomic_load(&g_running)) {
+			pthread_cond_wait(&g_wake, &g_wake_lock);
+			atomic_fetch_add_explicit(&g_wakeups, 1, memory_order_relaxed);
+		}
+		atomic_store(&g_sleeping, false);
+		pthread_mutex_unlock(&g_wake_lock);
+	}
+	drain();
+	return NULL;
+}
+
+bool log_start(log_level level, FILE* out, FILE* err)
+{
+	if (atomic_load(&g_running))
+		return true;
+
+	log_set_level(level);
+	g_out = out;
+	g_err = err;
+	atomic_store(&g_running, true);
+	if (pthread_create(&g_flusher, NULL, flusher_thread, NULL) != 0) {
+		atomic_store(&g_running, false);
+		fprintf(stderr, "log_start: failed to create flusher thread\n");
+		return false;
+	}
+	return true;
+}
+
+void log_stop(void)
+{
+	if (!atomic_exchange(&g_running, false))
+		return;
+	wake_flusher();
+	pthread_join(g_flusher, NULL);
+
+	// a write that saw g_running before it was cleared may still be pushing
+	while (atomic_load(&g_writers) > 0)
+		sched_yield();
+	drain();
+}
+
+void log_set_level(log_level level)
+{
+	atomic_store_explicit(&log_min_level, level, memory_order_relaxed);
+}
+
+log_level log_level_parse(const char* name, log_level fallback)
+{
+	static const char* names[] = { "debug", "info", "warn", "error", "off" };
+	for (int i = 0; name && i <= LOG_OFF; i++) {
+		if (strcasecmp(name, names[i]) == 0)
+			return (log_level)i;
+	}
+	return fallback;
+}
+
+void log_stats_get(log_stats* out)
+{
+	out->written = atomic_load_explicit(&g_written, memory_order_relaxed);
+	out->dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+	out->truncated = atomic_load_explicit(&g_truncated, memory_order_relaxed);
+	out->wakeups = atomic_load_explicit(&g_wakeups, memory_order_relaxed);
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Asynchronous logger for the gesture and IPC threads. A call copies the
+// format pointer, its typed arguments and any strings into a fixed-size
+// record on the calling thread's own ring; a background thread formats and
+// writes the records. Formats must be string literals. Before log_start (and
+// after log_stop) calls format and write synchronously instead.
+//
+// Up to LOG_MAX_ARGS arguments of integer, floating point, string or pointer
+// type; conversions follow printf, length modifiers are ignored.
+
+typedef enum {
+	LOG_DEBUG,
+	LOG_INFO,
+	LOG_WARN,
+	LOG_ERROR,
+	LOG_OFF
+} log_level;
+
+#define LOG_MAX_ARGS 8
+
+typedef enum {
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STR,
+	LOG_ARG_PTR
+} log_arg_type;
+
+typedef struct {
+	log_arg_type type;
+	union {
+		long long i;
+		unsigned long long u;
+		double d;
+		const char* s;
+		const void* p;
+	};
+} log_arg;
+
+typedef struct {
+	unsigned long long written;
+	unsigned long long dropped; // ring was full
+	unsigned long long truncated; // a string did not fit its record
+	unsigned long long wakeups; // times the flusher was woken from sleep
+} log_stats;
+
+extern atomic_int log_min_level;
+
+// debug/info go to out, warn/error to err; the flusher owns both from here.
+bool log_start(log_level level, FILE* out, FILE* err);
+
+// Writes everything still queued and joins the flusher.
+void log_stop(void);
+
+void log_set_level(log_level level);
+log_level log_level_parse(const char* name, log_level fallback);
+void log_stats_get(log_stats* out);
+
+void log_write(log_level level, const char* fmt, const log_arg* args, int count);
+
+static inline log_arg log_arg_int(long long v) { return (log_arg) { .type = LOG_ARG_INT, .i = v }; }
+static inline log_arg log_arg_uint(unsigned long long v) { return (log_arg) { .type = LOG_ARG_UINT, .u = v }; }
+static inline log_arg log_arg_double(double v) { return (log_arg) { .type = LOG_ARG_DOUBLE, .d = v }; }
+static inline log_arg log_arg_str(const char* v) { return (log_arg) { .type = LOG_ARG_STR, .s = v }; }
+static inline log_arg log_arg_ptr(const void* v) { return (log_arg) { .type = LOG_ARG_PTR, .p = v }; }
+
+#define LOG_ARG(x) _Generic((x),                     \
+	char*: log_arg_str,                               \
+	const char*: log_arg_str,                         \
+	float: log_arg_double,                            \
+	double: log_arg_double,                           \
+	unsigned char: log_arg_uint,                      \
+	unsigned short: log_arg_uint,                     \
+	unsigned int: log_arg_uint,                       \
+	unsigned long: log_arg_uint,                      \
+	unsigned long long: log_arg_uint,                 \
+	void*: log_arg_ptr,                               \
+	const void*: log_arg_ptr,                         \
+	default: log_arg_int)(x)
+
+#define LOG_CAT_(a, b) a##b
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, n, ...) n
+#define LOG_COUNT(...) LOG_COUNT_(__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define LOG_CALL_1(lvl, fmt) log_write(lvl, fmt, NULL, 0)
+#define LOG_CALL_2(lvl, fmt, a) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a) }, 1)
+#define LOG_CALL_3(lvl, fmt, a, b) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a), LOG_ARG(b) }, 2)
+#define LOG_CALL_4(lvl, fmt, a, b, c) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c) }, 3)
+#define LOG_CALL_5(lvl, fmt, a, b, c, d) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d) }, 4)
+#define LOG_CALL_6(lvl, fmt, a, b, c, d, e) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e) }, 5)
+#define LOG_CALL_7(lvl, fmt, a, b, c, d, e, f) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(f) }, 6)
+#define LOG_CALL_8(lvl, fmt, a, b, c, d, e, f, g) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(f), LOG_ARG(g) }, 7)
+#define LOG_CALL_9(lvl, fmt, a, b, c, d, e, f, g, h) log_write(lvl, fmt, (const log_arg[]) { LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(f), LOG_ARG(g), LOG_ARG(h) }, 8)
+
+#define LOG_AT(lvl, ...)                                                                  \
+	do {                                                                                  \
+		if ((int)(lvl) >= atomic_load_explicit(&log_min_level, memory_order_relaxed))     \
+			LOG_CAT(LOG_CALL_, LOG_COUNT(__VA_ARGS__))(lvl, __VA_ARGS__);                  \
+	} while (0)
+
+#define log_debug(...) LOG_AT(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...) LOG_AT(LOG_INFO, __VA_ARGS__)
+#define log_warn(...) LOG_AT(LOG_WARN, __VA_ARGS__)
+#define log_error(...) LOG_AT(LOG_ERROR, __VA_ARGS__)
@@ -2,281 +2,858 @@
 #include "Cocoa/Cocoa.h"
 #include "aerospace.h"
 #include "config.h"
+#include "control.h"
 #import "event_tap.h"
 #include "haptic.h"
+#include "log.h"
+#include "rt_thread.h"
+#include "stats.h"
+#include "tap_health.h"
+#include "throttle.h"
+#include "trace.h"
+#include "tracer.h"
 #include <AppKit/AppKit.h>
 #import <ApplicationServices/ApplicationServices.h>
 #include <pthread.h>
 
 static aerospace* g_aerospace = NULL;
-static CFTypeRef g_haptic = NULL;
 static Config g_config;
-static pthread_mutex_t g_gesture_mutex = PTHREAD_MUTEX_INITIALIZER;
-static gesture_ctx g_gesture_ctx = { 0 };
 static CFMutableDictionaryRef g_tracks = NULL;
+static dispatch_queue_t g_command_queue = NULL;
+static dispatch_queue_t g_query_queue = NULL;
+static pthread_mutex_t g_prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static swipe_stats g_stats;
+static trace_recorder g_recorder;
+static tap_health g_tap_health;
+static control_server* g_control = NULL;
+
+#define MAX_DEVICES 4
+
+// One set of gesture recognizers per trackpad, keyed by NSTouch.device. The table is only
+// touched on the event-tap thread and each context only on the gesture
+// thread, so frames from different pads never share state or a lock.
+typedef struct {
+	uintptr_t id;
+	haptic_worker* haptic;
+	gesture_set gesture;
+	gesture_filter filter; // event-tap thread only
+	unsigned fingers; // event-tap thread only
+} gesture_device;
+
+static gesture_device g_devices[MAX_DEVICES];
+static int g_device_count = 0;
+static Config g_device_config; // for pads seen later, event-tap thread only
+
+// One worker per actuator found at startup, in IORegistry order, so a pulse
+// plays on the pad that fired rather than on every pad.
+static haptic_worker* g_haptics[MAX_DEVICES];
+static int g_haptic_count = 0;
+
+// Every pad's recognizers run on one dedicated thread with its own run loop,
+// raised through rt_thread so frames are not scheduled behind a compile job
+// the way a default-QoS queue is. Blocks run in the order they were posted.
+static CFRunLoopRef g_gesture_loop = NULL;
+static rt_class g_gesture_class;
+
+static void keep_alive(__unused void* info)
+{
+}
+
+static void* gesture_thread(void* arg)
+{
+	dispatch_semaphore_t ready = (__bridge dispatch_semaphore_t)arg;
+	tracer_thread_name("gesture");
+
+	// a run loop without sources returns at once; this one is never signalled
+	CFRunLoopSourceContext context = { .perform = keep_alive };
+	CFRunLoopSourceRef source = CFRunLoopSourceCreate(NULL, 0, &context);
+	CFRunLoopAddSource(CFRunLoopGetCurrent(), source, kCFRunLoopDefaultMode);
+	CFRelease(source);
+
+	g_gesture_loop = CFRunLoopGetCurrent();
+	dispatch_semaphore_signal(ready);
+	CFRunLoopRun();
+	return NULL;
+}
+
+static bool start_gesture_thread(void)
+{
+	rt_params priority = rt_params_gesture(rt_class_parse(g_config.gesture_priority, RT_CLASS_REALTIME));
+	dispatch_semaphore_t ready = dispatch_semaphore_create(0);
+	pthread_t thread;
+	if (!rt_thread_start(&thread, "swipe-gesture", &priority, gesture_thread, (__bridge void*)ready, &g_gesture_class))
+		return false;
+	pthread_detach(thread);
+	dispatch_semaphore_wait(ready, DISPATCH_TIME_FOREVER);
+	log_info("Gesture thread scheduling: %s (asked for %s)", rt_class_name(g_gesture_class), rt_class_name(priority.want));
+	return true;
+}
+
+static void on_gesture_thread(dispatch_block_t block)
+{
+	CFRunLoopPerformBlock(g_gesture_loop, kCFRunLoopDefaultMode, block);
+	CFRunLoopWakeUp(g_gesture_loop);
+}
+
+static void on_gesture_thread_sync(dispatch_block_t block)
+{
+	dispatch_semaphore_t done = dispatch_semaphore_create(0);
+	on_gesture_thread(^{
+		block();
+		dispatch_semaphore_signal(done);
+	});
+	dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+}
+
+#define PREFETCH_TTL_NS (1000ull * 1000 * 1000) // cached table is trusted for 1s
+#define PREFETCH_STATS_INTERVAL 64
+
+// Speculative workspace-table refresh, guarded by g_prefetch_mutex. The mutex
+// is held across the refresh so a swipe that fires mid-prefetch waits for it
+// instead of issuing a second query.
+typedef struct {
+	int monitor; // monitor the armed gesture targets
+	bool armed; // a gesture armed and has not fired yet
+	unsigned long long issued, hits, misses, wasted, arms;
+} workspace_prefetch;
+
+static workspace_prefetch g_prefetch = { .monitor = AEROSPACE_MONITOR_NONE };
+
+static void log_connection_stats(void)
+{
+	static const char* names[AEROSPACE_CONN_COUNT] = { "command", "query" };
+
+	for (int i = 0; i < AEROSPACE_CONN_COUNT; i++) {
+		aerospace_conn_stats st;
+		aerospace_conn_stats_get(g_aerospace, i, &st);
+		log_info("IPC %s: requests=%llu errors=%llu reconnects=%llu last=%.2fms avg=%.2fms max=%.2fms",
+			names[i], st.requests, st.errors, st.reconnects,
+			st.last_ns / 1e6,
+			st.requests ? st.total_ns / 1e6 / st.requests : 0.0,
+			st.max_ns / 1e6);
+	}
+}
+
+// Summed over every actuator's worker; false when none was started.
+static bool haptic_stats_get(haptic_worker_stats* out)
+{
+	memset(out, 0, sizeof(*out));
+	for (int i = 0; i < g_haptic_count; ++i) {
+		haptic_worker_stats st;
+		haptic_worker_stats_get(g_haptics[i], &st);
+		out->submitted += st.submitted;
+		out->actuated += st.actuated;
+		out->coalesced += st.coalesced;
+		out->dropped += st.dropped;
+		out->total_queue_ns += st.total_queue_ns;
+		if (st.max_queue_ns > out->max_queue_ns)
+			out->max_queue_ns = st.max_queue_ns;
+	}
+	return g_haptic_count > 0;
+}
+
+// The worker of the actuator pad index pulses, NULL when its haptics are off
+// or there is no such actuator.
+static haptic_worker* haptic_for_device(const Config* config, int index)
+{
+	Config device = config_for_device(config, index);
+	if (!device.haptic)
+		return NULL;
+
+	int actuator = index;
+	if (index < config->device_count && config->devices[index].actuator >= 0)
+		actuator = config->devices[index].actuator;
+	return actuator < g_haptic_count ? g_haptics[actuator] : NULL;
+}
+
+static void log_haptic_stats(void)
+{
+	haptic_worker_stats st;
+	if (!haptic_stats_get(&st))
+		return;
+
+	log_info("Haptic: submitted=%llu actuated=%llu coalesced=%llu dropped=%llu avg_queue=%.3fms max_queue=%.3fms",
+		st.submitted, st.actuated, st.coalesced, st.dropped,
+		st.submitted ? st.total_queue_ns / 1e6 / st.submitted : 0.0,
+		st.max_queue_ns / 1e6);
+}
+
+static void log_tap_stats(void)
+{
+	tap_health* h = &g_tap_health;
+	uint64_t p99, max;
+	tap_health_callback_summary(h, &p99, &max);
+	log_info("Event tap: callbacks=%llu slow=%llu timeouts=%llu p99=%.1fus max=%.1fus",
+		atomic_load(&h->callbacks), atomic_load(&h->slow), atomic_load(&h->timeout_disables),
+		p99 / 1e3, max / 1e3);
+}
+
+static void prefetch_workspaces(void)
+{
+	dispatch_async(g_query_queue, ^{
+		workspace_prefetch* p = &g_prefetch;
+		pthread_mutex_lock(&g_prefetch_mutex);
+
+		if (p->armed)
+			p->wasted++;
+		p->armed = true;
+
+		bool refreshed = false;
+		aerospace_refresh_workspaces(g_aerospace, PREFETCH_TTL_NS, &refreshed);
+		if (refreshed)
+			p->issued++;
+		p->monitor = aerospace_monitor_id(g_aerospace, g_config.monitor);
+
+		bool report = ++p->arms % PREFETCH_STATS_INTERVAL == 0;
+		if (report)
+			log_info("Prefetch stats: issued=%llu hits=%llu misses=%llu wasted=%llu",
+				p->issued, p->hits, p->misses, p->wasted);
+
+		pthread_mutex_unlock(&g_prefetch_mutex);
+
+		if (report) {
+			log_connection_stats();
+			log_haptic_stats();
+			log_tap_stats();
+		}
+	});
+}
+
+// Returns the monitor a fired swipe acts on, doing the prefetch's work inline
+// when it did not run or the table went stale.
+static int take_target_monitor(void)
+{
+	workspace_prefetch* p = &g_prefetch;
+	pthread_mutex_lock(&g_prefetch_mutex);
+	p->armed = false;
+
+	bool refreshed = false;
+	int monitor = AEROSPACE_MONITOR_NONE;
+	if (aerospace_refresh_workspaces(g_aerospace, PREFETCH_TTL_NS, &refreshed)) {
+		if (refreshed || p->monitor == AEROSPACE_MONITOR_NONE) {
+			p->misses++;
+			stats_inc(&g_stats.cache_misses);
+			p->monitor = aerospace_monitor_id(g_aerospace, g_config.monitor);
+		} else {
+			p->hits++;
+			stats_inc(&g_stats.cache_hits);
+		}
+		monitor = p->monitor;
+	} else {
+		p->misses++;
+		stats_inc(&g_stats.cache_misses);
+	}
+	p->monitor = AEROSPACE_MONITOR_NONE;
 
-static void switch_workspace(const char* ws)
+	pthread_mutex_unlock(&g_prefetch_mutex);
+	return monitor;
+}
+
+// Lets the server pick the target from the focused monitor's list; used when
+// the local table is unavailable (e.g. an AeroSpace without --json). The
+// server moves one workspace per command, so a fling sends several.
+static void switch_workspace_on_server(const char* ws, int steps, bool wrap_around, bool skip_empty, uint64_t fired_ns)
 {
-	if (g_config.skip_empty || g_config.wrap_around) {
-		char* workspaces = aerospace_list_workspaces(g_aerospace, !g_config.skip_empty);
+	tracer_span("coalesce", "fire_to_send", fired_ns, NULL, 0);
+	bool ok = true;
+	if (skip_empty || wrap_around) {
+		char* workspaces = aerospace_list_workspaces(g_aerospace, !skip_empty);
 		if (!workspaces) {
-			fprintf(stderr, "Error: Unable to retrieve workspace list.\n");
+			log_error("Error: Unable to retrieve workspace list.");
+			stats_switch(&g_stats, 0, false);
 			return;
 		}
-		char* result = aerospace_workspace(g_aerospace, g_config.wrap_around, ws, workspaces);
+		char* result = NULL;
+		for (int i = 0; ok && i < steps; i++) {
+			free(result);
+			result = aerospace_workspace(g_aerospace, wrap_around, ws, workspaces);
+			ok = result == NULL;
+		}
 		if (result) {
-			fprintf(stderr, "Error: Failed to switch workspace to '%s'.\n", ws);
+			log_error("Error: Failed to switch workspace to '%s'.", ws);
 		} else {
-			printf("Switched workspace successfully to '%s'.\n", ws);
+			log_info("Switched workspace successfully to '%s'.", ws);
 		}
 		free(workspaces);
 		free(result);
 	} else {
-		char* result = aerospace_switch(g_aerospace, ws);
+		char* result = NULL;
+		for (int i = 0; ok && i < steps; i++) {
+			free(result);
+			result = aerospace_switch(g_aerospace, ws);
+			ok = result == NULL;
+		}
 		if (result) {
-			fprintf(stderr, "Error: Failed to switch workspace: '%s'\n", result);
+			log_error("Error: Failed to switch workspace: '%s'", result);
 		} else {
-			printf("Switched workspace successfully to '%s'.\n", ws);
+			log_info("Switched workspace successfully to '%s'.", ws);
 		}
 		free(result);
 	}
-
-	if (g_config.haptic == true)
-		haptic_actuate(g_haptic, 3);
+	stats_switch(&g_stats, ipc_monotonic_ns() - fired_ns, ok);
 }
 
-static void reset_gesture_state(gesture_ctx* ctx)
+static void send_navigation(aerospace_nav nav, uint64_t fired_ns)
 {
-	ctx->state = GS_IDLE;
-	ctx->last_fire_dir = 0;
+	tracer_span("coalesce", "fire_to_send", fired_ns, NULL, 0);
+	char* result = aerospace_nav_send(g_aerospace, &nav);
+	stats_switch(&g_stats, ipc_monotonic_ns() - fired_ns, result == NULL);
+	if (result) {
+		log_error("Error: Failed to switch workspace to '%s': %s", nav.name, result);
+	} else {
+		log_info("Switched workspace successfully to '%s'.", nav.name);
+	}
+	free(result);
 }
 
-static void fire_gesture(gesture_ctx* ctx, int direction)
+// Takes ownership of command.
+static void run_command(char* command, uint64_t fired_ns)
 {
-	if (direction == ctx->last_fire_dir)
-		return;
-
-	ctx->last_fire_dir = direction;
-	ctx->state = GS_COMMITTED;
-
-	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-		switch_workspace(direction > 0 ? g_config.swipe_right : g_config.swipe_left);
-	});
+	tracer_span("coalesce", "fire_to_send", fired_ns, NULL, 0);
+	char* result = aerospace_run(g_aerospace, command);
+	stats_switch(&g_stats, ipc_monotonic_ns() - fired_ns, result == NULL);
+	if (result) {
+		log_error("Error: '%s' failed: %s", command, result);
+	} else {
+		log_info("Ran '%s'.", command);
+	}
+	free(result);
+	free(command);
 }
 
-static void calculate_touch_averages(touch* touches, int count,
-	float* avg_x, float* avg_y, float* avg_vel,
-	float* min_x, float* max_x, float* min_y, float* max_y)
+typedef enum {
+	PENDING_NONE,
+	PENDING_NAV, // a target picked from the local table
+	PENDING_SERVER, // net steps for the server to resolve
+	PENDING_ACTION, // a configured command
+} pending_kind;
+
+// Commands waiting for the command queue: one slot for workspace switches
+// and one for configured commands, so whatever outruns the server has one
+// command in flight and at most two behind it. A navigation on the same
+// monitor replaces the waiting one and server steps add to waiting server
+// steps, so a scrub or a burst of swipes sends only where it ended up. Any
+// other switch, or a command while one is waiting, replaces the waiting one,
+// which is dropped. The slots go out in the order they were filled; a swipe
+// that folds into steps waiting ahead of a command goes out ahead of it too.
+// g_throttle spaces the sends.
+typedef struct {
+	pending_kind kind;
+	aerospace_nav nav;
+	int steps;
+	bool wrap_around, skip_empty;
+	char* command; // owned
+	uint64_t fired_ns; // of the first gesture folded in
+} pending_command;
+
+static pthread_mutex_t g_pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pending_command g_pending_switch, g_pending_action;
+static bool g_action_first; // the waiting command goes out before the waiting switch
+static bool g_draining; // a drain_commands is queued, running or waiting for a token
+static bool g_held; // the first waiting command already counted as throttled
+static throttle g_throttle;
+
+static void send_command(pending_command* command)
 {
-	*avg_x = *avg_y = *avg_vel = 0;
-	*min_x = *min_y = 1;
-	*max_x = *max_y = 0;
-
-	for (int i = 0; i < count; ++i) {
-		*avg_x += touches[i].x;
-		*avg_y += touches[i].y;
-		*avg_vel += touches[i].velocity;
-
-		if (touches[i].x < *min_x)
-			*min_x = touches[i].x;
-		if (touches[i].x > *max_x)
-			*max_x = touches[i].x;
-		if (touches[i].y < *min_y)
-			*min_y = touches[i].y;
-		if (touches[i].y > *max_y)
-			*max_y = touches[i].y;
+	switch (command->kind) {
+	case PENDING_NONE:
+		break;
+	case PENDING_NAV:
+		send_navigation(command->nav, command->fired_ns);
+		break;
+	case PENDING_SERVER:
+		if (command->steps)
+			switch_workspace_on_server(command->steps > 0 ? "next" : "prev", abs(command->steps),
+				command->wrap_around, command->skip_empty, command->fired_ns);
+		break;
+	case PENDING_ACTION:
+		run_command(command->command, command->fired_ns);
+		break;
 	}
-
-	*avg_x /= count;
-	*avg_y /= count;
-	*avg_vel /= count;
 }
 
-static bool handle_committed_state(gesture_ctx* ctx, touch* touches, int count)
+// Runs on g_command_queue until nothing is waiting. When the throttle holds
+// the next command it comes back once a token is due, and what arrives in
+// the meantime folds into what is already waiting.
+static void drain_commands(void)
 {
-	bool all_ended = true;
-	for (int i = 0; i < count; ++i) {
-		if (touches[i].phase != END_PHASE) {
-			all_ended = false;
-			break;
+	for (;;) {
+		pthread_mutex_lock(&g_pending_mutex);
+		if (g_pending_switch.kind == PENDING_NONE && g_pending_action.kind == PENDING_NONE) {
+			g_draining = false;
+			pthread_mutex_unlock(&g_pending_mutex);
+			return;
+		}
+		uint64_t wait = throttle_take(&g_throttle, ipc_monotonic_ns());
+		if (wait) {
+			if (!g_held)
+				stats_inc(&g_stats.throttled);
+			g_held = true;
+			pthread_mutex_unlock(&g_pending_mutex);
+
+			tracer_instant("coalesce", "throttled", "wait_us", (int64_t)(wait / 1000));
+			dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)wait), g_command_queue, ^{
+				drain_commands();
+			});
+			return;
 		}
+		g_held = false;
+		bool action = g_pending_action.kind != PENDING_NONE && (g_action_first || g_pending_switch.kind == PENDING_NONE);
+		pending_command* slot = action ? &g_pending_action : &g_pending_switch;
+		pending_command next = *slot;
+		*slot = (pending_command) { .kind = PENDING_NONE };
+		pthread_mutex_unlock(&g_pending_mutex);
+
+		send_command(&next);
 	}
+}
 
-	if (!count || all_ended) {
-		reset_gesture_state(ctx);
-		return true;
+static void queue_command(pending_command command)
+{
+	pending_command dropped = { .kind = PENDING_NONE };
+	pthread_mutex_lock(&g_pending_mutex);
+	pending_command* waiting = &g_pending_switch;
+	if (command.kind == PENDING_ACTION) {
+		dropped = g_pending_action;
+		g_pending_action = command;
+		g_action_first = g_pending_switch.kind == PENDING_NONE;
+	} else if (waiting->kind == PENDING_NONE) {
+		*waiting = command;
+		// a command already waiting was fired first
+		g_action_first = true;
+	} else if (command.kind == PENDING_NAV && waiting->kind == PENDING_NAV
+		&& waiting->nav.monitor_id == command.nav.monitor_id) {
+		aerospace_nav_supersede(g_aerospace, &waiting->nav);
+		waiting->nav = command.nav;
+		stats_inc(&g_stats.coalesced);
+		tracer_instant("coalesce", "nav_superseded", "monitor", command.nav.monitor_id);
+	} else if (command.kind == PENDING_SERVER && waiting->kind == PENDING_SERVER) {
+		waiting->steps += command.steps;
+		waiting->wrap_around = command.wrap_around;
+		waiting->skip_empty = command.skip_empty;
+		stats_inc(&g_stats.coalesced);
+	} else {
+		dropped = *waiting;
+		*waiting = command;
+	}
+	bool start = !g_draining;
+	g_draining = true;
+	pthread_mutex_unlock(&g_pending_mutex);
+
+	if (dropped.kind != PENDING_NONE) {
+		// a flood logs at the 1st, 2nd, 4th, 8th... drop; the counter has the rest
+		unsigned long long count = atomic_fetch_add_explicit(&g_stats.dropped, 1, memory_order_relaxed) + 1;
+		if ((count & (count - 1)) == 0)
+			log_warn("Dropping a command that a newer one replaced (%llu dropped)", count);
+		if (dropped.kind == PENDING_NAV)
+			aerospace_nav_complete(g_aerospace, &dropped.nav, false);
+		free(dropped.command);
 	}
+	if (start) {
+		dispatch_async(g_command_queue, ^{
+			drain_commands();
+		});
+	}
+}
 
-	float avg_x, avg_y, avg_vel, min_x, max_x, min_y, max_y;
-	calculate_touch_averages(touches, count, &avg_x, &avg_y, &avg_vel,
-		&min_x, &max_x, &min_y, &max_y);
+// Runs on g_query_queue: the target is computed from the client's predicted
+// focus and the prediction advances before the command is sent, so a burst of
+// swipes only queues behind the network, not behind each other's replies.
+// g_config is only written on this queue (see control_reload_config).
+static void switch_workspace(int direction, int steps, uint64_t fired_ns)
+{
+	tracer_span("coalesce", "query_queue", fired_ns, "direction", direction);
+	const char* ws = direction > 0 ? g_config.swipe_right : g_config.swipe_left;
+	bool wrap_around = g_config.wrap_around;
+	bool skip_empty = g_config.skip_empty;
+
+	int monitor = take_target_monitor();
+	int step = strcmp(ws, "next") == 0 ? steps : -steps;
+	aerospace_nav nav;
+	aerospace_nav_result moved = AEROSPACE_NAV_UNKNOWN;
+	if (monitor != AEROSPACE_MONITOR_NONE)
+		moved = aerospace_navigate(g_aerospace, monitor, step, wrap_around, skip_empty, &nav);
+
+	if (moved == AEROSPACE_NAV_STAY) {
+		// an end without wrap-around; the server would only refuse it
+		log_debug("Nothing to switch to on monitor %d.", monitor);
+	} else if (moved == AEROSPACE_NAV_MOVED) {
+		queue_command((pending_command) { .kind = PENDING_NAV, .nav = nav, .fired_ns = fired_ns });
+	} else {
+		queue_command((pending_command) { .kind = PENDING_SERVER,
+			.steps = step,
+			.wrap_around = wrap_around,
+			.skip_empty = skip_empty,
+			.fired_ns = fired_ns });
+	}
+}
+
+// Runs on g_query_queue like switch_workspace, which is where g_config is
+// written; the command is copied before it is queued.
+static void run_action(int index, int direction, uint64_t fired_ns)
+{
+	tracer_span("coalesce", "query_queue", fired_ns, "direction", direction);
+	const char* action = config_gesture_action(&g_config, index, direction);
+	if (!action[0])
+		return;
+	char* command = strdup(action);
+	if (!command)
+		return;
+
+	queue_command((pending_command) { .kind = PENDING_ACTION, .command = command, .fired_ns = fired_ns });
+}
 
-	float dx = avg_x - ctx->start_x;
-	if ((dx * ctx->last_fire_dir) < 0 && fabsf(dx) >= g_config.min_travel) {
-		ctx->state = GS_ARMED;
-		ctx->start_x = avg_x;
-		ctx->start_y = avg_y;
-		ctx->peak_velx = avg_vel;
-		ctx->dir = (avg_vel >= 0) ? 1 : -1;
+static void gesture_armed(gesture_ctx* ctx)
+{
+	stats_inc(&g_stats.armed);
+	// only the main horizontal swipe needs the workspace table
+	if (gesture_set_index(gesture_set_of(ctx), ctx) == 0 && ctx->params.kind == GESTURE_KIND_SWIPE
+		&& ctx->axis == GESTURE_AXIS_HORIZONTAL)
+		prefetch_workspaces();
+}
 
-		for (int i = 0; i < count; ++i)
-			ctx->base_x[i] = touches[i].x;
+static void gesture_fired(gesture_ctx* ctx, int direction)
+{
+	gesture_set* set = gesture_set_of(ctx);
+	gesture_device* device = set->userdata;
+	int index = gesture_set_index(set, ctx);
+	uint64_t fired_ns = ipc_monotonic_ns();
+
+	stats_fired(&g_stats, direction);
+	trace_recorder_fire(&g_recorder, direction);
+
+	// feedback runs on its own worker, in parallel with the IPC round trip;
+	// device->haptic is only set while the config asks for haptics
+	if (device->haptic)
+		haptic_worker_submit(device->haptic, 3);
+
+	if (index != 0 || abs(direction) != GESTURE_AXIS_HORIZONTAL) {
+		dispatch_async(g_query_queue, ^{
+			run_action(index, direction, fired_ns);
+		});
+		return;
 	}
 
-	return true;
+	int steps = ctx->fire_steps;
+	dispatch_async(g_query_queue, ^{
+		switch_workspace(direction, steps, fired_ns);
+	});
 }
 
-static void handle_idle_state(gesture_ctx* ctx, touch* touches, int count,
-	float avg_x, float avg_y, float avg_vel)
+static gesture_device* device_for_id(uintptr_t id)
 {
-	bool fast = fabsf(avg_vel) >= g_config.velocity_pct * FAST_VEL_FACTOR;
-	float need = fast ? g_config.min_travel_fast : g_config.min_travel;
+	for (int i = 0; i < g_device_count; ++i) {
+		if (g_devices[i].id == id)
+			return &g_devices[i];
+	}
 
-	bool moved = true;
-	for (int i = 0; i < count && moved; ++i)
-		moved &= fabsf(touches[i].x - ctx->base_x[i]) >= need;
+	// more pads than slots is unlikely; share the last one rather than drop input
+	if (g_device_count == MAX_DEVICES)
+		return &g_devices[MAX_DEVICES - 1];
 
-	float dx = avg_x - ctx->start_x;
-	float dy = avg_y - ctx->start_y;
+	int index = g_device_count++;
+	gesture_device* device = &g_devices[index];
+	device->id = id;
+	device->haptic = haptic_for_device(&g_device_config, index);
 
-	if (moved && (fast || (fabsf(dx) >= ACTIVATE_PCT && fabsf(dx) > fabsf(dy)))) {
-		ctx->state = GS_ARMED;
-		ctx->start_x = avg_x;
-		ctx->start_y = avg_y;
-		ctx->peak_velx = avg_vel;
-		ctx->dir = (avg_vel >= 0) ? 1 : -1;
-	}
+	gesture_recognizers recognizers = gesture_recognizers_for_device(&g_device_config, index);
+	device->fingers = gesture_recognizers_fingers(&recognizers);
+	gesture_callbacks callbacks = { .armed = gesture_armed, .fired = gesture_fired };
+	gesture_set_init(&device->gesture, &recognizers, callbacks, device);
+
+	log_info("New trackpad %d (id %p)", g_device_count, (void*)id);
+	return device;
 }
 
-static void handle_armed_state(gesture_ctx* ctx, touch* touches, int count,
-	float avg_x, float avg_y, float avg_vel)
-{
-	float dx = avg_x - ctx->start_x;
-	float dy = avg_y - ctx->start_y;
+typedef struct {
+	gesture_device* device;
+	touch* buf;
+	int count;
+	unsigned phases;
+} device_frame;
 
-	if (fabsf(dy) > fabsf(dx)) {
-		reset_gesture_state(ctx);
-		return;
+static device_frame* frame_for_device(device_frame* frames, int* frame_count, gesture_device* device)
+{
+	for (int f = 0; f < *frame_count; ++f) {
+		if (frames[f].device == device)
+			return &frames[f];
 	}
+	device_frame* frame = &frames[(*frame_count)++];
+	frame->device = device;
+	return frame;
+}
 
-	bool fast = fabsf(avg_vel) >= g_config.velocity_pct * FAST_VEL_FACTOR;
-	float stepReq = fast ? g_config.min_step_fast : g_config.min_step;
+// Stationary touches never reach the engine. The pre-filter sees each pad's
+// count and phases from a pass that only reads NSTouch properties; touches
+// are converted (KVC, velocity tracking, a copy) only for pads it passes.
+static void process_touches(NSSet<NSTouch*>* touches)
+{
+	uint64_t start = tracer_begin();
+	device_frame frames[MAX_DEVICES] = { 0 };
+	int frame_count = 0;
+	uint8_t frame_of[touches.count];
+
+	int i = 0;
+	for (NSTouch* nsTouch in touches) {
+		gesture_device* device = device_for_id((uintptr_t)(__bridge void*)nsTouch.device);
+		device_frame* frame = frame_for_device(frames, &frame_count, device);
+		frame_of[i++] = (uint8_t)(frame - frames);
+
+		NSTouchPhase phase = nsTouch.phase;
+		if (phase != NSTouchPhaseStationary) {
+			frame->count++;
+			frame->phases |= (unsigned)phase;
+		}
+	}
 
-	int mismatch_count = 0;
-	for (int i = 0; i < count; ++i) {
-		float ddx = touches[i].x - ctx->prev_x[i];
-		if (fabsf(ddx) < stepReq || (ddx * dx) < 0) {
-			mismatch_count++;
-			if (mismatch_count > g_config.swipe_tolerance) {
-				reset_gesture_state(ctx);
-				return;
-			}
+	int passed = 0;
+	for (int f = 0; f < frame_count; ++f) {
+		device_frame* frame = &frames[f];
+		if (!gesture_filter_pass(&frame->device->filter, frame->device->fingers, frame->count, frame->phases)) {
+			stats_inc(&g_stats.prefiltered);
+			continue;
 		}
+		frame->buf = malloc(sizeof(touch) * (frame->count ? frame->count : 1));
+		frame->count = 0;
+		passed++;
 	}
+	if (!passed)
+		return;
 
-	if (fabsf(avg_vel) > fabsf(ctx->peak_velx)) {
-		ctx->peak_velx = avg_vel;
-		ctx->dir = (avg_vel >= 0) ? 1 : -1;
+	i = 0;
+	for (NSTouch* nsTouch in touches) {
+		device_frame* frame = &frames[frame_of[i++]];
+		if (frame->buf && nsTouch.phase != NSTouchPhaseStationary)
+			frame->buf[frame->count++] = [TouchConverter convert_nstouch:nsTouch];
 	}
 
-	if (fabsf(avg_vel) >= g_config.velocity_pct) {
-		fire_gesture(ctx, avg_vel > 0 ? 1 : -1);
-	} else if (fabsf(dx) >= g_config.distance_pct && fabsf(avg_vel) <= g_config.velocity_pct * g_config.settle_factor) {
-		fire_gesture(ctx, dx > 0 ? 1 : -1);
+	tracer_end("input", "convert", start, "touches", (int64_t)touches.count);
+
+	for (int f = 0; f < frame_count; ++f) {
+		gesture_device* device = frames[f].device;
+		touch* buf = frames[f].buf;
+		int count = frames[f].count;
+		if (!buf)
+			continue;
+
+		stats_inc(&g_stats.frames);
+		trace_recorder_frame(&g_recorder, buf, count);
+
+		on_gesture_thread(^{
+			gesture_set_process(&device->gesture, buf, count);
+			free(buf);
+		});
 	}
 }
 
-static void gestureCallback(touch* touches, int count)
+static bool control_stats(__unused void* userdata, __unused yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
 {
-	pthread_mutex_lock(&g_gesture_mutex);
+	static const char* names[AEROSPACE_CONN_COUNT] = { "command", "query" };
 
-	gesture_ctx* ctx = &g_gesture_ctx;
+	stats_to_json(&g_stats, doc, reply);
+	yyjson_mut_obj_add_val(doc, reply, "log", stats_log_json(doc));
+	tap_health_to_json(&g_tap_health, doc, yyjson_mut_obj_add_obj(doc, reply, "tap"));
 
-	if (ctx->state == GS_COMMITTED) {
-		if (handle_committed_state(ctx, touches, count))
-			goto unlock;
+	yyjson_mut_val* ipc = yyjson_mut_obj_add_arr(doc, reply, "ipc");
+	for (int i = 0; i < AEROSPACE_CONN_COUNT; i++) {
+		aerospace_conn_stats st;
+		aerospace_conn_stats_get(g_aerospace, i, &st);
+		yyjson_mut_arr_append(ipc, stats_ipc_json(doc, names[i], &st));
 	}
 
-	if (count != g_config.fingers) {
-		if (ctx->state == GS_ARMED)
-			ctx->state = GS_IDLE;
+	pthread_mutex_lock(&g_prefetch_mutex);
+	workspace_prefetch p = g_prefetch;
+	pthread_mutex_unlock(&g_prefetch_mutex);
+	yyjson_mut_val* prefetch = yyjson_mut_obj_add_obj(doc, reply, "prefetch");
+	yyjson_mut_obj_add_uint(doc, prefetch, "issued", p.issued);
+	yyjson_mut_obj_add_uint(doc, prefetch, "wasted", p.wasted);
+
+	haptic_worker_stats st;
+	if (haptic_stats_get(&st)) {
+		yyjson_mut_val* haptic = yyjson_mut_obj_add_obj(doc, reply, "haptic");
+		yyjson_mut_obj_add_uint(doc, haptic, "submitted", st.submitted);
+		yyjson_mut_obj_add_uint(doc, haptic, "actuated", st.actuated);
+		yyjson_mut_obj_add_uint(doc, haptic, "coalesced", st.coalesced);
+		yyjson_mut_obj_add_uint(doc, haptic, "dropped", st.dropped);
+		yyjson_mut_obj_add_real(doc, haptic, "max_queue_us", st.max_queue_ns / 1e3);
+	}
+	return true;
+}
 
-		for (int i = 0; i < count; ++i)
-			ctx->prev_x[i] = ctx->base_x[i] = touches[i].x;
+static bool control_state(__unused void* userdata, __unused yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	static const char* names[] = { "idle", "armed", "committed" };
 
-		goto unlock;
+	// the device table belongs to the event-tap thread, the contexts to the gesture thread
+	__block int count = 0;
+	dispatch_sync(dispatch_get_main_queue(), ^{
+		count = g_device_count;
+	});
+
+	yyjson_mut_obj_add_bool(doc, reply, "tracing", atomic_load(&g_recorder.active));
+	yyjson_mut_obj_add_str(doc, reply, "gesture_priority", rt_class_name(g_gesture_class));
+	yyjson_mut_val* devices = yyjson_mut_obj_add_arr(doc, reply, "devices");
+	for (int i = 0; i < count; i++) {
+		gesture_device* device = &g_devices[i];
+		__block gesture_state state;
+		on_gesture_thread_sync(^{
+			state = gesture_set_state(&device->gesture);
+		});
+		yyjson_mut_arr_add_str(doc, devices, names[state]);
 	}
+	return true;
+}
 
-	float avg_x, avg_y, avg_vel, min_x, max_x, min_y, max_y;
-	calculate_touch_averages(touches, count, &avg_x, &avg_y, &avg_vel,
-		&min_x, &max_x, &min_y, &max_y);
+static bool control_config(__unused void* userdata, __unused yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	__block Config config;
+	dispatch_sync(g_query_queue, ^{
+		config = g_config;
+	});
 
-	if (ctx->state == GS_IDLE) {
-		handle_idle_state(ctx, touches, count, avg_x, avg_y, avg_vel);
-	} else if (ctx->state == GS_ARMED) {
-		handle_armed_state(ctx, touches, count, avg_x, avg_y, avg_vel);
-	}
+	config_to_json(&config, doc, yyjson_mut_obj_add_obj(doc, reply, "config"));
+	return true;
+}
 
-	for (int i = 0; i < count; ++i) {
-		ctx->prev_x[i] = touches[i].x;
-		if (ctx->state == GS_IDLE)
-			ctx->base_x[i] = touches[i].x;
-	}
+// g_config lives on the query queue, the device table on the event-tap thread
+// and the contexts on the gesture thread, so the new values are handed to each.
+static bool control_reload_config(void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	Config config = load_config();
+	bool haptic = config.haptic;
+	for (int i = 0; i < config.device_count; ++i)
+		haptic = haptic || config.devices[i].haptic == 1;
+	if (haptic && !g_haptic_count)
+		yyjson_mut_obj_add_str(doc, reply, "warning", "enabling haptics needs a restart");
+
+	dispatch_sync(g_query_queue, ^{
+		g_config = config;
+	});
+	pthread_mutex_lock(&g_pending_mutex);
+	if (config.switch_rate != g_throttle.rate || config.switch_burst != g_throttle.burst)
+		throttle_init(&g_throttle, config.switch_rate, config.switch_burst);
+	pthread_mutex_unlock(&g_pending_mutex);
+	log_set_level(log_level_parse(config.log_level, LOG_INFO));
+	tracer_enable(config.trace_events);
+	dispatch_sync(dispatch_get_main_queue(), ^{
+		g_device_config = config;
+		for (int i = 0; i < g_device_count; ++i) {
+			gesture_device* device = &g_devices[i];
+			gesture_recognizers params = gesture_recognizers_for_device(&config, i);
+			haptic_worker* worker = haptic_for_device(&config, i);
+			device->fingers = gesture_recognizers_fingers(&params);
+			on_gesture_thread(^{
+				gesture_set_configure(&device->gesture, &params);
+				device->haptic = worker;
+			});
+		}
+	});
+	return control_config(userdata, request, doc, reply);
+}
 
-unlock:
-	pthread_mutex_unlock(&g_gesture_mutex);
+static bool control_reset_stats(__unused void* userdata, __unused yyjson_val* request, __unused yyjson_mut_doc* doc, __unused yyjson_mut_val* reply)
+{
+	stats_reset(&g_stats);
+	tap_health_reset(&g_tap_health);
+	aerospace_conn_stats_reset(g_aerospace);
+	return true;
 }
 
-static void process_touches(NSSet<NSTouch*>* touches)
+static bool control_trace_start(__unused void* userdata, __unused yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
 {
-	NSUInteger buf_capacity = touches.count > 0 ? touches.count : 4;
-	touch* buf = malloc(sizeof(touch) * buf_capacity);
-	NSUInteger i = 0;
+	if (trace_recorder_start(&g_recorder))
+		return true;
+	yyjson_mut_obj_add_str(doc, reply, "error", "already tracing");
+	return false;
+}
 
-	for (NSTouch* touch in touches) {
-		if (touch.phase != (1 << 2)) {
-			if (i >= buf_capacity) {
-				buf_capacity *= 2;
-				buf = realloc(buf, sizeof(touch) * buf_capacity);
-			}
-			buf[i++] = [TouchConverter convert_nstouch:touch];
-		}
+static bool control_trace_stop(__unused void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	char path[512];
+	const char* requested = yyjson_get_str(yyjson_obj_get(request, "path"));
+	snprintf(path, sizeof(path), "%s", requested ? requested : "/tmp/aerospace-swipe.trace");
+
+	int frames = trace_recorder_stop(&g_recorder, path);
+	if (frames < 0) {
+		yyjson_mut_obj_add_str(doc, reply, "error", "not tracing or cannot write trace");
+		return false;
 	}
+	yyjson_mut_obj_add_strcpy(doc, reply, "path", path);
+	yyjson_mut_obj_add_int(doc, reply, "frames", frames);
+	return true;
+}
 
-	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-		gestureCallback(buf, (int)i);
-		free(buf);
-	});
+static bool control_trace_dump(__unused void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	char path[512];
+	const char* requested = yyjson_get_str(yyjson_obj_get(request, "path"));
+	snprintf(path, sizeof(path), "%s", requested ? requested : "/tmp/aerospace-swipe.json");
+
+	if (!tracer_enabled()) {
+		yyjson_mut_obj_add_str(doc, reply, "error", "trace_events is off in the config");
+		return false;
+	}
+	int events = tracer_dump(path);
+	if (events < 0) {
+		yyjson_mut_obj_add_str(doc, reply, "error", "cannot write trace");
+		return false;
+	}
+	yyjson_mut_obj_add_strcpy(doc, reply, "path", path);
+	yyjson_mut_obj_add_int(doc, reply, "events", events);
+	return true;
 }
 
+static const control_command g_control_commands[] = {
+	{ "stats", control_stats },
+	{ "state", control_state },
+	{ "config", control_config },
+	{ "reload-config", control_reload_config },
+	{ "reset-stats", control_reset_stats },
+	{ "trace-start", control_trace_start },
+	{ "trace-stop", control_trace_stop },
+	{ "trace-dump", control_trace_dump },
+};
+
 static CGEventRef key_handler(__unused CGEventTapProxy proxy, CGEventType type,
 	CGEventRef event, void* ref)
 {
 	struct event_tap* event_tap_ref = (struct event_tap*)ref;
+	uint64_t start = ipc_monotonic_ns();
 
 	if (!AXIsProcessTrusted()) {
-		NSLog(@"Accessibility permission lost, disabling tap.");
+		log_warn("Accessibility permission lost, disabling tap.");
 		event_tap_end(event_tap_ref);
 		return event;
 	}
 
+	// macOS turns the tap off when a callback overruns; say how often and
+	// what the callbacks looked like before re-enabling it
 	if (type == kCGEventTapDisabledByTimeout || type == kCGEventTapDisabledByUserInput) {
-		NSLog(@"Event-tap re-enabled.");
+		bool timeout = type == kCGEventTapDisabledByTimeout;
+		unsigned long long count = tap_health_disabled(&g_tap_health, timeout);
+		uint64_t p99, max;
+		tap_health_callback_summary(&g_tap_health, &p99, &max);
+		log_warn("Event-tap disabled by %s (%llu so far, callback p99=%.1fus max=%.1fus), re-enabling.",
+			timeout ? "timeout" : "user input", count, p99 / 1e3, max / 1e3);
 		CGEventTapEnable(event_tap_ref->handle, true);
 		return event;
 	}
 
-	if (type != NSEventTypeGesture)
+	if (type != NSEventTypeGesture) {
+		tap_health_callback(&g_tap_health, start, ipc_monotonic_ns(), false);
 		return event;
+	}
 
+	uint64_t convert_start = ipc_monotonic_ns();
 	NSEvent* ev = [NSEvent eventWithCGEvent:event];
 	NSSet<NSTouch*>* touches = ev.allTouches;
+	tap_health_conversion(&g_tap_health, ipc_monotonic_ns() - convert_start);
 
-	if (!touches.count)
-		return event;
-
-	process_touches(touches);
+	if (touches.count)
+		process_touches(touches);
 
+	tap_health_callback(&g_tap_health, start, ipc_monotonic_ns(), touches.count > 0);
+	tracer_span("tap", "callback", start, "touches", (int64_t)touches.count);
 	return event;
 }
 
@@ -347,13 +924,19 @@ int main(int argc, const char* argv[])
 		NSLog(@"Accessibility permission granted. Continuing app initialization...");
 
 		g_config = load_config();
-		NSLog(@"Loaded config: fingers=%d, skip_empty=%s, wrap_around=%s, haptic=%s, swipe_left='%s', swipe_right='%s'",
+		throttle_init(&g_throttle, g_config.switch_rate, g_config.switch_burst);
+		NSLog(@"Loaded config: fingers=%d, skip_empty=%s, wrap_around=%s, haptic=%s, swipe_left='%s', swipe_right='%s', monitor='%s'",
 			g_config.fingers,
 			g_config.skip_empty ? "YES" : "NO",
 			g_config.wrap_around ? "YES" : "NO",
 			g_config.haptic ? "YES" : "NO",
 			g_config.swipe_left,
-			g_config.swipe_right);
+			g_config.swipe_right,
+			g_config.monitor);
+
+		log_start(log_level_parse(g_config.log_level, LOG_INFO), stdout, stderr);
+		atexit(log_stop);
+		tracer_enable(g_config.trace_events);
 
 		g_aerospace = aerospace_new(NULL);
 		if (!g_aerospace) {
@@ -361,8 +944,33 @@ int main(int argc, const char* argv[])
 			exit(EXIT_FAILURE);
 		}
 
-		if (g_config.haptic && !(g_haptic = haptic_open_default())) {
-			fprintf(stderr, "Error: Failed to initialize haptic actuator.\n");
+		bool haptic = g_config.haptic;
+		for (int i = 0; i < g_config.device_count; ++i)
+			haptic = haptic || g_config.devices[i].haptic == 1;
+		if (haptic) {
+			// each worker owns its actuator; the array only hands them over
+			CFMutableArrayRef actuators = haptic_open_all();
+			CFIndex count = CFArrayGetCount(actuators);
+			for (CFIndex i = 0; i < count && g_haptic_count < MAX_DEVICES; ++i) {
+				CFTypeRef actuator = CFRetain(CFArrayGetValueAtIndex(actuators, i));
+				haptic_worker* worker = haptic_worker_start(haptic_backend_mt(actuator));
+				if (worker)
+					g_haptics[g_haptic_count++] = worker;
+				else
+					haptic_close(actuator);
+			}
+			CFRelease(actuators);
+			if (!g_haptic_count) {
+				fprintf(stderr, "Error: Failed to initialize haptic actuator.\n");
+				aerospace_close(g_aerospace);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		g_command_queue = dispatch_queue_create("com.acsandmann.swipe.command", DISPATCH_QUEUE_SERIAL);
+		g_query_queue = dispatch_queue_create("com.acsandmann.swipe.query", DISPATCH_QUEUE_SERIAL);
+		if (!start_gesture_thread()) {
+			fprintf(stderr, "Error: Failed to start the gesture thread.\n");
 			aerospace_close(g_aerospace);
 			exit(EXIT_FAILURE);
 		}
@@ -371,6 +979,16 @@ int main(int argc, const char* argv[])
 			&kCFTypeDictionaryKeyCallBacks,
 			NULL);
 
+		g_device_config = g_config;
+		stats_init(&g_stats);
+		trace_recorder_init(&g_recorder);
+		tap_health_init(&g_tap_health);
+
+		char control_path[108];
+		control_default_path(control_path, sizeof(control_path));
+		g_control = control_start(control_path, g_control_commands,
+			sizeof(g_control_commands) / sizeof(g_control_commands[0]), NULL);
+
 		event_tap_begin(&g_event_tap, key_handler);
 
 		return NSApplicationMain(argc, argv);
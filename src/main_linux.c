@@ -0,0 +1,344 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "control.h"
+#include "gesture.h"
+#include "input_evdev.h"
+#include "log.h"
+#include "rt_thread.h"
+#include "stats.h"
+#include "switch_queue.h"
+#include "trace.h"
+#include "tracer.h"
+#include "wm.h"
+
+#define MAX_DEVICES 4
+#define MAX_WM_CONNS 4
+
+static Config g_config;
+static wm_backend* g_wm;
+static input_backend* g_input;
+static gesture_set g_gestures[MAX_DEVICES];
+static gesture_filter g_filters[MAX_DEVICES]; // input thread only
+static atomic_int g_gesture_states[MAX_DEVICES]; // mirrors for the control thread
+static swipe_stats g_stats;
+static trace_recorder g_recorder;
+static switch_queue g_switch; // fired gestures on their way to the WM
+static rt_class g_gesture_class; // what the input thread got
+static int g_input_rc;
+
+// reload-config parses on the control thread and wakes the input thread,
+// which applies the result between frames, so the engine never sees a
+// half-written config and an idle pad does not hold it back
+static pthread_mutex_t g_config_lock = PTHREAD_MUTEX_INITIALIZER;
+static Config g_pending_config;
+static atomic_bool g_config_pending;
+
+static void gesture_armed(__attribute__((unused)) gesture_ctx* ctx)
+{
+	stats_inc(&g_stats.armed);
+}
+
+static void gesture_fired(gesture_ctx* ctx, int direction)
+{
+	stats_fired(&g_stats, direction);
+	trace_recorder_fire(&g_recorder, direction);
+
+	int index = gesture_set_index(gesture_set_of(ctx), ctx);
+	if (index != 0 || abs(direction) != GESTURE_AXIS_HORIZONTAL) {
+		const char* command = config_gesture_action(&g_config, index, direction);
+		if (command[0])
+			switch_queue_action(&g_switch, command);
+		return;
+	}
+
+	const char* ws = direction > 0 ? g_config.swipe_right : g_config.swipe_left;
+	switch_queue_steps(&g_switch, strcmp(ws, "next") == 0 ? ctx->fire_steps : -ctx->fire_steps);
+}
+
+static wm_options wm_options_from_config(const Config* config)
+{
+	wm_options options = {
+		.wrap_around = config->wrap_around,
+		.skip_empty = config->skip_empty,
+	};
+	snprintf(options.monitor, sizeof(options.monitor), "%s", config->monitor);
+	return options;
+}
+
+static void apply_pending_config(void)
+{
+	pthread_mutex_lock(&g_config_lock);
+	g_config = g_pending_config;
+	atomic_store(&g_config_pending, false);
+	pthread_mutex_unlock(&g_config_lock);
+
+	log_set_level(log_level_parse(g_config.log_level, LOG_INFO));
+	tracer_enable(g_config.trace_events);
+
+	for (int i = 0; i < MAX_DEVICES; i++) {
+		gesture_recognizers recognizers = gesture_recognizers_for_device(&g_config, i);
+		gesture_set_configure(&g_gestures[i], &recognizers);
+	}
+
+	switch_queue_configure(&g_switch, wm_options_from_config(&g_config), g_config.switch_rate, g_config.switch_burst);
+}
+
+static void on_frame(__attribute__((unused)) void* userdata, uint64_t device, const touch* touches, int count)
+{
+	// device 0 is input->wake()
+	if (atomic_load_explicit(&g_config_pending, memory_order_acquire))
+		apply_pending_config();
+
+	if (device == 0 || device > MAX_DEVICES)
+		return;
+
+	trace_recorder_frame(&g_recorder, touches, count);
+	gesture_set* set = &g_gestures[device - 1];
+	if (!gesture_filter_pass(&g_filters[device - 1], gesture_set_fingers(set), count, gesture_phases(touches, count))) {
+		stats_inc(&g_stats.prefiltered);
+		return;
+	}
+	stats_inc(&g_stats.frames);
+
+	gesture_set_process(set, touches, count);
+	atomic_store_explicit(&g_gesture_states[device - 1], gesture_set_state(set), memory_order_relaxed);
+}
+
+// Reads the pads and runs the engine; everything else stays off this thread
+// so it can run at the raised class.
+static void* input_thread(__attribute__((unused)) void* arg)
+{
+	g_input_rc = g_input->run(g_input, on_frame, NULL);
+	return NULL;
+}
+
+static bool control_stats(__attribute__((unused)) void* userdata, __attribute__((unused)) yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	stats_to_json(&g_stats, doc, reply);
+	yyjson_mut_obj_add_val(doc, reply, "log", stats_log_json(doc));
+
+	wm_conn_stats conns[MAX_WM_CONNS];
+	int count = g_wm->conn_stats(g_wm, conns, MAX_WM_CONNS);
+	yyjson_mut_val* ipc = yyjson_mut_obj_add_arr(doc, reply, "ipc");
+	for (int i = 0; i < count; i++)
+		yyjson_mut_arr_append(ipc, stats_ipc_json(doc, conns[i].name, &conns[i].stats));
+	return true;
+}
+
+static bool control_state(__attribute__((unused)) void* userdata, __attribute__((unused)) yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	static const char* names[] = { "idle", "armed", "committed" };
+
+	yyjson_mut_obj_add_str(doc, reply, "wm", g_wm->name);
+	yyjson_mut_obj_add_str(doc, reply, "gesture_priority", rt_class_name(g_gesture_class));
+	yyjson_mut_obj_add_bool(doc, reply, "tracing", atomic_load(&g_recorder.active));
+	yyjson_mut_val* devices = yyjson_mut_obj_add_arr(doc, reply, "devices");
+	for (int i = 0; i < MAX_DEVICES; i++)
+		yyjson_mut_arr_add_str(doc, devices, names[atomic_load_explicit(&g_gesture_states[i], memory_order_relaxed)]);
+
+	int steps, actions;
+	switch_queue_pending(&g_switch, &steps, &actions);
+	yyjson_mut_obj_add_int(doc, reply, "pending_steps", steps);
+	yyjson_mut_obj_add_int(doc, reply, "pending_actions", actions);
+	return true;
+}
+
+static bool control_config(__attribute__((unused)) void* userdata, __attribute__((unused)) yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	pthread_mutex_lock(&g_config_lock);
+	Config config = atomic_load(&g_config_pending) ? g_pending_config : g_config;
+	pthread_mutex_unlock(&g_config_lock);
+
+	config_to_json(&config, doc, yyjson_mut_obj_add_obj(doc, reply, "config"));
+	return true;
+}
+
+static bool control_reload_config(__attribute__((unused)) void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	Config config = load_config();
+
+	pthread_mutex_lock(&g_config_lock);
+	if (strcmp(config.wm, g_config.wm) != 0)
+		yyjson_mut_obj_add_str(doc, reply, "warning", "wm changes need a restart");
+	g_pending_config = config;
+	atomic_store_explicit(&g_config_pending, true, memory_order_release);
+	pthread_mutex_unlock(&g_config_lock);
+	g_input->wake(g_input);
+	return control_config(userdata, request, doc, reply);
+}
+
+static bool control_reset_stats(__attribute__((unused)) void* userdata, __attribute__((unused)) yyjson_val* request, __attribute__((unused)) yyjson_mut_doc* doc, __attribute__((unused)) yyjson_mut_val* reply)
+{
+	stats_reset(&g_stats);
+	g_wm->reset_stats(g_wm);
+	return true;
+}
+
+static bool control_trace_start(__attribute__((unused)) void* userdata, __attribute__((unused)) yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	if (trace_recorder_start(&g_recorder))
+		return true;
+	yyjson_mut_obj_add_str(doc, reply, "error", "already tracing");
+	return false;
+}
+
+static bool control_trace_stop(__attribute__((unused)) void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	char path[512];
+	const char* requested = yyjson_get_str(yyjson_obj_get(request, "path"));
+	snprintf(path, sizeof(path), "%s", requested ? requested : "/tmp/aerospace-swipe.trace");
+
+	int frames = trace_recorder_stop(&g_recorder, path);
+	if (frames < 0) {
+		yyjson_mut_obj_add_str(doc, reply, "error", "not tracing or cannot write trace");
+		return false;
+	}
+	yyjson_mut_obj_add_strcpy(doc, reply, "path", path);
+	yyjson_mut_obj_add_int(doc, reply, "frames", frames);
+	return true;
+}
+
+static bool control_trace_dump(__attribute__((unused)) void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	char path[512];
+	const char* requested = yyjson_get_str(yyjson_obj_get(request, "path"));
+	snprintf(path, sizeof(path), "%s", requested ? requested : "/tmp/aerospace-swipe.json");
+
+	if (!tracer_enabled()) {
+		yyjson_mut_obj_add_str(doc, reply, "error", "trace_events is off in the config");
+		return false;
+	}
+	int events = tracer_dump(path);
+	if (events < 0) {
+		yyjson_mut_obj_add_str(doc, reply, "error", "cannot write trace");
+		return false;
+	}
+	yyjson_mut_obj_add_strcpy(doc, reply, "path", path);
+	yyjson_mut_obj_add_int(doc, reply, "events", events);
+	return true;
+}
+
+static const control_command g_control_commands[] = {
+	{ "stats", control_stats },
+	{ "state", control_state },
+	{ "config", control_config },
+	{ "reload-config", control_reload_config },
+	{ "reset-stats", control_reset_stats },
+	{ "trace-start", control_trace_start },
+	{ "trace-stop", control_trace_stop },
+	{ "trace-dump", control_trace_dump },
+};
+
+static void handle_signal(__attribute__((unused)) int sig)
+{
+	if (g_input)
+		g_input->stop(g_input);
+}
+
+static wm_backend* open_wm(void)
+{
+	wm_options options = wm_options_from_config(&g_config);
+
+	if (strcmp(g_config.wm, "aerospace") == 0)
+		return wm_aerospace_new(aerospace_new(NULL), options);
+	if (strcmp(g_config.wm, "i3") == 0 || strcmp(g_config.wm, "sway") == 0)
+		return wm_i3_new(NULL, options);
+
+	fprintf(stderr, "Error: Unknown wm '%s'\n", g_config.wm);
+	return NULL;
+}
+
+int main(int argc, const char* argv[])
+{
+	signal(SIGPIPE, SIG_IGN);
+
+	g_config = load_config();
+	printf("Loaded config: fingers=%d, skip_empty=%s, wrap_around=%s, swipe_left='%s', swipe_right='%s', wm='%s'\n",
+		g_config.fingers,
+		g_config.skip_empty ? "YES" : "NO",
+		g_config.wrap_around ? "YES" : "NO",
+		g_config.swipe_left,
+		g_config.swipe_right,
+		g_config.wm);
+
+	// exit paths below still flush what the other threads queued
+	log_start(log_level_parse(g_config.log_level, LOG_INFO), stdout, stderr);
+	atexit(log_stop);
+	tracer_enable(g_config.trace_events);
+
+	g_wm = open_wm();
+	if (!g_wm) {
+		fprintf(stderr, "Error: Failed to connect to window manager '%s'.\n", g_config.wm);
+		exit(EXIT_FAILURE);
+	}
+
+	// touchpads come from argv, or every pointer with multitouch axes
+	char found[MAX_DEVICES][EVDEV_PATH_MAX];
+	const char* paths[MAX_DEVICES];
+	int count = 0;
+	if (argc > 1) {
+		for (int i = 1; i < argc && count < MAX_DEVICES; i++)
+			paths[count++] = argv[i];
+	} else {
+		count = input_evdev_scan(found, MAX_DEVICES);
+		for (int i = 0; i < count; i++)
+			paths[i] = found[i];
+	}
+
+	g_input = count > 0 ? input_evdev_open(paths, count) : NULL;
+	if (!g_input) {
+		fprintf(stderr, "Error: No usable touchpad (is the user in the 'input' group?)\n");
+		g_wm->close(g_wm);
+		exit(EXIT_FAILURE);
+	}
+
+	stats_init(&g_stats);
+	trace_recorder_init(&g_recorder);
+
+	gesture_callbacks callbacks = { .armed = gesture_armed, .fired = gesture_fired };
+	for (int i = 0; i < MAX_DEVICES; i++) {
+		gesture_recognizers recognizers = gesture_recognizers_for_device(&g_config, i);
+		gesture_set_init(&g_gestures[i], &recognizers, callbacks, NULL);
+	}
+
+	if (!switch_queue_start(&g_switch, g_wm, &g_stats, g_config.switch_rate, g_config.switch_burst)) {
+		fprintf(stderr, "Error: Failed to start the switch thread.\n");
+		g_input->close(g_input);
+		g_wm->close(g_wm);
+		exit(EXIT_FAILURE);
+	}
+
+	char control_path[108];
+	control_default_path(control_path, sizeof(control_path));
+	control_server* control = control_start(control_path, g_control_commands,
+		sizeof(g_control_commands) / sizeof(g_control_commands[0]), NULL);
+
+	struct sigaction sa = { .sa_handler = handle_signal };
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	rt_params priority = rt_params_gesture(rt_class_parse(g_config.gesture_priority, RT_CLASS_REALTIME));
+	pthread_t input;
+	int rc = -1;
+	if (rt_thread_start(&input, "swipe-input", &priority, input_thread, NULL, &g_gesture_class)) {
+		log_info("Input thread scheduling: %s (asked for %s)", rt_class_name(g_gesture_class), rt_class_name(priority.want));
+		pthread_join(input, NULL);
+		rc = g_input_rc;
+	} else {
+		log_error("Error: Failed to start the input thread.");
+	}
+
+	control_stop(control);
+
+	switch_queue_stop(&g_switch);
+
+	g_input->close(g_input);
+	g_wm->close(g_wm);
+	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
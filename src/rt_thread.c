@@ -0,0 +1,159 @@
+#ifndef __APPLE__
+#define _GNU_SOURCE // pthread_setname_np
+#endif
+#include "rt_thread.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#include <pthread/qos.h>
+#else
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define RT_NICE -10
+
+static const char* const CLASS_NAMES[] = { "default", "high", "realtime" };
+
+rt_params rt_params_gesture(rt_class want)
+{
+	return (rt_params) {
+		.want = want,
+		.period_ns = 8333333, // 120 Hz
+		.compute_ns = 500000,
+		.constraint_ns = 2000000,
+	};
+}
+
+rt_class rt_class_parse(const char* name, rt_class fallback)
+{
+	for (int c = RT_CLASS_DEFAULT; c <= RT_CLASS_REALTIME; c++) {
+		if (name && strcmp(name, CLASS_NAMES[c]) == 0)
+			return c;
+	}
+	return fallback;
+}
+
+const char* rt_class_name(rt_class c)
+{
+	return c >= RT_CLASS_DEFAULT && c <= RT_CLASS_REALTIME ? CLASS_NAMES[c] : "unknown";
+}
+
+#ifdef __APPLE__
+
+static uint32_t mach_ticks(uint64_t ns)
+{
+	mach_timebase_info_data_t tb;
+	mach_timebase_info(&tb);
+	return (uint32_t)(ns * tb.denom / tb.numer);
+}
+
+rt_class rt_thread_promote(const rt_params* params)
+{
+	if (params->want >= RT_CLASS_REALTIME) {
+		thread_time_constraint_policy_data_t policy = {
+			.period = mach_ticks(params->period_ns),
+			.computation = mach_ticks(params->compute_ns),
+			.constraint = mach_ticks(params->constraint_ns > params->compute_ns ? params->constraint_ns : params->compute_ns),
+			.preemptible = TRUE,
+		};
+		kern_return_t kr = thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+			(thread_policy_t)&policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+		if (kr == KERN_SUCCESS)
+			return RT_CLASS_REALTIME;
+	}
+	if (params->want >= RT_CLASS_HIGH && pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0) == 0)
+		return RT_CLASS_HIGH;
+	return RT_CLASS_DEFAULT;
+}
+
+static void set_name(const char* name)
+{
+	pthread_setname_np(name);
+}
+
+#else
+
+rt_class rt_thread_promote(const rt_params* params)
+{
+	if (params->want >= RT_CLASS_REALTIME) {
+		int policy = params->round_robin ? SCHED_RR : SCHED_FIFO;
+		int lo = sched_get_priority_min(policy), hi = sched_get_priority_max(policy);
+		int priority = params->priority ? params->priority : lo + 1;
+		struct sched_param sp = { .sched_priority = priority < lo ? lo : priority > hi ? hi : priority };
+		if (pthread_setschedparam(pthread_self(), policy, &sp) == 0)
+			return RT_CLASS_REALTIME;
+	}
+	// nice is per thread on linux
+	if (params->want >= RT_CLASS_HIGH && setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), RT_NICE) == 0)
+		return RT_CLASS_HIGH;
+	return RT_CLASS_DEFAULT;
+}
+
+static void set_name(const char* name)
+{
+	char short_name[16]; // the kernel keeps 15 characters
+	snprintf(short_name, sizeof(short_name), "%s", name);
+	pthread_setname_np(pthread_self(), short_name);
+}
+
+#endif
+
+typedef struct {
+	const char* name;
+	const rt_params* params;
+	void* (*fn)(void*);
+	void* arg;
+	rt_class got;
+	bool ready;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} rt_start;
+
+static void* trampoline(void* p)
+{
+	rt_start* start = p;
+	void* (*fn)(void*) = start->fn;
+	void* arg = start->arg;
+
+	set_name(start->name);
+	rt_class got = rt_thread_promote(start->params);
+
+	// start lives on the starting thread's stack until ready is seen
+	pthread_mutex_lock(&start->lock);
+	start->got = got;
+	start->ready = true;
+	pthread_cond_signal(&start->cond);
+	pthread_mutex_unlock(&start->lock);
+
+	return fn(arg);
+}
+
+bool rt_thread_start(pthread_t* thread, const char* name, const rt_params* params, void* (*fn)(void*), void* arg,
+	rt_class* got)
+{
+	rt_start start = { .name = name, .params = params, .fn = fn, .arg = arg };
+	pthread_mutex_init(&start.lock, NULL);
+	pthread_cond_init(&start.cond, NULL);
+
+	bool ok = pthread_create(thread, NULL, trampoline, &start) == 0;
+	if (ok) {
+		pthread_mutex_lock(&start.lock);
+		while (!start.ready)
+			pthread_cond_wait(&start.cond, &start.lock);
+		pthread_mutex_unlock(&start.lock);
+		if (got)
+			*got = start.got;
+	}
+
+	pthread_cond_destroy(&start.cond);
+	pthread_mutex_destroy(&start.lock);
+	return ok;
+}
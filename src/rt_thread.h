@@ -0,0 +1,39 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Scheduling class for the thread that turns touches into gestures, so a
+// compile job or a video call can't make it run late. One call for both
+// platforms; each steps down a class when the system refuses one (no
+// CAP_SYS_NICE or RLIMIT_RTPRIO on linux) and reports where it landed.
+
+typedef enum {
+	RT_CLASS_DEFAULT, // as created
+	RT_CLASS_HIGH, // user-interactive QoS (macOS), nice -10 (linux)
+	RT_CLASS_REALTIME, // Mach time-constraint policy (macOS), SCHED_FIFO or SCHED_RR (linux)
+} rt_class;
+
+typedef struct {
+	rt_class want; // the most to ask for
+	uint64_t period_ns; // how often work arrives; 0 if it is not periodic
+	uint64_t compute_ns; // work per period
+	uint64_t constraint_ns; // from arrival to done; at least compute_ns
+	bool round_robin; // SCHED_RR rather than SCHED_FIFO
+	int priority; // SCHED_FIFO/RR priority, 0 for a low one
+} rt_params;
+
+// A ~120 Hz touch stream taking well under a millisecond per frame.
+rt_params rt_params_gesture(rt_class want);
+
+// "default", "high" or "realtime"; fallback if name is none of them.
+rt_class rt_class_parse(const char* name, rt_class fallback);
+const char* rt_class_name(rt_class c);
+
+// Raises the calling thread as far as params->want and the system allow.
+rt_class rt_thread_promote(const rt_params* params);
+
+// Runs fn(arg) on a new thread named name that promotes itself first;
+// *got (may be NULL) is set before fn runs.
+bool rt_thread_start(pthread_t* thread, const char* name, const rt_params* params, void* (*fn)(void*), void* arg,
+	rt_class* got);
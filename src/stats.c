@@ -0,0 +1,122 @@
+#include "stats.h"
+
+#include <string.h>
+
+static unsigned long long load(atomic_ullong* counter)
+{
+	return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void clear(atomic_ullong* counter)
+{
+	atomic_store_explicit(counter, 0, memory_order_relaxed);
+}
+
+void stats_init(swipe_stats* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	pthread_mutex_init(&stats->lock, NULL);
+	stats->started_ns = ipc_monotonic_ns();
+}
+
+void stats_reset(swipe_stats* stats)
+{
+	clear(&stats->frames);
+	clear(&stats->prefiltered);
+	clear(&stats->armed);
+	for (int i = 0; i < GESTURE_DIRECTIONS; i++)
+		clear(&stats->fired[i]);
+	clear(&stats->cache_hits);
+	clear(&stats->cache_misses);
+	clear(&stats->switch_errors);
+	clear(&stats->coalesced);
+	clear(&stats->throttled);
+	clear(&stats->dropped);
+
+	pthread_mutex_lock(&stats->lock);
+	histogram_reset(&stats->switch_latency);
+	stats->started_ns = ipc_monotonic_ns();
+	pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_fired(swipe_stats* stats, int direction)
+{
+	if (gesture_direction_name(direction))
+		stats_inc(&stats->fired[direction + GESTURE_DIRECTION_MAX]);
+}
+
+void stats_switch(swipe_stats* stats, uint64_t latency_ns, bool ok)
+{
+	if (!ok) {
+		stats_inc(&stats->switch_errors);
+		return;
+	}
+
+	pthread_mutex_lock(&stats->lock);
+	histogram_record(&stats->switch_latency, latency_ns);
+	pthread_mutex_unlock(&stats->lock);
+}
+
+yyjson_mut_val* stats_latency_json(yyjson_mut_doc* doc, const histogram* h)
+{
+	yyjson_mut_val* obj = yyjson_mut_obj(doc);
+	yyjson_mut_obj_add_uint(doc, obj, "count", h->count);
+	yyjson_mut_obj_add_real(doc, obj, "p50_us", histogram_percentile(h, 0.50) / 1e3);
+	yyjson_mut_obj_add_real(doc, obj, "p90_us", histogram_percentile(h, 0.90) / 1e3);
+	yyjson_mut_obj_add_real(doc, obj, "p99_us", histogram_percentile(h, 0.99) / 1e3);
+	yyjson_mut_obj_add_real(doc, obj, "max_us", h->max / 1e3);
+	return obj;
+}
+
+void stats_to_json(swipe_stats* stats, yyjson_mut_doc* doc, yyjson_mut_val* obj)
+{
+	pthread_mutex_lock(&stats->lock);
+	histogram latency = stats->switch_latency;
+	uint64_t started_ns = stats->started_ns;
+	pthread_mutex_unlock(&stats->lock);
+
+	yyjson_mut_obj_add_real(doc, obj, "uptime_s", (ipc_monotonic_ns() - started_ns) / 1e9);
+	yyjson_mut_obj_add_uint(doc, obj, "frames", load(&stats->frames));
+	yyjson_mut_obj_add_uint(doc, obj, "prefiltered", load(&stats->prefiltered));
+	yyjson_mut_obj_add_uint(doc, obj, "armed", load(&stats->armed));
+
+	yyjson_mut_val* fired = yyjson_mut_obj_add_obj(doc, obj, "fired");
+	for (int direction = -GESTURE_DIRECTION_MAX; direction <= GESTURE_DIRECTION_MAX; direction++) {
+		const char* name = gesture_direction_name(direction);
+		if (name)
+			yyjson_mut_obj_add_uint(doc, fired, name, load(&stats->fired[direction + GESTURE_DIRECTION_MAX]));
+	}
+
+	yyjson_mut_val* cache = yyjson_mut_obj_add_obj(doc, obj, "cache");
+	yyjson_mut_obj_add_uint(doc, cache, "hits", load(&stats->cache_hits));
+	yyjson_mut_obj_add_uint(doc, cache, "misses", load(&stats->cache_misses));
+
+	yyjson_mut_obj_add_uint(doc, obj, "switch_errors", load(&stats->switch_errors));
+	yyjson_mut_obj_add_uint(doc, obj, "coalesced", load(&stats->coalesced));
+	yyjson_mut_obj_add_uint(doc, obj, "throttled", load(&stats->throttled));
+	yyjson_mut_obj_add_uint(doc, obj, "dropped", load(&stats->dropped));
+	yyjson_mut_obj_add_val(doc, obj, "switch_latency", stats_latency_json(doc, &latency));
+}
+
+yyjson_mut_val* stats_ipc_json(yyjson_mut_doc* doc, const char* name, const ipc_conn_stats* st)
+{
+	yyjson_mut_val* obj = stats_latency_json(doc, &st->latency);
+	yyjson_mut_obj_add_str(doc, obj, "name", name);
+	yyjson_mut_obj_add_uint(doc, obj, "requests", st->requests);
+	yyjson_mut_obj_add_uint(doc, obj, "errors", st->errors);
+	yyjson_mut_obj_add_uint(doc, obj, "reconnects", st->reconnects);
+	return obj;
+}
+
+yyjson_mut_val* stats_log_json(yyjson_mut_doc* doc)
+{
+	log_stats st;
+	log_stats_get(&st);
+
+	yyjson_mut_val* obj = yyjson_mut_obj(doc);
+	yyjson_mut_obj_add_uint(doc, obj, "written", st.written);
+	yyjson_mut_obj_add_uint(doc, obj, "dropped", st.dropped);
+	yyjson_mut_obj_add_uint(doc, obj, "truncated", st.truncated);
+	yyjson_mut_obj_add_uint(doc, obj, "wakeups", st.wakeups);
+	return obj;
+}
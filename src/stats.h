@@ -0,0 +1,53 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gesture.h"
+#include "histogram.h"
+#include "ipc.h"
+#include "log.h"
+#include "yyjson.h"
+
+// Daemon-wide counters reported by the control socket. Counters are relaxed
+// atomics bumped from the gesture threads; the latency histogram sits behind
+// a lock that is only contended while a query reads it.
+typedef struct {
+	uint64_t started_ns;
+	atomic_ullong frames;
+	atomic_ullong prefiltered; // frames dropped before conversion
+	atomic_ullong armed;
+	atomic_ullong fired[GESTURE_DIRECTIONS]; // by direction + GESTURE_DIRECTION_MAX
+	atomic_ullong cache_hits, cache_misses;
+	atomic_ullong switch_errors;
+	atomic_ullong coalesced; // switches folded into a later one before being sent
+	atomic_ullong throttled; // commands held back by the rate limit
+	atomic_ullong dropped; // commands refused because too many were waiting
+
+	pthread_mutex_t lock;
+	histogram switch_latency; // gesture fired to the WM's reply
+} swipe_stats;
+
+void stats_init(swipe_stats* stats);
+void stats_reset(swipe_stats* stats);
+
+static inline void stats_inc(atomic_ullong* counter)
+{
+	atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+void stats_fired(swipe_stats* stats, int direction);
+void stats_switch(swipe_stats* stats, uint64_t latency_ns, bool ok);
+
+// Adds the counters to obj.
+void stats_to_json(swipe_stats* stats, yyjson_mut_doc* doc, yyjson_mut_val* obj);
+
+// count plus p50/p90/p99/max in microseconds.
+yyjson_mut_val* stats_latency_json(yyjson_mut_doc* doc, const histogram* h);
+
+// One connection's counters and latency percentiles (in microseconds).
+yyjson_mut_val* stats_ipc_json(yyjson_mut_doc* doc, const char* name, const ipc_conn_stats* st);
+
+// The logger's written/dropped/truncated record counts.
+yyjson_mut_val* stats_log_json(yyjson_mut_doc* doc);
@@ -0,0 +1,83 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "yyjson.h"
+
+// Command-line client for the control socket:
+//   swipectl stats | state | config | reload-config | reset-stats | help
+//   swipectl trace-start
+//   swipectl trace-stop [path]
+
+static int usage(void)
+{
+	fprintf(stderr, "usage: swipectl [-s socket] <command> [path]\n");
+	return 2;
+}
+
+int main(int argc, char* argv[])
+{
+	char path[108];
+	control_default_path(path, sizeof(path));
+
+	int arg = 1;
+	if (arg + 1 < argc && strcmp(argv[arg], "-s") == 0) {
+		snprintf(path, sizeof(path), "%s", argv[arg + 1]);
+		arg += 2;
+	}
+	if (arg >= argc)
+		return usage();
+
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* root = yyjson_mut_obj(doc);
+	yyjson_mut_doc_set_root(doc, root);
+	yyjson_mut_obj_add_str(doc, root, "command", argv[arg]);
+	if (arg + 1 < argc)
+		yyjson_mut_obj_add_str(doc, root, "path", argv[arg + 1]);
+
+	size_t len;
+	char* request = yyjson_mut_write(doc, 0, &len);
+	yyjson_mut_doc_free(doc);
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		fprintf(stderr, "swipectl: cannot connect to %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	request[len] = '\n'; // replaces the terminator; len + 1 bytes go out
+	if (write(fd, request, len + 1) != (ssize_t)(len + 1)) {
+		fprintf(stderr, "swipectl: write failed: %s\n", strerror(errno));
+		return 1;
+	}
+	free(request);
+	shutdown(fd, SHUT_WR);
+
+	char reply[65536];
+	size_t got = 0;
+	ssize_t n;
+	while (got < sizeof(reply) && (n = read(fd, reply + got, sizeof(reply) - got)) > 0)
+		got += (size_t)n;
+	close(fd);
+
+	yyjson_doc* resp = yyjson_read(reply, got, 0);
+	if (!resp) {
+		fprintf(stderr, "swipectl: malformed reply\n");
+		return 1;
+	}
+
+	char* pretty = yyjson_write(resp, YYJSON_WRITE_PRETTY, NULL);
+	puts(pretty ? pretty : "");
+	free(pretty);
+
+	bool ok = yyjson_get_bool(yyjson_obj_get(yyjson_doc_get_root(resp), "ok"));
+	yyjson_doc_free(resp);
+	return ok ? 0 : 1;
+}
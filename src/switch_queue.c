@@ -0,0 +1,178 @@
+#include "switch_queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+#include "tracer.h"
+
+static void note_depth(switch_queue* q)
+{
+	int depth = (q->action[0] != 0) + (q->pending_steps != 0);
+	if (depth > q->peak_depth)
+		q->peak_depth = depth;
+}
+
+// Waits on the condition for at most ns; the lock is held.
+static void wait_for(switch_queue* q, uint64_t ns)
+{
+	struct timespec until;
+	clock_gettime(CLOCK_MONOTONIC, &until);
+	uint64_t nsec = (uint64_t)until.tv_nsec + ns;
+	until.tv_sec += nsec / 1000000000ull;
+	until.tv_nsec = nsec % 1000000000ull;
+	pthread_cond_timedwait(&q->cond, &q->lock, &until);
+}
+
+static void* switch_thread(void* arg)
+{
+	switch_queue* q = arg;
+	tracer_thread_name("switch");
+	pthread_mutex_lock(&q->lock);
+	while (q->running) {
+		if (!q->action[0] && q->pending_steps == 0) {
+			pthread_cond_wait(&q->cond, &q->lock);
+			continue;
+		}
+
+		// swipes that land while this waits fold into the pending steps
+		uint64_t wait = throttle_take(&q->limit, ipc_monotonic_ns());
+		if (wait) {
+			if (!q->held)
+				stats_inc(&q->stats->throttled);
+			q->held = true;
+			tracer_instant("coalesce", "throttled", "wait_us", (int64_t)(wait / 1000));
+			wait_for(q, wait);
+			continue;
+		}
+		q->held = false;
+
+		if (q->action[0] && (q->action_first || q->pending_steps == 0)) {
+			char command[SWITCH_COMMAND_MAX];
+			memcpy(command, q->action, sizeof(command));
+			uint64_t since = q->action_since_ns;
+			q->action[0] = '\0';
+			pthread_mutex_unlock(&q->lock);
+
+			uint64_t start = tracer_begin();
+			bool ok = q->wm->run_command(q->wm, command);
+			tracer_end("wm", "run_command", start, NULL, 0);
+			stats_switch(q->stats, ipc_monotonic_ns() - since, ok);
+			if (!ok)
+				log_error("Error: Failed to run '%s'", command);
+
+			pthread_mutex_lock(&q->lock);
+			continue;
+		}
+
+		int steps = q->pending_steps;
+		tracer_span("coalesce", "pending", q->pending_since_ns, "net_steps", steps);
+		q->pending_steps = 0;
+		uint64_t since = q->pending_since_ns;
+		q->wm->options = q->options;
+		pthread_mutex_unlock(&q->lock);
+
+		uint64_t start = tracer_begin();
+		bool ok = q->wm->switch_workspace(q->wm, steps);
+		tracer_end("wm", "switch_workspace", start, "step", steps);
+		stats_switch(q->stats, ipc_monotonic_ns() - since, ok);
+		if (!ok)
+			log_error("Error: Failed to switch workspace (%s %d)", steps > 0 ? "next" : "prev", abs(steps));
+
+		pthread_mutex_lock(&q->lock);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return NULL;
+}
+
+bool switch_queue_start(switch_queue* q, wm_backend* wm, swipe_stats* stats, double rate, int burst)
+{
+	memset(q, 0, sizeof(*q));
+	q->wm = wm;
+	q->stats = stats;
+	q->options = wm->options;
+	q->running = true;
+	throttle_init(&q->limit, rate, burst);
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&q->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&q->lock, NULL);
+
+	if (pthread_create(&q->thread, NULL, switch_thread, q) != 0) {
+		pthread_cond_destroy(&q->cond);
+		pthread_mutex_destroy(&q->lock);
+		return false;
+	}
+	return true;
+}
+
+void switch_queue_stop(switch_queue* q)
+{
+	pthread_mutex_lock(&q->lock);
+	q->running = false;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+	pthread_join(q->thread, NULL);
+
+	pthread_cond_destroy(&q->cond);
+	pthread_mutex_destroy(&q->lock);
+}
+
+void switch_queue_configure(switch_queue* q, wm_options options, double rate, int burst)
+{
+	pthread_mutex_lock(&q->lock);
+	q->options = options;
+	if (rate != q->limit.rate || (burst > 1 ? burst : 1) != q->limit.burst)
+		throttle_init(&q->limit, rate, burst);
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+void switch_queue_steps(switch_queue* q, int steps)
+{
+	pthread_mutex_lock(&q->lock);
+	if (q->pending_steps == 0) {
+		q->pending_since_ns = ipc_monotonic_ns();
+		// a command already waiting was fired first
+		q->action_first = true;
+	} else {
+		stats_inc(&q->stats->coalesced);
+	}
+	q->pending_steps += steps;
+	note_depth(q);
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+bool switch_queue_action(switch_queue* q, const char* command)
+{
+	pthread_mutex_lock(&q->lock);
+	bool replaced = q->action[0] != 0;
+	snprintf(q->action, sizeof(q->action), "%s", command);
+	q->action_since_ns = ipc_monotonic_ns();
+	q->action_first = q->pending_steps == 0;
+	note_depth(q);
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+
+	// a flood logs at the 1st, 2nd, 4th, 8th... drop; the counter has the rest
+	if (replaced) {
+		unsigned long long dropped = atomic_fetch_add_explicit(&q->stats->dropped, 1, memory_order_relaxed) + 1;
+		if ((dropped & (dropped - 1)) == 0)
+			log_warn("'%s' replaced a command that was still waiting (%llu dropped)", command, dropped);
+	}
+	return !replaced;
+}
+
+void switch_queue_pending(switch_queue* q, int* steps, int* actions)
+{
+	pthread_mutex_lock(&q->lock);
+	*steps = q->pending_steps;
+	*actions = q->action[0] != 0;
+	pthread_mutex_unlock(&q->lock);
+}
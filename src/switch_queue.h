@@ -0,0 +1,56 @@
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stats.h"
+#include "throttle.h"
+#include "wm.h"
+
+// Hands fired gestures to the window manager from one thread so the input
+// thread never waits on IPC. Behind the one command in flight there is a
+// single slot per kind: swipes fold into a net step count, and another
+// gesture's command replaces the one still waiting (counted as dropped). So
+// a burst of flicks or a scrub goes out as one multi-step switch and at most
+// two commands ever wait. The two slots go out in the order they were
+// filled; a swipe that lands while a command waits behind earlier steps
+// folds into those steps and so goes ahead of the command. The throttle
+// spaces the sends, so a misbehaving pad or a stuck state machine can't
+// flood the window manager either.
+
+#define SWITCH_QUEUE_DEPTH 2 // most commands waiting at once
+#define SWITCH_COMMAND_MAX 192 // SWIPE_ACTION_MAX
+
+typedef struct {
+	wm_backend* wm;
+	swipe_stats* stats;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond; // on CLOCK_MONOTONIC
+	pthread_t thread;
+	bool running;
+	int pending_steps;
+	uint64_t pending_since_ns;
+	char action[SWITCH_COMMAND_MAX]; // the waiting command, "" for none
+	uint64_t action_since_ns;
+	bool action_first; // the waiting command goes out before the steps
+	int peak_depth; // most commands waiting at once
+	bool held; // the next command already counted as throttled
+	wm_options options; // picked up by each switch
+	throttle limit;
+} switch_queue;
+
+// rate is in commands per second, 0 for no limit.
+bool switch_queue_start(switch_queue* q, wm_backend* wm, swipe_stats* stats, double rate, int burst);
+// Joins the thread; whatever is still waiting is not sent.
+void switch_queue_stop(switch_queue* q);
+
+void switch_queue_configure(switch_queue* q, wm_options options, double rate, int burst);
+
+// Moves steps workspaces forward (+) or back (-) after what is pending.
+void switch_queue_steps(switch_queue* q, int steps);
+// false when it replaced a command that was still waiting.
+bool switch_queue_action(switch_queue* q, const char* command);
+
+// The net steps and commands (0 or 1) waiting.
+void switch_queue_pending(switch_queue* q, int* steps, int* actions);
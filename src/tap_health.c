@@ -0,0 +1,100 @@
+#include "tap_health.h"
+
+#include <string.h>
+
+#include "stats.h"
+
+static unsigned long long load(atomic_ullong* counter)
+{
+	return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void tap_health_init(tap_health* h)
+{
+	memset(h, 0, sizeof(*h));
+	pthread_mutex_init(&h->lock, NULL);
+}
+
+void tap_health_reset(tap_health* h)
+{
+	atomic_store_explicit(&h->callbacks, 0, memory_order_relaxed);
+	atomic_store_explicit(&h->gestures, 0, memory_order_relaxed);
+	atomic_store_explicit(&h->slow, 0, memory_order_relaxed);
+	atomic_store_explicit(&h->timeout_disables, 0, memory_order_relaxed);
+	atomic_store_explicit(&h->user_disables, 0, memory_order_relaxed);
+
+	pthread_mutex_lock(&h->lock);
+	histogram_reset(&h->callback);
+	histogram_reset(&h->conversion);
+	h->window_start_ns = 0;
+	h->window_events = 0;
+	h->rate = h->peak_rate = 0;
+	pthread_mutex_unlock(&h->lock);
+}
+
+void tap_health_callback(tap_health* h, uint64_t start_ns, uint64_t end_ns, bool gesture)
+{
+	uint64_t elapsed = end_ns > start_ns ? end_ns - start_ns : 0;
+
+	atomic_fetch_add_explicit(&h->callbacks, 1, memory_order_relaxed);
+	if (gesture)
+		atomic_fetch_add_explicit(&h->gestures, 1, memory_order_relaxed);
+	if (elapsed > TAP_SLOW_CALLBACK_NS)
+		atomic_fetch_add_explicit(&h->slow, 1, memory_order_relaxed);
+
+	pthread_mutex_lock(&h->lock);
+	histogram_record(&h->callback, elapsed);
+
+	if (!h->window_start_ns)
+		h->window_start_ns = start_ns;
+	h->window_events++;
+	uint64_t window = end_ns - h->window_start_ns;
+	if (end_ns > h->window_start_ns && window >= TAP_RATE_WINDOW_NS) {
+		h->rate = h->window_events * 1e9 / window;
+		if (h->rate > h->peak_rate)
+			h->peak_rate = h->rate;
+		h->window_start_ns = end_ns;
+		h->window_events = 0;
+	}
+	pthread_mutex_unlock(&h->lock);
+}
+
+void tap_health_conversion(tap_health* h, uint64_t ns)
+{
+	pthread_mutex_lock(&h->lock);
+	histogram_record(&h->conversion, ns);
+	pthread_mutex_unlock(&h->lock);
+}
+
+unsigned long long tap_health_disabled(tap_health* h, bool timeout)
+{
+	atomic_ullong* counter = timeout ? &h->timeout_disables : &h->user_disables;
+	return atomic_fetch_add_explicit(counter, 1, memory_order_relaxed) + 1;
+}
+
+void tap_health_callback_summary(tap_health* h, uint64_t* p99, uint64_t* max)
+{
+	pthread_mutex_lock(&h->lock);
+	*p99 = histogram_percentile(&h->callback, 0.99);
+	*max = h->callback.max;
+	pthread_mutex_unlock(&h->lock);
+}
+
+void tap_health_to_json(tap_health* h, yyjson_mut_doc* doc, yyjson_mut_val* obj)
+{
+	pthread_mutex_lock(&h->lock);
+	histogram callback = h->callback;
+	histogram conversion = h->conversion;
+	double rate = h->rate, peak_rate = h->peak_rate;
+	pthread_mutex_unlock(&h->lock);
+
+	yyjson_mut_obj_add_uint(doc, obj, "callbacks", load(&h->callbacks));
+	yyjson_mut_obj_add_uint(doc, obj, "gestures", load(&h->gestures));
+	yyjson_mut_obj_add_uint(doc, obj, "slow", load(&h->slow));
+	yyjson_mut_obj_add_uint(doc, obj, "timeout_disables", load(&h->timeout_disables));
+	yyjson_mut_obj_add_uint(doc, obj, "user_disables", load(&h->user_disables));
+	yyjson_mut_obj_add_real(doc, obj, "events_per_sec", rate);
+	yyjson_mut_obj_add_real(doc, obj, "peak_events_per_sec", peak_rate);
+	yyjson_mut_obj_add_val(doc, obj, "callback", stats_latency_json(doc, &callback));
+	yyjson_mut_obj_add_val(doc, obj, "conversion", stats_latency_json(doc, &conversion));
+}
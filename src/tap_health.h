@@ -0,0 +1,44 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "histogram.h"
+#include "yyjson.h"
+
+// Accounting for the event-tap callback, which macOS disables when it runs
+// too long (kCGEventTapDisabledByTimeout). Timestamps are passed in so the
+// bookkeeping is plain C; only the callback that feeds it is platform code.
+// Written from the tap's run loop thread, read by the control thread.
+
+#define TAP_SLOW_CALLBACK_NS (1000ull * 1000) // well under the system's limit
+#define TAP_RATE_WINDOW_NS (1000ull * 1000 * 1000)
+
+typedef struct {
+	atomic_ullong callbacks;
+	atomic_ullong gestures; // callbacks that carried touches
+	atomic_ullong slow; // callbacks over TAP_SLOW_CALLBACK_NS
+	atomic_ullong timeout_disables, user_disables;
+
+	pthread_mutex_t lock;
+	histogram callback; // ns per callback
+	histogram conversion; // ns from the CGEvent to its touch set
+	uint64_t window_start_ns;
+	unsigned long long window_events;
+	double rate, peak_rate; // callbacks per second over the last full window
+} tap_health;
+
+void tap_health_init(tap_health* h);
+void tap_health_reset(tap_health* h);
+
+void tap_health_callback(tap_health* h, uint64_t start_ns, uint64_t end_ns, bool gesture);
+void tap_health_conversion(tap_health* h, uint64_t ns);
+
+// Counts a disable and returns how many of that kind there have been.
+unsigned long long tap_health_disabled(tap_health* h, bool timeout);
+
+// p99 and max callback time in ns, for log lines.
+void tap_health_callback_summary(tap_health* h, uint64_t* p99, uint64_t* max);
+
+void tap_health_to_json(tap_health* h, yyjson_mut_doc* doc, yyjson_mut_val* obj);
@@ -0,0 +1,29 @@
+#include "throttle.h"
+
+void throttle_init(throttle* t, double rate, int burst)
+{
+	t->rate = rate > 0 ? rate : 0;
+	t->burst = burst > 1 ? burst : 1;
+	t->tokens = t->burst;
+	t->last_ns = 0;
+}
+
+uint64_t throttle_take(throttle* t, uint64_t now_ns)
+{
+	if (t->rate <= 0)
+		return 0;
+
+	if (t->last_ns && now_ns > t->last_ns) {
+		t->tokens += (now_ns - t->last_ns) * t->rate / 1e9;
+		if (t->tokens > t->burst)
+			t->tokens = t->burst;
+	}
+	if (!t->last_ns || now_ns > t->last_ns)
+		t->last_ns = now_ns;
+
+	if (t->tokens >= 1) {
+		t->tokens -= 1;
+		return 0;
+	}
+	return (uint64_t)((1 - t->tokens) * 1e9 / t->rate) + 1;
+}
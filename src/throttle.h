@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+// Token bucket in front of the window manager: up to burst commands go out
+// back to back, after that one per 1/rate seconds. Callers hold whatever
+// lock guards their queue; timestamps are passed in so the bench can drive
+// it with its own clock.
+
+typedef struct {
+	double rate; // commands per second; 0 lets everything through
+	double burst;
+	double tokens;
+	uint64_t last_ns;
+} throttle;
+
+void throttle_init(throttle* t, double rate, int burst);
+
+// 0 when a command may go now (and counts it), otherwise the ns until one may.
+uint64_t throttle_take(throttle* t, uint64_t now_ns);
@@ -0,0 +1,188 @@
+#pragma once
+#include <math.h>
+#include <stdbool.h>
+
+#include "gesture.h"
+
+// Reductions over touch_frame lanes for the engine, four floats at a time:
+// SSE2 on x86-64, NEON on arm64, plain loops elsewhere or with
+// -DGESTURE_SCALAR. Chunks read up to the next multiple of four; lanes past
+// count are zero in the frame and masked out of the comparisons.
+
+#if !defined(GESTURE_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define TOUCH_SIMD "sse2"
+#elif !defined(GESTURE_SCALAR) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TOUCH_SIMD "neon"
+#else
+#define TOUCH_SIMD "scalar"
+#endif
+
+#define TOUCH_SIMD_INLINE static inline __attribute__((always_inline))
+
+TOUCH_SIMD_INLINE unsigned lane_mask(int count, int i)
+{
+	int valid = count - i;
+	return valid >= 4 ? 0xFu : (1u << valid) - 1;
+}
+
+#if !defined(GESTURE_SCALAR) && defined(__SSE2__)
+
+TOUCH_SIMD_INLINE float hsum(__m128 v)
+{
+	__m128 hi = _mm_movehl_ps(v, v);
+	__m128 sum = _mm_add_ps(v, hi);
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+TOUCH_SIMD_INLINE __m128 vabs(__m128 v)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+TOUCH_SIMD_INLINE void touch_sums(const touch_frame* f, int count, touch_totals* out)
+{
+	__m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sr = _mm_setzero_ps();
+	__m128 svx = _mm_setzero_ps(), svy = _mm_setzero_ps();
+	for (int i = 0; i < count; i += 4) {
+		__m128 x = _mm_load_ps(f->x + i), y = _mm_load_ps(f->y + i);
+		sx = _mm_add_ps(sx, x);
+		sy = _mm_add_ps(sy, y);
+		sr = _mm_add_ps(sr, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+		svx = _mm_add_ps(svx, _mm_load_ps(f->vel + i));
+		svy = _mm_add_ps(svy, _mm_load_ps(f->vel_y + i));
+	}
+	out->x = hsum(sx);
+	out->y = hsum(sy);
+	out->r2 = hsum(sr);
+	out->vel = hsum(svx);
+	out->vel_y = hsum(svy);
+}
+
+// max(|x[i] - base_x[i]|, wy * |y[i] - base_y[i]|) >= need for every touch
+TOUCH_SIMD_INLINE bool touch_all_moved(const touch_frame* f, int count, const float* base_x, const float* base_y,
+	float wy, float need)
+{
+	__m128 n = _mm_set1_ps(need), w = _mm_set1_ps(wy);
+	for (int i = 0; i < count; i += 4) {
+		__m128 dx = vabs(_mm_sub_ps(_mm_load_ps(f->x + i), _mm_load_ps(base_x + i)));
+		__m128 dy = _mm_mul_ps(w, vabs(_mm_sub_ps(_mm_load_ps(f->y + i), _mm_load_ps(base_y + i))));
+		unsigned ok = (unsigned)_mm_movemask_ps(_mm_cmpge_ps(_mm_max_ps(dx, dy), n));
+		if ((ok & lane_mask(count, i)) != lane_mask(count, i))
+			return false;
+	}
+	return true;
+}
+
+// touches whose step since prev, projected on (ux, uy), is under step or
+// against along
+TOUCH_SIMD_INLINE int touch_mismatches(const touch_frame* f, int count, const float* prev_x, const float* prev_y,
+	float ux, float uy, float step, float along)
+{
+	__m128 s = _mm_set1_ps(step), d = _mm_set1_ps(along), zero = _mm_setzero_ps();
+	__m128 vx = _mm_set1_ps(ux), vy = _mm_set1_ps(uy);
+	int mismatches = 0;
+	for (int i = 0; i < count; i += 4) {
+		__m128 ddx = _mm_sub_ps(_mm_load_ps(f->x + i), _mm_load_ps(prev_x + i));
+		__m128 ddy = _mm_sub_ps(_mm_load_ps(f->y + i), _mm_load_ps(prev_y + i));
+		__m128 dd = _mm_add_ps(_mm_mul_ps(ddx, vx), _mm_mul_ps(ddy, vy));
+		__m128 bad = _mm_or_ps(_mm_cmplt_ps(vabs(dd), s), _mm_cmplt_ps(_mm_mul_ps(dd, d), zero));
+		mismatches += __builtin_popcount((unsigned)_mm_movemask_ps(bad) & lane_mask(count, i));
+	}
+	return mismatches;
+}
+
+#elif !defined(GESTURE_SCALAR) && defined(__aarch64__)
+
+TOUCH_SIMD_INLINE unsigned movemask(uint32x4_t v)
+{
+	static const uint32_t bits[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(v, vld1q_u32(bits)));
+}
+
+TOUCH_SIMD_INLINE void touch_sums(const touch_frame* f, int count, touch_totals* out)
+{
+	float32x4_t sx = vdupq_n_f32(0), sy = vdupq_n_f32(0), sr = vdupq_n_f32(0);
+	float32x4_t svx = vdupq_n_f32(0), svy = vdupq_n_f32(0);
+	for (int i = 0; i < count; i += 4) {
+		float32x4_t x = vld1q_f32(f->x + i), y = vld1q_f32(f->y + i);
+		sx = vaddq_f32(sx, x);
+		sy = vaddq_f32(sy, y);
+		sr = vaddq_f32(sr, vfmaq_f32(vmulq_f32(x, x), y, y));
+		svx = vaddq_f32(svx, vld1q_f32(f->vel + i));
+		svy = vaddq_f32(svy, vld1q_f32(f->vel_y + i));
+	}
+	out->x = vaddvq_f32(sx);
+	out->y = vaddvq_f32(sy);
+	out->r2 = vaddvq_f32(sr);
+	out->vel = vaddvq_f32(svx);
+	out->vel_y = vaddvq_f32(svy);
+}
+
+TOUCH_SIMD_INLINE bool touch_all_moved(const touch_frame* f, int count, const float* base_x, const float* base_y,
+	float wy, float need)
+{
+	float32x4_t n = vdupq_n_f32(need), w = vdupq_n_f32(wy);
+	for (int i = 0; i < count; i += 4) {
+		float32x4_t dx = vabdq_f32(vld1q_f32(f->x + i), vld1q_f32(base_x + i));
+		float32x4_t dy = vmulq_f32(w, vabdq_f32(vld1q_f32(f->y + i), vld1q_f32(base_y + i)));
+		unsigned ok = movemask(vcgeq_f32(vmaxq_f32(dx, dy), n));
+		if ((ok & lane_mask(count, i)) != lane_mask(count, i))
+			return false;
+	}
+	return true;
+}
+
+TOUCH_SIMD_INLINE int touch_mismatches(const touch_frame* f, int count, const float* prev_x, const float* prev_y,
+	float ux, float uy, float step, float along)
+{
+	float32x4_t s = vdupq_n_f32(step), d = vdupq_n_f32(along), zero = vdupq_n_f32(0);
+	int mismatches = 0;
+	for (int i = 0; i < count; i += 4) {
+		float32x4_t ddx = vsubq_f32(vld1q_f32(f->x + i), vld1q_f32(prev_x + i));
+		float32x4_t ddy = vsubq_f32(vld1q_f32(f->y + i), vld1q_f32(prev_y + i));
+		float32x4_t dd = vaddq_f32(vmulq_n_f32(ddx, ux), vmulq_n_f32(ddy, uy));
+		uint32x4_t bad = vorrq_u32(vcltq_f32(vabsq_f32(dd), s), vcltq_f32(vmulq_f32(dd, d), zero));
+		mismatches += __builtin_popcount(movemask(bad) & lane_mask(count, i));
+	}
+	return mismatches;
+}
+
+#else
+
+TOUCH_SIMD_INLINE void touch_sums(const touch_frame* f, int count, touch_totals* out)
+{
+	touch_totals sum = { 0 };
+	for (int i = 0; i < count; ++i) {
+		sum.x += f->x[i];
+		sum.y += f->y[i];
+		sum.r2 += f->x[i] * f->x[i] + f->y[i] * f->y[i];
+		sum.vel += f->vel[i];
+		sum.vel_y += f->vel_y[i];
+	}
+	*out = sum;
+}
+
+TOUCH_SIMD_INLINE bool touch_all_moved(const touch_frame* f, int count, const float* base_x, const float* base_y,
+	float wy, float need)
+{
+	bool moved = true;
+	for (int i = 0; i < count; ++i)
+		moved &= fmaxf(fabsf(f->x[i] - base_x[i]), wy * fabsf(f->y[i] - base_y[i])) >= need;
+	return moved;
+}
+
+TOUCH_SIMD_INLINE int touch_mismatches(const touch_frame* f, int count, const float* prev_x, const float* prev_y,
+	float ux, float uy, float step, float along)
+{
+	int mismatches = 0;
+	for (int i = 0; i < count; ++i) {
+		float dd = (f->x[i] - prev_x[i]) * ux + (f->y[i] - prev_y[i]) * uy;
+		mismatches += fabsf(dd) < step || (dd * along) < 0;
+	}
+	return mismatches;
+}
+
+#endif
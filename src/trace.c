@@ -0,0 +1,377 @@
+#include "trace.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_LINE_MAX 4096
+
+static bool grow(void** buf, int* capacity, int needed, size_t item)
+{
+	if (needed <= *capacity)
+		return true;
+
+	int capacity_new = *capacity ? *capacity : 64;
+	while (capacity_new < needed)
+		capacity_new *= 2;
+
+	void* buf_new = realloc(*buf, (size_t)capacity_new * item);
+	if (!buf_new)
+		return false;
+	*buf = buf_new;
+	*capacity = capacity_new;
+	return true;
+}
+
+void trace_init(touch_trace* trace)
+{
+	memset(trace, 0, sizeof(*trace));
+}
+
+void trace_free(touch_trace* trace)
+{
+	free(trace->touches);
+	free(trace->counts);
+	free(trace->offsets);
+	free(trace->fires);
+	trace_init(trace);
+}
+
+void trace_clear(touch_trace* trace)
+{
+	trace->frames = 0;
+	trace->touch_count = 0;
+	trace->fire_count = 0;
+}
+
+bool trace_append(touch_trace* trace, const touch* touches, int count)
+{
+	if (count < 0)
+		count = 0;
+
+	int frame_capacity = trace->frame_capacity;
+	if (!grow((void**)&trace->counts, &frame_capacity, trace->frames + 1, sizeof(int))
+		|| !grow((void**)&trace->offsets, &trace->frame_capacity, trace->frames + 1, sizeof(int))
+		|| !grow((void**)&trace->touches, &trace->touch_capacity, trace->touch_count + count, sizeof(touch)))
+		return false;
+
+	memcpy(trace->touches + trace->touch_count, touches, (size_t)count * sizeof(touch));
+	trace->counts[trace->frames] = count;
+	trace->offsets[trace->frames] = trace->touch_count;
+	trace->touch_count += count;
+	trace->frames++;
+	return true;
+}
+
+bool trace_annotate(touch_trace* trace, int frame, int direction)
+{
+	if (!grow((void**)&trace->fires, &trace->fire_capacity, trace->fire_count + 1, sizeof(trace_fire)))
+		return false;
+
+	trace_fire* fire = &trace->fires[trace->fire_count++];
+	fire->frame = frame;
+	fire->direction = direction;
+	fire->latency = -1;
+	fire->steps = 1;
+	return true;
+}
+
+static int count_fields(const char* line)
+{
+	int fields = 0;
+	for (const char* p = line; *p;) {
+		while (isspace((unsigned char)*p))
+			p++;
+		if (!*p)
+			break;
+		fields++;
+		while (*p && !isspace((unsigned char)*p))
+			p++;
+	}
+	return fields;
+}
+
+static bool parse_frame(touch_trace* trace, char* line)
+{
+	char* p = line;
+	int fields = count_fields(line);
+	double timestamp = strtod(p, &p);
+	long count = strtol(p, &p, 10);
+	if (count < 0 || count > MAX_TOUCHES)
+		return false;
+	bool ids = count > 0 && fields >= 2 + 6 * count;
+	bool vel_y = count > 0 && fields >= 2 + 7 * count;
+
+	touch touches[MAX_TOUCHES];
+	for (long i = 0; i < count; i++) {
+		char* start = p;
+		touches[i].x = strtod(p, &p);
+		touches[i].y = strtod(p, &p);
+		touches[i].phase = (int)strtol(p, &p, 10);
+		touches[i].velocity = strtod(p, &p);
+		touches[i].is_palm = strtol(p, &p, 10) != 0;
+		touches[i].id = ids ? (int)strtol(p, &p, 10) : (int)i;
+		touches[i].velocity_y = vel_y ? strtod(p, &p) : 0.0;
+		touches[i].timestamp = timestamp;
+		if (p == start)
+			return false;
+	}
+	return trace_append(trace, touches, (int)count);
+}
+
+bool trace_load(const char* path, touch_trace* trace)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return false;
+
+	trace_init(trace);
+	char line[TRACE_LINE_MAX];
+	int line_no = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), file)) {
+		line_no++;
+		int frame, direction;
+		if (sscanf(line, "# fire %d %d", &frame, &direction) == 2)
+			ok = trace_annotate(trace, frame, direction);
+		else if (line[0] != '#' && line[0] != '\n')
+			ok = parse_frame(trace, line);
+	}
+	fclose(file);
+
+	if (!ok) {
+		fprintf(stderr, "trace: %s:%d: malformed frame\n", path, line_no);
+		trace_free(trace);
+	}
+	return ok;
+}
+
+static int parse_budget(const char* field)
+{
+	return strcmp(field, "-") == 0 ? -1 : atoi(field);
+}
+
+int trace_budgets_load(const char* path, trace_budget* out, int max)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return -1;
+
+	const char* slash = strrchr(path, '/');
+	int dir_len = slash ? (int)(slash - path) + 1 : 0;
+	char line[TRACE_LINE_MAX];
+	int line_no = 0, count = 0;
+	bool ok = true;
+	while (ok && count < max && fgets(line, sizeof(line), file)) {
+		line_no++;
+		char file_name[256], p50[16], p95[16];
+		int fingers;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		ok = sscanf(line, "%255s %d %15s %15s", file_name, &fingers, p50, p95) == 4;
+		if (ok) {
+			trace_budget* budget = &out[count++];
+			snprintf(budget->path, sizeof(budget->path), "%.*s%s", dir_len, path, file_name);
+			budget->fingers = fingers;
+			budget->p50 = parse_budget(p50);
+			budget->p95 = parse_budget(p95);
+		}
+	}
+	fclose(file);
+
+	if (!ok) {
+		fprintf(stderr, "trace: %s:%d: malformed budget\n", path, line_no);
+		return -1;
+	}
+	return count;
+}
+
+bool trace_save(const char* path, const touch_trace* trace)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "# swipe trace, %d frames\n", trace->frames);
+	for (int i = 0; i < trace->fire_count; i++)
+		fprintf(file, "# fire %d %d\n", trace->fires[i].frame, trace->fires[i].direction);
+
+	for (int f = 0; f < trace->frames; f++) {
+		const touch* touches = trace->touches + trace->offsets[f];
+		int count = trace->counts[f];
+		fprintf(file, "%.6f %d", count ? touches[0].timestamp : 0.0, count);
+		for (int i = 0; i < count; i++)
+			fprintf(file, " %.6f %.6f %d %.6f %d %d %.6f", touches[i].x, touches[i].y, touches[i].phase, touches[i].velocity,
+				touches[i].is_palm, touches[i].id, touches[i].velocity_y);
+		fputc('\n', file);
+	}
+
+	bool ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+typedef struct {
+	trace_fire* out;
+	int max;
+	int fired;
+	int frame;
+	int down; // frame the fingers were first all down, -1 if they are not
+} replay_state;
+
+static void record(replay_state* state, int direction, int steps)
+{
+	if (state->fired < state->max) {
+		trace_fire* fire = &state->out[state->fired];
+		fire->frame = state->frame;
+		fire->direction = direction;
+		fire->latency = state->down >= 0 ? state->frame - state->down : -1;
+		fire->steps = steps;
+	}
+	state->fired++;
+}
+
+static void record_fire(gesture_ctx* ctx, int direction)
+{
+	record(ctx->userdata, direction, ctx->fire_steps);
+}
+
+static void record_set_fire(gesture_ctx* ctx, int direction)
+{
+	record(gesture_set_of(ctx)->userdata, direction, ctx->fire_steps);
+}
+
+int trace_replay(const touch_trace* trace, const gesture_params* params, trace_fire* out, int max)
+{
+	replay_state state = { out, max, 0, 0, -1 };
+	gesture_ctx ctx;
+	gesture_callbacks callbacks = { .armed = NULL, .fired = record_fire };
+	gesture_init(&ctx, params, callbacks, &state);
+	gesture_filter filter = { 0 };
+
+	for (; state.frame < trace->frames; state.frame++) {
+		const touch* touches = trace->touches + trace->offsets[state.frame];
+		int count = trace->counts[state.frame];
+		if (count != params->fingers)
+			state.down = -1;
+		else if (state.down < 0)
+			state.down = state.frame;
+		// the daemons filter before the engine, so replays do too
+		if (gesture_filter_pass(&filter, GESTURE_FINGERS(params->fingers), count, gesture_phases(touches, count)))
+			gesture_process(&ctx, touches, count);
+	}
+	return state.fired;
+}
+
+int trace_replay_set(const touch_trace* trace, const gesture_recognizers* recognizers, trace_fire* out, int max)
+{
+	replay_state state = { out, max, 0, 0, -1 };
+	gesture_set set;
+	gesture_callbacks callbacks = { .armed = NULL, .fired = record_set_fire };
+	gesture_set_init(&set, recognizers, callbacks, &state);
+	gesture_filter filter = { 0 };
+	unsigned fingers = gesture_set_fingers(&set);
+
+	for (; state.frame < trace->frames; state.frame++) {
+		const touch* touches = trace->touches + trace->offsets[state.frame];
+		int count = trace->counts[state.frame];
+		if (count >= 32 || !(fingers & GESTURE_FINGERS(count)))
+			state.down = -1;
+		else if (state.down < 0)
+			state.down = state.frame;
+		if (gesture_filter_pass(&filter, fingers, count, gesture_phases(touches, count)))
+			gesture_set_process(&set, touches, count);
+	}
+	return state.fired;
+}
+
+static int compare_int(const void* a, const void* b)
+{
+	return *(const int*)a - *(const int*)b;
+}
+
+trace_score trace_score_fires(const touch_trace* trace, const trace_fire* fires, int fired, int max)
+{
+	int stored = fired < max ? fired : max;
+	int* latencies = malloc(sizeof(int) * (stored ? stored : 1));
+	if (!latencies)
+		stored = 0;
+	int matched = 0, next = 0;
+	for (int a = 0; a < trace->fire_count; a++) {
+		const trace_fire* want = &trace->fires[a];
+		while (next < stored && fires[next].frame <= want->frame) {
+			const trace_fire* got = &fires[next++];
+			if (got->direction == want->direction && (a == 0 || got->frame > trace->fires[a - 1].frame))
+				latencies[matched++] = got->latency;
+		}
+	}
+
+	trace_score score = {
+		.matched = matched,
+		.missed = trace->fire_count - matched,
+		.extra = fired - matched,
+		.p50 = -1,
+		.p95 = -1,
+	};
+	if (matched > 0) {
+		qsort(latencies, matched, sizeof(int), compare_int);
+		score.p50 = latencies[matched / 2];
+		score.p95 = latencies[(matched * 95) / 100];
+	}
+	free(latencies);
+	return score;
+}
+
+void trace_recorder_init(trace_recorder* rec)
+{
+	atomic_init(&rec->active, false);
+	pthread_mutex_init(&rec->lock, NULL);
+	trace_init(&rec->trace);
+}
+
+bool trace_recorder_start(trace_recorder* rec)
+{
+	pthread_mutex_lock(&rec->lock);
+	bool started = !atomic_load(&rec->active);
+	if (started) {
+		trace_clear(&rec->trace);
+		atomic_store(&rec->active, true);
+	}
+	pthread_mutex_unlock(&rec->lock);
+	return started;
+}
+
+void trace_recorder_frame(trace_recorder* rec, const touch* touches, int count)
+{
+	if (!atomic_load_explicit(&rec->active, memory_order_relaxed))
+		return;
+
+	pthread_mutex_lock(&rec->lock);
+	if (atomic_load(&rec->active))
+		trace_append(&rec->trace, touches, count);
+	pthread_mutex_unlock(&rec->lock);
+}
+
+void trace_recorder_fire(trace_recorder* rec, int direction)
+{
+	if (!atomic_load_explicit(&rec->active, memory_order_relaxed))
+		return;
+
+	pthread_mutex_lock(&rec->lock);
+	if (atomic_load(&rec->active) && rec->trace.frames > 0)
+		trace_annotate(&rec->trace, rec->trace.frames - 1, direction);
+	pthread_mutex_unlock(&rec->lock);
+}
+
+int trace_recorder_stop(trace_recorder* rec, const char* path)
+{
+	pthread_mutex_lock(&rec->lock);
+	int frames = -1;
+	if (atomic_load(&rec->active)) {
+		atomic_store(&rec->active, false);
+		frames = trace_save(path, &rec->trace) ? rec->trace.frames : -1;
+		trace_free(&rec->trace);
+	}
+	pthread_mutex_unlock(&rec->lock);
+	return frames;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "gesture.h"
+
+// Recorded touch frames, replayable through the gesture engine.
+//
+// On disk a trace is plain text, one frame per line:
+//   <timestamp> <count> [<x> <y> <phase> <velocity> <palm> <id> <velocity_y>]...
+// Older traces stop after <palm> or <id>; their touches get their position
+// in the frame as id and no y velocity.
+// Lines starting with '#' are comments; "# fire <frame> <direction>" lines
+// annotate the swipes the trace is expected to produce.
+
+typedef struct {
+	int frame; // index of the frame that fired
+	int direction; // a GESTURE_* direction
+	int latency; // frames since the fingers were first all down
+	int steps; // ctx->fire_steps in replays, 1 for annotations
+} trace_fire;
+
+typedef struct {
+	touch* touches;
+	int* counts;
+	int* offsets; // frame i starts at touches[offsets[i]]
+	int frames;
+	int frame_capacity;
+	int touch_count;
+	int touch_capacity;
+	trace_fire* fires; // annotations
+	int fire_count;
+	int fire_capacity;
+} touch_trace;
+
+void trace_init(touch_trace* trace);
+void trace_free(touch_trace* trace);
+void trace_clear(touch_trace* trace);
+
+bool trace_append(touch_trace* trace, const touch* touches, int count);
+bool trace_annotate(touch_trace* trace, int frame, int direction);
+
+bool trace_load(const char* path, touch_trace* trace);
+bool trace_save(const char* path, const touch_trace* trace);
+
+// Replays every frame through a fresh engine built from params and stores up
+// to max fires in out; returns how many fired in total.
+int trace_replay(const touch_trace* trace, const gesture_params* params, trace_fire* out, int max);
+
+// The same through a gesture_set of recognizers.
+int trace_replay_set(const touch_trace* trace, const gesture_recognizers* recognizers, trace_fire* out, int max);
+
+// A replay's fires against the trace's annotations. Fires pair with
+// annotations in order: one matches when it has the annotated direction,
+// lands by the annotated frame and after the annotation before. The
+// percentiles are frames-to-fire over the matched fires, -1 without any.
+typedef struct {
+	int matched, missed, extra;
+	int p50, p95;
+} trace_score;
+
+// fired is what trace_replay returned; only the first max are in fires.
+trace_score trace_score_fires(const touch_trace* trace, const trace_fire* fires, int fired, int max);
+
+// Frames-to-fire budgets for a corpus of annotated traces, read from a
+// manifest with one line per trace:
+//   <file> <fingers> <p50> <p95>
+// file is relative to the manifest's directory and replays with the default
+// thresholds for that many fingers. p50 and p95 are the most frames-to-fire
+// allowed; "-" for a trace with nothing annotated. '#' starts a comment.
+typedef struct {
+	char path[512];
+	int fingers;
+	int p50, p95; // -1 for "-"
+} trace_budget;
+
+// Reads up to max entries into out and returns how many, or -1 if the
+// manifest cannot be read or has a malformed line.
+int trace_budgets_load(const char* path, trace_budget* out, int max);
+
+// Records live frames into a trace while active; frame() is a single atomic
+// load otherwise. Frames from several pads are interleaved.
+typedef struct {
+	atomic_bool active;
+	pthread_mutex_t lock;
+	touch_trace trace;
+} trace_recorder;
+
+void trace_recorder_init(trace_recorder* rec);
+
+// False if a recording is already running.
+bool trace_recorder_start(trace_recorder* rec);
+void trace_recorder_frame(trace_recorder* rec, const touch* touches, int count);
+
+// Annotates the last recorded frame with a fire.
+void trace_recorder_fire(trace_recorder* rec, int direction);
+
+// Saves the recording to path and returns its frame count, or -1 if nothing
+// was recording or the file could not be written.
+int trace_recorder_stop(trace_recorder* rec, const char* path);
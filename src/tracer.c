@@ -0,0 +1,208 @@
+#include "tracer.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACER_THREADS 64
+
+// seq is idx + 1 once the slot holds event idx and 0 while it is rewritten,
+// so the dump can skip slots a writer is in the middle of.
+typedef struct {
+	atomic_ullong seq;
+	uint64_t ts_ns;
+	uint64_t dur_ns;
+	const char* cat;
+	const char* name;
+	const char* arg_name;
+	int64_t arg;
+	uint32_t tid;
+	char phase;
+} tracer_slot;
+
+typedef struct {
+	uint64_t ts_ns, dur_ns;
+	const char* cat;
+	const char* name;
+	const char* arg_name;
+	int64_t arg;
+	uint32_t tid;
+	char phase;
+} tracer_event;
+
+atomic_bool tracer_on;
+
+static tracer_slot g_ring[TRACER_EVENTS];
+static atomic_ullong g_next;
+static atomic_ullong g_cleared; // events before this index are not dumped
+static atomic_uint g_next_tid;
+static __thread uint32_t t_tid;
+
+static pthread_mutex_t g_names_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+	uint32_t tid;
+	char name[32];
+} g_names[TRACER_THREADS];
+static int g_name_count;
+
+uint64_t tracer_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void tracer_enable(bool on)
+{
+	atomic_store_explicit(&tracer_on, on, memory_order_relaxed);
+}
+
+static uint32_t thread_id(void)
+{
+	if (!t_tid)
+		t_tid = atomic_fetch_add_explicit(&g_next_tid, 1, memory_order_relaxed) + 1;
+	return t_tid;
+}
+
+static void record(char phase, const char* cat, const char* name, uint64_t ts_ns, uint64_t dur_ns,
+	const char* arg_name, int64_t arg)
+{
+	unsigned long long idx = atomic_fetch_add_explicit(&g_next, 1, memory_order_relaxed);
+	tracer_slot* slot = &g_ring[idx & (TRACER_EVENTS - 1)];
+
+	atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->ts_ns = ts_ns;
+	slot->dur_ns = dur_ns;
+	slot->cat = cat;
+	slot->name = name;
+	slot->arg_name = arg_name;
+	slot->arg = arg;
+	slot->tid = thread_id();
+	slot->phase = phase;
+	atomic_store_explicit(&slot->seq, idx + 1, memory_order_release);
+}
+
+void tracer_span(const char* cat, const char* name, uint64_t start_ns, const char* arg_name, int64_t arg)
+{
+	if (!tracer_enabled())
+		return;
+	uint64_t now = tracer_now_ns();
+	record('X', cat, name, start_ns, now > start_ns ? now - start_ns : 0, arg_name, arg);
+}
+
+void tracer_instant(const char* cat, const char* name, const char* arg_name, int64_t arg)
+{
+	if (!tracer_enabled())
+		return;
+	record('i', cat, name, tracer_now_ns(), 0, arg_name, arg);
+}
+
+void tracer_thread_name(const char* name)
+{
+	uint32_t tid = thread_id();
+
+	pthread_mutex_lock(&g_names_lock);
+	int i = 0;
+	while (i < g_name_count && g_names[i].tid != tid)
+		i++;
+	if (i < TRACER_THREADS) {
+		g_names[i].tid = tid;
+		snprintf(g_names[i].name, sizeof(g_names[i].name), "%s", name);
+		if (i == g_name_count)
+			g_name_count++;
+	}
+	pthread_mutex_unlock(&g_names_lock);
+}
+
+void tracer_clear(void)
+{
+	atomic_store(&g_cleared, atomic_load(&g_next));
+}
+
+static int compare_events(const void* a, const void* b)
+{
+	const tracer_event* x = a;
+	const tracer_event* y = b;
+	return (x->ts_ns > y->ts_ns) - (x->ts_ns < y->ts_ns);
+}
+
+// Copies out every slot that still holds a complete event in [first, last).
+static int snapshot(tracer_event* out, unsigned long long first, unsigned long long last)
+{
+	int count = 0;
+	for (unsigned long long idx = first; idx < last; idx++) {
+		tracer_slot* slot = &g_ring[idx & (TRACER_EVENTS - 1)];
+		unsigned long long seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		if (seq != idx + 1)
+			continue;
+
+		tracer_event ev = {
+			.ts_ns = slot->ts_ns,
+			.dur_ns = slot->dur_ns,
+			.cat = slot->cat,
+			.name = slot->name,
+			.arg_name = slot->arg_name,
+			.arg = slot->arg,
+			.tid = slot->tid,
+			.phase = slot->phase,
+		};
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq)
+			continue;
+		out[count++] = ev;
+	}
+	return count;
+}
+
+int tracer_dump(const char* path)
+{
+	unsigned long long last = atomic_load(&g_next);
+	unsigned long long first = atomic_load(&g_cleared);
+	if (last - first > TRACER_EVENTS)
+		first = last - TRACER_EVENTS;
+
+	tracer_event* events = malloc(sizeof(tracer_event) * TRACER_EVENTS);
+	if (!events)
+		return -1;
+	int count = snapshot(events, first, last);
+	qsort(events, count, sizeof(tracer_event), compare_events);
+
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		free(events);
+		return -1;
+	}
+
+	int pid = (int)getpid();
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"aerospace-swipe\"}}", pid);
+
+	pthread_mutex_lock(&g_names_lock);
+	for (int i = 0; i < g_name_count; i++)
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			pid, g_names[i].tid, g_names[i].name);
+	pthread_mutex_unlock(&g_names_lock);
+
+	for (int i = 0; i < count; i++) {
+		const tracer_event* ev = &events[i];
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f",
+			ev->name, ev->cat, ev->phase, pid, ev->tid, ev->ts_ns / 1e3);
+		if (ev->phase == 'X')
+			fprintf(file, ",\"dur\":%.3f", ev->dur_ns / 1e3);
+		else
+			fprintf(file, ",\"s\":\"t\"");
+		if (ev->arg_name)
+			fprintf(file, ",\"args\":{\"%s\":%lld}", ev->arg_name, (long long)ev->arg);
+		fprintf(file, "}");
+	}
+	fprintf(file, "\n]}\n");
+
+	bool ok = !ferror(file);
+	ok &= fclose(file) == 0;
+	free(events);
+	return ok ? count : -1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Opt-in lifecycle tracer. Spans and instants from any thread land in one
+// bounded ring that overwrites its oldest events, so it can stay on and be
+// dumped after a late swipe as Chrome trace-event JSON (chrome://tracing,
+// ui.perfetto.dev). While disabled every call is one relaxed load.
+//
+// Names, categories and argument names must be string literals.
+
+#define TRACER_EVENTS 16384 // power of two
+
+extern atomic_bool tracer_on;
+
+static inline bool tracer_enabled(void)
+{
+	return atomic_load_explicit(&tracer_on, memory_order_relaxed);
+}
+
+void tracer_enable(bool on);
+uint64_t tracer_now_ns(void);
+
+// Start timestamp for tracer_end, or 0 when tracing is off so the matching
+// end is skipped.
+static inline uint64_t tracer_begin(void)
+{
+	return tracer_enabled() ? tracer_now_ns() : 0;
+}
+
+// A complete ("X") event from start_ns until now; arg_name may be NULL.
+void tracer_span(const char* cat, const char* name, uint64_t start_ns, const char* arg_name, int64_t arg);
+
+static inline void tracer_end(const char* cat, const char* name, uint64_t start_ns, const char* arg_name, int64_t arg)
+{
+	if (start_ns)
+		tracer_span(cat, name, start_ns, arg_name, arg);
+}
+
+void tracer_instant(const char* cat, const char* name, const char* arg_name, int64_t arg);
+
+// Labels the calling thread's track in the dump.
+void tracer_thread_name(const char* name);
+
+// Writes the buffered events oldest first; returns how many, or -1.
+int tracer_dump(const char* path);
+void tracer_clear(void);
@@ -0,0 +1,327 @@
+#include "wm.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i3ipc.h"
+#include "log.h"
+#include "yyjson.h"
+
+#define WM_TABLE_TTL_NS (1000ull * 1000 * 1000)
+#define WM_COMMAND_MAX 1024
+
+static wm_backend* backend_new(const char* name, void* impl, wm_options options)
+{
+	wm_backend* wm = calloc(1, sizeof(wm_backend));
+	if (!wm)
+		return NULL;
+	wm->name = name;
+	wm->impl = impl;
+	wm->options = options;
+	return wm;
+}
+
+static bool aerospace_switch_workspace(wm_backend* wm, int direction)
+{
+	aerospace* client = wm->impl;
+	int monitor = AEROSPACE_MONITOR_NONE;
+	if (aerospace_refresh_workspaces(client, WM_TABLE_TTL_NS, NULL))
+		monitor = aerospace_monitor_id(client, wm->options.monitor);
+
+	aerospace_nav nav;
+	aerospace_nav_result moved = AEROSPACE_NAV_UNKNOWN;
+	if (monitor != AEROSPACE_MONITOR_NONE)
+		moved = aerospace_navigate(client, monitor, direction, wm->options.wrap_around, wm->options.skip_empty, &nav);
+	if (moved == AEROSPACE_NAV_STAY)
+		return true;
+	if (moved == AEROSPACE_NAV_MOVED) {
+		char* result = aerospace_nav_send(client, &nav);
+		if (result)
+			log_error("Error: Failed to switch workspace to '%s': %s", nav.name, result);
+		free(result);
+		return result == NULL;
+	}
+
+	// the server only moves one workspace per command
+	const char* ws = direction > 0 ? "next" : "prev";
+	char* workspaces = aerospace_list_workspaces(client, !wm->options.skip_empty);
+	bool ok = true;
+	for (int i = 0; ok && i < abs(direction); i++) {
+		char* result = aerospace_workspace(client, wm->options.wrap_around, ws, workspaces ? workspaces : "");
+		ok = result == NULL;
+		free(result);
+	}
+	free(workspaces);
+	return ok;
+}
+
+static bool aerospace_run_command(wm_backend* wm, const char* command)
+{
+	char* result = aerospace_run(wm->impl, command);
+	if (result)
+		log_error("Error: '%s' failed: %s", command, result);
+	free(result);
+	return result == NULL;
+}
+
+static char* aerospace_list(wm_backend* wm)
+{
+	return aerospace_list_workspaces(wm->impl, !wm->options.skip_empty);
+}
+
+static int aerospace_subscribe(wm_backend* wm, wm_focus_fn on_focus, void* userdata)
+{
+	(void)wm;
+	(void)on_focus;
+	(void)userdata;
+	// the AeroSpace server socket has no event stream
+	errno = ENOTSUP;
+	return -1;
+}
+
+static int aerospace_stats(wm_backend* wm, wm_conn_stats* out, int max)
+{
+	static const char* names[AEROSPACE_CONN_COUNT] = { "command", "query" };
+
+	int count = 0;
+	for (; count < AEROSPACE_CONN_COUNT && count < max; count++) {
+		out[count].name = names[count];
+		aerospace_conn_stats_get(wm->impl, count, &out[count].stats);
+	}
+	return count;
+}
+
+static void aerospace_reset_stats(wm_backend* wm)
+{
+	aerospace_conn_stats_reset(wm->impl);
+}
+
+static void aerospace_backend_close(wm_backend* wm)
+{
+	aerospace_close(wm->impl);
+	free(wm);
+}
+
+wm_backend* wm_aerospace_new(aerospace* client, wm_options options)
+{
+	if (!client)
+		return NULL;
+
+	wm_backend* wm = backend_new("aerospace", client, options);
+	if (!wm)
+		return NULL;
+	wm->switch_workspace = aerospace_switch_workspace;
+	wm->run_command = aerospace_run_command;
+	wm->list_workspaces = aerospace_list;
+	wm->subscribe = aerospace_subscribe;
+	wm->conn_stats = aerospace_stats;
+	wm->reset_stats = aerospace_reset_stats;
+	wm->close = aerospace_backend_close;
+	return wm;
+}
+
+typedef struct {
+	char* names; // newline-separated, focused output only
+	size_t len;
+	char focused[128];
+} i3_workspaces;
+
+static void collect_workspaces(void* userdata, uint32_t type, const char* payload, size_t len)
+{
+	(void)type;
+	i3_workspaces* out = userdata;
+
+	yyjson_doc* doc = yyjson_read(payload, len, 0);
+	yyjson_val* root = yyjson_doc_get_root(doc);
+	if (!yyjson_is_arr(root)) {
+		yyjson_doc_free(doc);
+		return;
+	}
+
+	const char* output = NULL;
+	size_t idx, max;
+	yyjson_val* item;
+	yyjson_arr_foreach(root, idx, max, item)
+	{
+		if (yyjson_get_bool(yyjson_obj_get(item, "focused"))) {
+			const char* name = yyjson_get_str(yyjson_obj_get(item, "name"));
+			output = yyjson_get_str(yyjson_obj_get(item, "output"));
+			snprintf(out->focused, sizeof(out->focused), "%s", name ? name : "");
+		}
+	}
+
+	out->names = calloc(1, len + 1);
+	if (!out->names) {
+		yyjson_doc_free(doc);
+		return;
+	}
+	yyjson_arr_foreach(root, idx, max, item)
+	{
+		const char* name = yyjson_get_str(yyjson_obj_get(item, "name"));
+		const char* ws_output = yyjson_get_str(yyjson_obj_get(item, "output"));
+		if (!name || (output && (!ws_output || strcmp(output, ws_output) != 0)))
+			continue;
+		out->len += sprintf(out->names + out->len, "%s%s", out->len ? "\n" : "", name);
+	}
+
+	yyjson_doc_free(doc);
+}
+
+static bool i3_query_workspaces(i3ipc* client, i3_workspaces* out)
+{
+	memset(out, 0, sizeof(*out));
+	if (!i3ipc_request(client, I3IPC_CONN_QUERY, I3IPC_GET_WORKSPACES, "", 0, collect_workspaces, out) || !out->names) {
+		free(out->names);
+		out->names = NULL;
+		return false;
+	}
+	return true;
+}
+
+// `workspace "<name>"` with the quotes and backslashes in name escaped, as
+// i3's command parser reads a quoted argument; false if it does not fit.
+static bool workspace_command(char* out, size_t size, const char* name)
+{
+	size_t len = (size_t)snprintf(out, size, "workspace \"");
+	for (const char* p = name; *p; p++) {
+		if (len + 4 > size)
+			return false;
+		if (*p == '"' || *p == '\\')
+			out[len++] = '\\';
+		out[len++] = *p;
+	}
+	out[len++] = '"';
+	out[len] = '\0';
+	return true;
+}
+
+// Without wrap-around the target has to be picked locally; i3's
+// next_on_output always wraps.
+static bool i3_switch_no_wrap(i3ipc* client, int direction)
+{
+	i3_workspaces ws;
+	if (!i3_query_workspaces(client, &ws))
+		return false;
+
+	char* names[128];
+	int count = 0, current = -1;
+	for (char* save = NULL, *line = strtok_r(ws.names, "\n", &save); line && count < 128; line = strtok_r(NULL, "\n", &save)) {
+		if (strcmp(line, ws.focused) == 0)
+			current = count;
+		names[count++] = line;
+	}
+
+	int target = current + direction;
+	if (target < 0)
+		target = 0;
+	if (target >= count)
+		target = count - 1;
+	// at an end there is nothing to send, which is not a failure
+	bool ok = current >= 0 && target == current;
+	if (current >= 0 && target != current) {
+		char command[WM_COMMAND_MAX];
+		ok = workspace_command(command, sizeof(command), names[target]) && i3ipc_command(client, command);
+	}
+
+	free(ws.names);
+	return ok;
+}
+
+static bool i3_switch_workspace(wm_backend* wm, int direction)
+{
+	if (!wm->options.wrap_around)
+		return i3_switch_no_wrap(wm->impl, direction);
+
+	// i3 drops empty unfocused workspaces itself, so skip_empty always holds;
+	// several steps go out as one ;-separated command
+	const char* step = direction > 0 ? "workspace next_on_output" : "workspace prev_on_output";
+	char command[WM_COMMAND_MAX];
+	size_t len = 0;
+	for (int i = 0; i < abs(direction) && len + strlen(step) + 2 < sizeof(command); i++)
+		len += snprintf(command + len, sizeof(command) - len, "%s%s", len ? "; " : "", step);
+	return len && i3ipc_command(wm->impl, command);
+}
+
+static bool i3_run_command(wm_backend* wm, const char* command)
+{
+	return i3ipc_command(wm->impl, command);
+}
+
+static char* i3_list(wm_backend* wm)
+{
+	i3_workspaces ws;
+	return i3_query_workspaces(wm->impl, &ws) ? ws.names : NULL;
+}
+
+typedef struct {
+	wm_focus_fn on_focus;
+	void* userdata;
+} i3_subscription;
+
+static void workspace_event(void* userdata, uint32_t type, const char* payload, size_t len)
+{
+	i3_subscription* sub = userdata;
+	if (type != I3IPC_EVENT_WORKSPACE)
+		return;
+
+	yyjson_doc* doc = yyjson_read(payload, len, 0);
+	yyjson_val* root = yyjson_doc_get_root(doc);
+	const char* change = yyjson_get_str(yyjson_obj_get(root, "change"));
+	const char* name = yyjson_get_str(yyjson_obj_get(yyjson_obj_get(root, "current"), "name"));
+	if (change && name && strcmp(change, "focus") == 0)
+		sub->on_focus(sub->userdata, name);
+	yyjson_doc_free(doc);
+}
+
+static int i3_subscribe(wm_backend* wm, wm_focus_fn on_focus, void* userdata)
+{
+	i3_subscription sub = { on_focus, userdata };
+	return i3ipc_subscribe(wm->impl, "[\"workspace\"]", workspace_event, &sub);
+}
+
+static int i3_stats(wm_backend* wm, wm_conn_stats* out, int max)
+{
+	static const char* names[] = { "command", "query" };
+	static const i3ipc_conn_kind kinds[] = { I3IPC_CONN_COMMAND, I3IPC_CONN_QUERY };
+
+	int count = 0;
+	for (; count < 2 && count < max; count++) {
+		out[count].name = names[count];
+		i3ipc_conn_stats_get(wm->impl, kinds[count], &out[count].stats);
+	}
+	return count;
+}
+
+static void i3_reset_stats(wm_backend* wm)
+{
+	i3ipc_conn_stats_reset(wm->impl);
+}
+
+static void i3_backend_close(wm_backend* wm)
+{
+	i3ipc_close(wm->impl);
+	free(wm);
+}
+
+wm_backend* wm_i3_new(const char* socket_path, wm_options options)
+{
+	i3ipc* client = i3ipc_new(socket_path);
+	if (!client)
+		return NULL;
+
+	wm_backend* wm = backend_new("i3", client, options);
+	if (!wm) {
+		i3ipc_close(client);
+		return NULL;
+	}
+	wm->switch_workspace = i3_switch_workspace;
+	wm->run_command = i3_run_command;
+	wm->list_workspaces = i3_list;
+	wm->subscribe = i3_subscribe;
+	wm->conn_stats = i3_stats;
+	wm->reset_stats = i3_reset_stats;
+	wm->close = i3_backend_close;
+	return wm;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdbool.h>
+
+#include "aerospace.h"
+
+// Window-manager backend: what the gesture engine needs from whatever is
+// managing workspaces. AeroSpace (macOS) and i3/sway (Linux) implement it.
+
+typedef void (*wm_focus_fn)(void* userdata, const char* workspace);
+
+typedef struct {
+	bool wrap_around;
+	bool skip_empty;
+	char monitor[16]; // AeroSpace monitor selector, see config.md
+} wm_options;
+
+typedef struct {
+	const char* name;
+	ipc_conn_stats stats;
+} wm_conn_stats;
+
+typedef struct wm_backend wm_backend;
+struct wm_backend {
+	const char* name;
+	void* impl;
+	wm_options options;
+	// Moves direction workspaces forward (+) or back (-), in one request
+	// where the window manager allows; false if the window manager refused
+	// or did not answer. Staying put at an end without wrap-around is not a
+	// failure.
+	bool (*switch_workspace)(wm_backend* wm, int direction);
+	// Runs a user-configured command in the window manager's own syntax.
+	bool (*run_command)(wm_backend* wm, const char* command);
+	// Newline-separated workspace names of the focused output; caller frees.
+	char* (*list_workspaces)(wm_backend* wm);
+	// Reports focus changes until the connection ends; -1 if unsupported.
+	int (*subscribe)(wm_backend* wm, wm_focus_fn on_focus, void* userdata);
+	// Fills up to max request-connection counters; returns how many.
+	int (*conn_stats)(wm_backend* wm, wm_conn_stats* out, int max);
+	void (*reset_stats)(wm_backend* wm);
+	void (*close)(wm_backend* wm);
+};
+
+// Takes ownership of client.
+wm_backend* wm_aerospace_new(aerospace* client, wm_options options);
+
+// socket_path may be NULL to use $SWAYSOCK or $I3SOCK.
+wm_backend* wm_i3_new(const char* socket_path, wm_options options);
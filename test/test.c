@@ -0,0 +1,80 @@
+#include "test.h"
+
+#include <signal.h>
+#include <string.h>
+
+static const char* const* g_filters;
+static int g_filter_count;
+static int g_case_failures;
+static int g_failed, g_passed;
+
+bool test_check(bool ok, const char* expr, const char* file, int line)
+{
+	if (!ok) {
+		fprintf(stderr, "  %s:%d: CHECK(%s) failed\n", file, line, expr);
+		g_case_failures++;
+	}
+	return ok;
+}
+
+bool test_check_eq(long long a, long long b, const char* expr, const char* file, int line)
+{
+	if (a != b) {
+		fprintf(stderr, "  %s:%d: CHECK_EQ(%s) failed: %lld != %lld\n", file, line, expr, a, b);
+		g_case_failures++;
+	}
+	return a == b;
+}
+
+static bool selected(const char* name)
+{
+	if (g_filter_count == 0)
+		return true;
+	for (int i = 0; i < g_filter_count; i++) {
+		if (strstr(name, g_filters[i]))
+			return true;
+	}
+	return false;
+}
+
+void test_run(const char* name, void (*fn)(void))
+{
+	if (!selected(name))
+		return;
+
+	g_case_failures = 0;
+	fn();
+	if (g_case_failures) {
+		fprintf(stderr, "FAIL %s\n", name);
+		g_failed++;
+	} else {
+		fprintf(stderr, "ok   %s\n", name);
+		g_passed++;
+	}
+}
+
+// usage: swipe-test [substring ...]; only cases containing one of the
+// substrings run.
+int main(int argc, const char* argv[])
+{
+	signal(SIGPIPE, SIG_IGN);
+	g_filters = argv + 1;
+	g_filter_count = argc - 1;
+
+	test_tap_health();
+	test_simd();
+	test_config();
+	test_aggregates();
+	test_gesture_set();
+	test_fling();
+	test_golden();
+	test_evdev();
+	test_aerospace();
+	test_switch_queue();
+	test_i3();
+	test_control();
+	test_log();
+
+	fprintf(stderr, "%d passed, %d failed\n", g_passed, g_failed);
+	return g_failed ? 1 : 0;
+}
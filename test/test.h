@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "gesture.h"
+
+// Assertion harness behind `make test`. A case is a function of CHECKs that
+// keep going after a failure so one run shows everything that broke; the
+// runner prints each case and exits non-zero if any check failed. Everything
+// runs headless on Linux.
+
+bool test_check(bool ok, const char* expr, const char* file, int line);
+
+#define CHECK(cond) test_check((cond), #cond, __FILE__, __LINE__)
+
+// Like CHECK, with the two values printed when they differ.
+#define CHECK_EQ(a, b) test_check_eq((long long)(a), (long long)(b), #a " == " #b, __FILE__, __LINE__)
+bool test_check_eq(long long a, long long b, const char* expr, const char* file, int line);
+
+// Runs fn under name unless the command line filters it out.
+void test_run(const char* name, void (*fn)(void));
+
+// The detection thresholds a default config produces.
+gesture_params test_gesture_params(void);
+
+// Test groups, one per file.
+void test_tap_health(void);
+void test_simd(void);
+void test_config(void);
+void test_aggregates(void);
+void test_gesture_set(void);
+void test_fling(void);
+void test_golden(void);
+void test_evdev(void);
+void test_aerospace(void);
+void test_switch_queue(void);
+void test_i3(void);
+void test_control(void);
+void test_log(void);
@@ -0,0 +1,520 @@
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "mock_server.h"
+#include "test.h"
+#include "wm.h"
+
+// Built in like the bench does, so the reply reader and the batch can be
+// driven over a socketpair whose far end the test scripts.
+#include "../src/aerospace.c"
+
+static const char REPLY_A[] = "{\"exitCode\":0,\"stdout\":\"a\",\"stderr\":\"\"}\n";
+static const char REPLY_B[] = "{\"exitCode\":0,\"stdout\":\"b\",\"stderr\":\"\"}\n";
+static const char REPLY_FAILED[] = "{\"exitCode\":1,\"stdout\":\"\",\"stderr\":\"no such workspace\"}\n";
+
+// A client whose command connection is one end of a socketpair; the other
+// end is returned in *server. Reconnects go to a path that does not exist.
+static aerospace* paired_client(int* server)
+{
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+		return NULL;
+
+	aerospace* client = calloc(1, sizeof(aerospace));
+	client->socket_path = strdup("/nonexistent/aerospace.sock");
+	pthread_mutex_init(&client->table_lock, NULL);
+	for (int i = 0; i < AEROSPACE_CONN_COUNT; i++) {
+		pthread_mutex_init(&client->conns[i].lock, NULL);
+		client->conns[i].path = client->socket_path;
+		client->conns[i].fd = -1;
+	}
+	client->conns[AEROSPACE_CONN_COMMAND].fd = sv[0];
+	*server = sv[1];
+	return client;
+}
+
+static bool send_text(int fd, const char* text)
+{
+	return write(fd, text, strlen(text)) == (ssize_t)strlen(text);
+}
+
+static void reads_split_reply(void)
+{
+	int server;
+	aerospace* client = paired_client(&server);
+	if (!CHECK(client))
+		return;
+	ipc_conn* conn = &client->conns[AEROSPACE_CONN_COMMAND];
+
+	// half the reply already buffered, the rest still on the socket
+	size_t half = sizeof(REPLY_A) / 2;
+	memcpy(conn->read_buf, REPLY_A, half);
+	conn->read_buf_len = half;
+	CHECK(send_text(server, REPLY_A + half));
+	CHECK(send_text(server, REPLY_FAILED));
+
+	bool failed;
+	char* result = conn_read_response(conn, "stdout", &failed);
+	CHECK(!failed && result && strcmp(result, "a") == 0);
+	free(result);
+	result = conn_read_response(conn, "stdout", &failed);
+	CHECK(!failed && result && strcmp(result, "no such workspace") == 0);
+	free(result);
+	CHECK(conn->fd >= 0);
+
+	close(server);
+	aerospace_close(client);
+}
+
+// a bad reply must neither block waiting for more nor leave what follows
+// it to be read as the next request's reply
+static void malformed_reply_drops_connection(void)
+{
+	static const char* const bad[] = {
+		"{\"exitCode\":0,}\n",
+		"Internal error\n",
+		"{\"stdout\":\"no exit code\"}\n",
+	};
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		int server;
+		aerospace* client = paired_client(&server);
+		if (!CHECK(client))
+			return;
+		ipc_conn* conn = &client->conns[AEROSPACE_CONN_COMMAND];
+
+		CHECK(send_text(server, bad[i]));
+		CHECK(send_text(server, REPLY_A));
+		bool failed;
+		char* result = conn_read_response(conn, "stdout", &failed);
+		CHECK(failed && !result);
+		CHECK_EQ(conn->fd, -1);
+		CHECK_EQ(conn->read_buf_len, 0);
+
+		close(server);
+		aerospace_close(client);
+	}
+}
+
+static aerospace_command focus(const char** args)
+{
+	return (aerospace_command) { args, 2, NULL, "stdout" };
+}
+
+static void batch_answers_in_order(void)
+{
+	int server;
+	aerospace* client = paired_client(&server);
+	if (!CHECK(client))
+		return;
+
+	const char* args[] = { "workspace", "3" };
+	aerospace_command commands[3] = { focus(args), focus(args), focus(args) };
+	char* results[3];
+	CHECK(send_text(server, REPLY_A));
+	CHECK(send_text(server, REPLY_FAILED));
+	CHECK(send_text(server, REPLY_B));
+	CHECK_EQ(aerospace_batch(client, commands, 3, results), 3);
+	CHECK(results[0] && strcmp(results[0], "a") == 0);
+	CHECK(results[1] && strcmp(results[1], "no such workspace") == 0);
+	CHECK(results[2] && strcmp(results[2], "b") == 0);
+	for (int i = 0; i < 3; i++)
+		free(results[i]);
+
+	// three requests went out in one batch, newline-framed
+	char sent[1024];
+	ssize_t n = read(server, sent, sizeof(sent) - 1);
+	CHECK(n > 0);
+	sent[n > 0 ? n : 0] = '\0';
+	int lines = 0;
+	for (char* p = sent; (p = strchr(p, '\n')); p++)
+		lines++;
+	CHECK_EQ(lines, 3);
+
+	aerospace_conn_stats stats;
+	aerospace_conn_stats_get(client, AEROSPACE_CONN_COMMAND, &stats);
+	CHECK_EQ(stats.requests, 3);
+	CHECK_EQ(stats.errors, 0);
+	CHECK(client->conns[AEROSPACE_CONN_COMMAND].fd >= 0);
+
+	close(server);
+	aerospace_close(client);
+}
+
+static void batch_stops_and_drops_connection(void)
+{
+	int server;
+	aerospace* client = paired_client(&server);
+	if (!CHECK(client))
+		return;
+
+	const char* args[] = { "workspace", "3" };
+	aerospace_command commands[3] = { focus(args), focus(args), focus(args) };
+	char* results[3];
+	CHECK(send_text(server, REPLY_A));
+	CHECK(send_text(server, "Internal error\n"));
+	CHECK(send_text(server, REPLY_B));
+	CHECK_EQ(aerospace_batch(client, commands, 3, results), 1);
+	CHECK(results[0] && strcmp(results[0], "a") == 0);
+	CHECK(!results[1] && !results[2]);
+	free(results[0]);
+
+	aerospace_conn_stats stats;
+	aerospace_conn_stats_get(client, AEROSPACE_CONN_COMMAND, &stats);
+	CHECK_EQ(stats.errors, 2);
+	// REPLY_B is not read as the answer to a later request
+	CHECK_EQ(client->conns[AEROSPACE_CONN_COMMAND].fd, -1);
+	CHECK_EQ(client->conns[AEROSPACE_CONN_COMMAND].read_buf_len, 0);
+
+	close(server);
+	aerospace_close(client);
+}
+
+// The cached table against the mock's own state, with failures injected.
+// Swipes go the way wm.c sends them; the long TTL means only a table marked
+// stale is loaded again.
+
+#define NAV_TTL_NS (60ull * 1000 * 1000 * 1000)
+
+static mock_server* g_server;
+
+static aerospace* mock_client(void)
+{
+	static int serial;
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/swipe-test-%d-%d.sock", (int)getpid(), serial++);
+	g_server = mock_server_start(path, MOCK_AEROSPACE);
+	return g_server ? aerospace_new(path) : NULL;
+}
+
+static void mock_client_close(aerospace* client)
+{
+	aerospace_close(client);
+	mock_server_stop(g_server);
+}
+
+static bool swipe(aerospace* client, int monitor_id, int steps)
+{
+	aerospace_refresh_workspaces(client, NAV_TTL_NS, NULL);
+	aerospace_nav nav;
+	if (aerospace_navigate(client, monitor_id, steps, false, false, &nav) != AEROSPACE_NAV_MOVED)
+		return false;
+	char* result = aerospace_nav_send(client, &nav);
+	free(result);
+	return result == NULL;
+}
+
+// Both monitors show what the server shows, with nothing in flight.
+static bool converged(aerospace* client)
+{
+	bool same = true;
+	pthread_mutex_lock(&client->table_lock);
+	for (int id = 1; id <= 2; id++) {
+		monitor_entry* mon = client->table ? table_monitor(client->table, id) : NULL;
+		same = same && mon && mon->inflight == 0 && mon->visible >= 0 && mon->predicted == mon->visible
+			&& atoi(mon->workspaces[mon->visible].name) == mock_server_visible(g_server, id);
+	}
+	pthread_mutex_unlock(&client->table_lock);
+	return same;
+}
+
+static void converges_after_error_reply(void)
+{
+	aerospace* client = mock_client();
+	if (!CHECK(client))
+		return;
+
+	CHECK(swipe(client, 1, 1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 2);
+	CHECK(converged(client));
+
+	mock_server_fail(g_server, MOCK_FAIL_ERROR, 1);
+	CHECK(!swipe(client, 1, 1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 2);
+	CHECK(converged(client));
+
+	CHECK(swipe(client, 1, 2));
+	CHECK_EQ(mock_server_visible(g_server, 1), 4);
+	CHECK(converged(client));
+	mock_client_close(client);
+}
+
+// the switch happened but its reply never came: the client cannot know, so
+// it has to find out from the next listing
+static void converges_after_dropped_connection(void)
+{
+	aerospace* client = mock_client();
+	if (!CHECK(client))
+		return;
+
+	CHECK(swipe(client, 1, 1));
+	mock_server_fail(g_server, MOCK_FAIL_DROP, 1);
+	CHECK(!swipe(client, 1, 1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 3);
+
+	bool refreshed;
+	CHECK(aerospace_refresh_workspaces(client, NAV_TTL_NS, &refreshed));
+	CHECK(refreshed);
+	CHECK(converged(client));
+
+	// and the command connection comes back
+	CHECK(swipe(client, 1, 1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 4);
+	CHECK(converged(client));
+	mock_client_close(client);
+}
+
+static void converges_after_stale_table(void)
+{
+	aerospace* client = mock_client();
+	if (!CHECK(client))
+		return;
+
+	// switched elsewhere: a swipe from the old table still lands on a
+	// workspace the client then knows is showing
+	CHECK(swipe(client, 1, 1));
+	mock_server_focus(g_server, 6);
+	mock_server_focus(g_server, 12);
+	CHECK(swipe(client, 1, 1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 3);
+	CHECK(!converged(client));
+	CHECK(aerospace_refresh_workspaces(client, 0, NULL));
+	CHECK(converged(client));
+
+	// a listing from before the last change holds until the next one
+	mock_server_focus(g_server, 7);
+	mock_server_fail(g_server, MOCK_FAIL_STALE, 1);
+	CHECK(aerospace_refresh_workspaces(client, 0, NULL));
+	CHECK(!converged(client));
+	CHECK(aerospace_refresh_workspaces(client, 0, NULL));
+	CHECK(converged(client));
+	mock_client_close(client);
+}
+
+// A configured action of several commands goes out as one batch: one round
+// trip on the command connection, every command run, the first error kept.
+static void run_batches_commands(void)
+{
+	aerospace* client = mock_client();
+	if (!CHECK(client))
+		return;
+
+	aerospace_conn_stats before, after;
+	aerospace_conn_stats_get(client, AEROSPACE_CONN_COMMAND, &before);
+	char* result = aerospace_run(client, "workspace 3;workspace 5 ;  ; workspace 4");
+	CHECK(!result);
+	free(result);
+	aerospace_conn_stats_get(client, AEROSPACE_CONN_COMMAND, &after);
+	CHECK_EQ(after.requests - before.requests, 3);
+	CHECK_EQ(after.latency.count - before.latency.count, 1);
+	CHECK_EQ(mock_server_visible(g_server, 1), 4);
+
+	mock_server_fail(g_server, MOCK_FAIL_ERROR, 1);
+	result = aerospace_run(client, "workspace 2; workspace 6");
+	CHECK(result && strcmp(result, "mock: command failed") == 0);
+	free(result);
+	CHECK_EQ(mock_server_visible(g_server, 1), 6);
+
+	result = aerospace_run(client, " ; ");
+	CHECK(result && strcmp(result, "empty command") == 0);
+	free(result);
+	mock_client_close(client);
+}
+
+// The backend wm.c builds on the client counts a refused switch as a
+// failure and staying put at an end as none.
+static void wm_switch_reports_outcome(void)
+{
+	aerospace* client = mock_client();
+	if (!CHECK(client))
+		return;
+	wm_options options = { .wrap_around = false, .skip_empty = false, .monitor = "focused" };
+	wm_backend* wm = wm_aerospace_new(client, options);
+
+	CHECK(wm->switch_workspace(wm, -1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 1);
+	CHECK(wm->switch_workspace(wm, 1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 2);
+
+	mock_server_fail(g_server, MOCK_FAIL_ERROR, 1);
+	CHECK(!wm->switch_workspace(wm, 1));
+	CHECK_EQ(mock_server_visible(g_server, 1), 2);
+
+	wm->close(wm);
+	mock_server_stop(g_server);
+}
+
+// Between full listings a refresh patches the table it has; a workspace the
+// table has never seen makes it list everything again.
+static void refreshes_visible_between_listings(void)
+{
+	aerospace* client = mock_client();
+	if (!CHECK(client))
+		return;
+
+	CHECK(aerospace_refresh_workspaces(client, 0, NULL));
+	workspace_table* listed = client->table;
+	mock_server_focus(g_server, 12);
+	mock_server_focus(g_server, 5);
+	bool refreshed;
+	CHECK(aerospace_refresh_workspaces(client, 0, &refreshed));
+	CHECK(refreshed);
+	CHECK(client->table == listed);
+	CHECK(converged(client));
+	CHECK_EQ(aerospace_monitor_id(client, "focused"), 1);
+
+	// a workspace that appeared since the listing
+	pthread_mutex_lock(&client->table_lock);
+	monitor_entry* mon = table_monitor(client->table, 1);
+	mon->count = 7;
+	pthread_mutex_unlock(&client->table_lock);
+	mock_server_focus(g_server, 8);
+	CHECK(aerospace_refresh_workspaces(client, 0, NULL));
+	CHECK(client->table != listed);
+	CHECK_EQ(table_monitor(client->table, 1)->count, 8);
+	CHECK(converged(client));
+
+	// and after an arbitrary command, which may have made one
+	listed = client->table;
+	free(aerospace_run(client, "move-node-to-workspace 20"));
+	CHECK(aerospace_refresh_workspaces(client, 0, NULL));
+	CHECK(client->table != listed);
+	mock_client_close(client);
+}
+
+// Puts script on PATH as the only `aerospace`; restore_path undoes it.
+static char* install_fake_cli(char* dir, const char* script)
+{
+	if (!mkdtemp(dir))
+		return NULL;
+	char path[64];
+	snprintf(path, sizeof(path), "%s/aerospace", dir);
+	FILE* f = fopen(path, "w");
+	if (f) {
+		fputs(script, f);
+		fclose(f);
+	}
+	chmod(path, 0755);
+
+	const char* old_path = getenv("PATH");
+	char* saved = strdup(old_path ? old_path : "");
+	setenv("PATH", dir, 1);
+	return saved;
+}
+
+static void restore_path(const char* dir, char* saved)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "%s/aerospace", dir);
+	unlink(path);
+	rmdir(dir);
+	setenv("PATH", saved, 1);
+	free(saved);
+}
+
+// A stand-in aerospace CLI that prints each argument on its own line, then
+// its stdin; only shell builtins, as PATH holds nothing else.
+static const char ECHO_CLI[] = "#!/bin/sh\n"
+							   "for a in \"$@\"; do printf '%s\\n' \"$a\"; done\n"
+							   "while IFS= read -r line; do printf '%s\\n' \"$line\"; done\n";
+
+static void cli_keeps_arguments_whole(void)
+{
+	char dir[] = "/tmp/swipe-test-XXXXXX";
+	char* saved = install_fake_cli(dir, ECHO_CLI);
+	if (!CHECK(saved))
+		return;
+
+	const char* args[] = { "list-workspaces", "--format", "%{workspace} %{monitor-id}", "it's \"$HOME\" `x`" };
+	bool failed;
+	char* output = execute_cli(args, 4, "1\n2", "stdout", &failed);
+	CHECK(!failed && output && strcmp(output, "list-workspaces\n--format\n%{workspace} %{monitor-id}\nit's \"$HOME\" `x`\n1\n2") == 0);
+	free(output);
+
+	// a command without output asked for answers NULL, like the socket
+	output = execute_cli(args, 1, NULL, NULL, &failed);
+	CHECK(!failed && !output);
+
+	// no CLI at all: no answer, and nothing is left running
+	char path[64];
+	snprintf(path, sizeof(path), "%s/aerospace", dir);
+	unlink(path);
+	output = execute_cli(args, 1, NULL, "stdout", &failed);
+	CHECK(failed && !output);
+	restore_path(dir, saved);
+}
+
+// A stand-in for AeroSpace itself: workspaces 1, 2 and "bad" on monitor 1
+// with 1 showing, every one of them switchable but "bad", which fails the
+// way the real CLI does, on stderr with a non-zero exit.
+static const char WORKSPACE_CLI[] = "#!/bin/sh\n"
+									"empty=\n"
+									"for a in \"$@\"; do [ \"$a\" = --empty ] && empty=1; done\n"
+									"case \"$1\" in\n"
+									"list-workspaces)\n"
+									"  if [ -n \"$empty\" ]; then\n"
+									"    printf '[{\"workspace\":\"1\"},{\"workspace\":\"2\"},{\"workspace\":\"bad\"}]\\n'\n"
+									"  else\n"
+									"    printf '[{\"workspace\":\"1\",\"monitor-id\":1,\"workspace-is-visible\":true,\"workspace-is-focused\":true},'\n"
+									"    printf '{\"workspace\":\"2\",\"monitor-id\":1},{\"workspace\":\"bad\",\"monitor-id\":1}]\\n'\n"
+									"  fi ;;\n"
+									"workspace)\n"
+									"  if [ \"$2\" = bad ]; then printf 'no such workspace\\n' >&2; exit 1; fi ;;\n"
+									"esac\n";
+
+static void cli_fallback_reports_outcomes(void)
+{
+	char dir[] = "/tmp/swipe-test-XXXXXX";
+	char* saved = install_fake_cli(dir, WORKSPACE_CLI);
+	if (!CHECK(saved))
+		return;
+
+	aerospace* client = aerospace_new("/nonexistent/aerospace.sock");
+	CHECK(client->use_cli_fallback);
+	CHECK(aerospace_refresh_workspaces(client, NAV_TTL_NS, NULL));
+
+	// a switch the CLI carries out is a success, not an empty error
+	aerospace_nav nav;
+	CHECK_EQ(aerospace_navigate(client, 1, 1, false, false, &nav), AEROSPACE_NAV_MOVED);
+	char* result = aerospace_nav_send(client, &nav);
+	CHECK(!result);
+	free(result);
+	CHECK(client->table->refreshed_ns != 0);
+	CHECK_EQ(table_monitor(client->table, 1)->visible, 1);
+
+	// one it refuses comes back with its stderr and rolls the prediction back
+	CHECK_EQ(aerospace_navigate(client, 1, 1, false, false, &nav), AEROSPACE_NAV_MOVED);
+	result = aerospace_nav_send(client, &nav);
+	CHECK(result && strcmp(result, "no such workspace") == 0);
+	free(result);
+	CHECK_EQ(table_monitor(client->table, 1)->predicted, 1);
+
+	// at the end without wrap-around there is nothing to send
+	CHECK(aerospace_refresh_workspaces(client, 0, NULL));
+	table_monitor(client->table, 1)->predicted = table_monitor(client->table, 1)->visible = 2;
+	CHECK_EQ(aerospace_navigate(client, 1, 1, false, false, &nav), AEROSPACE_NAV_STAY);
+	CHECK_EQ(aerospace_navigate(client, 2, 1, false, false, &nav), AEROSPACE_NAV_UNKNOWN);
+
+	result = aerospace_run(client, "focus-monitor up");
+	CHECK(!result);
+	free(result);
+
+	aerospace_close(client);
+	restore_path(dir, saved);
+}
+
+void test_aerospace(void)
+{
+	test_run("aerospace/reads_split_reply", reads_split_reply);
+	test_run("aerospace/malformed_reply_drops_connection", malformed_reply_drops_connection);
+	test_run("aerospace/batch_answers_in_order", batch_answers_in_order);
+	test_run("aerospace/batch_stops_and_drops_connection", batch_stops_and_drops_connection);
+	test_run("aerospace/converges_after_error_reply", converges_after_error_reply);
+	test_run("aerospace/converges_after_dropped_connection", converges_after_dropped_connection);
+	test_run("aerospace/converges_after_stale_table", converges_after_stale_table);
+	test_run("aerospace/run_batches_commands", run_batches_commands);
+	test_run("aerospace/wm_switch_reports_outcome", wm_switch_reports_outcome);
+	test_run("aerospace/refreshes_visible_between_listings", refreshes_visible_between_listings);
+	test_run("aerospace/cli_keeps_arguments_whole", cli_keeps_arguments_whole);
+	test_run("aerospace/cli_fallback_reports_outcomes", cli_fallback_reports_outcomes);
+}
@@ -0,0 +1,170 @@
+#include <math.h>
+#include <string.h>
+
+#include "gesture.h"
+#include "synth.h"
+#include "test.h"
+
+// The engine's running sums and extrema against summing every frame again,
+// over the synthetic corpora the benches replay, the golden traces, and a
+// random walk that exercises the paths they do not: fingers resting,
+// reordered touch sets, one finger replaced mid-frame, and an extremum
+// moving inward.
+
+typedef struct {
+	int frames, drifted, wrong_extrema;
+} agg_result;
+
+static void compare(const touch_aggregates* agg, const touch* touches, int count, agg_result* r)
+{
+	double x = 0, y = 0, vel = 0, vel_y = 0, r2 = 0;
+	float min_x = count ? (float)touches[0].x : 0, max_x = min_x;
+	float min_y = count ? (float)touches[0].y : 0, max_y = min_y;
+	for (int i = 0; i < count; i++) {
+		float tx = (float)touches[i].x, ty = (float)touches[i].y;
+		x += tx;
+		y += ty;
+		r2 += (double)tx * tx + (double)ty * ty;
+		vel += (float)touches[i].velocity;
+		vel_y += (float)touches[i].velocity_y;
+		min_x = fminf(min_x, tx);
+		max_x = fmaxf(max_x, tx);
+		min_y = fminf(min_y, ty);
+		max_y = fmaxf(max_y, ty);
+	}
+
+	r->frames++;
+	r->drifted += agg->count != count || fabs(x - agg->sum_x) > 1e-5 || fabs(y - agg->sum_y) > 1e-5
+		|| fabs(r2 - agg->sum_r2) > 1e-5 || fabs(vel - agg->sum_vel) > 1e-5 * (1 + fabs(vel))
+		|| fabs(vel_y - agg->sum_vel_y) > 1e-5 * (1 + fabs(vel_y));
+	r->wrong_extrema += agg->min_x != min_x || agg->max_x != max_x || agg->min_y != min_y || agg->max_y != max_y;
+}
+
+static agg_result replay(const touch_trace* trace)
+{
+	gesture_params params = test_gesture_params();
+	gesture_ctx ctx;
+	gesture_init(&ctx, &params, (gesture_callbacks) { 0 }, NULL);
+
+	agg_result r = { 0 };
+	for (int f = 0; f < trace->frames; f++) {
+		const touch* touches = trace->touches + trace->offsets[f];
+		int count = trace->counts[f] > MAX_TOUCHES ? MAX_TOUCHES : trace->counts[f];
+		gesture_process(&ctx, touches, count);
+		compare(&ctx.agg, touches, count, &r);
+	}
+	return r;
+}
+
+static void check_trace(const touch_trace* trace)
+{
+	agg_result r = replay(trace);
+	CHECK_EQ(r.frames, trace->frames);
+	CHECK_EQ(r.drifted, 0);
+	CHECK_EQ(r.wrong_extrema, 0);
+}
+
+static void swipes_match_full_sums(void)
+{
+	touch_trace trace;
+	for (int fingers = 2; fingers <= 5; fingers++) {
+		bench_trace_swipes(&trace, fingers, 16, 0.012, 3);
+		check_trace(&trace);
+		trace_free(&trace);
+	}
+
+	static const int directions[] = { GESTURE_UP, GESTURE_DOWN_LEFT, GESTURE_UP_LEFT, GESTURE_RIGHT };
+	bench_trace_swipes_along(&trace, 3, 16, 0.008, 6, directions, 4);
+	check_trace(&trace);
+	trace_free(&trace);
+
+	static const double speeds[] = { 0.01, 0.03, 0.06 };
+	bench_trace_flings(&trace, 3, 12, speeds, 3);
+	check_trace(&trace);
+	trace_free(&trace);
+}
+
+static void pinches_match_full_sums(void)
+{
+	touch_trace trace;
+	bench_trace_pinches(&trace, 4, 12, 0.004, 4);
+	check_trace(&trace);
+	trace_free(&trace);
+}
+
+static void golden_traces_match_full_sums(void)
+{
+	trace_budget budgets[64];
+	int count = trace_budgets_load("bench/traces/budgets", budgets, 64);
+	CHECK(count > 0);
+	for (int i = 0; i < count; i++) {
+		touch_trace trace;
+		if (!CHECK(trace_load(budgets[i].path, &trace)))
+			continue;
+		check_trace(&trace);
+		trace_free(&trace);
+	}
+}
+
+static unsigned g_seed = 7;
+
+static double rnd(void)
+{
+	g_seed = g_seed * 1103515245u + 12345u;
+	return ((g_seed >> 8) & 0xFFFF) / 65535.0;
+}
+
+static void random_walk_matches_full_sums(void)
+{
+	const int fingers = 4;
+	touch touches[MAX_TOUCHES];
+	for (int i = 0; i < fingers; i++)
+		touches[i] = (touch) { .x = 0.3 + 0.1 * i, .y = 0.5, .phase = 2, .id = i };
+	int next_id = fingers;
+
+	gesture_params params = test_gesture_params();
+	params.fingers = fingers;
+	gesture_ctx ctx;
+	gesture_init(&ctx, &params, (gesture_callbacks) { 0 }, NULL);
+
+	agg_result r = { 0 };
+	for (int f = 0; f < 20000; f++) {
+		// about half the fingers move each frame, some of them inward
+		// from an extremum
+		for (int i = 0; i < fingers; i++) {
+			if (rnd() < 0.5)
+				continue;
+			touches[i].x += (rnd() - 0.5) * 0.02;
+			touches[i].y += (rnd() - 0.5) * 0.02;
+			touches[i].velocity = (rnd() - 0.5) * 2;
+			touches[i].velocity_y = (rnd() - 0.5) * 2;
+		}
+		double roll = rnd();
+		if (roll < 0.05) {
+			touch first = touches[0];
+			memmove(touches, touches + 1, sizeof(touch) * (fingers - 1));
+			touches[fingers - 1] = first;
+		} else if (roll < 0.06) {
+			touches[(int)(rnd() * fingers) % fingers].id = next_id++;
+		}
+
+		int count = roll > 0.99 ? fingers - 1 : fingers;
+		gesture_process(&ctx, touches, count);
+		compare(&ctx.agg, touches, count, &r);
+	}
+
+	CHECK_EQ(r.drifted, 0);
+	CHECK_EQ(r.wrong_extrema, 0);
+	// the incremental paths actually ran
+	CHECK(ctx.agg.updates < 20000ull * fingers * 3 / 4);
+	CHECK(ctx.agg.rebuilds < 20000 / 10);
+	CHECK(ctx.agg.rescans > 0);
+}
+
+void test_aggregates(void)
+{
+	test_run("aggregates/swipes_match_full_sums", swipes_match_full_sums);
+	test_run("aggregates/pinches_match_full_sums", pinches_match_full_sums);
+	test_run("aggregates/golden_traces_match_full_sums", golden_traces_match_full_sums);
+	test_run("aggregates/random_walk_matches_full_sums", random_walk_matches_full_sums);
+}
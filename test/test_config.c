@@ -0,0 +1,233 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "synth.h"
+#include "test.h"
+
+gesture_params test_gesture_params(void)
+{
+	Config config = default_config();
+	return gesture_params_from_config(&config);
+}
+
+static const char g_config_json[] = "{\n"
+									"  \"fingers\": 3,\n"
+									"  \"distance_pct\": 0.12,\n"
+									"  \"swipe_up\": \"fullscreen\",\n"
+									"  \"swipe_down\": [\"move-node-to-workspace next\", 3, \"workspace next\"],\n"
+									"  \"fling_velocity\": [2.0, 1.0, 4.0],\n"
+									"  \"switch_burst\": 0,\n"
+									"  \"gestures\": [\n"
+									"    { \"type\": \"swipe\", \"fingers\": 4, \"left\": \"move-node-to-workspace prev\" },\n"
+									"    { \"type\": \"pinch\", \"fingers\": 4, \"pinch_out\": \"fullscreen\", \"left\": \"x\" },\n"
+									"    { \"type\": \"pinch\", \"fingers\": 5 }\n"
+									"  ]\n"
+									"}\n";
+
+static const char g_devices_json[] = "{\n"
+									 "  \"fingers\": 3,\n"
+									 "  \"haptic\": true,\n"
+									 "  \"devices\": [\n"
+									 "    { \"haptic\": false },\n"
+									 "    { \"fingers\": 4, \"actuator\": 0 },\n"
+									 "    { \"fingers\": 1, \"distance_pct\": 0.12 }\n"
+									 "  ]\n"
+									 "}\n";
+
+// load_config reads ./config.json, so it runs from a scratch directory, with
+// its chatter sent to /dev/null.
+static bool load_from(const char* json, Config* out)
+{
+	char dir[] = "/tmp/swipe-test-XXXXXX";
+	char cwd[1024];
+	if (!mkdtemp(dir) || !getcwd(cwd, sizeof(cwd)) || chdir(dir) != 0)
+		return false;
+
+	FILE* f = fopen("config.json", "w");
+	bool ok = f && fputs(json, f) >= 0;
+	if (f)
+		fclose(f);
+	if (ok) {
+		fflush(stdout);
+		fflush(stderr);
+		int out_fd = dup(STDOUT_FILENO), err_fd = dup(STDERR_FILENO);
+		int null_fd = open("/dev/null", O_WRONLY);
+		dup2(null_fd, STDOUT_FILENO);
+		dup2(null_fd, STDERR_FILENO);
+		*out = load_config();
+		fflush(stdout);
+		fflush(stderr);
+		dup2(out_fd, STDOUT_FILENO);
+		dup2(err_fd, STDERR_FILENO);
+		close(null_fd);
+		close(out_fd);
+		close(err_fd);
+	}
+	unlink("config.json");
+	ok = chdir(cwd) == 0 && ok;
+	rmdir(dir);
+	return ok;
+}
+
+static void loads_values_and_gestures(void)
+{
+	Config config;
+	if (!CHECK(load_from(g_config_json, &config)))
+		return;
+
+	CHECK(config.distance_pct == 0.12f);
+	CHECK(strcmp(config_action(&config, GESTURE_UP), "fullscreen") == 0);
+	// a list of commands becomes one ;-separated line, skipping non-strings
+	CHECK(strcmp(config_action(&config, GESTURE_DOWN), "move-node-to-workspace next; workspace next") == 0);
+	// out-of-order and out-of-range entries are dropped
+	CHECK_EQ(config.fling_count, 2);
+	CHECK(config.fling_velocity[1] == 4.0f);
+	CHECK_EQ(config.switch_burst, default_config().switch_burst);
+
+	// the empty pinch is dropped and the pinch ignores swipe directions
+	CHECK_EQ(config.gesture_count, 2);
+	CHECK(strcmp(config_gesture_action(&config, 1, GESTURE_LEFT), "move-node-to-workspace prev") == 0);
+	CHECK(strcmp(config_gesture_action(&config, 2, GESTURE_PINCH_OUT), "fullscreen") == 0);
+	CHECK(strcmp(config_gesture_action(&config, 2, GESTURE_LEFT), "") == 0);
+	CHECK(strcmp(config_gesture_action(&config, 3, GESTURE_LEFT), "") == 0);
+}
+
+static void builds_recognizers(void)
+{
+	Config config;
+	if (!CHECK(load_from(g_config_json, &config)))
+		return;
+
+	gesture_recognizers recognizers = gesture_recognizers_from_config(&config);
+	CHECK_EQ(recognizers.count, 3);
+	CHECK_EQ(recognizers.params[0].fingers, 3);
+	CHECK_EQ(recognizers.params[0].axes,
+		GESTURE_AXIS_BIT(GESTURE_AXIS_HORIZONTAL) | GESTURE_AXIS_BIT(GESTURE_AXIS_VERTICAL));
+	CHECK_EQ(recognizers.params[1].axes, GESTURE_AXIS_BIT(GESTURE_AXIS_HORIZONTAL));
+	CHECK_EQ(recognizers.params[2].kind, GESTURE_KIND_PINCH);
+	// extra recognizers share the main thresholds
+	CHECK(recognizers.params[2].distance_pct == 0.12f);
+	CHECK_EQ(gesture_recognizers_fingers(&recognizers), GESTURE_FINGERS(3) | GESTURE_FINGERS(4));
+}
+
+static void reports_json(void)
+{
+	Config config;
+	if (!CHECK(load_from(g_config_json, &config)))
+		return;
+
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* root = yyjson_mut_obj(doc);
+	yyjson_mut_doc_set_root(doc, root);
+	config_to_json(&config, doc, root);
+
+	CHECK(strcmp(yyjson_mut_get_str(yyjson_mut_obj_get(root, "swipe_up")), "fullscreen") == 0);
+	CHECK_EQ(yyjson_mut_arr_size(yyjson_mut_obj_get(root, "fling_velocity")), 2);
+	CHECK_EQ(yyjson_mut_arr_size(yyjson_mut_obj_get(root, "gestures")), 2);
+	yyjson_mut_doc_free(doc);
+}
+
+static void applies_device_overrides(void)
+{
+	Config config;
+	if (!CHECK(load_from(g_devices_json, &config)))
+		return;
+
+	CHECK_EQ(config.device_count, 3);
+	CHECK(!config_for_device(&config, 0).haptic);
+	CHECK_EQ(config_for_device(&config, 0).fingers, 3);
+	CHECK(config_for_device(&config, 1).haptic);
+	CHECK_EQ(config_for_device(&config, 1).fingers, 4);
+	CHECK_EQ(config.devices[1].actuator, 0);
+	// a finger count no swipe has keeps the top-level one
+	CHECK_EQ(config_for_device(&config, 2).fingers, 3);
+	CHECK(config_for_device(&config, 2).distance_pct == 0.12f);
+	CHECK_EQ(config.devices[2].actuator, -1);
+	// pads past the list take the top level
+	CHECK_EQ(config_for_device(&config, 3).fingers, 3);
+	CHECK(config_for_device(&config, 3).haptic);
+
+	gesture_recognizers recognizers = gesture_recognizers_for_device(&config, 1);
+	CHECK_EQ(recognizers.params[0].fingers, 4);
+}
+
+typedef struct {
+	int direction[64];
+	int count;
+} pad_fires;
+
+static void pad_fired(gesture_ctx* ctx, int direction)
+{
+	pad_fires* fires = gesture_set_of(ctx)->userdata;
+	if (fires->count < 64)
+		fires->direction[fires->count++] = direction;
+}
+
+static void feed_frame(gesture_set* set, const touch_trace* trace, int f)
+{
+	if (f < trace->frames)
+		gesture_set_process(set, trace->touches + trace->offsets[f], trace->counts[f]);
+}
+
+// Two pads with their own finger counts, their frames interleaved the way
+// the event tap delivers them: each fires its own swipes and nothing of the
+// other's, even where both are mid-swipe with the same touch ids.
+static void replays_two_devices_interleaved(void)
+{
+	Config config;
+	if (!CHECK(load_from(g_devices_json, &config)))
+		return;
+
+	touch_trace three, four;
+	bench_trace_swipes(&three, 3, 8, 0.012, 3);
+	bench_trace_swipes(&four, 4, 6, 0.012, 3);
+
+	pad_fires fires[2] = { 0 };
+	gesture_set sets[2];
+	for (int i = 0; i < 2; i++) {
+		gesture_recognizers recognizers = gesture_recognizers_for_device(&config, i);
+		gesture_set_init(&sets[i], &recognizers, (gesture_callbacks) { .fired = pad_fired }, &fires[i]);
+	}
+
+	int frames = three.frames > four.frames ? three.frames : four.frames;
+	for (int f = 0; f < frames; f++) {
+		feed_frame(&sets[0], &three, f);
+		feed_frame(&sets[1], &four, f);
+	}
+
+	CHECK(three.fire_count > 0 && four.fire_count > 0);
+	CHECK_EQ(fires[0].count, three.fire_count);
+	for (int i = 0; i < fires[0].count && i < three.fire_count; i++)
+		CHECK_EQ(fires[0].direction[i], three.fires[i].direction);
+	CHECK_EQ(fires[1].count, four.fire_count);
+	for (int i = 0; i < fires[1].count && i < four.fire_count; i++)
+		CHECK_EQ(fires[1].direction[i], four.fires[i].direction);
+
+	// and each pad's swipes mean nothing to the other
+	pad_fires crossed[2] = { 0 };
+	for (int i = 0; i < 2; i++) {
+		gesture_recognizers recognizers = gesture_recognizers_for_device(&config, i);
+		gesture_set_init(&sets[i], &recognizers, (gesture_callbacks) { .fired = pad_fired }, &crossed[i]);
+	}
+	for (int f = 0; f < frames; f++) {
+		feed_frame(&sets[0], &four, f);
+		feed_frame(&sets[1], &three, f);
+	}
+	CHECK_EQ(crossed[0].count, 0);
+	CHECK_EQ(crossed[1].count, 0);
+
+	trace_free(&three);
+	trace_free(&four);
+}
+
+void test_config(void)
+{
+	test_run("config/loads_values_and_gestures", loads_values_and_gestures);
+	test_run("config/builds_recognizers", builds_recognizers);
+	test_run("config/reports_json", reports_json);
+	test_run("config/applies_device_overrides", applies_device_overrides);
+	test_run("config/replays_two_devices_interleaved", replays_two_devices_interleaved);
+}
@@ -0,0 +1,132 @@
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "test.h"
+
+// The control socket: where it lives by default, and a client that stops
+// reading its replies while another one asks for something.
+
+#define BIG_REPLY 65536
+#define BIG_REQUESTS 64
+#define REPLY_WAIT_MS 2000
+
+static bool control_big(void* userdata, yyjson_val* request, yyjson_mut_doc* doc, yyjson_mut_val* reply)
+{
+	(void)userdata;
+	(void)request;
+	static char filler[BIG_REPLY];
+	memset(filler, 'x', sizeof(filler) - 1);
+	yyjson_mut_obj_add_strn(doc, reply, "filler", filler, sizeof(filler) - 1);
+	return true;
+}
+
+static const control_command g_commands[] = {
+	{ "big", control_big },
+};
+
+static int connect_to(const char* path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool send_line(int fd, const char* line)
+{
+	size_t len = strlen(line);
+	return write(fd, line, len) == (ssize_t)len;
+}
+
+// Reads until a newline, EOF or REPLY_WAIT_MS without data; the byte count
+// read, or -1 on error or timeout.
+static long read_reply(int fd, bool until_eof)
+{
+	char buf[4096];
+	long total = 0;
+	for (;;) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		if (poll(&pfd, 1, REPLY_WAIT_MS) <= 0)
+			return -1;
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n <= 0)
+			return until_eof ? total : -1;
+		total += n;
+		if (!until_eof && memchr(buf, '\n', (size_t)n))
+			return total;
+	}
+}
+
+static void default_path_follows_runtime_dir(void)
+{
+	const char* saved = getenv("XDG_RUNTIME_DIR");
+	char* old = saved ? strdup(saved) : NULL;
+	char path[108], expected[108];
+
+	setenv("XDG_RUNTIME_DIR", "/run/user/1000/", 1);
+	control_default_path(path, sizeof(path));
+	CHECK(strcmp(path, "/run/user/1000/aerospace-swipe.ctl") == 0);
+
+	// too long for a socket address, or unset: /tmp with the user's name
+	const char* user = getenv("USER");
+	snprintf(expected, sizeof(expected), "/tmp/aerospace-swipe-%s.ctl", user ? user : "unknown");
+	char long_dir[160];
+	memset(long_dir, 'd', sizeof(long_dir) - 1);
+	long_dir[0] = '/';
+	long_dir[sizeof(long_dir) - 1] = '\0';
+	setenv("XDG_RUNTIME_DIR", long_dir, 1);
+	control_default_path(path, sizeof(path));
+	CHECK(strcmp(path, expected) == 0);
+
+	unsetenv("XDG_RUNTIME_DIR");
+	control_default_path(path, sizeof(path));
+	CHECK(strcmp(path, expected) == 0);
+
+	if (old)
+		setenv("XDG_RUNTIME_DIR", old, 1);
+	free(old);
+}
+
+static void drops_client_that_stops_reading(void)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/swipe-test-control-%d.sock", (int)getpid());
+	control_server* server = control_start(path, g_commands, 1, NULL);
+	if (!CHECK(server))
+		return;
+
+	// far more reply than the socket buffers hold, and never read
+	int stuck = connect_to(path);
+	CHECK(stuck >= 0);
+	for (int i = 0; i < BIG_REQUESTS; i++)
+		send_line(stuck, "{\"command\":\"big\"}\n");
+	nanosleep(&(struct timespec) { 0, 50000000 }, NULL);
+
+	int other = connect_to(path);
+	CHECK(other >= 0 && send_line(other, "{\"command\":\"help\"}\n"));
+	CHECK(read_reply(other, false) > 0);
+
+	// the stuck client got part of its replies and then its connection closed
+	long got = read_reply(stuck, true);
+	CHECK(got >= 0 && got < (long)BIG_REPLY * BIG_REQUESTS);
+
+	close(stuck);
+	close(other);
+	control_stop(server);
+}
+
+void test_control(void)
+{
+	test_run("control/default_path_follows_runtime_dir", default_path_follows_runtime_dir);
+	test_run("control/drops_client_that_stops_reading", drops_client_that_stops_reading);
+}
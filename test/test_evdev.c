@@ -0,0 +1,255 @@
+#include <string.h>
+
+#include "input_evdev.h"
+#include "test.h"
+
+// The evdev decoder through SYN_DROPPED, slots it cannot follow, and
+// contacts already down when it starts, fed directly and through
+// input_evdev_replay of a checked-in capture.
+
+// Raw struct input_event records (64-bit layout) of three 3-finger swipes
+// on a 0-4096 pad: right with an ABS_MT_SLOT 40 and its positions in the
+// middle, left cut off by SYN_DROPPED two frames in, and left again.
+#define CAPTURE_PATH "test/captures/swipe_dropped.evdev"
+#define PAD_MAX 4096
+#define MAX_FRAMES 256
+
+typedef struct {
+	touch touches[MAX_FRAMES][MAX_TOUCHES];
+	int counts[MAX_FRAMES];
+	int frames;
+} frame_log;
+
+static void log_frame(void* userdata, uint64_t device, const touch* touches, int count)
+{
+	(void)device;
+	frame_log* log = userdata;
+	if (log->frames == MAX_FRAMES)
+		return;
+	memcpy(log->touches[log->frames], touches, sizeof(touch) * count);
+	log->counts[log->frames++] = count;
+}
+
+static void feed(evdev_decoder* dec, frame_log* log, int type, int code, int value)
+{
+	struct input_event ev = { .type = type, .code = code, .value = value };
+	evdev_decoder_feed(dec, &ev, log_frame, log);
+}
+
+static void put_contact(evdev_decoder* dec, frame_log* log, int slot, int id, int x)
+{
+	feed(dec, log, EV_ABS, ABS_MT_SLOT, slot);
+	if (id >= 0)
+		feed(dec, log, EV_ABS, ABS_MT_TRACKING_ID, id);
+	feed(dec, log, EV_ABS, ABS_MT_POSITION_X, x);
+	feed(dec, log, EV_ABS, ABS_MT_POSITION_Y, PAD_MAX / 2);
+}
+
+static const touch* find_touch(const frame_log* log, int frame, int id)
+{
+	for (int i = 0; i < log->counts[frame]; i++) {
+		if (log->touches[frame][i].id == id)
+			return &log->touches[frame][i];
+	}
+	return NULL;
+}
+
+static evdev_snapshot g_snapshot;
+
+static bool fake_sync(void* userdata, evdev_snapshot* out)
+{
+	(void)userdata;
+	*out = g_snapshot;
+	return true;
+}
+
+static void decoder(evdev_decoder* dec)
+{
+	evdev_axis axis = { 0, PAD_MAX };
+	evdev_decoder_init(dec, 1, axis, axis);
+}
+
+static void resyncs_after_drop(void)
+{
+	static evdev_decoder dec;
+	static frame_log log;
+	log.frames = 0;
+	decoder(&dec);
+	dec.sync = fake_sync;
+
+	for (int i = 0; i < 3; i++)
+		put_contact(&dec, &log, i, 10 + i, 1000);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+
+	// while events were lost slot 0 moved, slot 1 lifted and slot 2 was
+	// lifted and touched again
+	memset(&g_snapshot, 0xff, sizeof(g_snapshot));
+	g_snapshot.slot = 2;
+	g_snapshot.tracking_id[0] = 10;
+	g_snapshot.tracking_id[2] = 13;
+	g_snapshot.x[0] = g_snapshot.x[2] = 2048;
+	g_snapshot.y[0] = g_snapshot.y[2] = PAD_MAX / 2;
+	feed(&dec, &log, EV_SYN, SYN_DROPPED, 0);
+	put_contact(&dec, &log, 0, -1, 3000); // lost with the rest
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+
+	if (!CHECK_EQ(log.frames, 2))
+		return;
+	const touch* moved = find_touch(&log, 1, 0);
+	const touch* lifted = find_touch(&log, 1, 1);
+	const touch* again = find_touch(&log, 1, 2);
+	CHECK(moved && moved->phase == TOUCH_PHASE_MOVED && moved->x == 0.5);
+	CHECK(lifted && lifted->phase == TOUCH_PHASE_ENDED);
+	CHECK(again && again->phase == TOUCH_PHASE_BEGAN && again->x == 0.5);
+
+	// the snapshot's slot is current: no ABS_MT_SLOT before these
+	feed(&dec, &log, EV_ABS, ABS_MT_POSITION_X, 1024);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+	CHECK_EQ(log.counts[2], 2);
+	const touch* slot2 = find_touch(&log, 2, 2);
+	CHECK(slot2 && slot2->x == 0.25);
+}
+
+static void drop_without_sync_ends_contacts(void)
+{
+	static evdev_decoder dec;
+	static frame_log log;
+	log.frames = 0;
+	decoder(&dec);
+
+	put_contact(&dec, &log, 0, 1, 1000);
+	put_contact(&dec, &log, 1, 2, 1200);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+	feed(&dec, &log, EV_SYN, SYN_DROPPED, 0);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+
+	if (!CHECK_EQ(log.frames, 3))
+		return;
+	CHECK_EQ(log.counts[1], 2);
+	for (int i = 0; i < log.counts[1]; i++)
+		CHECK_EQ(log.touches[1][i].phase, TOUCH_PHASE_ENDED);
+	CHECK_EQ(log.counts[2], 0);
+}
+
+static void ignores_slots_out_of_range(void)
+{
+	static evdev_decoder dec;
+	static frame_log log;
+	log.frames = 0;
+	decoder(&dec);
+
+	put_contact(&dec, &log, 0, 1, 1024);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+	feed(&dec, &log, EV_ABS, ABS_MT_SLOT, MAX_TOUCHES);
+	feed(&dec, &log, EV_ABS, ABS_MT_TRACKING_ID, 7);
+	feed(&dec, &log, EV_ABS, ABS_MT_POSITION_X, 0);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+	feed(&dec, &log, EV_ABS, ABS_MT_POSITION_X, 0); // still no valid slot
+	feed(&dec, &log, EV_ABS, ABS_MT_SLOT, 0);
+	feed(&dec, &log, EV_ABS, ABS_MT_POSITION_X, 2048);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+
+	if (!CHECK_EQ(log.frames, 3))
+		return;
+	CHECK_EQ(log.counts[1], 1);
+	CHECK(log.touches[1][0].x == 0.25);
+	CHECK_EQ(log.counts[2], 1);
+	CHECK(log.touches[2][0].x == 0.5);
+}
+
+// what input_evdev_open does with the fingers it finds on the pad
+static void contacts_down_at_open_begin(void)
+{
+	static evdev_decoder dec;
+	static frame_log log;
+	log.frames = 0;
+	decoder(&dec);
+
+	evdev_snapshot snap;
+	memset(&snap, 0xff, sizeof(snap));
+	snap.slot = 1;
+	snap.tracking_id[0] = 4;
+	snap.tracking_id[1] = 5;
+	snap.x[0] = snap.x[1] = 1024;
+	snap.y[0] = snap.y[1] = 0;
+	evdev_decoder_sync(&dec, &snap);
+	feed(&dec, &log, EV_ABS, ABS_MT_POSITION_X, 2048);
+	feed(&dec, &log, EV_SYN, SYN_REPORT, 0);
+
+	if (!CHECK_EQ(log.frames, 1) || !CHECK_EQ(log.counts[0], 2))
+		return;
+	CHECK_EQ(log.touches[0][0].phase, TOUCH_PHASE_BEGAN);
+	CHECK(log.touches[0][0].x == 0.25 && log.touches[0][0].y == 1.0);
+	CHECK(log.touches[0][1].x == 0.5);
+}
+
+typedef struct {
+	frame_log log;
+	gesture_ctx gesture;
+	int fired[8];
+	int fire_count;
+} replay_run;
+
+static void replay_fired(gesture_ctx* ctx, int direction)
+{
+	replay_run* run = ctx->userdata;
+	if (run->fire_count < 8)
+		run->fired[run->fire_count++] = direction;
+}
+
+static void replay_frame(void* userdata, uint64_t device, const touch* touches, int count)
+{
+	replay_run* run = userdata;
+	log_frame(&run->log, device, touches, count);
+	gesture_process(&run->gesture, touches, count);
+}
+
+static void replays_capture(void)
+{
+	evdev_axis axis = { 0, PAD_MAX };
+	input_backend* input = input_evdev_replay(CAPTURE_PATH, axis, axis);
+	if (!CHECK(input))
+		return;
+
+	static replay_run run;
+	gesture_params params = test_gesture_params();
+	gesture_init(&run.gesture, &params, (gesture_callbacks) { .fired = replay_fired }, &run);
+	CHECK_EQ(input->run(input, replay_frame, &run), 0);
+	input->close(input);
+
+	// the cut-off swipe neither fires nor leaves fingers behind
+	CHECK_EQ(run.fire_count, 2);
+	CHECK_EQ(run.fired[0], GESTURE_RIGHT);
+	CHECK_EQ(run.fired[1], GESTURE_LEFT);
+
+	// the first swipe lifts, then SYN_DROPPED ends the second
+	int ended_at = -1, lifts = 0;
+	for (int f = 0; f < run.log.frames; f++) {
+		bool ended = false;
+		for (int i = 0; i < run.log.counts[f]; i++) {
+			// slot 40's position never lands on a slot that is followed
+			CHECK(run.log.touches[f][i].x > 0.2);
+			ended = ended || run.log.touches[f][i].phase == TOUCH_PHASE_ENDED;
+		}
+		if (ended && ++lifts == 2)
+			ended_at = f;
+	}
+	// all three at once, then nothing until the third swipe touches down
+	if (!CHECK(ended_at > 0))
+		return;
+	CHECK_EQ(run.log.counts[ended_at], 3);
+	int next = ended_at + 1;
+	while (next < run.log.frames && run.log.counts[next] == 0)
+		next++;
+	CHECK(next < run.log.frames && run.log.touches[next][0].phase == TOUCH_PHASE_BEGAN);
+}
+
+void test_evdev(void)
+{
+	test_run("evdev/resyncs_after_drop", resyncs_after_drop);
+	test_run("evdev/drop_without_sync_ends_contacts", drop_without_sync_ends_contacts);
+	test_run("evdev/ignores_slots_out_of_range", ignores_slots_out_of_range);
+	test_run("evdev/contacts_down_at_open_begin", contacts_down_at_open_begin);
+	test_run("evdev/replays_capture", replays_capture);
+}
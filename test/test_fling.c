@@ -0,0 +1,75 @@
+#include "gesture.h"
+#include "synth.h"
+#include "test.h"
+
+// The fling curve: each fling adds up to the steps its speed is worth,
+// whether the producer's velocities are exact, jittered or smoothed. Speeds
+// near a point of the curve stay on their side of it despite the noise.
+
+#define FLINGS 60
+#define MAX_FIRES 256
+
+static gesture_params fling_params(void)
+{
+	gesture_params params = test_gesture_params();
+	params.fling_vel[0] = 2.5f;
+	params.fling_vel[1] = 5.0f;
+	params.fling_count = 2;
+	return params;
+}
+
+// Replays FLINGS flings cycling through speeds under each estimator and
+// checks every one against expected.
+static void check_flings(const double* speeds, const int* expected, int count)
+{
+	gesture_params params = fling_params();
+	for (bench_velocity how = BENCH_VELOCITY_EXACT; how <= BENCH_VELOCITY_SMOOTHED; how++) {
+		touch_trace trace;
+		bench_trace_flings(&trace, params.fingers, FLINGS, speeds, count);
+		bench_trace_reestimate(&trace, how);
+
+		trace_fire fires[MAX_FIRES];
+		int fired = trace_replay(&trace, &params, fires, MAX_FIRES);
+		int steps[FLINGS], calls[FLINGS];
+		bench_fire_steps(&trace, fires, fired < MAX_FIRES ? fired : MAX_FIRES, steps, calls);
+
+		int wrong = 0;
+		for (int a = 0; a < trace.fire_count; a++)
+			wrong += steps[a] != expected[a % count];
+		CHECK_EQ(trace.fire_count, FLINGS);
+		if (!CHECK_EQ(wrong, 0))
+			fprintf(stderr, "  estimator %d\n", how);
+		trace_free(&trace);
+	}
+}
+
+static void steps_match_speed(void)
+{
+	// 1.44, 3.6 and 7.2 pad widths per second at 120 Hz
+	static const double speeds[] = { 0.012, 0.030, 0.060 };
+	static const int expected[] = { 1, 2, 3 };
+	check_flings(speeds, expected, 3);
+}
+
+static void no_step_from_noise_under_a_point(void)
+{
+	// 2.16 and 4.32 pad widths per second, about 15% under each point
+	static const double speeds[] = { 0.018, 0.036 };
+	static const int expected[] = { 1, 2 };
+	check_flings(speeds, expected, 2);
+}
+
+static void steps_clear_of_a_point(void)
+{
+	// 3 and 6 pad widths per second, 20% over each point
+	static const double speeds[] = { 0.025, 0.050 };
+	static const int expected[] = { 2, 3 };
+	check_flings(speeds, expected, 2);
+}
+
+void test_fling(void)
+{
+	test_run("fling/steps_match_speed", steps_match_speed);
+	test_run("fling/no_step_from_noise_under_a_point", no_step_from_noise_under_a_point);
+	test_run("fling/steps_clear_of_a_point", steps_clear_of_a_point);
+}
@@ -0,0 +1,207 @@
+#include "gesture.h"
+#include "synth.h"
+#include "test.h"
+
+// The conflict policy of gesture_set: one recognizer fires per touch
+// sequence, the earliest in the list when several fire on the same frame,
+// and it owns the device until its fingers lift.
+
+#define MAX_FIRES 256
+
+typedef struct {
+	int recognizer[MAX_FIRES];
+	int direction[MAX_FIRES];
+	int frame[MAX_FIRES];
+	int count;
+	int current_frame;
+} fire_log;
+
+static void log_fire(gesture_ctx* ctx, int direction)
+{
+	gesture_set* set = gesture_set_of(ctx);
+	fire_log* log = set->userdata;
+	if (log->count == MAX_FIRES)
+		return;
+	log->recognizer[log->count] = gesture_set_index(set, ctx);
+	log->direction[log->count] = direction;
+	log->frame[log->count] = log->current_frame;
+	log->count++;
+}
+
+static gesture_params swipe(int fingers)
+{
+	gesture_params params = test_gesture_params();
+	params.fingers = fingers;
+	return params;
+}
+
+static gesture_params pinch(int fingers)
+{
+	gesture_params params = swipe(fingers);
+	params.kind = GESTURE_KIND_PINCH;
+	return params;
+}
+
+// Replays trace and checks after every frame that the owner is released
+// by the frame after each lift-off.
+static void replay(gesture_set* set, const touch_trace* trace, fire_log* log)
+{
+	for (int f = 0; f < trace->frames; f++) {
+		log->current_frame = f;
+		gesture_set_process(set, trace->touches + trace->offsets[f], trace->counts[f]);
+		if (trace->counts[f] == 0)
+			CHECK_EQ(set->owner, -1);
+	}
+}
+
+static void earliest_recognizer_wins(void)
+{
+	// the same swipe twice: both fire on the same frame, the first wins
+	gesture_recognizers recognizers = { .params = { swipe(3), swipe(3) }, .count = 2 };
+	fire_log log = { .count = 0 };
+	gesture_set set;
+	gesture_set_init(&set, &recognizers, (gesture_callbacks) { .fired = log_fire }, &log);
+
+	touch_trace trace;
+	bench_trace_swipes(&trace, 3, 8, 0.012, 3);
+	replay(&set, &trace, &log);
+
+	CHECK_EQ(log.count, trace.fire_count);
+	for (int i = 0; i < log.count; i++) {
+		CHECK_EQ(log.recognizer[i], 0);
+		CHECK_EQ(log.direction[i], trace.fires[i].direction);
+	}
+	trace_free(&trace);
+}
+
+static void others_reset_while_owned(void)
+{
+	gesture_recognizers recognizers = { .params = { swipe(3), swipe(3) }, .count = 2 };
+	fire_log log = { .count = 0 };
+	gesture_set set;
+	gesture_set_init(&set, &recognizers, (gesture_callbacks) { .fired = log_fire }, &log);
+
+	touch_trace trace;
+	bench_trace_swipes(&trace, 3, 4, 0.012, 3);
+	int owned = 0;
+	for (int f = 0; f < trace.frames; f++) {
+		log.current_frame = f;
+		gesture_set_process(&set, trace.touches + trace.offsets[f], trace.counts[f]);
+		if (set.owner == 0) {
+			owned++;
+			CHECK_EQ(set.recognizers[1].state, GS_IDLE);
+			CHECK_EQ(gesture_set_state(&set), set.recognizers[0].state);
+		}
+	}
+	CHECK(owned > 0);
+	trace_free(&trace);
+}
+
+static void later_recognizer_fires_alone(void)
+{
+	// a four-finger swipe is only the second recognizer's
+	gesture_recognizers recognizers = { .params = { swipe(3), swipe(4) }, .count = 2 };
+	fire_log log = { .count = 0 };
+	gesture_set set;
+	gesture_set_init(&set, &recognizers, (gesture_callbacks) { .fired = log_fire }, &log);
+	CHECK_EQ(gesture_set_fingers(&set), GESTURE_FINGERS(3) | GESTURE_FINGERS(4));
+
+	touch_trace trace;
+	bench_trace_swipes(&trace, 4, 6, 0.012, 3);
+	replay(&set, &trace, &log);
+
+	CHECK_EQ(log.count, trace.fire_count);
+	for (int i = 0; i < log.count; i++)
+		CHECK_EQ(log.recognizer[i], 1);
+	trace_free(&trace);
+}
+
+static void swipe_and_pinch_on_the_same_fingers(void)
+{
+	gesture_recognizers recognizers = { .params = { swipe(4), pinch(4) }, .count = 2 };
+	fire_log log = { .count = 0 };
+	gesture_set set;
+	gesture_set_init(&set, &recognizers, (gesture_callbacks) { .fired = log_fire }, &log);
+
+	touch_trace trace;
+	bench_trace_pinches(&trace, 4, 6, 0.004, 4);
+	replay(&set, &trace, &log);
+	CHECK_EQ(log.count, trace.fire_count);
+	for (int i = 0; i < log.count; i++) {
+		CHECK_EQ(log.recognizer[i], 1);
+		CHECK_EQ(log.direction[i], trace.fires[i].direction);
+	}
+	trace_free(&trace);
+
+	log.count = 0;
+	bench_trace_swipes(&trace, 4, 6, 0.012, 3);
+	replay(&set, &trace, &log);
+	CHECK_EQ(log.count, trace.fire_count);
+	for (int i = 0; i < log.count; i++)
+		CHECK_EQ(log.recognizer[i], 0);
+	trace_free(&trace);
+}
+
+// One fire per touch sequence: with the swipe first, a pinch that spreads
+// while the fingers travel loses to it and stays quiet until the lift.
+static void one_fire_per_sequence(void)
+{
+	gesture_recognizers recognizers = { .params = { swipe(4), pinch(4) }, .count = 2 };
+	fire_log log = { .count = 0 };
+	gesture_set set;
+	gesture_set_init(&set, &recognizers, (gesture_callbacks) { .fired = log_fire }, &log);
+
+	touch_trace trace;
+	bench_trace_swipes(&trace, 4, 4, 0.012, 3);
+	// spread the fingers apart as they go, enough for a pinch out
+	for (int f = 0, step = 0; f < trace.frames; f++, step++) {
+		touch* touches = trace.touches + trace.offsets[f];
+		if (trace.counts[f] == 0)
+			step = -1;
+		for (int i = 0; i < trace.counts[f]; i++)
+			touches[i].y += 0.004 * step * (i - 1.5);
+	}
+	gesture_recognizers pinch_only = { .params = { pinch(4) }, .count = 1 };
+	trace_fire pinches[64];
+	CHECK(trace_replay_set(&trace, &pinch_only, pinches, 64) >= 4);
+	replay(&set, &trace, &log);
+
+	int sequence_fires[8] = { 0 };
+	for (int i = 0, sequence = 0, f = 0; i < log.count; i++) {
+		for (; f < log.frame[i]; f++)
+			sequence += trace.counts[f] == 0;
+		if (sequence < 8)
+			sequence_fires[sequence]++;
+		CHECK_EQ(log.recognizer[i], 0);
+	}
+	for (int s = 0; s < 4; s++)
+		CHECK_EQ(sequence_fires[s], 1);
+	trace_free(&trace);
+}
+
+static void replay_set_matches_single(void)
+{
+	gesture_params params = swipe(3);
+	gesture_recognizers recognizers = { .params = { params }, .count = 1 };
+
+	touch_trace trace;
+	bench_trace_swipes(&trace, 3, 12, 0.012, 3);
+	trace_fire single[64], set[64];
+	int fired = trace_replay(&trace, &params, single, 64);
+	CHECK_EQ(trace_replay_set(&trace, &recognizers, set, 64), fired);
+	for (int i = 0; i < fired && i < 64; i++) {
+		CHECK_EQ(set[i].frame, single[i].frame);
+		CHECK_EQ(set[i].direction, single[i].direction);
+	}
+	trace_free(&trace);
+}
+
+void test_gesture_set(void)
+{
+	test_run("gesture_set/earliest_recognizer_wins", earliest_recognizer_wins);
+	test_run("gesture_set/others_reset_while_owned", others_reset_while_owned);
+	test_run("gesture_set/later_recognizer_fires_alone", later_recognizer_fires_alone);
+	test_run("gesture_set/swipe_and_pinch_on_the_same_fingers", swipe_and_pinch_on_the_same_fingers);
+	test_run("gesture_set/one_fire_per_sequence", one_fire_per_sequence);
+	test_run("gesture_set/replay_set_matches_single", replay_set_matches_single);
+}
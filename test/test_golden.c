@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "trace.h"
+
+// The golden traces in bench/traces: every annotated fire and no other,
+// within the frames-to-fire budgets of the manifest.
+
+#define GOLDEN_MANIFEST "bench/traces/budgets"
+#define GOLDEN_MAX 64
+#define MAX_FIRES 256
+
+static const trace_budget* g_budget;
+
+static void replays_within_budget(void)
+{
+	touch_trace trace;
+	if (!CHECK(trace_load(g_budget->path, &trace)))
+		return;
+
+	gesture_params params = test_gesture_params();
+	params.fingers = g_budget->fingers;
+	trace_fire fires[MAX_FIRES];
+	trace_score score = trace_score_fires(&trace, fires, trace_replay(&trace, &params, fires, MAX_FIRES), MAX_FIRES);
+
+	CHECK_EQ(score.missed, 0);
+	CHECK_EQ(score.extra, 0);
+	if (g_budget->p50 < 0) {
+		CHECK_EQ(trace.fire_count, 0);
+	} else {
+		CHECK(trace.fire_count > 0);
+		CHECK(score.p50 <= g_budget->p50);
+		CHECK(score.p95 <= g_budget->p95);
+	}
+	if (score.matched > 0 && (score.p50 > g_budget->p50 || score.p95 > g_budget->p95))
+		fprintf(stderr, "  %s: %d fires, frames-to-fire p50 %d (budget %d) p95 %d (budget %d)\n", g_budget->path,
+			score.matched, score.p50, g_budget->p50, score.p95, g_budget->p95);
+	trace_free(&trace);
+}
+
+static void manifest_loads(void)
+{
+	trace_budget budgets[GOLDEN_MAX];
+	CHECK(trace_budgets_load(GOLDEN_MANIFEST, budgets, GOLDEN_MAX) > 0);
+}
+
+void test_golden(void)
+{
+	static trace_budget budgets[GOLDEN_MAX];
+	test_run("golden/manifest_loads", manifest_loads);
+
+	int count = trace_budgets_load(GOLDEN_MANIFEST, budgets, GOLDEN_MAX);
+	for (int i = 0; i < count; i++) {
+		const char* slash = strrchr(budgets[i].path, '/');
+		char name[128];
+		snprintf(name, sizeof(name), "golden/%s", slash ? slash + 1 : budgets[i].path);
+		g_budget = &budgets[i];
+		test_run(name, replays_within_budget);
+	}
+}
@@ -0,0 +1,242 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i3ipc.h"
+#include "mock_server.h"
+#include "test.h"
+#include "wm.h"
+
+// The i3 backend against the mock i3 socket: the commands a switch sends,
+// the GET_WORKSPACES listing it reads, the ends of the focused output
+// without wrap-around, and focus events from a subscription.
+
+static mock_server* g_server;
+
+static wm_backend* mock_wm(bool wrap_around)
+{
+	static int serial;
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/swipe-test-i3-%d-%d.sock", (int)getpid(), serial++);
+	g_server = mock_server_start(path, MOCK_I3);
+	wm_options options = { .wrap_around = wrap_around, .skip_empty = true };
+	return g_server ? wm_i3_new(path, options) : NULL;
+}
+
+static void mock_wm_close(wm_backend* wm)
+{
+	wm->close(wm);
+	mock_server_stop(g_server);
+}
+
+// 1, 2 and 3 on output A and 9 on B, with the one named focused focused.
+static void focus_workspace(const char* focused)
+{
+	static const char* const names[] = { "1", "2", "3", "9" };
+	char json[512];
+	size_t len = (size_t)snprintf(json, sizeof(json), "[");
+	for (int i = 0; i < 4; i++) {
+		len += (size_t)snprintf(json + len, sizeof(json) - len, "%s{\"name\":\"%s\",\"output\":\"%s\",\"focused\":%s}",
+			i ? "," : "", names[i], i < 3 ? "A" : "B", strcmp(names[i], focused) == 0 ? "true" : "false");
+	}
+	snprintf(json + len, sizeof(json) - len, "]");
+	mock_server_set_workspaces(g_server, json);
+}
+
+static bool sent(const char* expected)
+{
+	char* commands = mock_server_commands(g_server);
+	bool same = strcmp(commands, expected) == 0;
+	if (!same)
+		fprintf(stderr, "  sent \"%s\", expected \"%s\"\n", commands, expected);
+	free(commands);
+	return same;
+}
+
+static void sends_commands(void)
+{
+	wm_backend* wm = mock_wm(true);
+	if (!CHECK(wm))
+		return;
+
+	CHECK(wm->switch_workspace(wm, 1));
+	CHECK(wm->switch_workspace(wm, -3));
+	CHECK(wm->run_command(wm, "focus output up"));
+	CHECK(sent("workspace next_on_output\n"
+			   "workspace prev_on_output; workspace prev_on_output; workspace prev_on_output\n"
+			   "focus output up\n"));
+	mock_wm_close(wm);
+}
+
+static void parses_workspaces(void)
+{
+	wm_backend* wm = mock_wm(true);
+	if (!CHECK(wm))
+		return;
+
+	// only the focused output's, in i3's order
+	focus_workspace("2");
+	char* names = wm->list_workspaces(wm);
+	CHECK(names && strcmp(names, "1\n2\n3") == 0);
+	free(names);
+
+	focus_workspace("9");
+	names = wm->list_workspaces(wm);
+	CHECK(names && strcmp(names, "9") == 0);
+	free(names);
+
+	// entries without a name are skipped, a focused one included
+	mock_server_set_workspaces(g_server, "[{\"output\":\"A\",\"focused\":true},{\"name\":\"4\",\"output\":\"A\"},{\"name\":\"5\",\"output\":\"B\"}]");
+	names = wm->list_workspaces(wm);
+	CHECK(names && strcmp(names, "4") == 0);
+	free(names);
+
+	mock_server_set_workspaces(g_server, "{\"error\":\"not a list\"}");
+	CHECK(!wm->list_workspaces(wm));
+	mock_wm_close(wm);
+}
+
+static void no_wrap_stops_at_both_ends(void)
+{
+	wm_backend* wm = mock_wm(false);
+	if (!CHECK(wm))
+		return;
+
+	// staying put at an end is not a failure, and sends nothing
+	focus_workspace("1");
+	CHECK(wm->switch_workspace(wm, -1));
+	CHECK(sent(""));
+	CHECK(wm->switch_workspace(wm, 1));
+	CHECK(sent("workspace \"2\"\n"));
+
+	focus_workspace("3");
+	CHECK(wm->switch_workspace(wm, 1));
+	CHECK(wm->switch_workspace(wm, 4));
+	CHECK(sent(""));
+	// a fling past the first stops on it, and the other output is not in the way
+	CHECK(wm->switch_workspace(wm, -5));
+	CHECK(sent("workspace \"1\"\n"));
+
+	// a focused workspace without a name is nowhere on the output
+	mock_server_set_workspaces(g_server, "[{\"output\":\"A\",\"focused\":true},{\"name\":\"4\",\"output\":\"A\"}]");
+	CHECK(!wm->switch_workspace(wm, 1));
+	CHECK(sent(""));
+	mock_wm_close(wm);
+}
+
+static void quotes_workspace_names(void)
+{
+	wm_backend* wm = mock_wm(false);
+	if (!CHECK(wm))
+		return;
+
+	mock_server_set_workspaces(g_server, "[{\"name\":\"1\",\"output\":\"A\",\"focused\":true},"
+										 "{\"name\":\"2: \\\"web\\\" C:\\\\\",\"output\":\"A\"}]");
+	CHECK(wm->switch_workspace(wm, 1));
+	CHECK(sent("workspace \"2: \\\"web\\\" C:\\\\\"\n"));
+	mock_wm_close(wm);
+}
+
+typedef struct {
+	wm_backend* wm;
+	pthread_mutex_t lock;
+	char focused[8][32];
+	int count;
+	int rc;
+} subscription;
+
+static void on_focus(void* userdata, const char* workspace)
+{
+	subscription* sub = userdata;
+	pthread_mutex_lock(&sub->lock);
+	if (sub->count < 8)
+		snprintf(sub->focused[sub->count++], sizeof(sub->focused[0]), "%s", workspace);
+	pthread_mutex_unlock(&sub->lock);
+}
+
+static void* subscribe_thread(void* arg)
+{
+	subscription* sub = arg;
+	sub->rc = sub->wm->subscribe(sub->wm, on_focus, sub);
+	return NULL;
+}
+
+static int focus_count(subscription* sub)
+{
+	pthread_mutex_lock(&sub->lock);
+	int count = sub->count;
+	pthread_mutex_unlock(&sub->lock);
+	return count;
+}
+
+static bool wait_for(int (*poll)(void*), void* arg, int value)
+{
+	for (int spins = 0; spins < 1000; spins++) {
+		if (poll(arg) >= value)
+			return true;
+		nanosleep(&(struct timespec) { 0, 1000000 }, NULL);
+	}
+	return false;
+}
+
+static int poll_subscribers(void* arg)
+{
+	return mock_server_subscribers(arg);
+}
+
+static int poll_focus(void* arg)
+{
+	return focus_count(arg);
+}
+
+static void subscribe_reports_focus(void)
+{
+	wm_backend* wm = mock_wm(true);
+	if (!CHECK(wm))
+		return;
+
+	static subscription sub;
+	sub.wm = wm;
+	sub.count = 0;
+	sub.rc = -2;
+	pthread_mutex_init(&sub.lock, NULL);
+	pthread_t thread;
+	if (!CHECK(pthread_create(&thread, NULL, subscribe_thread, &sub) == 0)) {
+		mock_wm_close(wm);
+		return;
+	}
+	CHECK(wait_for(poll_subscribers, g_server, 1));
+
+	// only focus changes reach the callback
+	mock_server_event(g_server, I3IPC_EVENT_WORKSPACE, "{\"change\":\"init\",\"current\":{\"name\":\"7\"}}");
+	mock_server_event(g_server, I3IPC_EVENT_WORKSPACE, "{\"change\":\"focus\",\"current\":{\"name\":\"3\"},\"old\":{\"name\":\"1\"}}");
+	mock_server_event(g_server, I3IPC_EVENT_WORKSPACE | 1, "{\"change\":\"focus\",\"current\":{\"name\":\"8\"}}");
+	mock_server_event(g_server, I3IPC_EVENT_WORKSPACE, "{\"change\":\"focus\",\"current\":{}}");
+	mock_server_event(g_server, I3IPC_EVENT_WORKSPACE, "{\"change\":\"focus\",\"current\":{\"name\":\"2\"}}");
+	CHECK(wait_for(poll_focus, &sub, 2));
+
+	// and requests on the other connections still go through meanwhile
+	CHECK(wm->run_command(wm, "nop"));
+	CHECK(sent("nop\n"));
+
+	// the subscription lasts until the connection ends
+	mock_server_stop(g_server);
+	pthread_join(thread, NULL);
+	CHECK_EQ(sub.rc, 0);
+	CHECK_EQ(sub.count, 2);
+	CHECK(strcmp(sub.focused[0], "3") == 0);
+	CHECK(strcmp(sub.focused[1], "2") == 0);
+	wm->close(wm);
+	pthread_mutex_destroy(&sub.lock);
+}
+
+void test_i3(void)
+{
+	test_run("i3/sends_commands", sends_commands);
+	test_run("i3/parses_workspaces", parses_workspaces);
+	test_run("i3/no_wrap_stops_at_both_ends", no_wrap_stops_at_both_ends);
+	test_run("i3/quotes_workspace_names", quotes_workspace_names);
+	test_run("i3/subscribe_reports_focus", subscribe_reports_focus);
+}
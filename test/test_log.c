@@ -0,0 +1,93 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "test.h"
+
+// The asynchronous logger: a server error reply logged whole, and every
+// record accounted for when log_stop races the threads still logging.
+
+#define STOP_THREADS 4
+#define STOP_RECORDS 50
+
+// Reads file back from the start; caller frees.
+static char* contents(FILE* file, size_t* lines)
+{
+	fflush(file);
+	long size = ftell(file);
+	rewind(file);
+	char* text = calloc(1, (size_t)size + 1);
+	if (text && fread(text, 1, (size_t)size, file) != (size_t)size)
+		text[0] = '\0';
+	*lines = 0;
+	for (char* p = text; p && *p; p++)
+		*lines += *p == '\n';
+	return text;
+}
+
+static void keeps_long_error_replies(void)
+{
+	FILE* file = tmpfile();
+	if (!CHECK(file))
+		return;
+
+	// about what AeroSpace says about a command it does not know
+	char reply[300];
+	memset(reply, 'e', sizeof(reply) - 1);
+	reply[sizeof(reply) - 1] = '\0';
+
+	log_stats before, after;
+	log_stats_get(&before);
+	CHECK(log_start(LOG_INFO, file, file));
+	log_error("Error: Failed to switch workspace to '%s': %s", "workspace-with-a-long-name", reply);
+	log_stop();
+	log_stats_get(&after);
+
+	size_t lines;
+	char* text = contents(file, &lines);
+	CHECK_EQ(lines, 1);
+	CHECK(text && strstr(text, reply));
+	CHECK_EQ(after.truncated, before.truncated);
+	free(text);
+	fclose(file);
+}
+
+static void* log_records(void* arg)
+{
+	(void)arg;
+	for (int i = 0; i < STOP_RECORDS; i++)
+		log_info("record %d", i);
+	return NULL;
+}
+
+static void stop_loses_nothing(void)
+{
+	FILE* file = tmpfile();
+	if (!CHECK(file))
+		return;
+
+	log_stats before, after;
+	log_stats_get(&before);
+	CHECK(log_start(LOG_INFO, file, file));
+	pthread_t threads[STOP_THREADS];
+	for (int i = 0; i < STOP_THREADS; i++)
+		pthread_create(&threads[i], NULL, log_records, NULL);
+	log_stop();
+	for (int i = 0; i < STOP_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	log_stats_get(&after);
+
+	// each one written, before or after the stop, or counted as dropped
+	size_t lines;
+	free(contents(file, &lines));
+	CHECK_EQ(lines + (after.dropped - before.dropped), STOP_THREADS * STOP_RECORDS);
+	fclose(file);
+}
+
+void test_log(void)
+{
+	test_run("log/keeps_long_error_replies", keeps_long_error_replies);
+	test_run("log/stop_loses_nothing", stop_loses_nothing);
+}
@@ -0,0 +1,156 @@
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "switch_queue.h"
+#include "test.h"
+
+// The switch queue against a backend that records what it is sent and can
+// hold the switch thread inside a call, so commands pile up behind it the
+// way they do behind a slow window manager.
+
+#define FAKE_LOG_MAX 64
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool hold; // calls wait until released
+	bool inside; // the switch thread is in a call
+	char log[FAKE_LOG_MAX][SWITCH_COMMAND_MAX];
+	int count;
+} fake_wm;
+
+static bool fake_call(wm_backend* wm, const char* entry)
+{
+	fake_wm* fake = wm->impl;
+	pthread_mutex_lock(&fake->lock);
+	if (fake->count < FAKE_LOG_MAX)
+		snprintf(fake->log[fake->count++], SWITCH_COMMAND_MAX, "%s", entry);
+	fake->inside = true;
+	pthread_cond_broadcast(&fake->cond);
+	while (fake->hold)
+		pthread_cond_wait(&fake->cond, &fake->lock);
+	fake->inside = false;
+	pthread_mutex_unlock(&fake->lock);
+	return true;
+}
+
+static bool fake_switch(wm_backend* wm, int direction)
+{
+	char entry[32];
+	snprintf(entry, sizeof(entry), "steps %+d", direction);
+	return fake_call(wm, entry);
+}
+
+static bool fake_run(wm_backend* wm, const char* command)
+{
+	return fake_call(wm, command);
+}
+
+static fake_wm g_fake;
+static wm_backend g_wm = { .name = "fake", .impl = &g_fake, .switch_workspace = fake_switch, .run_command = fake_run };
+static swipe_stats g_stats;
+
+static void fake_reset(void)
+{
+	pthread_mutex_init(&g_fake.lock, NULL);
+	pthread_cond_init(&g_fake.cond, NULL);
+	g_fake.hold = false;
+	g_fake.inside = false;
+	g_fake.count = 0;
+	stats_init(&g_stats);
+}
+
+// Sends one step and waits until the switch thread is holding it.
+static void hold_thread(switch_queue* q)
+{
+	pthread_mutex_lock(&g_fake.lock);
+	g_fake.hold = true;
+	pthread_mutex_unlock(&g_fake.lock);
+	switch_queue_steps(q, 1);
+	pthread_mutex_lock(&g_fake.lock);
+	while (!g_fake.inside)
+		pthread_cond_wait(&g_fake.cond, &g_fake.lock);
+	pthread_mutex_unlock(&g_fake.lock);
+}
+
+// Lets the switch thread go and waits until the backend has had that many
+// calls and nothing is waiting or in flight.
+static void release_and_drain(switch_queue* q, int calls)
+{
+	pthread_mutex_lock(&g_fake.lock);
+	g_fake.hold = false;
+	pthread_cond_broadcast(&g_fake.cond);
+	pthread_mutex_unlock(&g_fake.lock);
+	for (int spins = 0; spins < 1000; spins++) {
+		int steps, actions;
+		switch_queue_pending(q, &steps, &actions);
+		pthread_mutex_lock(&g_fake.lock);
+		bool idle = !g_fake.inside && g_fake.count >= calls;
+		pthread_mutex_unlock(&g_fake.lock);
+		if (!steps && !actions && idle)
+			return;
+		nanosleep(&(struct timespec) { 0, 1000000 }, NULL);
+	}
+}
+
+static void flood_keeps_two_waiting(void)
+{
+	fake_reset();
+	static switch_queue q;
+	if (!CHECK(switch_queue_start(&q, &g_wm, &g_stats, 0, 0)))
+		return;
+
+	hold_thread(&q);
+	char command[32];
+	for (int i = 0; i < 100; i++) {
+		switch_queue_steps(&q, 1);
+		snprintf(command, sizeof(command), "workspace %d", i);
+		CHECK_EQ(switch_queue_action(&q, command), i == 0);
+	}
+	CHECK_EQ(q.peak_depth, SWITCH_QUEUE_DEPTH);
+	CHECK_EQ(atomic_load(&g_stats.dropped), 99);
+	release_and_drain(&q, 3);
+	switch_queue_stop(&q);
+
+	// the held step, then the net steps, fired first, then the latest command
+	CHECK_EQ(g_fake.count, 3);
+	CHECK(strcmp(g_fake.log[0], "steps +1") == 0);
+	CHECK(strcmp(g_fake.log[1], "steps +100") == 0);
+	CHECK(strcmp(g_fake.log[2], "workspace 99") == 0);
+}
+
+static void command_fired_first_goes_first(void)
+{
+	fake_reset();
+	static switch_queue q;
+	if (!CHECK(switch_queue_start(&q, &g_wm, &g_stats, 0, 0)))
+		return;
+
+	hold_thread(&q);
+	CHECK(switch_queue_action(&q, "fullscreen"));
+	switch_queue_steps(&q, -2);
+	release_and_drain(&q, 3);
+
+	CHECK_EQ(g_fake.count, 3);
+	CHECK(strcmp(g_fake.log[1], "fullscreen") == 0);
+	CHECK(strcmp(g_fake.log[2], "steps -2") == 0);
+
+	// and steps fired ahead of a command still go ahead of it
+	hold_thread(&q);
+	switch_queue_steps(&q, 1);
+	CHECK(switch_queue_action(&q, "fullscreen"));
+	release_and_drain(&q, 6);
+	switch_queue_stop(&q);
+
+	CHECK_EQ(g_fake.count, 6);
+	CHECK(strcmp(g_fake.log[4], "steps +1") == 0);
+	CHECK(strcmp(g_fake.log[5], "fullscreen") == 0);
+	CHECK(q.peak_depth <= SWITCH_QUEUE_DEPTH);
+}
+
+void test_switch_queue(void)
+{
+	test_run("switch_queue/flood_keeps_two_waiting", flood_keeps_two_waiting);
+	test_run("switch_queue/command_fired_first_goes_first", command_fired_first_goes_first);
+}
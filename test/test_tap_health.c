@@ -0,0 +1,119 @@
+#include "tap_health.h"
+#include "test.h"
+
+#define MS (1000ull * 1000)
+
+static unsigned long long load(atomic_ullong* counter)
+{
+	return atomic_load(counter);
+}
+
+static void counts_callbacks(void)
+{
+	tap_health h;
+	tap_health_init(&h);
+
+	tap_health_callback(&h, 1000, 1000 + 20000, true);
+	tap_health_callback(&h, 2000, 2000 + 20000, false);
+	tap_health_callback(&h, 3000, 3000 + TAP_SLOW_CALLBACK_NS + 1, true);
+	// a clock that steps back counts as an instant callback, not a huge one
+	tap_health_callback(&h, 5000, 4000, false);
+
+	CHECK_EQ(load(&h.callbacks), 4);
+	CHECK_EQ(load(&h.gestures), 2);
+	CHECK_EQ(load(&h.slow), 1);
+	CHECK_EQ(h.callback.count, 4);
+	CHECK(h.callback.max > TAP_SLOW_CALLBACK_NS);
+
+	uint64_t p99, max;
+	tap_health_callback_summary(&h, &p99, &max);
+	CHECK_EQ(max, TAP_SLOW_CALLBACK_NS + 1);
+	CHECK(p99 <= max);
+}
+
+static void measures_rate_per_window(void)
+{
+	tap_health h;
+	tap_health_init(&h);
+
+	// 120 callbacks a second; the rate appears once a full window has passed
+	uint64_t t = 1000;
+	for (int i = 0; i < 120; i++, t += TAP_RATE_WINDOW_NS / 120)
+		tap_health_callback(&h, t, t + 10000, true);
+	CHECK(h.rate == 0);
+	tap_health_callback(&h, t, t + 10000, true);
+	CHECK(h.rate > 115 && h.rate < 125);
+
+	// a slower window keeps the peak from the faster one
+	for (int i = 0; i < 62; i++, t += TAP_RATE_WINDOW_NS / 60)
+		tap_health_callback(&h, t, t + 10000, true);
+	CHECK(h.rate > 55 && h.rate < 65);
+	CHECK(h.peak_rate > 115 && h.peak_rate < 125);
+}
+
+static void counts_disables_by_kind(void)
+{
+	tap_health h;
+	tap_health_init(&h);
+
+	CHECK_EQ(tap_health_disabled(&h, true), 1);
+	CHECK_EQ(tap_health_disabled(&h, true), 2);
+	CHECK_EQ(tap_health_disabled(&h, false), 1);
+	CHECK_EQ(load(&h.timeout_disables), 2);
+	CHECK_EQ(load(&h.user_disables), 1);
+}
+
+static void reset_clears_everything(void)
+{
+	tap_health h;
+	tap_health_init(&h);
+	for (uint64_t t = 0; t < 2 * TAP_RATE_WINDOW_NS; t += 10 * MS)
+		tap_health_callback(&h, t + 1, t + 1 + 2 * TAP_SLOW_CALLBACK_NS, true);
+	tap_health_conversion(&h, 5000);
+	tap_health_disabled(&h, true);
+
+	tap_health_reset(&h);
+	CHECK_EQ(load(&h.callbacks), 0);
+	CHECK_EQ(load(&h.gestures), 0);
+	CHECK_EQ(load(&h.slow), 0);
+	CHECK_EQ(load(&h.timeout_disables), 0);
+	CHECK_EQ(h.callback.count, 0);
+	CHECK_EQ(h.conversion.count, 0);
+	CHECK(h.rate == 0 && h.peak_rate == 0);
+
+	// the window restarts from the next callback
+	tap_health_callback(&h, 5 * TAP_RATE_WINDOW_NS, 5 * TAP_RATE_WINDOW_NS + 1000, false);
+	CHECK(h.rate == 0);
+}
+
+static void reports_json(void)
+{
+	tap_health h;
+	tap_health_init(&h);
+	tap_health_callback(&h, 1000, 21000, true);
+	tap_health_conversion(&h, 3000);
+	tap_health_disabled(&h, false);
+
+	yyjson_mut_doc* doc = yyjson_mut_doc_new(NULL);
+	yyjson_mut_val* root = yyjson_mut_obj(doc);
+	yyjson_mut_doc_set_root(doc, root);
+	tap_health_to_json(&h, doc, root);
+
+	CHECK_EQ(yyjson_mut_get_uint(yyjson_mut_obj_get(root, "callbacks")), 1);
+	CHECK_EQ(yyjson_mut_get_uint(yyjson_mut_obj_get(root, "gestures")), 1);
+	CHECK_EQ(yyjson_mut_get_uint(yyjson_mut_obj_get(root, "user_disables")), 1);
+	yyjson_mut_val* callback = yyjson_mut_obj_get(root, "callback");
+	CHECK(callback != NULL);
+	CHECK_EQ(yyjson_mut_get_uint(yyjson_mut_obj_get(callback, "count")), 1);
+	CHECK_EQ(yyjson_mut_get_uint(yyjson_mut_obj_get(yyjson_mut_obj_get(root, "conversion"), "count")), 1);
+	yyjson_mut_doc_free(doc);
+}
+
+void test_tap_health(void)
+{
+	test_run("tap_health/counts_callbacks", counts_callbacks);
+	test_run("tap_health/measures_rate_per_window", measures_rate_per_window);
+	test_run("tap_health/counts_disables_by_kind", counts_disables_by_kind);
+	test_run("tap_health/reset_clears_everything", reset_clears_everything);
+	test_run("tap_health/reports_json", reports_json);
+}